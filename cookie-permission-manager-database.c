@@ -0,0 +1,655 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+#include "cookie-permission-manager-database.h"
+#include "cookie-permission-manager.h"
+
+#include <string.h>
+
+struct _CookiePermissionManagerStatementRegistry
+{
+	sqlite3			*database;
+	sqlite3_stmt	*statements[COOKIE_PERMISSION_MANAGER_STATEMENT_LAST];
+};
+
+/* IMPLEMENTATION: Private variables and methods */
+
+/* SQL of statements in registry - must be in same order as CookiePermissionManagerStatement */
+static const gchar	*_cookie_permission_manager_statement_sql[COOKIE_PERMISSION_MANAGER_STATEMENT_LAST]=
+{
+	/* COOKIE_PERMISSION_MANAGER_STATEMENT_SELECT_ALL */
+	"SELECT domain, value FROM policies;",
+
+	/* COOKIE_PERMISSION_MANAGER_STATEMENT_SELECT_ALL_KEYS */
+	"SELECT rdomain FROM policies;",
+
+	/* COOKIE_PERMISSION_MANAGER_STATEMENT_SELECT_BY_KEY */
+	"SELECT value FROM policies WHERE rdomain=?;",
+
+	/* COOKIE_PERMISSION_MANAGER_STATEMENT_INSERT */
+	"INSERT OR REPLACE INTO policies (domain, rdomain, value) VALUES (?, ?, ?);",
+
+	/* COOKIE_PERMISSION_MANAGER_STATEMENT_DELETE */
+	"DELETE FROM policies WHERE rdomain=?;",
+
+	/* COOKIE_PERMISSION_MANAGER_STATEMENT_DELETE_ALL */
+	"DELETE FROM policies;",
+
+	/* COOKIE_PERMISSION_MANAGER_STATEMENT_SELECT_ALL_PATTERNS */
+	"SELECT pattern, value FROM patterns;",
+
+	/* COOKIE_PERMISSION_MANAGER_STATEMENT_INSERT_PATTERN */
+	"INSERT OR REPLACE INTO patterns (pattern, value) VALUES (?, ?);",
+
+	/* COOKIE_PERMISSION_MANAGER_STATEMENT_DELETE_PATTERN */
+	"DELETE FROM patterns WHERE pattern=?;",
+
+	/* COOKIE_PERMISSION_MANAGER_STATEMENT_DELETE_ALL_PATTERNS */
+	"DELETE FROM patterns;",
+
+	/* COOKIE_PERMISSION_MANAGER_STATEMENT_BEGIN */
+	"BEGIN;",
+
+	/* COOKIE_PERMISSION_MANAGER_STATEMENT_COMMIT */
+	"COMMIT;",
+
+	/* COOKIE_PERMISSION_MANAGER_STATEMENT_ROLLBACK */
+	"ROLLBACK;",
+
+	/* COOKIE_PERMISSION_MANAGER_STATEMENT_COUNT_ALL */
+	"SELECT (SELECT COUNT(*) FROM policies)+(SELECT COUNT(*) FROM patterns);",
+
+	/* COOKIE_PERMISSION_MANAGER_STATEMENT_SELECT_ALL_SESSION */
+	"SELECT domain FROM session_policies;",
+
+	/* COOKIE_PERMISSION_MANAGER_STATEMENT_DELETE_ALL_SESSION */
+	"DELETE FROM session_policies;"
+};
+
+/* Copy error message of database to a string which can be freed with sqlite3_free()
+ * like error messages returned by sqlite3_exec()
+ */
+static void _cookie_permission_manager_database_set_error(sqlite3 *inDatabase, gchar **outError)
+{
+	if(outError && !*outError) *outError=sqlite3_mprintf("%s", sqlite3_errmsg(inDatabase));
+}
+
+/* Migrate to version 1: Store canonical reversed domain key and number of labels
+ * for each domain so parent domains can be found by indexed equality lookups
+ */
+static gint _cookie_permission_manager_database_migrate_version_1(sqlite3 *inDatabase, gchar **outError)
+{
+	sqlite3_stmt		*selectStatement=NULL;
+	sqlite3_stmt		*updateStatement=NULL;
+	gint				success;
+
+	/* Add new columns */
+	success=sqlite3_exec(inDatabase,
+							"ALTER TABLE policies ADD COLUMN rdomain text;",
+							NULL,
+							NULL,
+							outError);
+
+	if(success==SQLITE_OK)
+	{
+		success=sqlite3_exec(inDatabase,
+								"ALTER TABLE policies ADD COLUMN labels integer;",
+								NULL,
+								NULL,
+								outError);
+	}
+
+	/* Fill in new columns for all existing domains */
+	if(success==SQLITE_OK)
+	{
+		success=sqlite3_prepare_v2(inDatabase,
+									"SELECT rowid, domain FROM policies;",
+									-1,
+									&selectStatement,
+									NULL);
+	}
+
+	if(success==SQLITE_OK)
+	{
+		success=sqlite3_prepare_v2(inDatabase,
+									"UPDATE policies SET rdomain=?, labels=? WHERE rowid=?;",
+									-1,
+									&updateStatement,
+									NULL);
+	}
+
+	if(success==SQLITE_OK)
+	{
+		while(success==SQLITE_OK && sqlite3_step(selectStatement)==SQLITE_ROW)
+		{
+			gchar		*key;
+			gint		labels;
+
+			key=cookie_permission_manager_database_get_domain_key((gchar*)sqlite3_column_text(selectStatement, 1), &labels);
+
+			success=sqlite3_bind_text(updateStatement, 1, key, -1, g_free);
+			if(success==SQLITE_OK) success=sqlite3_bind_int(updateStatement, 2, labels);
+			if(success==SQLITE_OK) success=sqlite3_bind_int64(updateStatement, 3, sqlite3_column_int64(selectStatement, 0));
+			if(success==SQLITE_OK && sqlite3_step(updateStatement)!=SQLITE_DONE) success=sqlite3_errcode(inDatabase);
+
+			sqlite3_reset(updateStatement);
+		}
+	}
+
+	if(success!=SQLITE_OK) _cookie_permission_manager_database_set_error(inDatabase, outError);
+
+	sqlite3_finalize(updateStatement);
+	sqlite3_finalize(selectStatement);
+
+	/* Create index on domain key */
+	if(success==SQLITE_OK)
+	{
+		success=sqlite3_exec(inDatabase,
+								"CREATE INDEX IF NOT EXISTS rdomain ON policies (rdomain);",
+								NULL,
+								NULL,
+								outError);
+	}
+
+	return(success);
+}
+
+/* Migrate to version 2: Store policies for domain patterns containing wildcards
+ * in a table of their own
+ */
+static gint _cookie_permission_manager_database_migrate_version_2(sqlite3 *inDatabase, gchar **outError)
+{
+	return(sqlite3_exec(inDatabase,
+						"CREATE TABLE IF NOT EXISTS "
+						"patterns(pattern text PRIMARY KEY, value integer);",
+						NULL,
+						NULL,
+						outError));
+}
+
+/* Migrate to version 3: Decisions for one session only are kept in memory and
+ * never stored so remove any stored by earlier versions. Their domains are moved
+ * to a table of legacy session domains whose cookies are purged once after migration.
+ */
+static gint _cookie_permission_manager_database_migrate_version_3(sqlite3 *inDatabase, gchar **outError)
+{
+	gchar		*sql;
+	gint		success;
+
+	sql=sqlite3_mprintf("CREATE TABLE IF NOT EXISTS session_policies(domain text PRIMARY KEY);"
+						"INSERT OR IGNORE INTO session_policies (domain) SELECT lower(ltrim(domain, '.')) FROM policies WHERE value=%d;"
+						"INSERT OR IGNORE INTO session_policies (domain) SELECT lower(ltrim(pattern, '.')) FROM patterns WHERE value=%d;"
+						"DELETE FROM policies WHERE value=%d;"
+						"DELETE FROM patterns WHERE value=%d;",
+						COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION,
+						COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION,
+						COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION,
+						COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION);
+	success=sqlite3_exec(inDatabase, sql, NULL, NULL, outError);
+	sqlite3_free(sql);
+
+	return(success);
+}
+
+/* Migrate to version 4: Databases migrated to version 3 before lack the table of
+ * legacy session domains
+ */
+static gint _cookie_permission_manager_database_migrate_version_4(sqlite3 *inDatabase, gchar **outError)
+{
+	return(sqlite3_exec(inDatabase,
+						"CREATE TABLE IF NOT EXISTS "
+						"session_policies(domain text PRIMARY KEY);",
+						NULL,
+						NULL,
+						outError));
+}
+
+/* Migrate to version 5: Domain key is unique so a domain stored with a different
+ * case or leading dot replaces the existing policy instead of being added next to
+ * it. Only the policy stored last is kept of duplicates stored before. The number
+ * of labels is not needed as parent domains are found by their keys and the unique
+ * index on domain is dropped so the domain key is the only conflict target. Table
+ * is rebuilt as columns cannot be dropped by older versions of SQLite.
+ */
+static gint _cookie_permission_manager_database_migrate_version_5(sqlite3 *inDatabase, gchar **outError)
+{
+	return(sqlite3_exec(inDatabase,
+						"DELETE FROM policies WHERE rowid NOT IN (SELECT MAX(rowid) FROM policies GROUP BY rdomain);"
+						"CREATE TABLE policies_version_5(domain text, rdomain text, value integer);"
+						"INSERT INTO policies_version_5 (domain, rdomain, value) SELECT domain, rdomain, value FROM policies;"
+						"DROP TABLE policies;"
+						"ALTER TABLE policies_version_5 RENAME TO policies;"
+						"CREATE UNIQUE INDEX rdomain ON policies (rdomain);",
+						NULL,
+						NULL,
+						outError));
+}
+
+/* Execute a statement of registry which does not return any row */
+static gint _cookie_permission_manager_database_execute(CookiePermissionManagerStatementRegistry *inStatements,
+														CookiePermissionManagerStatement inStatement)
+{
+	sqlite3_stmt	*statement;
+	gint			success=SQLITE_OK;
+
+	statement=cookie_permission_manager_statement_registry_get(inStatements, inStatement);
+	if(!statement) return(sqlite3_errcode(inStatements->database));
+
+	if(sqlite3_step(statement)!=SQLITE_DONE) success=sqlite3_errcode(inStatements->database);
+
+	sqlite3_reset(statement);
+
+	return(success);
+}
+
+/* IMPLEMENTATION: Public API */
+
+/* Get schema version of database. Returns SQLITE_OK on success otherwise the
+ * error code and the error message in outError which must be freed with sqlite3_free().
+ */
+gint cookie_permission_manager_database_get_version(sqlite3 *inDatabase, gint *outVersion, gchar **outError)
+{
+	sqlite3_stmt		*statement=NULL;
+	gint				success;
+
+	g_return_val_if_fail(inDatabase, SQLITE_MISUSE);
+	g_return_val_if_fail(outVersion, SQLITE_MISUSE);
+
+	success=sqlite3_prepare_v2(inDatabase, "PRAGMA user_version;", -1, &statement, NULL);
+	if(statement && success==SQLITE_OK)
+	{
+		success=sqlite3_step(statement);
+		if(success==SQLITE_ROW)
+		{
+			*outVersion=sqlite3_column_int(statement, 0);
+			success=SQLITE_OK;
+		}
+	}
+
+	if(success!=SQLITE_OK) _cookie_permission_manager_database_set_error(inDatabase, outError);
+
+	sqlite3_finalize(statement);
+
+	return(success);
+}
+
+/* Migrate database schema to current version. The table structure of version 0
+ * must already exist. All migrations are done in one transaction. Returns SQLITE_OK
+ * on success otherwise the error code and the error message in outError which must
+ * be freed with sqlite3_free().
+ */
+gint cookie_permission_manager_database_migrate(sqlite3 *inDatabase, gchar **outError)
+{
+	gint		version=0;
+	gint		success;
+	gchar		*sql;
+
+	g_return_val_if_fail(inDatabase, SQLITE_MISUSE);
+
+	/* Check if database is up to date */
+	success=cookie_permission_manager_database_get_version(inDatabase, &version, outError);
+	if(success!=SQLITE_OK || version>=COOKIE_PERMISSION_DATABASE_VERSION) return(success);
+
+	/* Migrate database step by step */
+	success=sqlite3_exec(inDatabase, "BEGIN;", NULL, NULL, outError);
+	if(success!=SQLITE_OK) return(success);
+
+	if(success==SQLITE_OK && version<1) success=_cookie_permission_manager_database_migrate_version_1(inDatabase, outError);
+	if(success==SQLITE_OK && version<2) success=_cookie_permission_manager_database_migrate_version_2(inDatabase, outError);
+	if(success==SQLITE_OK && version<3) success=_cookie_permission_manager_database_migrate_version_3(inDatabase, outError);
+	if(success==SQLITE_OK && version<4) success=_cookie_permission_manager_database_migrate_version_4(inDatabase, outError);
+	if(success==SQLITE_OK && version<5) success=_cookie_permission_manager_database_migrate_version_5(inDatabase, outError);
+
+	if(success==SQLITE_OK)
+	{
+		sql=sqlite3_mprintf("PRAGMA user_version=%d;", COOKIE_PERMISSION_DATABASE_VERSION);
+		success=sqlite3_exec(inDatabase, sql, NULL, NULL, outError);
+		sqlite3_free(sql);
+	}
+
+	if(success==SQLITE_OK) success=sqlite3_exec(inDatabase, "COMMIT;", NULL, NULL, outError);
+		else sqlite3_exec(inDatabase, "ROLLBACK;", NULL, NULL, NULL);
+
+	return(success);
+}
+
+/* Set up journal and synchronisation of database connection for durability profile.
+ * It must be applied to every connection as synchronisation is set per connection.
+ *  - Strict: Rollback journal and full sync at each commit (blocks readers while writing)
+ *  - WAL: Write-ahead log synced at checkpoints only so readers never block writers
+ *  - Memory-first: Write-ahead log never synced and only checkpointed when
+ *    the owner of the connection calls sqlite3_wal_checkpoint_v2() periodically
+ * Returns SQLITE_OK on success otherwise the error code and the error message
+ * in outError which must be freed with sqlite3_free().
+ */
+gint cookie_permission_manager_database_set_durability(sqlite3 *inDatabase, gint inDurability, gchar **outError)
+{
+	const gchar		*sql;
+
+	g_return_val_if_fail(inDatabase, SQLITE_MISUSE);
+
+	switch(inDurability)
+	{
+		case COOKIE_PERMISSION_MANAGER_DURABILITY_WAL:
+			sql="PRAGMA journal_mode=WAL;"
+				"PRAGMA synchronous=NORMAL;"
+				"PRAGMA wal_autocheckpoint=1000;";
+			break;
+
+		case COOKIE_PERMISSION_MANAGER_DURABILITY_MEMORY_FIRST:
+			sql="PRAGMA journal_mode=WAL;"
+				"PRAGMA synchronous=OFF;"
+				"PRAGMA wal_autocheckpoint=0;";
+			break;
+
+		case COOKIE_PERMISSION_MANAGER_DURABILITY_STRICT:
+		default:
+			sql="PRAGMA journal_mode=TRUNCATE;"
+				"PRAGMA synchronous=FULL;";
+			break;
+	}
+
+	/* Wait for other connections instead of failing at once */
+	sqlite3_busy_timeout(inDatabase, COOKIE_PERMISSION_DATABASE_BUSY_TIMEOUT);
+
+	return(sqlite3_exec(inDatabase, sql, NULL, NULL, outError));
+}
+
+/* Get canonical key of domain stored in database, i.e. the lower-cased domain with
+ * its labels in reversed order (e.g. www.Example.com becomes com.example.www).
+ * Each parent domain's key is a prefix of this key ending at a label boundary.
+ * Returned string must be freed with g_free().
+ */
+gchar* cookie_permission_manager_database_get_domain_key(const gchar *inDomain, gint *outLabels)
+{
+	GString		*key;
+	gchar		*domain;
+	gchar		*label, *end;
+	gint		labels=0;
+
+	g_return_val_if_fail(inDomain, NULL);
+
+	/* Strip leading dot of cookie domains and lower-case domain */
+	if(*inDomain=='.') inDomain++;
+	domain=g_ascii_strdown(inDomain, -1);
+
+	/* Append labels from end to start of domain */
+	key=g_string_sized_new(strlen(domain));
+
+	end=domain+strlen(domain);
+	while(end>domain)
+	{
+		label=end;
+		while(label>domain && *(label-1)!='.') label--;
+
+		if(label<end)
+		{
+			if(key->len>0) g_string_append_c(key, '.');
+			g_string_append_len(key, label, end-label);
+			labels++;
+		}
+
+		end=(label>domain ? label-1 : domain);
+	}
+
+	/* Free allocated resources */
+	g_free(domain);
+
+	if(outLabels) *outLabels=labels;
+	return(g_string_free(key, FALSE));
+}
+
+/* Create registry of prepared statements for database connection.
+ * The registry must be freed before the database connection is closed.
+ */
+CookiePermissionManagerStatementRegistry* cookie_permission_manager_statement_registry_new(sqlite3 *inDatabase)
+{
+	CookiePermissionManagerStatementRegistry	*self;
+
+	g_return_val_if_fail(inDatabase, NULL);
+
+	self=g_new0(CookiePermissionManagerStatementRegistry, 1);
+	self->database=inDatabase;
+
+	return(self);
+}
+
+/* Finalize all prepared statements and destroy registry */
+void cookie_permission_manager_statement_registry_free(CookiePermissionManagerStatementRegistry *self)
+{
+	gint			i;
+
+	g_return_if_fail(self);
+
+	for(i=0; i<COOKIE_PERMISSION_MANAGER_STATEMENT_LAST; i++)
+	{
+		if(self->statements[i]) sqlite3_finalize(self->statements[i]);
+	}
+
+	g_free(self);
+}
+
+/* Get prepared statement. It is prepared on first use and reset with all bindings
+ * cleared on each further use. Caller should call sqlite3_reset() on statement when
+ * done to release any lock held by it. Returns NULL if statement could not be prepared.
+ */
+sqlite3_stmt* cookie_permission_manager_statement_registry_get(CookiePermissionManagerStatementRegistry *self,
+																CookiePermissionManagerStatement inStatement)
+{
+	sqlite3_stmt	*statement;
+	gint			success;
+
+	g_return_val_if_fail(self, NULL);
+	g_return_val_if_fail(inStatement<COOKIE_PERMISSION_MANAGER_STATEMENT_LAST, NULL);
+
+	statement=self->statements[inStatement];
+	if(!statement)
+	{
+		success=sqlite3_prepare_v2(self->database,
+									_cookie_permission_manager_statement_sql[inStatement],
+									-1,
+									&statement,
+									NULL);
+		if(success!=SQLITE_OK)
+		{
+			if(statement) sqlite3_finalize(statement);
+			return(NULL);
+		}
+
+		self->statements[inStatement]=statement;
+	}
+		else
+		{
+			sqlite3_reset(statement);
+			sqlite3_clear_bindings(statement);
+		}
+
+	return(statement);
+}
+
+/* Get database connection statements are prepared for */
+sqlite3* cookie_permission_manager_statement_registry_get_database(CookiePermissionManagerStatementRegistry *self)
+{
+	g_return_val_if_fail(self, NULL);
+
+	return(self->database);
+}
+
+/* Get policy stored for domain itself (not any parent domain). Returns SQLITE_ROW
+ * if a policy was found, SQLITE_DONE if not or the error code otherwise.
+ */
+gint cookie_permission_manager_database_get_policy(CookiePermissionManagerStatementRegistry *inStatements,
+													const gchar *inDomain,
+													gint *outPolicy)
+{
+	sqlite3_stmt	*statement;
+	gchar			*key;
+	gint			success;
+
+	g_return_val_if_fail(inStatements, SQLITE_MISUSE);
+	g_return_val_if_fail(inDomain, SQLITE_MISUSE);
+
+	statement=cookie_permission_manager_statement_registry_get(inStatements, COOKIE_PERMISSION_MANAGER_STATEMENT_SELECT_BY_KEY);
+	if(!statement) return(sqlite3_errcode(inStatements->database));
+
+	key=cookie_permission_manager_database_get_domain_key(inDomain, NULL);
+
+	success=sqlite3_bind_text(statement, 1, key, -1, SQLITE_STATIC);
+	if(success==SQLITE_OK) success=sqlite3_step(statement);
+	if(success==SQLITE_ROW && outPolicy) *outPolicy=sqlite3_column_int(statement, 0);
+
+	sqlite3_reset(statement);
+	g_free(key);
+
+	return(success);
+}
+
+/* Store policy for domain together with its key. An existing policy of a domain
+ * with same key, e.g. stored with a different case, is replaced.
+ */
+gint cookie_permission_manager_database_set_policy(CookiePermissionManagerStatementRegistry *inStatements,
+													const gchar *inDomain,
+													gint inPolicy)
+{
+	sqlite3_stmt	*statement;
+	gchar			*key;
+	gint			success;
+
+	g_return_val_if_fail(inStatements, SQLITE_MISUSE);
+	g_return_val_if_fail(inDomain, SQLITE_MISUSE);
+
+	statement=cookie_permission_manager_statement_registry_get(inStatements, COOKIE_PERMISSION_MANAGER_STATEMENT_INSERT);
+	if(!statement) return(sqlite3_errcode(inStatements->database));
+
+	key=cookie_permission_manager_database_get_domain_key(inDomain, NULL);
+
+	success=sqlite3_bind_text(statement, 1, inDomain, -1, SQLITE_TRANSIENT);
+	if(success==SQLITE_OK) success=sqlite3_bind_text(statement, 2, key, -1, g_free);
+		else g_free(key);
+	if(success==SQLITE_OK) success=sqlite3_bind_int(statement, 3, inPolicy);
+	if(success==SQLITE_OK && sqlite3_step(statement)!=SQLITE_DONE) success=sqlite3_errcode(inStatements->database);
+
+	sqlite3_reset(statement);
+
+	return(success);
+}
+
+/* Remove policy of domain. It is matched by its key like lookups do so rows
+ * stored with a different case of domain are removed as well.
+ */
+gint cookie_permission_manager_database_remove_policy(CookiePermissionManagerStatementRegistry *inStatements,
+														const gchar *inDomain)
+{
+	sqlite3_stmt	*statement;
+	gint			success;
+
+	g_return_val_if_fail(inStatements, SQLITE_MISUSE);
+	g_return_val_if_fail(inDomain, SQLITE_MISUSE);
+
+	statement=cookie_permission_manager_statement_registry_get(inStatements, COOKIE_PERMISSION_MANAGER_STATEMENT_DELETE);
+	if(!statement) return(sqlite3_errcode(inStatements->database));
+
+	success=sqlite3_bind_text(statement, 1, cookie_permission_manager_database_get_domain_key(inDomain, NULL), -1, g_free);
+	if(success==SQLITE_OK && sqlite3_step(statement)!=SQLITE_DONE) success=sqlite3_errcode(inStatements->database);
+
+	sqlite3_reset(statement);
+
+	return(success);
+}
+
+/* Remove all policies of domains and patterns */
+gint cookie_permission_manager_database_remove_all_policies(CookiePermissionManagerStatementRegistry *inStatements)
+{
+	gint			success;
+
+	g_return_val_if_fail(inStatements, SQLITE_MISUSE);
+
+	success=_cookie_permission_manager_database_execute(inStatements, COOKIE_PERMISSION_MANAGER_STATEMENT_DELETE_ALL);
+	if(success==SQLITE_OK) success=_cookie_permission_manager_database_execute(inStatements, COOKIE_PERMISSION_MANAGER_STATEMENT_DELETE_ALL_PATTERNS);
+
+	return(success);
+}
+
+/* Group following changes into one transaction which must be ended by
+ * cookie_permission_manager_database_commit() or _rollback()
+ */
+gint cookie_permission_manager_database_begin(CookiePermissionManagerStatementRegistry *inStatements)
+{
+	g_return_val_if_fail(inStatements, SQLITE_MISUSE);
+
+	return(_cookie_permission_manager_database_execute(inStatements, COOKIE_PERMISSION_MANAGER_STATEMENT_BEGIN));
+}
+
+gint cookie_permission_manager_database_commit(CookiePermissionManagerStatementRegistry *inStatements)
+{
+	g_return_val_if_fail(inStatements, SQLITE_MISUSE);
+
+	return(_cookie_permission_manager_database_execute(inStatements, COOKIE_PERMISSION_MANAGER_STATEMENT_COMMIT));
+}
+
+void cookie_permission_manager_database_rollback(CookiePermissionManagerStatementRegistry *inStatements)
+{
+	g_return_if_fail(inStatements);
+
+	_cookie_permission_manager_database_execute(inStatements, COOKIE_PERMISSION_MANAGER_STATEMENT_ROLLBACK);
+}
+
+/* Store policy for domain pattern */
+gint cookie_permission_manager_database_set_pattern_policy(CookiePermissionManagerStatementRegistry *inStatements,
+															const gchar *inPattern,
+															gint inPolicy)
+{
+	sqlite3_stmt	*statement;
+	gint			success;
+
+	g_return_val_if_fail(inStatements, SQLITE_MISUSE);
+	g_return_val_if_fail(inPattern, SQLITE_MISUSE);
+
+	statement=cookie_permission_manager_statement_registry_get(inStatements, COOKIE_PERMISSION_MANAGER_STATEMENT_INSERT_PATTERN);
+	if(!statement) return(sqlite3_errcode(inStatements->database));
+
+	success=sqlite3_bind_text(statement, 1, inPattern, -1, SQLITE_TRANSIENT);
+	if(success==SQLITE_OK) success=sqlite3_bind_int(statement, 2, inPolicy);
+	if(success==SQLITE_OK && sqlite3_step(statement)!=SQLITE_DONE) success=sqlite3_errcode(inStatements->database);
+
+	sqlite3_reset(statement);
+
+	return(success);
+}
+
+/* Remove policy of domain pattern */
+gint cookie_permission_manager_database_remove_pattern_policy(CookiePermissionManagerStatementRegistry *inStatements,
+																const gchar *inPattern)
+{
+	sqlite3_stmt	*statement;
+	gint			success;
+
+	g_return_val_if_fail(inStatements, SQLITE_MISUSE);
+	g_return_val_if_fail(inPattern, SQLITE_MISUSE);
+
+	statement=cookie_permission_manager_statement_registry_get(inStatements, COOKIE_PERMISSION_MANAGER_STATEMENT_DELETE_PATTERN);
+	if(!statement) return(sqlite3_errcode(inStatements->database));
+
+	success=sqlite3_bind_text(statement, 1, inPattern, -1, SQLITE_TRANSIENT);
+	if(success==SQLITE_OK && sqlite3_step(statement)!=SQLITE_DONE) success=sqlite3_errcode(inStatements->database);
+
+	sqlite3_reset(statement);
+
+	return(success);
+}
+
+/* Forget all legacy session domains and domain patterns after their cookies were purged */
+gint cookie_permission_manager_database_remove_all_session_policies(CookiePermissionManagerStatementRegistry *inStatements)
+{
+	g_return_val_if_fail(inStatements, SQLITE_MISUSE);
+
+	return(_cookie_permission_manager_database_execute(inStatements, COOKIE_PERMISSION_MANAGER_STATEMENT_DELETE_ALL_SESSION));
+}
@@ -0,0 +1,89 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+#ifndef __COOKIE_PERMISSION_MANAGER_DATABASE__
+#define __COOKIE_PERMISSION_MANAGER_DATABASE__
+
+#include <glib.h>
+#include <sqlite3.h>
+
+G_BEGIN_DECLS
+
+/* Version of database schema stored in PRAGMA user_version */
+#define COOKIE_PERMISSION_DATABASE_VERSION		5
+
+/* Time in milliseconds to wait for database locked by another connection */
+#define COOKIE_PERMISSION_DATABASE_BUSY_TIMEOUT	5000
+
+/* Statements prepared once per database connection */
+typedef enum
+{
+	COOKIE_PERMISSION_MANAGER_STATEMENT_SELECT_ALL,
+	COOKIE_PERMISSION_MANAGER_STATEMENT_SELECT_ALL_KEYS,
+	COOKIE_PERMISSION_MANAGER_STATEMENT_SELECT_BY_KEY,
+	COOKIE_PERMISSION_MANAGER_STATEMENT_INSERT,
+	COOKIE_PERMISSION_MANAGER_STATEMENT_DELETE,
+	COOKIE_PERMISSION_MANAGER_STATEMENT_DELETE_ALL,
+	COOKIE_PERMISSION_MANAGER_STATEMENT_SELECT_ALL_PATTERNS,
+	COOKIE_PERMISSION_MANAGER_STATEMENT_INSERT_PATTERN,
+	COOKIE_PERMISSION_MANAGER_STATEMENT_DELETE_PATTERN,
+	COOKIE_PERMISSION_MANAGER_STATEMENT_DELETE_ALL_PATTERNS,
+	COOKIE_PERMISSION_MANAGER_STATEMENT_BEGIN,
+	COOKIE_PERMISSION_MANAGER_STATEMENT_COMMIT,
+	COOKIE_PERMISSION_MANAGER_STATEMENT_ROLLBACK,
+	COOKIE_PERMISSION_MANAGER_STATEMENT_COUNT_ALL,
+	COOKIE_PERMISSION_MANAGER_STATEMENT_SELECT_ALL_SESSION,
+	COOKIE_PERMISSION_MANAGER_STATEMENT_DELETE_ALL_SESSION,
+
+	COOKIE_PERMISSION_MANAGER_STATEMENT_LAST
+} CookiePermissionManagerStatement;
+
+typedef struct _CookiePermissionManagerStatementRegistry	CookiePermissionManagerStatementRegistry;
+
+/* Public API */
+gint cookie_permission_manager_database_get_version(sqlite3 *inDatabase, gint *outVersion, gchar **outError);
+gint cookie_permission_manager_database_migrate(sqlite3 *inDatabase, gchar **outError);
+gint cookie_permission_manager_database_set_durability(sqlite3 *inDatabase, gint inDurability, gchar **outError);
+
+gchar* cookie_permission_manager_database_get_domain_key(const gchar *inDomain, gint *outLabels);
+
+CookiePermissionManagerStatementRegistry* cookie_permission_manager_statement_registry_new(sqlite3 *inDatabase);
+void cookie_permission_manager_statement_registry_free(CookiePermissionManagerStatementRegistry *self);
+
+sqlite3_stmt* cookie_permission_manager_statement_registry_get(CookiePermissionManagerStatementRegistry *self,
+																CookiePermissionManagerStatement inStatement);
+sqlite3* cookie_permission_manager_statement_registry_get_database(CookiePermissionManagerStatementRegistry *self);
+
+gint cookie_permission_manager_database_get_policy(CookiePermissionManagerStatementRegistry *inStatements,
+													const gchar *inDomain,
+													gint *outPolicy);
+gint cookie_permission_manager_database_set_policy(CookiePermissionManagerStatementRegistry *inStatements,
+													const gchar *inDomain,
+													gint inPolicy);
+gint cookie_permission_manager_database_remove_policy(CookiePermissionManagerStatementRegistry *inStatements,
+														const gchar *inDomain);
+gint cookie_permission_manager_database_remove_all_policies(CookiePermissionManagerStatementRegistry *inStatements);
+
+gint cookie_permission_manager_database_begin(CookiePermissionManagerStatementRegistry *inStatements);
+gint cookie_permission_manager_database_commit(CookiePermissionManagerStatementRegistry *inStatements);
+void cookie_permission_manager_database_rollback(CookiePermissionManagerStatementRegistry *inStatements);
+
+gint cookie_permission_manager_database_set_pattern_policy(CookiePermissionManagerStatementRegistry *inStatements,
+															const gchar *inPattern,
+															gint inPolicy);
+gint cookie_permission_manager_database_remove_pattern_policy(CookiePermissionManagerStatementRegistry *inStatements,
+																const gchar *inPattern);
+
+gint cookie_permission_manager_database_remove_all_session_policies(CookiePermissionManagerStatementRegistry *inStatements);
+
+G_END_DECLS
+
+#endif /* __COOKIE_PERMISSION_MANAGER_DATABASE__ */
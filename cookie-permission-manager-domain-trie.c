@@ -0,0 +1,376 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+#include "cookie-permission-manager-domain-trie.h"
+
+#include <string.h>
+
+/* Domain names are limited to 253 characters so this buffer is large enough
+ * for any valid domain name. Longer ones are copied to heap.
+ */
+#define DOMAIN_BUFFER_SIZE		256
+
+typedef struct _CookiePermissionManagerDomainTrieNode	CookiePermissionManagerDomainTrieNode;
+
+struct _CookiePermissionManagerDomainTrieNode
+{
+	GHashTable								*children;	/* Label -> node, created on demand */
+	gboolean								hasPolicy;
+	gint									policy;
+};
+
+struct _CookiePermissionManagerDomainTrie
+{
+	CookiePermissionManagerDomainTrieNode	*root;
+	guint									size;
+};
+
+/* IMPLEMENTATION: Private variables and methods */
+
+/* Create and destroy a node */
+static CookiePermissionManagerDomainTrieNode* _cookie_permission_manager_domain_trie_node_new(void)
+{
+	return(g_slice_new0(CookiePermissionManagerDomainTrieNode));
+}
+
+static void _cookie_permission_manager_domain_trie_node_free(gpointer inData)
+{
+	CookiePermissionManagerDomainTrieNode	*node=(CookiePermissionManagerDomainTrieNode*)inData;
+
+	if(node->children) g_hash_table_destroy(node->children);
+	g_slice_free(CookiePermissionManagerDomainTrieNode, node);
+}
+
+/* Copy a node and all nodes below it */
+static CookiePermissionManagerDomainTrieNode* _cookie_permission_manager_domain_trie_node_copy(CookiePermissionManagerDomainTrieNode *inNode)
+{
+	CookiePermissionManagerDomainTrieNode	*node;
+	GHashTableIter							iter;
+	gpointer								label, child;
+
+	node=_cookie_permission_manager_domain_trie_node_new();
+	node->hasPolicy=inNode->hasPolicy;
+	node->policy=inNode->policy;
+
+	if(inNode->children)
+	{
+		node->children=g_hash_table_new_full(g_str_hash,
+												g_str_equal,
+												g_free,
+												_cookie_permission_manager_domain_trie_node_free);
+
+		g_hash_table_iter_init(&iter, inNode->children);
+		while(g_hash_table_iter_next(&iter, &label, &child))
+		{
+			g_hash_table_insert(node->children,
+								g_strdup((const gchar*)label),
+								_cookie_permission_manager_domain_trie_node_copy((CookiePermissionManagerDomainTrieNode*)child));
+		}
+	}
+
+	return(node);
+}
+
+/* Copy domain name lower-cased and without leading dot into buffer.
+ * If buffer is too small a new string is allocated which must be freed
+ * by caller if returned pointer is not the buffer passed in.
+ */
+static gchar* _cookie_permission_manager_domain_trie_normalize(const gchar *inDomain, gchar *ioBuffer)
+{
+	gsize		length;
+	gchar		*domain;
+	gchar		*iter;
+
+	if(*inDomain=='.') inDomain++;
+
+	length=strlen(inDomain);
+	if(length<DOMAIN_BUFFER_SIZE)
+	{
+		memcpy(ioBuffer, inDomain, length+1);
+		domain=ioBuffer;
+	}
+		else domain=g_strdup(inDomain);
+
+	for(iter=domain; *iter; iter++) *iter=g_ascii_tolower(*iter);
+
+	return(domain);
+}
+
+/* Get next label from the end of domain name. The label found is terminated in place
+ * and ioEnd is moved to the character before the label. Returns NULL if there is no
+ * further label.
+ */
+static gchar* _cookie_permission_manager_domain_trie_next_label(gchar *inDomain, gchar **ioEnd)
+{
+	gchar		*label;
+	gchar		*end=*ioEnd;
+
+	while(end>inDomain)
+	{
+		/* Terminate label at its end */
+		*end='\0';
+
+		/* Search start of label */
+		label=end;
+		while(label>inDomain && *(label-1)!='.') label--;
+
+		/* Move end to dot in front of label for next call */
+		end=(label>inDomain ? label-1 : inDomain);
+		*ioEnd=end;
+
+		/* Skip empty labels (e.g. consecutive dots) */
+		if(*label) return(label);
+	}
+
+	return(NULL);
+}
+
+/* IMPLEMENTATION: Public API */
+
+/* Create new trie */
+CookiePermissionManagerDomainTrie* cookie_permission_manager_domain_trie_new(void)
+{
+	CookiePermissionManagerDomainTrie		*self;
+
+	self=g_new0(CookiePermissionManagerDomainTrie, 1);
+	self->root=_cookie_permission_manager_domain_trie_node_new();
+	self->size=0;
+
+	return(self);
+}
+
+/* Create new trie containing same policies as another one */
+CookiePermissionManagerDomainTrie* cookie_permission_manager_domain_trie_copy(CookiePermissionManagerDomainTrie *self)
+{
+	CookiePermissionManagerDomainTrie		*copy;
+
+	g_return_val_if_fail(self, NULL);
+
+	copy=g_new0(CookiePermissionManagerDomainTrie, 1);
+	copy->root=_cookie_permission_manager_domain_trie_node_copy(self->root);
+	copy->size=self->size;
+
+	return(copy);
+}
+
+/* Destroy trie */
+void cookie_permission_manager_domain_trie_free(CookiePermissionManagerDomainTrie *self)
+{
+	g_return_if_fail(self);
+
+	_cookie_permission_manager_domain_trie_node_free(self->root);
+	g_free(self);
+}
+
+/* Get number of domains with policy stored in trie */
+guint cookie_permission_manager_domain_trie_get_size(CookiePermissionManagerDomainTrie *self)
+{
+	g_return_val_if_fail(self, 0);
+
+	return(self->size);
+}
+
+/* Set policy for domain */
+void cookie_permission_manager_domain_trie_insert(CookiePermissionManagerDomainTrie *self, const gchar *inDomain, gint inPolicy)
+{
+	CookiePermissionManagerDomainTrieNode	*node, *child;
+	gchar									buffer[DOMAIN_BUFFER_SIZE];
+	gchar									*domain, *end, *label;
+
+	g_return_if_fail(self);
+	g_return_if_fail(inDomain);
+
+	/* Walk down labels and create missing nodes */
+	domain=_cookie_permission_manager_domain_trie_normalize(inDomain, buffer);
+	end=domain+strlen(domain);
+
+	node=self->root;
+	while((label=_cookie_permission_manager_domain_trie_next_label(domain, &end)))
+	{
+		if(!node->children)
+		{
+			node->children=g_hash_table_new_full(g_str_hash,
+													g_str_equal,
+													g_free,
+													_cookie_permission_manager_domain_trie_node_free);
+		}
+
+		child=g_hash_table_lookup(node->children, label);
+		if(!child)
+		{
+			child=_cookie_permission_manager_domain_trie_node_new();
+			g_hash_table_insert(node->children, g_strdup(label), child);
+		}
+
+		node=child;
+	}
+
+	/* Store policy at node of last label but do not store it at root node
+	 * which would be the case for an empty domain name
+	 */
+	if(node!=self->root)
+	{
+		if(!node->hasPolicy) self->size++;
+
+		node->hasPolicy=TRUE;
+		node->policy=inPolicy;
+	}
+
+	/* Free allocated resources */
+	if(domain!=buffer) g_free(domain);
+}
+
+/* Remove policy of domain and release nodes not needed anymore */
+gboolean cookie_permission_manager_domain_trie_remove(CookiePermissionManagerDomainTrie *self, const gchar *inDomain)
+{
+	CookiePermissionManagerDomainTrieNode	*node;
+	GPtrArray								*path;
+	GPtrArray								*labels;
+	gchar									buffer[DOMAIN_BUFFER_SIZE];
+	gchar									*domain, *end, *label;
+	gboolean								removed=FALSE;
+
+	g_return_val_if_fail(self, FALSE);
+	g_return_val_if_fail(inDomain, FALSE);
+
+	/* Walk down labels and remember path to be able to release empty nodes */
+	domain=_cookie_permission_manager_domain_trie_normalize(inDomain, buffer);
+	end=domain+strlen(domain);
+
+	path=g_ptr_array_new();
+	labels=g_ptr_array_new();
+
+	node=self->root;
+	while(node && (label=_cookie_permission_manager_domain_trie_next_label(domain, &end)))
+	{
+		g_ptr_array_add(path, node);
+		g_ptr_array_add(labels, label);
+
+		node=(node->children ? g_hash_table_lookup(node->children, label) : NULL);
+	}
+
+	/* Remove policy and release all nodes on path which neither have a policy
+	 * nor children anymore
+	 */
+	if(node && node!=self->root && node->hasPolicy)
+	{
+		node->hasPolicy=FALSE;
+		self->size--;
+		removed=TRUE;
+
+		while(path->len>0 &&
+				!node->hasPolicy &&
+				(!node->children || g_hash_table_size(node->children)==0))
+		{
+			CookiePermissionManagerDomainTrieNode	*parent;
+
+			parent=g_ptr_array_index(path, path->len-1);
+			label=g_ptr_array_index(labels, labels->len-1);
+			g_ptr_array_remove_index(path, path->len-1);
+			g_ptr_array_remove_index(labels, labels->len-1);
+
+			g_hash_table_remove(parent->children, label);
+			if(g_hash_table_size(parent->children)==0)
+			{
+				g_hash_table_destroy(parent->children);
+				parent->children=NULL;
+			}
+
+			node=parent;
+		}
+	}
+
+	/* Free allocated resources */
+	g_ptr_array_free(labels, TRUE);
+	g_ptr_array_free(path, TRUE);
+	if(domain!=buffer) g_free(domain);
+
+	return(removed);
+}
+
+/* Remove all policies from trie */
+void cookie_permission_manager_domain_trie_remove_all(CookiePermissionManagerDomainTrie *self)
+{
+	g_return_if_fail(self);
+
+	_cookie_permission_manager_domain_trie_node_free(self->root);
+	self->root=_cookie_permission_manager_domain_trie_node_new();
+	self->size=0;
+}
+
+/* Get policy stored for domain itself (not resolved by any parent domain).
+ * Returns TRUE if a policy is stored for domain.
+ */
+gboolean cookie_permission_manager_domain_trie_get(CookiePermissionManagerDomainTrie *self, const gchar *inDomain, gint *outPolicy)
+{
+	CookiePermissionManagerDomainTrieNode	*node;
+	gchar									buffer[DOMAIN_BUFFER_SIZE];
+	gchar									*domain, *end, *label;
+
+	g_return_val_if_fail(self, FALSE);
+	g_return_val_if_fail(inDomain, FALSE);
+
+	domain=_cookie_permission_manager_domain_trie_normalize(inDomain, buffer);
+	end=domain+strlen(domain);
+
+	node=self->root;
+	while(node && (label=_cookie_permission_manager_domain_trie_next_label(domain, &end)))
+	{
+		node=(node->children ? g_hash_table_lookup(node->children, label) : NULL);
+	}
+
+	if(node==self->root || (node && !node->hasPolicy)) node=NULL;
+	if(node && outPolicy) *outPolicy=node->policy;
+
+	/* Free allocated resources */
+	if(domain!=buffer) g_free(domain);
+
+	return(node!=NULL);
+}
+
+/* Lookup policy for domain. The most specific policy wins, i.e. the policy stored
+ * for the domain itself or - if none is stored - for its nearest parent domain.
+ * Returns TRUE if a policy was found.
+ */
+gboolean cookie_permission_manager_domain_trie_lookup(CookiePermissionManagerDomainTrie *self, const gchar *inDomain, gint *outPolicy)
+{
+	CookiePermissionManagerDomainTrieNode	*node;
+	gchar									buffer[DOMAIN_BUFFER_SIZE];
+	gchar									*domain, *end, *label;
+	gboolean								found=FALSE;
+	gint									policy=0;
+
+	g_return_val_if_fail(self, FALSE);
+	g_return_val_if_fail(inDomain, FALSE);
+
+	domain=_cookie_permission_manager_domain_trie_normalize(inDomain, buffer);
+	end=domain+strlen(domain);
+
+	node=self->root;
+	while(node->children && (label=_cookie_permission_manager_domain_trie_next_label(domain, &end)))
+	{
+		node=g_hash_table_lookup(node->children, label);
+		if(!node) break;
+
+		if(node->hasPolicy)
+		{
+			policy=node->policy;
+			found=TRUE;
+		}
+	}
+
+	if(found && outPolicy) *outPolicy=policy;
+
+	/* Free allocated resources */
+	if(domain!=buffer) g_free(domain);
+
+	return(found);
+}
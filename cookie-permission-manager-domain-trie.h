@@ -0,0 +1,41 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+#ifndef __COOKIE_PERMISSION_MANAGER_DOMAIN_TRIE__
+#define __COOKIE_PERMISSION_MANAGER_DOMAIN_TRIE__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* In-memory index of policies keyed by domain. Domains are stored as a trie
+ * of their reversed labels (e.g. www.example.com is stored as com -> example -> www)
+ * so a lookup only costs one step per label of the domain looked up.
+ */
+typedef struct _CookiePermissionManagerDomainTrie		CookiePermissionManagerDomainTrie;
+
+/* Public API */
+CookiePermissionManagerDomainTrie* cookie_permission_manager_domain_trie_new(void);
+CookiePermissionManagerDomainTrie* cookie_permission_manager_domain_trie_copy(CookiePermissionManagerDomainTrie *self);
+void cookie_permission_manager_domain_trie_free(CookiePermissionManagerDomainTrie *self);
+
+guint cookie_permission_manager_domain_trie_get_size(CookiePermissionManagerDomainTrie *self);
+
+void cookie_permission_manager_domain_trie_insert(CookiePermissionManagerDomainTrie *self, const gchar *inDomain, gint inPolicy);
+gboolean cookie_permission_manager_domain_trie_remove(CookiePermissionManagerDomainTrie *self, const gchar *inDomain);
+void cookie_permission_manager_domain_trie_remove_all(CookiePermissionManagerDomainTrie *self);
+
+gboolean cookie_permission_manager_domain_trie_get(CookiePermissionManagerDomainTrie *self, const gchar *inDomain, gint *outPolicy);
+gboolean cookie_permission_manager_domain_trie_lookup(CookiePermissionManagerDomainTrie *self, const gchar *inDomain, gint *outPolicy);
+
+G_END_DECLS
+
+#endif /* __COOKIE_PERMISSION_MANAGER_DOMAIN_TRIE__ */
@@ -0,0 +1,728 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+#include "cookie-permission-manager-pattern-matcher.h"
+
+#include <string.h>
+
+/* Maximum number of states of deterministic automaton held in memory. All states are
+ * built when patterns are compiled. If this limit is reached the missing transitions
+ * are left unknown and a lookup reaching one goes on in the non-deterministic automaton.
+ */
+#define MAX_STATES				4096
+
+/* State without any position left */
+#define EMPTY_STATE				0
+
+#define UNKNOWN_STATE			G_MAXUINT
+#define NO_RANK					-1
+
+/* Flags of positions */
+#define POSITION_BASE			(1 << 0)	/* Part of every state */
+#define POSITION_MATCHED		(1 << 1)	/* Only '*' follows - pattern matches anything from here */
+
+typedef struct _CookiePermissionManagerPatternMatcherState		CookiePermissionManagerPatternMatcherState;
+
+struct _CookiePermissionManagerPatternMatcherState
+{
+	GBytes			*positions;			/* Sorted positions of non-deterministic automaton */
+	gint			acceptRank;			/* Rank of most specific pattern accepting at this state */
+};
+
+/* Scratch memory for stepping through non-deterministic automaton. Compiled
+ * automaton is never changed so each walk through it brings its own.
+ */
+typedef struct _CookiePermissionManagerPatternMatcherScratch	CookiePermissionManagerPatternMatcherScratch;
+
+struct _CookiePermissionManagerPatternMatcherScratch
+{
+	guint			*marks;				/* Stamp of last step a position was added at */
+	guint			stamp;
+};
+
+struct _CookiePermissionManagerPatternMatcher
+{
+	GHashTable		*rules;				/* Lower-cased pattern -> policy */
+
+	/* Non-deterministic automaton: All patterns concatenated with each pattern
+	 * terminated by a NUL character. Each character is a position and the
+	 * terminating NUL is the accepting position of its pattern.
+	 */
+	gchar			*positions;
+	guint			numberPositions;
+	gint			*positionRanks;		/* Rank of pattern a position belongs to */
+	guint8			*positionFlags;
+	gint			*rankPolicies;		/* Policy of pattern by rank */
+
+	/* Positions behind leading '*' of patterns are part of every state. They are not
+	 * stored in states but their transitions are precomputed for each class.
+	 */
+	GPtrArray		*baseTransitions;
+	gboolean		hasBase;
+	GArray			*startPositions;
+	guint			startState;
+	gint			startRank;
+
+	/* Characters are mapped to classes. Each literal character used in any pattern
+	 * has its own class and all other characters share class 0.
+	 */
+	guint8			classes[256];
+	guint			numberClasses;
+	guchar			classCharacters[256];
+
+	/* Deterministic automaton built when compiling. Each transition also stores the
+	 * rank of the most specific pattern which is known to match whatever follows.
+	 * It is read-only afterwards so lookups from any thread need no lock.
+	 */
+	GArray			*states;
+	GHashTable		*stateIDs;
+	GArray			*transitions;
+	GArray			*transitionRanks;
+};
+
+/* IMPLEMENTATION: Private variables and methods */
+
+/* Count literal characters of pattern */
+static guint _cookie_permission_manager_pattern_matcher_get_literals(const gchar *inPattern)
+{
+	guint		literals=0;
+
+	for(; *inPattern; inPattern++)
+	{
+		if(*inPattern!='*' && *inPattern!='?') literals++;
+	}
+
+	return(literals);
+}
+
+/* Sort patterns from least specific to most specific one. A pattern is more specific
+ * if it has more literal characters or - if equal - if it is longer. The order of
+ * remaining patterns is made stable by comparing them.
+ */
+static gint _cookie_permission_manager_pattern_matcher_compare_specificity(gconstpointer inLeft, gconstpointer inRight)
+{
+	const gchar		*left=*((const gchar**)inLeft);
+	const gchar		*right=*((const gchar**)inRight);
+	guint			leftValue, rightValue;
+
+	leftValue=_cookie_permission_manager_pattern_matcher_get_literals(left);
+	rightValue=_cookie_permission_manager_pattern_matcher_get_literals(right);
+	if(leftValue!=rightValue) return(leftValue<rightValue ? -1 : 1);
+
+	leftValue=strlen(left);
+	rightValue=strlen(right);
+	if(leftValue!=rightValue) return(leftValue<rightValue ? -1 : 1);
+
+	return(strcmp(left, right));
+}
+
+static gint _cookie_permission_manager_pattern_matcher_compare_positions(gconstpointer inLeft, gconstpointer inRight)
+{
+	guint		left=*((const guint*)inLeft);
+	guint		right=*((const guint*)inRight);
+
+	return(left<right ? -1 : (left>right ? 1 : 0));
+}
+
+/* Release compiled automaton */
+static void _cookie_permission_manager_pattern_matcher_release_automaton(CookiePermissionManagerPatternMatcher *self)
+{
+	guint		i;
+
+	if(self->states)
+	{
+		for(i=0; i<self->states->len; i++)
+		{
+			g_bytes_unref(g_array_index(self->states, CookiePermissionManagerPatternMatcherState, i).positions);
+		}
+		g_array_free(self->states, TRUE);
+	}
+	self->states=NULL;
+
+	if(self->stateIDs) g_hash_table_destroy(self->stateIDs);
+	self->stateIDs=NULL;
+
+	if(self->transitions) g_array_free(self->transitions, TRUE);
+	self->transitions=NULL;
+
+	if(self->transitionRanks) g_array_free(self->transitionRanks, TRUE);
+	self->transitionRanks=NULL;
+
+	if(self->baseTransitions) g_ptr_array_free(self->baseTransitions, TRUE);
+	self->baseTransitions=NULL;
+	self->hasBase=FALSE;
+
+	if(self->startPositions) g_array_free(self->startPositions, TRUE);
+	self->startPositions=NULL;
+	self->startRank=NO_RANK;
+
+	g_free(self->positions);
+	self->positions=NULL;
+	self->numberPositions=0;
+
+	g_free(self->positionRanks);
+	self->positionRanks=NULL;
+
+	g_free(self->positionFlags);
+	self->positionFlags=NULL;
+
+	g_free(self->rankPolicies);
+	self->rankPolicies=NULL;
+}
+
+/* Add position to set including all positions reachable without consuming a character,
+ * i.e. positions behind a '*' as it may also match an empty sequence. Positions which
+ * are part of every state are not added. Positions after which only '*' follows are
+ * not added either but the rank of their pattern is remembered in ioRank as the
+ * pattern matches whatever follows.
+ */
+static void _cookie_permission_manager_pattern_matcher_add_position(CookiePermissionManagerPatternMatcher *self,
+																	CookiePermissionManagerPatternMatcherScratch *ioScratch,
+																	GArray *ioSet,
+																	guint inPosition,
+																	gint *ioRank)
+{
+	while(ioScratch->marks[inPosition]!=ioScratch->stamp)
+	{
+		ioScratch->marks[inPosition]=ioScratch->stamp;
+
+		if(self->positionFlags[inPosition] & POSITION_BASE) break;
+
+		if(self->positionFlags[inPosition] & POSITION_MATCHED)
+		{
+			*ioRank=MAX(*ioRank, self->positionRanks[inPosition]);
+			break;
+		}
+
+		g_array_append_val(ioSet, inPosition);
+
+		if(self->positions[inPosition]!='*') break;
+		inPosition++;
+	}
+}
+
+/* Check if position moves on to next position when consuming a character of class */
+static gboolean _cookie_permission_manager_pattern_matcher_position_matches(CookiePermissionManagerPatternMatcher *self,
+																			guint inPosition,
+																			guint inClass)
+{
+	gchar		character=self->positions[inPosition];
+
+	if(character=='?') return(TRUE);
+	if(character=='\0' || character=='*' || inClass==0) return(FALSE);
+
+	return((guchar)character==self->classCharacters[inClass]);
+}
+
+/* Get sorted set of positions reached from set by consuming a character of class.
+ * The rank of the most specific pattern known to match is returned in outRank.
+ */
+static void _cookie_permission_manager_pattern_matcher_step(CookiePermissionManagerPatternMatcher *self,
+															CookiePermissionManagerPatternMatcherScratch *ioScratch,
+															const guint *inSet,
+															guint inSetSize,
+															guint inClass,
+															GArray *outSet,
+															gint *outRank)
+{
+	GArray		*baseTransitions;
+	guint		i, position;
+
+	g_array_set_size(outSet, 0);
+	*outRank=NO_RANK;
+	ioScratch->stamp++;
+
+	/* Transitions of positions being part of every state */
+	if(self->hasBase)
+	{
+		baseTransitions=g_ptr_array_index(self->baseTransitions, inClass);
+		for(i=0; i<baseTransitions->len; i++)
+		{
+			_cookie_permission_manager_pattern_matcher_add_position(self, ioScratch, outSet, g_array_index(baseTransitions, guint, i), outRank);
+		}
+	}
+
+	/* Transitions of positions in set */
+	for(i=0; i<inSetSize; i++)
+	{
+		position=inSet[i];
+
+		if(self->positions[position]=='*')
+		{
+			_cookie_permission_manager_pattern_matcher_add_position(self, ioScratch, outSet, position, outRank);
+		}
+			else if(_cookie_permission_manager_pattern_matcher_position_matches(self, position, inClass))
+			{
+				_cookie_permission_manager_pattern_matcher_add_position(self, ioScratch, outSet, position+1, outRank);
+			}
+	}
+
+	g_array_sort(outSet, _cookie_permission_manager_pattern_matcher_compare_positions);
+}
+
+/* Get rank of most specific pattern accepting at end of domain at set of positions */
+static gint _cookie_permission_manager_pattern_matcher_get_accept_rank(CookiePermissionManagerPatternMatcher *self,
+																		const guint *inSet,
+																		guint inSetSize)
+{
+	gint		rank=NO_RANK;
+	guint		i;
+
+	for(i=0; i<inSetSize; i++)
+	{
+		if(self->positions[inSet[i]]=='\0') rank=MAX(rank, self->positionRanks[inSet[i]]);
+	}
+
+	return(rank);
+}
+
+/* Get state for set of positions and add it if it does not exist yet.
+ * Returns UNKNOWN_STATE if maximum number of states is reached.
+ */
+static guint _cookie_permission_manager_pattern_matcher_get_state(CookiePermissionManagerPatternMatcher *self, GArray *inSet)
+{
+	CookiePermissionManagerPatternMatcherState	state;
+	GBytes										*key;
+	gpointer									value;
+	guint										stateID;
+	guint										i;
+	guint										unknownState=UNKNOWN_STATE;
+	gint										noRank=NO_RANK;
+
+	key=g_bytes_new(inSet->data, inSet->len*sizeof(guint));
+	if(g_hash_table_lookup_extended(self->stateIDs, key, NULL, &value))
+	{
+		g_bytes_unref(key);
+		return(GPOINTER_TO_UINT(value));
+	}
+
+	if(self->states->len>=MAX_STATES)
+	{
+		g_bytes_unref(key);
+		return(UNKNOWN_STATE);
+	}
+
+	/* Set up new state with unknown transitions */
+	state.positions=key;
+	state.acceptRank=_cookie_permission_manager_pattern_matcher_get_accept_rank(self, (const guint*)inSet->data, inSet->len);
+
+	stateID=self->states->len;
+	g_array_append_val(self->states, state);
+	g_hash_table_insert(self->stateIDs, key, GUINT_TO_POINTER(stateID));
+
+	for(i=0; i<self->numberClasses; i++)
+	{
+		g_array_append_val(self->transitions, unknownState);
+		g_array_append_val(self->transitionRanks, noRank);
+	}
+
+	return(stateID);
+}
+
+/* Build states of deterministic automaton reachable from start state breadth first.
+ * The empty state and the start state are added first. Both are the same if all
+ * patterns begin with '*'.
+ */
+static void _cookie_permission_manager_pattern_matcher_build_states(CookiePermissionManagerPatternMatcher *self,
+																	CookiePermissionManagerPatternMatcherScratch *ioScratch)
+{
+	GArray			*set;
+	gconstpointer	data;
+	gsize			size;
+	guint			state, nextState, characterClass;
+	gint			rank;
+
+	set=g_array_new(FALSE, FALSE, sizeof(guint));
+
+	_cookie_permission_manager_pattern_matcher_get_state(self, set);
+	self->startState=_cookie_permission_manager_pattern_matcher_get_state(self, self->startPositions);
+
+	for(state=0; state<self->states->len; state++)
+	{
+		/* Positions are owned by state and do not move if more states are added */
+		data=g_bytes_get_data(g_array_index(self->states, CookiePermissionManagerPatternMatcherState, state).positions, &size);
+
+		for(characterClass=0; characterClass<self->numberClasses; characterClass++)
+		{
+			_cookie_permission_manager_pattern_matcher_step(self, ioScratch, data, size/sizeof(guint), characterClass, set, &rank);
+
+			nextState=_cookie_permission_manager_pattern_matcher_get_state(self, set);
+			if(nextState!=UNKNOWN_STATE)
+			{
+				g_array_index(self->transitions, guint, state*self->numberClasses+characterClass)=nextState;
+				g_array_index(self->transitionRanks, gint, state*self->numberClasses+characterClass)=rank;
+			}
+		}
+	}
+
+	g_array_free(set, TRUE);
+}
+
+/* Go on matching domain in non-deterministic automaton at positions of state whose
+ * transition is unknown as maximum number of states was reached. Returns the state
+ * to go on with as soon as positions reached are a known state again otherwise
+ * UNKNOWN_STATE. Domain is advanced to next character to match and the rank of
+ * the most specific pattern known to match is updated in ioRank.
+ */
+static guint _cookie_permission_manager_pattern_matcher_lookup_positions(CookiePermissionManagerPatternMatcher *self,
+																		guint inState,
+																		const gchar **ioDomain,
+																		gint *ioRank)
+{
+	CookiePermissionManagerPatternMatcherScratch	scratch;
+	GArray											*set, *nextSet, *swap;
+	GBytes											*key;
+	gconstpointer									data;
+	gsize											size;
+	gpointer										value;
+	guint											state=UNKNOWN_STATE;
+	gint											rank;
+
+	scratch.marks=g_new0(guint, self->numberPositions);
+	scratch.stamp=0;
+
+	data=g_bytes_get_data(g_array_index(self->states, CookiePermissionManagerPatternMatcherState, inState).positions, &size);
+	set=g_array_sized_new(FALSE, FALSE, sizeof(guint), size/sizeof(guint));
+	g_array_append_vals(set, data, size/sizeof(guint));
+	nextSet=g_array_new(FALSE, FALSE, sizeof(guint));
+
+	while(**ioDomain && (set->len>0 || self->hasBase))
+	{
+		_cookie_permission_manager_pattern_matcher_step(self,
+														&scratch,
+														(const guint*)set->data,
+														set->len,
+														self->classes[(guchar)g_ascii_tolower(**ioDomain)],
+														nextSet,
+														&rank);
+		*ioRank=MAX(*ioRank, rank);
+		(*ioDomain)++;
+
+		swap=set;
+		set=nextSet;
+		nextSet=swap;
+
+		/* Lookup of state does not change automaton */
+		key=g_bytes_new_static(set->data, set->len*sizeof(guint));
+		if(g_hash_table_lookup_extended(self->stateIDs, key, NULL, &value)) state=GPOINTER_TO_UINT(value);
+		g_bytes_unref(key);
+
+		if(state!=UNKNOWN_STATE) break;
+	}
+
+	/* Patterns accepting at end of domain */
+	if(state==UNKNOWN_STATE && !**ioDomain)
+	{
+		*ioRank=MAX(*ioRank, _cookie_permission_manager_pattern_matcher_get_accept_rank(self, (const guint*)set->data, set->len));
+	}
+
+	g_array_free(nextSet, TRUE);
+	g_array_free(set, TRUE);
+	g_free(scratch.marks);
+
+	return(state);
+}
+
+/* IMPLEMENTATION: Public API */
+
+/* Create new pattern matcher */
+CookiePermissionManagerPatternMatcher* cookie_permission_manager_pattern_matcher_new(void)
+{
+	CookiePermissionManagerPatternMatcher	*self;
+
+	self=g_new0(CookiePermissionManagerPatternMatcher, 1);
+	self->rules=g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	self->startRank=NO_RANK;
+
+	return(self);
+}
+
+/* Create new pattern matcher with same patterns as given one. Automaton is not
+ * copied but has to be compiled again.
+ */
+CookiePermissionManagerPatternMatcher* cookie_permission_manager_pattern_matcher_copy(CookiePermissionManagerPatternMatcher *self)
+{
+	CookiePermissionManagerPatternMatcher	*copy;
+	GHashTableIter							iter;
+	gpointer								pattern, policy;
+
+	g_return_val_if_fail(self, NULL);
+
+	copy=cookie_permission_manager_pattern_matcher_new();
+
+	g_hash_table_iter_init(&iter, self->rules);
+	while(g_hash_table_iter_next(&iter, &pattern, &policy))
+	{
+		g_hash_table_insert(copy->rules, g_strdup((const gchar*)pattern), policy);
+	}
+
+	return(copy);
+}
+
+/* Destroy pattern matcher */
+void cookie_permission_manager_pattern_matcher_free(CookiePermissionManagerPatternMatcher *self)
+{
+	g_return_if_fail(self);
+
+	_cookie_permission_manager_pattern_matcher_release_automaton(self);
+	g_hash_table_destroy(self->rules);
+	g_free(self);
+}
+
+/* Get number of patterns */
+guint cookie_permission_manager_pattern_matcher_get_size(CookiePermissionManagerPatternMatcher *self)
+{
+	g_return_val_if_fail(self, 0);
+
+	return(g_hash_table_size(self->rules));
+}
+
+/* Set policy for pattern. Changes take effect when patterns are compiled again. */
+void cookie_permission_manager_pattern_matcher_insert(CookiePermissionManagerPatternMatcher *self, const gchar *inPattern, gint inPolicy)
+{
+	g_return_if_fail(self);
+	g_return_if_fail(inPattern && *inPattern);
+
+	g_hash_table_insert(self->rules, g_ascii_strdown(inPattern, -1), GINT_TO_POINTER(inPolicy));
+}
+
+/* Remove policy of pattern. Changes take effect when patterns are compiled again. */
+gboolean cookie_permission_manager_pattern_matcher_remove(CookiePermissionManagerPatternMatcher *self, const gchar *inPattern)
+{
+	gchar		*pattern;
+	gboolean	removed;
+
+	g_return_val_if_fail(self, FALSE);
+	g_return_val_if_fail(inPattern, FALSE);
+
+	pattern=g_ascii_strdown(inPattern, -1);
+	removed=g_hash_table_remove(self->rules, pattern);
+	g_free(pattern);
+
+	return(removed);
+}
+
+/* Remove all patterns and automaton */
+void cookie_permission_manager_pattern_matcher_remove_all(CookiePermissionManagerPatternMatcher *self)
+{
+	g_return_if_fail(self);
+
+	g_hash_table_remove_all(self->rules);
+	_cookie_permission_manager_pattern_matcher_release_automaton(self);
+}
+
+/* Get policy set for pattern itself (not matching it) */
+gboolean cookie_permission_manager_pattern_matcher_get(CookiePermissionManagerPatternMatcher *self, const gchar *inPattern, gint *outPolicy)
+{
+	gchar		*pattern;
+	gpointer	policy;
+	gboolean	found;
+
+	g_return_val_if_fail(self, FALSE);
+	g_return_val_if_fail(inPattern, FALSE);
+
+	pattern=g_ascii_strdown(inPattern, -1);
+	found=g_hash_table_lookup_extended(self->rules, pattern, NULL, &policy);
+	g_free(pattern);
+
+	if(found && outPolicy) *outPolicy=GPOINTER_TO_INT(policy);
+	return(found);
+}
+
+/* Compile all patterns into one automaton. Must be called after patterns were changed
+ * and before pattern matcher is shared with other threads. All states of deterministic
+ * automaton up to MAX_STATES are built here as it is never changed by lookups.
+ */
+void cookie_permission_manager_pattern_matcher_compile(CookiePermissionManagerPatternMatcher *self)
+{
+	CookiePermissionManagerPatternMatcherScratch	scratch;
+	GPtrArray		*patterns;
+	GHashTableIter	iter;
+	gpointer		key;
+	gsize			length;
+	guint			i, position, characterClass;
+
+	g_return_if_fail(self);
+
+	_cookie_permission_manager_pattern_matcher_release_automaton(self);
+	if(g_hash_table_size(self->rules)==0) return;
+
+	/* Order patterns by specificity so the rank of a pattern is its index */
+	patterns=g_ptr_array_sized_new(g_hash_table_size(self->rules));
+	length=0;
+
+	g_hash_table_iter_init(&iter, self->rules);
+	while(g_hash_table_iter_next(&iter, &key, NULL))
+	{
+		g_ptr_array_add(patterns, key);
+		length+=strlen((gchar*)key)+1;
+	}
+	g_ptr_array_sort(patterns, _cookie_permission_manager_pattern_matcher_compare_specificity);
+
+	/* Set up positions of non-deterministic automaton and character classes */
+	self->positions=g_new(gchar, length);
+	self->numberPositions=length;
+	self->positionRanks=g_new0(gint, length);
+	self->positionFlags=g_new0(guint8, length);
+	self->rankPolicies=g_new0(gint, patterns->len);
+
+	scratch.marks=g_new0(guint, length);
+	scratch.stamp=0;
+
+	memset(self->classes, 0, sizeof(self->classes));
+	self->numberClasses=1;
+
+	position=0;
+	for(i=0; i<patterns->len; i++)
+	{
+		const gchar	*pattern=g_ptr_array_index(patterns, i);
+		guint		start=position;
+		guint		end;
+
+		for(; *pattern; pattern++, position++)
+		{
+			guchar	character=(guchar)*pattern;
+
+			self->positions[position]=*pattern;
+			self->positionRanks[position]=i;
+
+			if(character!='*' && character!='?' && self->classes[character]==0)
+			{
+				self->classes[character]=self->numberClasses;
+				self->classCharacters[self->numberClasses]=character;
+				self->numberClasses++;
+			}
+		}
+
+		self->positions[position]='\0';
+		self->positionRanks[position]=i;
+		self->rankPolicies[i]=GPOINTER_TO_INT(g_hash_table_lookup(self->rules, g_ptr_array_index(patterns, i)));
+		end=position;
+		position++;
+
+		/* Mark trailing '*' after which pattern matches anything */
+		while(end>start && self->positions[end-1]=='*')
+		{
+			end--;
+			self->positionFlags[end]|=POSITION_MATCHED;
+		}
+
+		/* Mark leading '*' and the position following them. They are part of every
+		 * state as '*' loops back to itself.
+		 */
+		if(!(self->positionFlags[start] & POSITION_MATCHED) && self->positions[start]=='*')
+		{
+			while(self->positions[start]=='*') self->positionFlags[start++]|=POSITION_BASE;
+			self->positionFlags[start]|=POSITION_BASE;
+
+			self->hasBase=TRUE;
+		}
+	}
+
+	/* Precompute transitions of positions being part of every state */
+	self->baseTransitions=g_ptr_array_new_with_free_func((GDestroyNotify)g_array_unref);
+	for(characterClass=0; characterClass<self->numberClasses; characterClass++)
+	{
+		GArray		*transitions=g_array_new(FALSE, FALSE, sizeof(guint));
+
+		for(position=0; self->hasBase && position<self->numberPositions; position++)
+		{
+			if((self->positionFlags[position] & POSITION_BASE) &&
+				_cookie_permission_manager_pattern_matcher_position_matches(self, position, characterClass))
+			{
+				guint	nextPosition=position+1;
+
+				g_array_append_val(transitions, nextPosition);
+			}
+		}
+
+		g_ptr_array_add(self->baseTransitions, transitions);
+	}
+
+	/* Set up start positions */
+	self->startPositions=g_array_new(FALSE, FALSE, sizeof(guint));
+	self->startRank=NO_RANK;
+	scratch.stamp++;
+
+	position=0;
+	for(i=0; i<patterns->len; i++)
+	{
+		_cookie_permission_manager_pattern_matcher_add_position(self, &scratch, self->startPositions, position, &self->startRank);
+		position+=strlen((gchar*)g_ptr_array_index(patterns, i))+1;
+	}
+	g_array_sort(self->startPositions, _cookie_permission_manager_pattern_matcher_compare_positions);
+
+	/* Build deterministic automaton */
+	self->states=g_array_new(FALSE, FALSE, sizeof(CookiePermissionManagerPatternMatcherState));
+	self->stateIDs=g_hash_table_new(g_bytes_hash, g_bytes_equal);
+	self->transitions=g_array_new(FALSE, FALSE, sizeof(guint));
+	self->transitionRanks=g_array_new(FALSE, FALSE, sizeof(gint));
+
+	_cookie_permission_manager_pattern_matcher_build_states(self, &scratch);
+
+	/* Free allocated resources */
+	g_ptr_array_free(patterns, TRUE);
+	g_free(scratch.marks);
+}
+
+/* Lookup policy of most specific pattern matching domain. Returns TRUE if a pattern matched.
+ * It takes no lock and may be called from any thread as long as patterns are not changed.
+ */
+gboolean cookie_permission_manager_pattern_matcher_lookup(CookiePermissionManagerPatternMatcher *self, const gchar *inDomain, gint *outPolicy)
+{
+	const gchar		*domain=inDomain;
+	guint			state, nextState, characterClass;
+	gint			rank;
+
+	g_return_val_if_fail(self, FALSE);
+	g_return_val_if_fail(inDomain, FALSE);
+
+	if(*domain=='.') domain++;
+
+	/* If no pattern is compiled nothing can match */
+	if(!self->states) return(FALSE);
+
+	/* Walk through automaton. Stop early if no pattern can match anymore. */
+	state=self->startState;
+	rank=self->startRank;
+	while(*domain && (state!=EMPTY_STATE || self->hasBase))
+	{
+		characterClass=self->classes[(guchar)g_ascii_tolower(*domain)];
+
+		nextState=g_array_index(self->transitions, guint, state*self->numberClasses+characterClass);
+		if(nextState==UNKNOWN_STATE)
+		{
+			/* Transition was not built as there were too many states */
+			state=_cookie_permission_manager_pattern_matcher_lookup_positions(self, state, &domain, &rank);
+			if(state==UNKNOWN_STATE) break;
+			continue;
+		}
+
+		rank=MAX(rank, g_array_index(self->transitionRanks, gint, state*self->numberClasses+characterClass));
+		state=nextState;
+		domain++;
+	}
+
+	/* Patterns accepting at end of domain */
+	if(state!=UNKNOWN_STATE && !*domain) rank=MAX(rank, g_array_index(self->states, CookiePermissionManagerPatternMatcherState, state).acceptRank);
+
+	if(rank!=NO_RANK && outPolicy) *outPolicy=self->rankPolicies[rank];
+
+	return(rank!=NO_RANK);
+}
+
+/* Check if text is a pattern, i.e. it contains any wildcard character */
+gboolean cookie_permission_manager_pattern_matcher_is_pattern(const gchar *inText)
+{
+	g_return_val_if_fail(inText, FALSE);
+
+	return(strpbrk(inText, "*?")!=NULL);
+}
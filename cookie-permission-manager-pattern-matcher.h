@@ -0,0 +1,49 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+#ifndef __COOKIE_PERMISSION_MANAGER_PATTERN_MATCHER__
+#define __COOKIE_PERMISSION_MANAGER_PATTERN_MATCHER__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Policies for domain patterns like *.doubleclick.* or ads?.*.com where '*' matches
+ * any sequence of characters and '?' matches exactly one character. All patterns are
+ * compiled into one deterministic automaton so a lookup only costs one step per
+ * character of the domain looked up regardless of the number of patterns. If more
+ * than one pattern matches the most specific one, i.e. the one with most literal
+ * characters, wins. Lookups do not change a compiled pattern matcher so it can be
+ * shared with other threads as long as it is neither changed nor compiled again.
+ */
+typedef struct _CookiePermissionManagerPatternMatcher		CookiePermissionManagerPatternMatcher;
+
+/* Public API */
+CookiePermissionManagerPatternMatcher* cookie_permission_manager_pattern_matcher_new(void);
+CookiePermissionManagerPatternMatcher* cookie_permission_manager_pattern_matcher_copy(CookiePermissionManagerPatternMatcher *self);
+void cookie_permission_manager_pattern_matcher_free(CookiePermissionManagerPatternMatcher *self);
+
+guint cookie_permission_manager_pattern_matcher_get_size(CookiePermissionManagerPatternMatcher *self);
+
+void cookie_permission_manager_pattern_matcher_insert(CookiePermissionManagerPatternMatcher *self, const gchar *inPattern, gint inPolicy);
+gboolean cookie_permission_manager_pattern_matcher_remove(CookiePermissionManagerPatternMatcher *self, const gchar *inPattern);
+void cookie_permission_manager_pattern_matcher_remove_all(CookiePermissionManagerPatternMatcher *self);
+gboolean cookie_permission_manager_pattern_matcher_get(CookiePermissionManagerPatternMatcher *self, const gchar *inPattern, gint *outPolicy);
+
+void cookie_permission_manager_pattern_matcher_compile(CookiePermissionManagerPatternMatcher *self);
+
+gboolean cookie_permission_manager_pattern_matcher_lookup(CookiePermissionManagerPatternMatcher *self, const gchar *inDomain, gint *outPolicy);
+
+gboolean cookie_permission_manager_pattern_matcher_is_pattern(const gchar *inText);
+
+G_END_DECLS
+
+#endif /* __COOKIE_PERMISSION_MANAGER_PATTERN_MATCHER__ */
@@ -0,0 +1,260 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+#include "cookie-permission-manager-policy-cache.h"
+
+#include <string.h>
+
+/* Number of hash functions used by bloom filter. Seven hashes give a false positive
+ * rate of about 1% at ten bits per stored key.
+ */
+#define BLOOM_FILTER_HASHES		7
+
+typedef struct _CookiePermissionManagerPolicyCacheEntry		CookiePermissionManagerPolicyCacheEntry;
+
+struct _CookiePermissionManagerPolicyCacheEntry
+{
+	gchar			*key;
+	gboolean		found;
+	gint			policy;
+};
+
+struct _CookiePermissionManagerPolicyCache
+{
+	GHashTable		*entries;		/* Key -> link in recently used queue */
+	GQueue			*recentlyUsed;	/* Most recently used entry at head */
+	guint			maxEntries;
+};
+
+struct _CookiePermissionManagerBloomFilter
+{
+	guint8			*bits;
+	guint64			numberBits;
+};
+
+/* IMPLEMENTATION: Private variables and methods */
+
+/* Release an entry of cache */
+static void _cookie_permission_manager_policy_cache_entry_free(CookiePermissionManagerPolicyCacheEntry *inEntry)
+{
+	g_free(inEntry->key);
+	g_slice_free(CookiePermissionManagerPolicyCacheEntry, inEntry);
+}
+
+/* Calculate 64-bit FNV-1a hash of key */
+static guint64 _cookie_permission_manager_bloom_filter_hash(const gchar *inKey, gssize inLength)
+{
+	guint64			hash=G_GUINT64_CONSTANT(14695981039346656037);
+	gssize			i;
+
+	if(inLength<0) inLength=strlen(inKey);
+
+	for(i=0; i<inLength; i++)
+	{
+		hash^=(guchar)inKey[i];
+		hash*=G_GUINT64_CONSTANT(1099511628211);
+	}
+
+	return(hash);
+}
+
+/* IMPLEMENTATION: Public API - Policy cache */
+
+/* Create new cache holding at most inMaxEntries entries */
+CookiePermissionManagerPolicyCache* cookie_permission_manager_policy_cache_new(guint inMaxEntries)
+{
+	CookiePermissionManagerPolicyCache		*self;
+
+	self=g_new0(CookiePermissionManagerPolicyCache, 1);
+	self->entries=g_hash_table_new(g_str_hash, g_str_equal);
+	self->recentlyUsed=g_queue_new();
+	self->maxEntries=MAX(inMaxEntries, 1);
+
+	return(self);
+}
+
+/* Destroy cache */
+void cookie_permission_manager_policy_cache_free(CookiePermissionManagerPolicyCache *self)
+{
+	g_return_if_fail(self);
+
+	cookie_permission_manager_policy_cache_remove_all(self);
+
+	g_hash_table_destroy(self->entries);
+	g_queue_free(self->recentlyUsed);
+	g_free(self);
+}
+
+/* Lookup resolved policy of domain key. Returns TRUE if domain key is cached
+ * and sets outFound to TRUE if a policy was resolved for this domain.
+ */
+gboolean cookie_permission_manager_policy_cache_lookup(CookiePermissionManagerPolicyCache *self,
+														const gchar *inKey,
+														gboolean *outFound,
+														gint *outPolicy)
+{
+	GList										*link;
+	CookiePermissionManagerPolicyCacheEntry		*entry;
+
+	g_return_val_if_fail(self, FALSE);
+	g_return_val_if_fail(inKey, FALSE);
+
+	link=g_hash_table_lookup(self->entries, inKey);
+	if(!link) return(FALSE);
+
+	/* Mark entry as most recently used */
+	g_queue_unlink(self->recentlyUsed, link);
+	g_queue_push_head_link(self->recentlyUsed, link);
+
+	entry=(CookiePermissionManagerPolicyCacheEntry*)link->data;
+	if(outFound) *outFound=entry->found;
+	if(outPolicy) *outPolicy=entry->policy;
+
+	return(TRUE);
+}
+
+/* Store resolved policy of domain key and evict least recently used entry if cache is full */
+void cookie_permission_manager_policy_cache_insert(CookiePermissionManagerPolicyCache *self,
+													const gchar *inKey,
+													gboolean inFound,
+													gint inPolicy)
+{
+	GList										*link;
+	CookiePermissionManagerPolicyCacheEntry		*entry;
+
+	g_return_if_fail(self);
+	g_return_if_fail(inKey);
+
+	/* Update existing entry or create a new one */
+	link=g_hash_table_lookup(self->entries, inKey);
+	if(link)
+	{
+		g_queue_unlink(self->recentlyUsed, link);
+		entry=(CookiePermissionManagerPolicyCacheEntry*)link->data;
+	}
+		else
+		{
+			entry=g_slice_new(CookiePermissionManagerPolicyCacheEntry);
+			entry->key=g_strdup(inKey);
+
+			link=g_list_alloc();
+			link->data=entry;
+			g_hash_table_insert(self->entries, entry->key, link);
+		}
+
+	entry->found=inFound;
+	entry->policy=inPolicy;
+	g_queue_push_head_link(self->recentlyUsed, link);
+
+	/* Evict least recently used entries */
+	while(g_queue_get_length(self->recentlyUsed)>self->maxEntries)
+	{
+		link=g_queue_pop_tail_link(self->recentlyUsed);
+		entry=(CookiePermissionManagerPolicyCacheEntry*)link->data;
+
+		g_hash_table_remove(self->entries, entry->key);
+		_cookie_permission_manager_policy_cache_entry_free(entry);
+		g_list_free_1(link);
+	}
+}
+
+/* Remove all entries from cache, e.g. because a policy has changed */
+void cookie_permission_manager_policy_cache_remove_all(CookiePermissionManagerPolicyCache *self)
+{
+	GList										*link;
+
+	g_return_if_fail(self);
+
+	g_hash_table_remove_all(self->entries);
+	while((link=g_queue_pop_tail_link(self->recentlyUsed)))
+	{
+		_cookie_permission_manager_policy_cache_entry_free((CookiePermissionManagerPolicyCacheEntry*)link->data);
+		g_list_free_1(link);
+	}
+}
+
+/* IMPLEMENTATION: Public API - Bloom filter */
+
+/* Create new bloom filter using inSize bytes */
+CookiePermissionManagerBloomFilter* cookie_permission_manager_bloom_filter_new(gsize inSize)
+{
+	CookiePermissionManagerBloomFilter		*self;
+
+	self=g_new0(CookiePermissionManagerBloomFilter, 1);
+	self->numberBits=((guint64)MAX(inSize, 1))*8;
+	self->bits=g_malloc0(MAX(inSize, 1));
+
+	return(self);
+}
+
+/* Destroy bloom filter */
+void cookie_permission_manager_bloom_filter_free(CookiePermissionManagerBloomFilter *self)
+{
+	g_return_if_fail(self);
+
+	g_free(self->bits);
+	g_free(self);
+}
+
+/* Add domain key to bloom filter. If inLength is negative key is NULL-terminated. */
+void cookie_permission_manager_bloom_filter_add(CookiePermissionManagerBloomFilter *self, const gchar *inKey, gssize inLength)
+{
+	guint64			hash, hash1, hash2;
+	guint64			bit;
+	gint			i;
+
+	g_return_if_fail(self);
+	g_return_if_fail(inKey);
+
+	/* Derive all hash functions from one hash by double hashing */
+	hash=_cookie_permission_manager_bloom_filter_hash(inKey, inLength);
+	hash1=hash & 0xffffffff;
+	hash2=(hash>>32) | 1;
+
+	for(i=0; i<BLOOM_FILTER_HASHES; i++)
+	{
+		bit=(hash1+i*hash2) % self->numberBits;
+		self->bits[bit/8]|=(1 << (bit%8));
+	}
+}
+
+/* Check if domain key may have been added to bloom filter. If FALSE is returned
+ * the key was definitely not added. If inLength is negative key is NULL-terminated.
+ */
+gboolean cookie_permission_manager_bloom_filter_contains(CookiePermissionManagerBloomFilter *self, const gchar *inKey, gssize inLength)
+{
+	guint64			hash, hash1, hash2;
+	guint64			bit;
+	gint			i;
+
+	g_return_val_if_fail(self, TRUE);
+	g_return_val_if_fail(inKey, TRUE);
+
+	hash=_cookie_permission_manager_bloom_filter_hash(inKey, inLength);
+	hash1=hash & 0xffffffff;
+	hash2=(hash>>32) | 1;
+
+	for(i=0; i<BLOOM_FILTER_HASHES; i++)
+	{
+		bit=(hash1+i*hash2) % self->numberBits;
+		if(!(self->bits[bit/8] & (1 << (bit%8)))) return(FALSE);
+	}
+
+	return(TRUE);
+}
+
+/* Remove all keys from bloom filter */
+void cookie_permission_manager_bloom_filter_remove_all(CookiePermissionManagerBloomFilter *self)
+{
+	g_return_if_fail(self);
+
+	memset(self->bits, 0, self->numberBits/8);
+}
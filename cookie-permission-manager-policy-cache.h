@@ -0,0 +1,51 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+#ifndef __COOKIE_PERMISSION_MANAGER_POLICY_CACHE__
+#define __COOKIE_PERMISSION_MANAGER_POLICY_CACHE__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Least-recently-used cache of resolved policies keyed by domain key.
+ * It also remembers domains for which no policy was found.
+ */
+typedef struct _CookiePermissionManagerPolicyCache		CookiePermissionManagerPolicyCache;
+
+CookiePermissionManagerPolicyCache* cookie_permission_manager_policy_cache_new(guint inMaxEntries);
+void cookie_permission_manager_policy_cache_free(CookiePermissionManagerPolicyCache *self);
+
+gboolean cookie_permission_manager_policy_cache_lookup(CookiePermissionManagerPolicyCache *self,
+														const gchar *inKey,
+														gboolean *outFound,
+														gint *outPolicy);
+void cookie_permission_manager_policy_cache_insert(CookiePermissionManagerPolicyCache *self,
+													const gchar *inKey,
+													gboolean inFound,
+													gint inPolicy);
+void cookie_permission_manager_policy_cache_remove_all(CookiePermissionManagerPolicyCache *self);
+
+/* Bloom filter over domain keys to answer "definitely not stored" without
+ * querying database
+ */
+typedef struct _CookiePermissionManagerBloomFilter		CookiePermissionManagerBloomFilter;
+
+CookiePermissionManagerBloomFilter* cookie_permission_manager_bloom_filter_new(gsize inSize);
+void cookie_permission_manager_bloom_filter_free(CookiePermissionManagerBloomFilter *self);
+
+void cookie_permission_manager_bloom_filter_add(CookiePermissionManagerBloomFilter *self, const gchar *inKey, gssize inLength);
+gboolean cookie_permission_manager_bloom_filter_contains(CookiePermissionManagerBloomFilter *self, const gchar *inKey, gssize inLength);
+void cookie_permission_manager_bloom_filter_remove_all(CookiePermissionManagerBloomFilter *self);
+
+G_END_DECLS
+
+#endif /* __COOKIE_PERMISSION_MANAGER_POLICY_CACHE__ */
@@ -0,0 +1,232 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+#include "cookie-permission-manager-policy-engine.h"
+#include "cookie-permission-manager.h"
+
+#include <string.h>
+
+/* IMPLEMENTATION: Private variables and methods */
+
+/* Get length of key of parent domain which is a prefix of domain's key */
+static gint _cookie_permission_manager_policy_engine_get_parent_key_length(const gchar *inKey, gint inLength)
+{
+	while(inLength>0 && inKey[inLength-1]!='.') inLength--;
+	if(inLength>0) inLength--;
+
+	return(inLength);
+}
+
+/* Get policy for domain key by looking it up in database.
+ * This is used if policies could not be loaded into memory completely.
+ * The key of each parent domain is a prefix of the cookie domain's key
+ * so we probe the indexed key column from the most specific domain
+ * to the least specific one and stop at first match.
+ */
+static gboolean _cookie_permission_manager_policy_engine_lookup_database(const CookiePermissionManagerPolicySources *inSources,
+																			const gchar *inKey,
+																			gint *outPolicy)
+{
+	sqlite3_stmt					*statement=NULL;
+	gint							keyLength;
+	gint							error;
+	gint							policy=COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED;
+	gboolean						foundPolicy=FALSE;
+	gint64							startTime;
+
+	startTime=g_get_monotonic_time();
+
+	/* Lookup policy for cookie domain and its parent domains in database */
+	keyLength=strlen(inKey);
+
+	statement=cookie_permission_manager_statement_registry_get(inSources->statements, COOKIE_PERMISSION_MANAGER_STATEMENT_SELECT_BY_KEY);
+	error=(statement ? SQLITE_OK : SQLITE_ERROR);
+	if(statement)
+	{
+		while(!foundPolicy && keyLength>0 && error==SQLITE_OK)
+		{
+			/* Decisions not written to database yet take precedence */
+			if(inSources->writeQueue &&
+				cookie_permission_manager_write_queue_lookup(inSources->writeQueue, inKey, keyLength, &policy))
+			{
+				foundPolicy=(policy!=COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED);
+				keyLength=_cookie_permission_manager_policy_engine_get_parent_key_length(inKey, keyLength);
+				continue;
+			}
+
+			error=sqlite3_bind_text(statement, 1, inKey, keyLength, SQLITE_STATIC);
+			if(error==SQLITE_OK && sqlite3_step(statement)==SQLITE_ROW)
+			{
+				policy=sqlite3_column_int(statement, 0);
+				foundPolicy=TRUE;
+			}
+			sqlite3_reset(statement);
+
+			keyLength=_cookie_permission_manager_policy_engine_get_parent_key_length(inKey, keyLength);
+		}
+	}
+
+	if(error!=SQLITE_OK) g_warning(_("SQL fails: %s"), sqlite3_errmsg(cookie_permission_manager_statement_registry_get_database(inSources->statements)));
+
+	if(statement) sqlite3_reset(statement);
+
+	if(inSources->statistics)
+	{
+		cookie_permission_manager_statistics_record(inSources->statistics, COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_SQL, startTime);
+	}
+
+	if(foundPolicy && outPolicy) *outPolicy=policy;
+	return(foundPolicy);
+}
+
+/* Get policy for domain key in bounded-memory mode. Resolved policies are taken
+ * from cache. If not cached the bloom filter tells if the domain or any of its
+ * parent domains may have a policy at all before database is queried.
+ */
+static gboolean _cookie_permission_manager_policy_engine_lookup_cache(const CookiePermissionManagerPolicySources *inSources,
+																		const gchar *inKey,
+																		gint *outPolicy)
+{
+	gint							policy=COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED;
+	gboolean						foundPolicy=FALSE;
+
+	if(!cookie_permission_manager_policy_cache_lookup(inSources->policyCache, inKey, &foundPolicy, &policy))
+	{
+		gboolean					mayExist=FALSE;
+		gint						keyLength;
+
+		/* Check if domain or any parent domain may be stored */
+		if(inSources->policyFilter)
+		{
+			keyLength=strlen(inKey);
+			while(!mayExist && keyLength>0)
+			{
+				mayExist=cookie_permission_manager_bloom_filter_contains(inSources->policyFilter, inKey, keyLength);
+				keyLength=_cookie_permission_manager_policy_engine_get_parent_key_length(inKey, keyLength);
+			}
+		}
+			else mayExist=TRUE;
+
+		/* Lookup in database only if needed and remember result */
+		if(mayExist) foundPolicy=_cookie_permission_manager_policy_engine_lookup_database(inSources, inKey, &policy);
+		cookie_permission_manager_policy_cache_insert(inSources->policyCache, inKey, foundPolicy, policy);
+	}
+
+	if(foundPolicy && outPolicy) *outPolicy=policy;
+	return(foundPolicy);
+}
+
+/* IMPLEMENTATION: Public API */
+
+/* Get size in bytes of bloom filter and number of entries of policy cache
+ * for a memory budget in bytes. A quarter of budget is taken by bloom filter.
+ */
+gsize cookie_permission_manager_policy_engine_get_filter_size(gsize inMemoryBudget)
+{
+	return(inMemoryBudget/4);
+}
+
+guint cookie_permission_manager_policy_engine_get_cache_size(gsize inMemoryBudget)
+{
+	return((inMemoryBudget-inMemoryBudget/4)/COOKIE_PERMISSION_POLICY_CACHE_ENTRY_SIZE);
+}
+
+/* Lookup policy for cookies from domain. Decisions for this session only are
+ * consulted first, then policies of domain and its parent domains and finally
+ * patterns of session tier and stored patterns. Policies of domains take
+ * precedence over patterns. Returns FALSE if no policy was found.
+ */
+gboolean cookie_permission_manager_policy_engine_lookup(const CookiePermissionManagerPolicySources *inSources,
+														const gchar *inDomain,
+														gint *outPolicy)
+{
+	CookiePermissionManagerPatternMatcher	*patterns;
+	gint									policy=COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED;
+	gboolean								foundPolicy=FALSE;
+
+	g_return_val_if_fail(inSources && inSources->snapshot, FALSE);
+	g_return_val_if_fail(inDomain, FALSE);
+
+	if(cookie_permission_manager_policy_snapshot_is_session_domain(inSources->snapshot, inDomain))
+	{
+		policy=COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION;
+		foundPolicy=TRUE;
+	}
+
+	/* Lookup most specific policy for cookie domain in memory if available */
+	if(!foundPolicy)
+	{
+		if(cookie_permission_manager_policy_snapshot_has_policies(inSources->snapshot))
+		{
+			foundPolicy=cookie_permission_manager_policy_snapshot_lookup(inSources->snapshot, inDomain, &policy);
+		}
+			else if(inSources->statements)
+			{
+				gchar						*key;
+
+				key=cookie_permission_manager_database_get_domain_key(inDomain, NULL);
+				if(inSources->policyCache) foundPolicy=_cookie_permission_manager_policy_engine_lookup_cache(inSources, key, &policy);
+					else foundPolicy=_cookie_permission_manager_policy_engine_lookup_database(inSources, key, &policy);
+				g_free(key);
+			}
+	}
+
+	patterns=cookie_permission_manager_policy_snapshot_get_session_patterns(inSources->snapshot);
+	if(!foundPolicy && patterns) foundPolicy=cookie_permission_manager_pattern_matcher_lookup(patterns, inDomain, &policy);
+
+	patterns=cookie_permission_manager_policy_snapshot_get_patterns(inSources->snapshot);
+	if(!foundPolicy && patterns) foundPolicy=cookie_permission_manager_pattern_matcher_lookup(patterns, inDomain, &policy);
+
+	if(foundPolicy && outPolicy) *outPolicy=policy;
+	return(foundPolicy);
+}
+
+/* Get policy for cookies from domain. If no policy was found the unknown policy
+ * of sources is returned which is COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED
+ * if user should be asked.
+ */
+gint cookie_permission_manager_policy_engine_get_policy(const CookiePermissionManagerPolicySources *inSources,
+														const gchar *inDomain)
+{
+	gint							policy=COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED;
+	gint64							startTime;
+
+	g_return_val_if_fail(inSources && inSources->snapshot, COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED);
+	g_return_val_if_fail(inDomain, COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED);
+
+	startTime=g_get_monotonic_time();
+
+	if(!cookie_permission_manager_policy_engine_lookup(inSources, inDomain, &policy)) policy=inSources->unknownPolicy;
+
+	/* Count outcome and time spent on lookup */
+	if(inSources->statistics)
+	{
+		switch(policy)
+		{
+			case COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT:
+			case COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION:
+				cookie_permission_manager_statistics_count_outcome(inSources->statistics, COOKIE_PERMISSION_MANAGER_STATISTICS_OUTCOME_ACCEPT);
+				break;
+
+			case COOKIE_PERMISSION_MANAGER_POLICY_BLOCK:
+				cookie_permission_manager_statistics_count_outcome(inSources->statistics, COOKIE_PERMISSION_MANAGER_STATISTICS_OUTCOME_BLOCK);
+				break;
+
+			default:
+				cookie_permission_manager_statistics_count_outcome(inSources->statistics, COOKIE_PERMISSION_MANAGER_STATISTICS_OUTCOME_ASK);
+				break;
+		}
+
+		cookie_permission_manager_statistics_record(inSources->statistics, COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_GET_POLICY, startTime);
+	}
+
+	return(policy);
+}
@@ -0,0 +1,60 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+#ifndef __COOKIE_PERMISSION_MANAGER_POLICY_ENGINE__
+#define __COOKIE_PERMISSION_MANAGER_POLICY_ENGINE__
+
+#include "cookie-permission-manager-database.h"
+#include "cookie-permission-manager-policy-cache.h"
+#include "cookie-permission-manager-policy-snapshot.h"
+#include "cookie-permission-manager-statistics.h"
+#include "cookie-permission-manager-write-queue.h"
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Estimated memory used by one entry in policy cache in bounded-memory mode
+ * including hash table node, list link and domain key
+ */
+#define COOKIE_PERMISSION_POLICY_CACHE_ENTRY_SIZE		128
+
+/* Everything policies for cookies from a domain are resolved from. It is filled
+ * in by caller and does not own any of it. Only snapshot is required. Policies of
+ * domains are looked up in snapshot if held in memory, otherwise in cache and
+ * database.
+ */
+typedef struct _CookiePermissionManagerPolicySources		CookiePermissionManagerPolicySources;
+
+struct _CookiePermissionManagerPolicySources
+{
+	CookiePermissionManagerPolicySnapshot		*snapshot;
+	CookiePermissionManagerStatementRegistry	*statements;	/* NULL if there is no database */
+	CookiePermissionManagerWriteQueue			*writeQueue;	/* Decisions not written to database yet or NULL */
+	CookiePermissionManagerPolicyCache			*policyCache;	/* NULL if no memory budget is set */
+	CookiePermissionManagerBloomFilter			*policyFilter;	/* NULL if all keys could not be read */
+	CookiePermissionManagerStatistics			*statistics;	/* NULL if not recorded */
+	gint										unknownPolicy;	/* Policy for domains without any policy */
+};
+
+/* Public API */
+gsize cookie_permission_manager_policy_engine_get_filter_size(gsize inMemoryBudget);
+guint cookie_permission_manager_policy_engine_get_cache_size(gsize inMemoryBudget);
+
+gboolean cookie_permission_manager_policy_engine_lookup(const CookiePermissionManagerPolicySources *inSources,
+														const gchar *inDomain,
+														gint *outPolicy);
+gint cookie_permission_manager_policy_engine_get_policy(const CookiePermissionManagerPolicySources *inSources,
+														const gchar *inDomain);
+
+G_END_DECLS
+
+#endif /* __COOKIE_PERMISSION_MANAGER_POLICY_ENGINE__ */
@@ -0,0 +1,1277 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+#include "cookie-permission-manager-policy-list.h"
+#include "cookie-permission-manager-pattern-matcher.h"
+#include "cookie-permission-manager.h"
+
+static void _cookie_permission_manager_policy_list_tree_model_iface_init(GtkTreeModelIface *iface);
+static void _cookie_permission_manager_policy_list_tree_sortable_iface_init(GtkTreeSortableIface *iface);
+
+/* Define this class in GObject system */
+G_DEFINE_TYPE_WITH_CODE(CookiePermissionManagerPolicyList,
+						cookie_permission_manager_policy_list,
+						G_TYPE_OBJECT,
+						G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_MODEL, _cookie_permission_manager_policy_list_tree_model_iface_init)
+						G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_SORTABLE, _cookie_permission_manager_policy_list_tree_sortable_iface_init))
+
+/* Private structure - access only by public API if needed */
+#define COOKIE_PERMISSION_MANAGER_POLICY_LIST_GET_PRIVATE(obj) \
+	(G_TYPE_INSTANCE_GET_PRIVATE((obj), TYPE_COOKIE_PERMISSION_MANAGER_POLICY_LIST, CookiePermissionManagerPolicyListPrivate))
+
+typedef struct _CookiePermissionManagerPolicyListEntry		CookiePermissionManagerPolicyListEntry;
+
+struct _CookiePermissionManagerPolicyListEntry
+{
+	guint			index;			/* Position among all entries */
+	guint			row;			/* Position among visible rows or G_MAXUINT if filtered out */
+	guint			filterStamp;	/* Equals stamp of filter if entry matches current filter */
+	guint8			policy;			/* COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED if removed while frozen */
+	guint8			isPattern;
+	gchar			sentinel;		/* Always zero so start of domain can be found from any label in it */
+	gchar			domain[1];		/* Lower-case domain allocated with entry */
+};
+
+struct _CookiePermissionManagerPolicyListPrivate
+{
+	GPtrArray					*entries;		/* All entries sorted */
+	GPtrArray					*rows;			/* Entries matching filter in same order */
+	GHashTable					*domains;		/* Domain -> entry, keys are owned by entries */
+	gint						stamp;
+
+	gint						sortColumn;
+	GtkSortType					sortOrder;
+
+	gchar						*filter;
+	guint						filterStamp;
+	GPtrArray					*labelIndex;	/* Sorted starts of all labels in domains or NULL if not built */
+	GPtrArray					*labelIndexPending;	/* Entries added while frozen and not in label index yet */
+
+	gint						freezeCount;
+	gboolean					frozenChanges;
+	gboolean					frozenFilterChanges;
+};
+
+/* Position of policies when sorted by their names. Names are translated so
+ * they are collated once when class is initialized and not on every comparison.
+ */
+static guint	CookiePermissionManagerPolicyListPolicyRanks[COOKIE_PERMISSION_MANAGER_POLICY_BLOCK+1]={ 0, };
+
+/* IMPLEMENTATION: Private variables and methods */
+
+#define ENTRY(inArray, inIndex)		((CookiePermissionManagerPolicyListEntry*)g_ptr_array_index((inArray), (inIndex)))
+
+/* Check if a label of domain starts with filter text. Filter text may span
+ * more than one label like "example.co".
+ */
+static gboolean _cookie_permission_manager_policy_list_entry_matches(CookiePermissionManagerPolicyListPrivate *priv,
+																		CookiePermissionManagerPolicyListEntry *inEntry)
+{
+	const gchar		*label;
+	gsize			length;
+
+	if(!priv->filter) return(TRUE);
+
+	length=strlen(priv->filter);
+	for(label=inEntry->domain; label; label=strchr(label, '.'))
+	{
+		if(*label=='.') label++;
+		if(strncmp(label, priv->filter, length)==0) return(TRUE);
+	}
+
+	return(FALSE);
+}
+
+/* Check if entry is visible with current filter */
+static gboolean _cookie_permission_manager_policy_list_is_visible(CookiePermissionManagerPolicyListPrivate *priv,
+																	CookiePermissionManagerPolicyListEntry *inEntry)
+{
+	return(!priv->filter || inEntry->filterStamp==priv->filterStamp);
+}
+
+/* Create entry for domain */
+static CookiePermissionManagerPolicyListEntry* _cookie_permission_manager_policy_list_entry_new(CookiePermissionManagerPolicyListPrivate *priv,
+																								const gchar *inDomain,
+																								gint inPolicy)
+{
+	CookiePermissionManagerPolicyListEntry		*entry;
+	gsize										length;
+	gchar										*target;
+
+	length=strlen(inDomain);
+	entry=g_malloc(G_STRUCT_OFFSET(CookiePermissionManagerPolicyListEntry, domain)+length+1);
+	entry->index=G_MAXUINT;
+	entry->row=G_MAXUINT;
+	entry->policy=inPolicy;
+	entry->isPattern=cookie_permission_manager_pattern_matcher_is_pattern(inDomain);
+	entry->sentinel=0;
+
+	for(target=entry->domain; *inDomain; inDomain++, target++) *target=g_ascii_tolower(*inDomain);
+	*target=0;
+
+	/* Keep marks of current filter valid for new entries */
+	entry->filterStamp=(_cookie_permission_manager_policy_list_entry_matches(priv, entry) ? priv->filterStamp : priv->filterStamp-1);
+
+	return(entry);
+}
+
+/* Compare two entries by current sort column and order. Domains are unique so
+ * they decide if sort column does not and entries are never equal.
+ */
+static gint _cookie_permission_manager_policy_list_compare(CookiePermissionManagerPolicyListPrivate *priv,
+															CookiePermissionManagerPolicyListEntry *inLeft,
+															CookiePermissionManagerPolicyListEntry *inRight)
+{
+	gint		result=0;
+
+	switch(priv->sortColumn)
+	{
+		case COOKIE_PERMISSION_MANAGER_POLICY_LIST_COLUMN_POLICY:
+			result=(gint)CookiePermissionManagerPolicyListPolicyRanks[inLeft->policy]-(gint)CookiePermissionManagerPolicyListPolicyRanks[inRight->policy];
+			break;
+
+		case COOKIE_PERMISSION_MANAGER_POLICY_LIST_COLUMN_IS_PATTERN:
+			result=(gint)inLeft->isPattern-(gint)inRight->isPattern;
+			break;
+
+		default:
+			break;
+	}
+
+	if(result==0) result=strcmp(inLeft->domain, inRight->domain);
+	if(priv->sortOrder==GTK_SORT_DESCENDING) result=-result;
+
+	return(result);
+}
+
+static gint _cookie_permission_manager_policy_list_sort_callback(gconstpointer inLeft,
+																	gconstpointer inRight,
+																	gpointer inUserData)
+{
+	return(_cookie_permission_manager_policy_list_compare((CookiePermissionManagerPolicyListPrivate*)inUserData,
+															*((CookiePermissionManagerPolicyListEntry**)inLeft),
+															*((CookiePermissionManagerPolicyListEntry**)inRight)));
+}
+
+/* Check if list is sorted at all */
+static gboolean _cookie_permission_manager_policy_list_is_sorted(CookiePermissionManagerPolicyListPrivate *priv)
+{
+	return(priv->sortColumn>=0);
+}
+
+/* Set position of entries starting at index */
+static void _cookie_permission_manager_policy_list_update_indices(CookiePermissionManagerPolicyListPrivate *priv, guint inStart)
+{
+	guint		i;
+
+	for(i=inStart; i<priv->entries->len; i++) ENTRY(priv->entries, i)->index=i;
+}
+
+/* Set position of visible rows starting at row */
+static void _cookie_permission_manager_policy_list_update_rows(CookiePermissionManagerPolicyListPrivate *priv, guint inStart)
+{
+	guint		i;
+
+	for(i=inStart; i<priv->rows->len; i++) ENTRY(priv->rows, i)->row=i;
+}
+
+/* Get index in array of all entries or of visible rows where entry has to be
+ * inserted to keep array sorted
+ */
+static guint _cookie_permission_manager_policy_list_find_position(CookiePermissionManagerPolicyListPrivate *priv,
+																	GPtrArray *inArray,
+																	CookiePermissionManagerPolicyListEntry *inEntry)
+{
+	guint		low, high, middle;
+
+	if(!_cookie_permission_manager_policy_list_is_sorted(priv)) return(inArray->len);
+
+	low=0;
+	high=inArray->len;
+	while(low<high)
+	{
+		middle=low+(high-low)/2;
+		if(_cookie_permission_manager_policy_list_compare(priv, ENTRY(inArray, middle), inEntry)<0) low=middle+1;
+			else high=middle;
+	}
+
+	return(low);
+}
+
+/* Insert pointer into array at position */
+static void _cookie_permission_manager_policy_list_array_insert(GPtrArray *inArray, guint inPosition, gpointer inData)
+{
+	g_ptr_array_add(inArray, NULL);
+	memmove(&inArray->pdata[inPosition+1],
+			&inArray->pdata[inPosition],
+			(inArray->len-inPosition-1)*sizeof(gpointer));
+	inArray->pdata[inPosition]=inData;
+}
+
+/* Merge sorted pointers into sorted array from its end. Returns lowest position
+ * a pointer was merged in.
+ */
+static guint _cookie_permission_manager_policy_list_array_merge(GPtrArray *inArray,
+																GPtrArray *inSorted,
+																GCompareDataFunc inCompare,
+																gpointer inUserData)
+{
+	gint		left, right, target;
+
+	left=inArray->len-1;
+	right=inSorted->len-1;
+	g_ptr_array_set_size(inArray, inArray->len+inSorted->len);
+	target=inArray->len-1;
+
+	while(right>=0)
+	{
+		if(left>=0 && inCompare(&inArray->pdata[left], &inSorted->pdata[right], inUserData)>0)
+		{
+			inArray->pdata[target--]=inArray->pdata[left--];
+		}
+			else inArray->pdata[target--]=inSorted->pdata[right--];
+	}
+
+	return(target+1);
+}
+
+/* Label index: Sorted pointers to start of each label in all domains so all
+ * domains having a label starting with filter text are found by binary search.
+ * Ties are ordered by address so each pointer can be found again for removal.
+ */
+static gint _cookie_permission_manager_policy_list_label_compare(gconstpointer inLeft,
+																	gconstpointer inRight,
+																	gpointer inUserData)
+{
+	const gchar		*left=*((const gchar**)inLeft);
+	const gchar		*right=*((const gchar**)inRight);
+	gint			result;
+
+	result=strcmp(left, right);
+	if(result==0) result=(left<right ? -1 : (left>right ? 1 : 0));
+
+	return(result);
+}
+
+/* Get entry a label in label index belongs to */
+static CookiePermissionManagerPolicyListEntry* _cookie_permission_manager_policy_list_label_get_entry(const gchar *inLabel)
+{
+	while(*(inLabel-1)) inLabel--;
+
+	return((CookiePermissionManagerPolicyListEntry*)(inLabel-G_STRUCT_OFFSET(CookiePermissionManagerPolicyListEntry, domain)));
+}
+
+/* Append start of each label of domain to array */
+static void _cookie_permission_manager_policy_list_label_collect(GPtrArray *ioLabels,
+																	CookiePermissionManagerPolicyListEntry *inEntry)
+{
+	gchar		*label;
+
+	for(label=inEntry->domain; label; label=strchr(label, '.'))
+	{
+		if(*label=='.') label++;
+		g_ptr_array_add(ioLabels, label);
+	}
+}
+
+/* Release label index. It is built again when needed. */
+static void _cookie_permission_manager_policy_list_label_index_invalidate(CookiePermissionManagerPolicyListPrivate *priv)
+{
+	if(priv->labelIndex) g_ptr_array_free(priv->labelIndex, TRUE);
+	priv->labelIndex=NULL;
+
+	g_ptr_array_set_size(priv->labelIndexPending, 0);
+}
+
+/* Build label index over all entries not removed */
+static void _cookie_permission_manager_policy_list_label_index_build(CookiePermissionManagerPolicyListPrivate *priv)
+{
+	CookiePermissionManagerPolicyListEntry		*entry;
+	guint										i;
+
+	if(priv->labelIndex) return;
+
+	priv->labelIndex=g_ptr_array_sized_new(priv->entries->len*3);
+	for(i=0; i<priv->entries->len; i++)
+	{
+		entry=ENTRY(priv->entries, i);
+		if(entry->policy!=COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED) _cookie_permission_manager_policy_list_label_collect(priv->labelIndex, entry);
+	}
+
+	g_ptr_array_sort_with_data(priv->labelIndex, _cookie_permission_manager_policy_list_label_compare, NULL);
+
+	/* Entries added while frozen are in index now */
+	g_ptr_array_set_size(priv->labelIndexPending, 0);
+}
+
+/* Add labels of new entries to label index if it is built */
+static void _cookie_permission_manager_policy_list_label_index_add(CookiePermissionManagerPolicyListPrivate *priv,
+																	GPtrArray *inEntries)
+{
+	GPtrArray		*labels;
+	guint			i;
+
+	if(!priv->labelIndex) return;
+
+	labels=g_ptr_array_new();
+	for(i=0; i<inEntries->len; i++) _cookie_permission_manager_policy_list_label_collect(labels, ENTRY(inEntries, i));
+
+	g_ptr_array_sort_with_data(labels, _cookie_permission_manager_policy_list_label_compare, NULL);
+	_cookie_permission_manager_policy_list_array_merge(priv->labelIndex, labels, _cookie_permission_manager_policy_list_label_compare, NULL);
+
+	g_ptr_array_free(labels, TRUE);
+}
+
+/* Remove labels of entry from label index if it is built */
+static void _cookie_permission_manager_policy_list_label_index_remove(CookiePermissionManagerPolicyListPrivate *priv,
+																		CookiePermissionManagerPolicyListEntry *inEntry)
+{
+	gchar		*label;
+	guint		low, high, middle;
+
+	if(!priv->labelIndex) return;
+
+	for(label=inEntry->domain; label; label=strchr(label, '.'))
+	{
+		if(*label=='.') label++;
+
+		low=0;
+		high=priv->labelIndex->len;
+		while(low<high)
+		{
+			middle=low+(high-low)/2;
+			if(_cookie_permission_manager_policy_list_label_compare(&priv->labelIndex->pdata[middle], &label, NULL)<0) low=middle+1;
+				else high=middle;
+		}
+
+		if(low<priv->labelIndex->len && priv->labelIndex->pdata[low]==label) g_ptr_array_remove_index(priv->labelIndex, low);
+	}
+}
+
+/* Add labels of entries added while frozen to label index in one merge. Entries
+ * removed again meanwhile are skipped.
+ */
+static void _cookie_permission_manager_policy_list_label_index_add_pending(CookiePermissionManagerPolicyListPrivate *priv)
+{
+	CookiePermissionManagerPolicyListEntry		*entry;
+	guint										i, kept;
+
+	if(priv->labelIndexPending->len==0) return;
+
+	for(i=0, kept=0; i<priv->labelIndexPending->len; i++)
+	{
+		entry=ENTRY(priv->labelIndexPending, i);
+		if(entry->policy!=COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED) priv->labelIndexPending->pdata[kept++]=entry;
+	}
+	g_ptr_array_set_size(priv->labelIndexPending, kept);
+
+	_cookie_permission_manager_policy_list_label_index_add(priv, priv->labelIndexPending);
+	g_ptr_array_set_size(priv->labelIndexPending, 0);
+}
+
+/* Mark all entries matching current filter by looking up filter text in label index */
+static void _cookie_permission_manager_policy_list_label_index_mark(CookiePermissionManagerPolicyListPrivate *priv)
+{
+	const gchar		*label;
+	gsize			length;
+	guint			low, high, middle;
+
+	if(!priv->filter) return;
+
+	_cookie_permission_manager_policy_list_label_index_build(priv);
+	_cookie_permission_manager_policy_list_label_index_add_pending(priv);
+
+	/* Find first label starting with filter text */
+	length=strlen(priv->filter);
+	low=0;
+	high=priv->labelIndex->len;
+	while(low<high)
+	{
+		middle=low+(high-low)/2;
+		if(strcmp((const gchar*)priv->labelIndex->pdata[middle], priv->filter)<0) low=middle+1;
+			else high=middle;
+	}
+
+	/* Mark entries of all labels starting with filter text */
+	for(; low<priv->labelIndex->len; low++)
+	{
+		label=(const gchar*)priv->labelIndex->pdata[low];
+		if(strncmp(label, priv->filter, length)!=0) break;
+
+		_cookie_permission_manager_policy_list_label_get_entry(label)->filterStamp=priv->filterStamp;
+	}
+}
+
+/* Set up visible rows from all entries without telling views */
+static void _cookie_permission_manager_policy_list_rebuild_rows(CookiePermissionManagerPolicyListPrivate *priv)
+{
+	CookiePermissionManagerPolicyListEntry		*entry;
+	guint										i;
+
+	g_ptr_array_set_size(priv->rows, 0);
+	for(i=0; i<priv->entries->len; i++)
+	{
+		entry=ENTRY(priv->entries, i);
+		if(_cookie_permission_manager_policy_list_is_visible(priv, entry))
+		{
+			entry->row=priv->rows->len;
+			g_ptr_array_add(priv->rows, entry);
+		}
+			else entry->row=G_MAXUINT;
+	}
+}
+
+/* Set iterator to entry */
+static void _cookie_permission_manager_policy_list_set_iter(CookiePermissionManagerPolicyList *self,
+															GtkTreeIter *outIter,
+															CookiePermissionManagerPolicyListEntry *inEntry)
+{
+	outIter->stamp=self->priv->stamp;
+	outIter->user_data=inEntry;
+	outIter->user_data2=NULL;
+	outIter->user_data3=NULL;
+}
+
+/* Tell views about new visible row */
+static void _cookie_permission_manager_policy_list_row_inserted(CookiePermissionManagerPolicyList *self,
+																CookiePermissionManagerPolicyListEntry *inEntry)
+{
+	GtkTreePath									*path;
+	GtkTreeIter									iter;
+
+	path=gtk_tree_path_new_from_indices(inEntry->row, -1);
+	_cookie_permission_manager_policy_list_set_iter(self, &iter, inEntry);
+	gtk_tree_model_row_inserted(GTK_TREE_MODEL(self), path, &iter);
+	gtk_tree_path_free(path);
+}
+
+/* Tell views about removed visible row */
+static void _cookie_permission_manager_policy_list_row_deleted(CookiePermissionManagerPolicyList *self, guint inRow)
+{
+	GtkTreePath									*path;
+
+	path=gtk_tree_path_new_from_indices(inRow, -1);
+	gtk_tree_model_row_deleted(GTK_TREE_MODEL(self), path);
+	gtk_tree_path_free(path);
+}
+
+/* Insert entry at its position and tell views about it if visible */
+static void _cookie_permission_manager_policy_list_insert(CookiePermissionManagerPolicyList *self,
+															CookiePermissionManagerPolicyListEntry *inEntry)
+{
+	CookiePermissionManagerPolicyListPrivate	*priv=self->priv;
+	guint										position;
+
+	position=_cookie_permission_manager_policy_list_find_position(priv, priv->entries, inEntry);
+	_cookie_permission_manager_policy_list_array_insert(priv->entries, position, inEntry);
+	_cookie_permission_manager_policy_list_update_indices(priv, position);
+
+	inEntry->row=G_MAXUINT;
+	if(_cookie_permission_manager_policy_list_is_visible(priv, inEntry))
+	{
+		position=_cookie_permission_manager_policy_list_find_position(priv, priv->rows, inEntry);
+		_cookie_permission_manager_policy_list_array_insert(priv->rows, position, inEntry);
+		_cookie_permission_manager_policy_list_update_rows(priv, position);
+
+		_cookie_permission_manager_policy_list_row_inserted(self, inEntry);
+	}
+}
+
+/* Take entry out of list and tell views about it if visible. Entry is not freed. */
+static void _cookie_permission_manager_policy_list_take(CookiePermissionManagerPolicyList *self,
+														CookiePermissionManagerPolicyListEntry *inEntry)
+{
+	CookiePermissionManagerPolicyListPrivate	*priv=self->priv;
+	guint										position;
+
+	position=inEntry->index;
+	g_ptr_array_remove_index(priv->entries, position);
+	_cookie_permission_manager_policy_list_update_indices(priv, position);
+
+	position=inEntry->row;
+	if(position!=G_MAXUINT)
+	{
+		g_ptr_array_remove_index(priv->rows, position);
+		_cookie_permission_manager_policy_list_update_rows(priv, position);
+		inEntry->row=G_MAXUINT;
+
+		_cookie_permission_manager_policy_list_row_deleted(self, position);
+	}
+}
+
+/* Tell views that entry has changed if visible */
+static void _cookie_permission_manager_policy_list_changed(CookiePermissionManagerPolicyList *self,
+															CookiePermissionManagerPolicyListEntry *inEntry)
+{
+	GtkTreePath									*path;
+	GtkTreeIter									iter;
+
+	if(inEntry->row==G_MAXUINT) return;
+
+	path=gtk_tree_path_new_from_indices(inEntry->row, -1);
+	_cookie_permission_manager_policy_list_set_iter(self, &iter, inEntry);
+	gtk_tree_model_row_changed(GTK_TREE_MODEL(self), path, &iter);
+	gtk_tree_path_free(path);
+}
+
+/* Check if entry is still at its sorted position. Visible rows are in the same
+ * order as all entries so they are in order if all entries are.
+ */
+static gboolean _cookie_permission_manager_policy_list_is_in_order(CookiePermissionManagerPolicyListPrivate *priv,
+																	CookiePermissionManagerPolicyListEntry *inEntry)
+{
+	if(!_cookie_permission_manager_policy_list_is_sorted(priv)) return(TRUE);
+
+	if(inEntry->index>0 &&
+		_cookie_permission_manager_policy_list_compare(priv, ENTRY(priv->entries, inEntry->index-1), inEntry)>0)
+	{
+		return(FALSE);
+	}
+
+	if(inEntry->index+1<priv->entries->len &&
+		_cookie_permission_manager_policy_list_compare(priv, inEntry, ENTRY(priv->entries, inEntry->index+1))>0)
+	{
+		return(FALSE);
+	}
+
+	return(TRUE);
+}
+
+/* Sort all entries and tell views about new order of visible rows */
+static void _cookie_permission_manager_policy_list_sort(CookiePermissionManagerPolicyList *self)
+{
+	CookiePermissionManagerPolicyListPrivate	*priv=self->priv;
+	CookiePermissionManagerPolicyListEntry		*entry;
+	gint										*newOrder;
+	GtkTreePath									*path;
+	guint										i, row;
+
+	if(priv->freezeCount>0 ||
+		priv->entries->len<2 ||
+		!_cookie_permission_manager_policy_list_is_sorted(priv))
+	{
+		return;
+	}
+
+	g_ptr_array_sort_with_data(priv->entries, _cookie_permission_manager_policy_list_sort_callback, priv);
+	_cookie_permission_manager_policy_list_update_indices(priv, 0);
+
+	/* Visible rows still know their old position */
+	newOrder=g_new(gint, MAX(priv->rows->len, 1));
+	for(i=0, row=0; i<priv->entries->len; i++)
+	{
+		entry=ENTRY(priv->entries, i);
+		if(entry->row==G_MAXUINT) continue;
+
+		newOrder[row]=entry->row;
+		priv->rows->pdata[row]=entry;
+		entry->row=row;
+		row++;
+	}
+
+	if(priv->rows->len>0)
+	{
+		path=gtk_tree_path_new();
+		gtk_tree_model_rows_reordered(GTK_TREE_MODEL(self), path, NULL, newOrder);
+		gtk_tree_path_free(path);
+	}
+
+	g_free(newOrder);
+}
+
+/* IMPLEMENTATION: GtkTreeModel */
+
+static GtkTreeModelFlags _cookie_permission_manager_policy_list_get_flags(GtkTreeModel *inModel)
+{
+	return(GTK_TREE_MODEL_ITERS_PERSIST | GTK_TREE_MODEL_LIST_ONLY);
+}
+
+static gint _cookie_permission_manager_policy_list_get_n_columns(GtkTreeModel *inModel)
+{
+	return(COOKIE_PERMISSION_MANAGER_POLICY_LIST_N_COLUMNS);
+}
+
+static GType _cookie_permission_manager_policy_list_get_column_type(GtkTreeModel *inModel, gint inColumn)
+{
+	switch(inColumn)
+	{
+		case COOKIE_PERMISSION_MANAGER_POLICY_LIST_COLUMN_DOMAIN:
+			return(G_TYPE_STRING);
+
+		case COOKIE_PERMISSION_MANAGER_POLICY_LIST_COLUMN_POLICY:
+			return(G_TYPE_INT);
+
+		case COOKIE_PERMISSION_MANAGER_POLICY_LIST_COLUMN_IS_PATTERN:
+			return(G_TYPE_BOOLEAN);
+
+		default:
+			break;
+	}
+
+	return(G_TYPE_INVALID);
+}
+
+static gboolean _cookie_permission_manager_policy_list_iter_nth_child(GtkTreeModel *inModel,
+																		GtkTreeIter *outIter,
+																		GtkTreeIter *inParent,
+																		gint inIndex)
+{
+	CookiePermissionManagerPolicyList			*self=COOKIE_PERMISSION_MANAGER_POLICY_LIST(inModel);
+	CookiePermissionManagerPolicyListPrivate	*priv=self->priv;
+
+	if(inParent || inIndex<0 || (guint)inIndex>=priv->rows->len) return(FALSE);
+
+	_cookie_permission_manager_policy_list_set_iter(self, outIter, ENTRY(priv->rows, inIndex));
+	return(TRUE);
+}
+
+static gboolean _cookie_permission_manager_policy_list_get_iter(GtkTreeModel *inModel,
+																GtkTreeIter *outIter,
+																GtkTreePath *inPath)
+{
+	if(gtk_tree_path_get_depth(inPath)!=1) return(FALSE);
+
+	return(_cookie_permission_manager_policy_list_iter_nth_child(inModel, outIter, NULL, gtk_tree_path_get_indices(inPath)[0]));
+}
+
+static GtkTreePath* _cookie_permission_manager_policy_list_get_path(GtkTreeModel *inModel, GtkTreeIter *inIter)
+{
+	CookiePermissionManagerPolicyListEntry		*entry=(CookiePermissionManagerPolicyListEntry*)inIter->user_data;
+
+	g_return_val_if_fail(inIter->stamp==COOKIE_PERMISSION_MANAGER_POLICY_LIST(inModel)->priv->stamp, NULL);
+	g_return_val_if_fail(entry->row!=G_MAXUINT, NULL);
+
+	return(gtk_tree_path_new_from_indices(entry->row, -1));
+}
+
+static void _cookie_permission_manager_policy_list_get_value(GtkTreeModel *inModel,
+																GtkTreeIter *inIter,
+																gint inColumn,
+																GValue *outValue)
+{
+	CookiePermissionManagerPolicyListEntry		*entry=(CookiePermissionManagerPolicyListEntry*)inIter->user_data;
+
+	g_return_if_fail(inIter->stamp==COOKIE_PERMISSION_MANAGER_POLICY_LIST(inModel)->priv->stamp);
+
+	switch(inColumn)
+	{
+		case COOKIE_PERMISSION_MANAGER_POLICY_LIST_COLUMN_DOMAIN:
+			g_value_init(outValue, G_TYPE_STRING);
+			g_value_set_string(outValue, entry->domain);
+			break;
+
+		case COOKIE_PERMISSION_MANAGER_POLICY_LIST_COLUMN_POLICY:
+			g_value_init(outValue, G_TYPE_INT);
+			g_value_set_int(outValue, entry->policy);
+			break;
+
+		case COOKIE_PERMISSION_MANAGER_POLICY_LIST_COLUMN_IS_PATTERN:
+			g_value_init(outValue, G_TYPE_BOOLEAN);
+			g_value_set_boolean(outValue, entry->isPattern);
+			break;
+
+		default:
+			g_warning(_("Invalid column %d in list of policies"), inColumn);
+			break;
+	}
+}
+
+static gboolean _cookie_permission_manager_policy_list_iter_next(GtkTreeModel *inModel, GtkTreeIter *ioIter)
+{
+	CookiePermissionManagerPolicyListEntry		*entry=(CookiePermissionManagerPolicyListEntry*)ioIter->user_data;
+
+	if(entry->row==G_MAXUINT) return(FALSE);
+
+	return(_cookie_permission_manager_policy_list_iter_nth_child(inModel, ioIter, NULL, entry->row+1));
+}
+
+static gboolean _cookie_permission_manager_policy_list_iter_children(GtkTreeModel *inModel,
+																		GtkTreeIter *outIter,
+																		GtkTreeIter *inParent)
+{
+	return(_cookie_permission_manager_policy_list_iter_nth_child(inModel, outIter, inParent, 0));
+}
+
+static gboolean _cookie_permission_manager_policy_list_iter_has_child(GtkTreeModel *inModel, GtkTreeIter *inIter)
+{
+	return(FALSE);
+}
+
+static gint _cookie_permission_manager_policy_list_iter_n_children(GtkTreeModel *inModel, GtkTreeIter *inIter)
+{
+	if(inIter) return(0);
+
+	return(COOKIE_PERMISSION_MANAGER_POLICY_LIST(inModel)->priv->rows->len);
+}
+
+static gboolean _cookie_permission_manager_policy_list_iter_parent(GtkTreeModel *inModel,
+																	GtkTreeIter *outIter,
+																	GtkTreeIter *inChild)
+{
+	return(FALSE);
+}
+
+static void _cookie_permission_manager_policy_list_tree_model_iface_init(GtkTreeModelIface *iface)
+{
+	iface->get_flags=_cookie_permission_manager_policy_list_get_flags;
+	iface->get_n_columns=_cookie_permission_manager_policy_list_get_n_columns;
+	iface->get_column_type=_cookie_permission_manager_policy_list_get_column_type;
+	iface->get_iter=_cookie_permission_manager_policy_list_get_iter;
+	iface->get_path=_cookie_permission_manager_policy_list_get_path;
+	iface->get_value=_cookie_permission_manager_policy_list_get_value;
+	iface->iter_next=_cookie_permission_manager_policy_list_iter_next;
+	iface->iter_children=_cookie_permission_manager_policy_list_iter_children;
+	iface->iter_has_child=_cookie_permission_manager_policy_list_iter_has_child;
+	iface->iter_n_children=_cookie_permission_manager_policy_list_iter_n_children;
+	iface->iter_nth_child=_cookie_permission_manager_policy_list_iter_nth_child;
+	iface->iter_parent=_cookie_permission_manager_policy_list_iter_parent;
+}
+
+/* IMPLEMENTATION: GtkTreeSortable */
+
+static gboolean _cookie_permission_manager_policy_list_get_sort_column_id(GtkTreeSortable *inSortable,
+																			gint *outColumn,
+																			GtkSortType *outOrder)
+{
+	CookiePermissionManagerPolicyListPrivate	*priv=COOKIE_PERMISSION_MANAGER_POLICY_LIST(inSortable)->priv;
+
+	if(outColumn) *outColumn=priv->sortColumn;
+	if(outOrder) *outOrder=priv->sortOrder;
+
+	return(_cookie_permission_manager_policy_list_is_sorted(priv));
+}
+
+static void _cookie_permission_manager_policy_list_set_sort_column_id(GtkTreeSortable *inSortable,
+																		gint inColumn,
+																		GtkSortType inOrder)
+{
+	CookiePermissionManagerPolicyList			*self=COOKIE_PERMISSION_MANAGER_POLICY_LIST(inSortable);
+	CookiePermissionManagerPolicyListPrivate	*priv=self->priv;
+
+	/* There is no default sort function so default sort column means unsorted */
+	if(inColumn==GTK_TREE_SORTABLE_DEFAULT_SORT_COLUMN_ID) inColumn=GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID;
+
+	if(priv->sortColumn==inColumn && priv->sortOrder==inOrder) return;
+
+	priv->sortColumn=inColumn;
+	priv->sortOrder=inOrder;
+
+	gtk_tree_sortable_sort_column_changed(inSortable);
+	_cookie_permission_manager_policy_list_sort(self);
+}
+
+static void _cookie_permission_manager_policy_list_set_sort_func(GtkTreeSortable *inSortable,
+																	gint inColumn,
+																	GtkTreeIterCompareFunc inFunc,
+																	gpointer inUserData,
+																	GDestroyNotify inDestroyFunc)
+{
+	g_warning(_("List of policies does not support custom sort functions"));
+}
+
+static void _cookie_permission_manager_policy_list_set_default_sort_func(GtkTreeSortable *inSortable,
+																			GtkTreeIterCompareFunc inFunc,
+																			gpointer inUserData,
+																			GDestroyNotify inDestroyFunc)
+{
+	g_warning(_("List of policies does not support custom sort functions"));
+}
+
+static gboolean _cookie_permission_manager_policy_list_has_default_sort_func(GtkTreeSortable *inSortable)
+{
+	return(FALSE);
+}
+
+static void _cookie_permission_manager_policy_list_tree_sortable_iface_init(GtkTreeSortableIface *iface)
+{
+	iface->get_sort_column_id=_cookie_permission_manager_policy_list_get_sort_column_id;
+	iface->set_sort_column_id=_cookie_permission_manager_policy_list_set_sort_column_id;
+	iface->set_sort_func=_cookie_permission_manager_policy_list_set_sort_func;
+	iface->set_default_sort_func=_cookie_permission_manager_policy_list_set_default_sort_func;
+	iface->has_default_sort_func=_cookie_permission_manager_policy_list_has_default_sort_func;
+}
+
+/* IMPLEMENTATION: GObject */
+
+/* Finalize this object */
+static void cookie_permission_manager_policy_list_finalize(GObject *inObject)
+{
+	CookiePermissionManagerPolicyListPrivate	*priv=COOKIE_PERMISSION_MANAGER_POLICY_LIST(inObject)->priv;
+	guint										i;
+
+	/* Dispose allocated resources */
+	_cookie_permission_manager_policy_list_label_index_invalidate(priv);
+	g_ptr_array_free(priv->labelIndexPending, TRUE);
+
+	g_hash_table_destroy(priv->domains);
+
+	g_ptr_array_free(priv->rows, TRUE);
+
+	for(i=0; i<priv->entries->len; i++) g_free(g_ptr_array_index(priv->entries, i));
+	g_ptr_array_free(priv->entries, TRUE);
+
+	g_free(priv->filter);
+
+	/* Call parent's class finalize method */
+	G_OBJECT_CLASS(cookie_permission_manager_policy_list_parent_class)->finalize(inObject);
+}
+
+/* Class initialization
+ * Override functions in parent classes and define properties and signals
+ */
+static void cookie_permission_manager_policy_list_class_init(CookiePermissionManagerPolicyListClass *klass)
+{
+	GObjectClass		*gobjectClass=G_OBJECT_CLASS(klass);
+	gint				policy, other;
+	guint				rank;
+
+	/* Override functions */
+	gobjectClass->finalize=cookie_permission_manager_policy_list_finalize;
+
+	/* Set up private structure */
+	g_type_class_add_private(klass, sizeof(CookiePermissionManagerPolicyListPrivate));
+
+	/* Collate names of policies once */
+	for(policy=COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT; policy<=COOKIE_PERMISSION_MANAGER_POLICY_BLOCK; policy++)
+	{
+		rank=0;
+		for(other=COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT; other<=COOKIE_PERMISSION_MANAGER_POLICY_BLOCK; other++)
+		{
+			if(g_utf8_collate(cookie_permission_manager_policy_list_get_policy_name(other),
+								cookie_permission_manager_policy_list_get_policy_name(policy))<0)
+			{
+				rank++;
+			}
+		}
+
+		CookiePermissionManagerPolicyListPolicyRanks[policy]=rank;
+	}
+}
+
+/* Object initialization
+ * Create private structure and set up default values
+ */
+static void cookie_permission_manager_policy_list_init(CookiePermissionManagerPolicyList *self)
+{
+	CookiePermissionManagerPolicyListPrivate	*priv;
+
+	priv=self->priv=COOKIE_PERMISSION_MANAGER_POLICY_LIST_GET_PRIVATE(self);
+
+	/* Set up default values */
+	priv->entries=g_ptr_array_new();
+	priv->rows=g_ptr_array_new();
+	priv->domains=g_hash_table_new(g_str_hash, g_str_equal);
+	priv->stamp=g_random_int();
+	priv->sortColumn=GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID;
+	priv->sortOrder=GTK_SORT_ASCENDING;
+	priv->filter=NULL;
+	priv->filterStamp=0;
+	priv->labelIndex=NULL;
+	priv->labelIndexPending=g_ptr_array_new();
+	priv->freezeCount=0;
+	priv->frozenChanges=FALSE;
+	priv->frozenFilterChanges=FALSE;
+}
+
+/* Implementation: Public API */
+
+/* Create new object */
+CookiePermissionManagerPolicyList* cookie_permission_manager_policy_list_new(void)
+{
+	return(g_object_new(TYPE_COOKIE_PERMISSION_MANAGER_POLICY_LIST, NULL));
+}
+
+/* Get number of domains and domain patterns in list including ones
+ * not matching filter
+ */
+guint cookie_permission_manager_policy_list_get_size(CookiePermissionManagerPolicyList *self)
+{
+	g_return_val_if_fail(IS_COOKIE_PERMISSION_MANAGER_POLICY_LIST(self), 0);
+
+	return(g_hash_table_size(self->priv->domains));
+}
+
+/* Add, update or remove row of domain or domain pattern. Setting policy to
+ * COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED removes the row.
+ */
+void cookie_permission_manager_policy_list_set_policy(CookiePermissionManagerPolicyList *self, const gchar *inDomain, gint inPolicy)
+{
+	CookiePermissionManagerPolicyListPrivate	*priv;
+	CookiePermissionManagerPolicyListEntry		*entry;
+	GPtrArray									*entries;
+	gchar										*key;
+
+	g_return_if_fail(IS_COOKIE_PERMISSION_MANAGER_POLICY_LIST(self));
+	g_return_if_fail(inDomain);
+	g_return_if_fail(inPolicy>=COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED && inPolicy<=COOKIE_PERMISSION_MANAGER_POLICY_BLOCK);
+
+	priv=self->priv;
+
+	key=g_ascii_strdown(inDomain, -1);
+	entry=(CookiePermissionManagerPolicyListEntry*)g_hash_table_lookup(priv->domains, key);
+	g_free(key);
+
+	if(!entry && inPolicy==COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED) return;
+	if(entry && entry->policy==inPolicy) return;
+
+	/* While frozen only record changes. Removed entries are kept in list until
+	 * list is thawed as positions of other entries would change otherwise. Labels
+	 * of removed entries are taken out of label index at once while labels of new
+	 * entries are merged into it in one pass when needed.
+	 */
+	if(priv->freezeCount>0)
+	{
+		if(!entry)
+		{
+			entry=_cookie_permission_manager_policy_list_entry_new(priv, inDomain, inPolicy);
+			entry->index=priv->entries->len;
+			g_ptr_array_add(priv->entries, entry);
+			g_hash_table_insert(priv->domains, entry->domain, entry);
+
+			if(priv->labelIndex) g_ptr_array_add(priv->labelIndexPending, entry);
+		}
+			else
+			{
+				if(inPolicy==COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED)
+				{
+					_cookie_permission_manager_policy_list_label_index_remove(priv, entry);
+					g_hash_table_remove(priv->domains, entry->domain);
+				}
+				entry->policy=inPolicy;
+			}
+
+		priv->frozenChanges=TRUE;
+		return;
+	}
+
+	/* Add new entry at its sorted position */
+	if(!entry)
+	{
+		entry=_cookie_permission_manager_policy_list_entry_new(priv, inDomain, inPolicy);
+		g_hash_table_insert(priv->domains, entry->domain, entry);
+		_cookie_permission_manager_policy_list_insert(self, entry);
+
+		entries=g_ptr_array_new();
+		g_ptr_array_add(entries, entry);
+		_cookie_permission_manager_policy_list_label_index_add(priv, entries);
+		g_ptr_array_free(entries, TRUE);
+		return;
+	}
+
+	/* Remove entry */
+	if(inPolicy==COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED)
+	{
+		_cookie_permission_manager_policy_list_label_index_remove(priv, entry);
+		g_hash_table_remove(priv->domains, entry->domain);
+		_cookie_permission_manager_policy_list_take(self, entry);
+		g_free(entry);
+		return;
+	}
+
+	/* Change policy of entry and move it if it is out of order now */
+	entry->policy=inPolicy;
+	if(_cookie_permission_manager_policy_list_is_in_order(priv, entry))
+	{
+		_cookie_permission_manager_policy_list_changed(self, entry);
+	}
+		else
+		{
+			_cookie_permission_manager_policy_list_take(self, entry);
+			_cookie_permission_manager_policy_list_insert(self, entry);
+		}
+}
+
+/* Set policies of many domains at once. New rows are sorted among themselves
+ * and merged into list in one pass instead of being inserted one by one.
+ */
+void cookie_permission_manager_policy_list_add_policies(CookiePermissionManagerPolicyList *self,
+															const gchar **inDomains,
+															const gint *inPolicies,
+															guint inCount)
+{
+	CookiePermissionManagerPolicyListPrivate	*priv;
+	CookiePermissionManagerPolicyListEntry		*entry;
+	GPtrArray									*newEntries, *newRows;
+	gchar										*key;
+	guint										i, kept, start;
+
+	g_return_if_fail(IS_COOKIE_PERMISSION_MANAGER_POLICY_LIST(self));
+	g_return_if_fail(inDomains || inCount==0);
+	g_return_if_fail(inPolicies || inCount==0);
+
+	priv=self->priv;
+
+	/* Frozen or unsorted lists just append so there is nothing to merge */
+	if(priv->freezeCount>0 || !_cookie_permission_manager_policy_list_is_sorted(priv))
+	{
+		for(i=0; i<inCount; i++) cookie_permission_manager_policy_list_set_policy(self, inDomains[i], inPolicies[i]);
+		return;
+	}
+
+	/* Change existing rows one by one and collect new ones. New entries are not
+	 * in list yet so their position is G_MAXUINT.
+	 */
+	newEntries=g_ptr_array_sized_new(inCount);
+	for(i=0; i<inCount; i++)
+	{
+		key=g_ascii_strdown(inDomains[i], -1);
+		entry=(CookiePermissionManagerPolicyListEntry*)g_hash_table_lookup(priv->domains, key);
+		g_free(key);
+
+		if(entry && entry->index==G_MAXUINT)
+		{
+			if(inPolicies[i]==COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED) g_hash_table_remove(priv->domains, entry->domain);
+			entry->policy=inPolicies[i];
+		}
+			else if(entry || inPolicies[i]==COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED)
+			{
+				cookie_permission_manager_policy_list_set_policy(self, inDomains[i], inPolicies[i]);
+			}
+			else
+			{
+				entry=_cookie_permission_manager_policy_list_entry_new(priv, inDomains[i], inPolicies[i]);
+				g_hash_table_insert(priv->domains, entry->domain, entry);
+				g_ptr_array_add(newEntries, entry);
+			}
+	}
+
+	/* Drop new entries removed again in same batch */
+	for(i=0, kept=0; i<newEntries->len; i++)
+	{
+		entry=ENTRY(newEntries, i);
+		if(entry->policy==COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED) g_free(entry);
+			else newEntries->pdata[kept++]=entry;
+	}
+	g_ptr_array_set_size(newEntries, kept);
+
+	if(newEntries->len==0)
+	{
+		g_ptr_array_free(newEntries, TRUE);
+		return;
+	}
+
+	/* Merge sorted new entries into all entries and visible ones into rows */
+	g_ptr_array_sort_with_data(newEntries, _cookie_permission_manager_policy_list_sort_callback, priv);
+
+	start=_cookie_permission_manager_policy_list_array_merge(priv->entries, newEntries, _cookie_permission_manager_policy_list_sort_callback, priv);
+	_cookie_permission_manager_policy_list_update_indices(priv, start);
+
+	_cookie_permission_manager_policy_list_label_index_add(priv, newEntries);
+
+	newRows=g_ptr_array_sized_new(newEntries->len);
+	for(i=0; i<newEntries->len; i++)
+	{
+		entry=ENTRY(newEntries, i);
+		if(_cookie_permission_manager_policy_list_is_visible(priv, entry)) g_ptr_array_add(newRows, entry);
+	}
+
+	if(newRows->len>0)
+	{
+		start=_cookie_permission_manager_policy_list_array_merge(priv->rows, newRows, _cookie_permission_manager_policy_list_sort_callback, priv);
+		_cookie_permission_manager_policy_list_update_rows(priv, start);
+
+		/* Tell views about new rows in ascending order so each path is valid when signalled */
+		for(i=0; i<newRows->len; i++) _cookie_permission_manager_policy_list_row_inserted(self, ENTRY(newRows, i));
+	}
+
+	g_ptr_array_free(newRows, TRUE);
+	g_ptr_array_free(newEntries, TRUE);
+}
+
+/* Remove all rows */
+void cookie_permission_manager_policy_list_remove_all(CookiePermissionManagerPolicyList *self)
+{
+	CookiePermissionManagerPolicyListPrivate	*priv;
+	guint										i;
+
+	g_return_if_fail(IS_COOKIE_PERMISSION_MANAGER_POLICY_LIST(self));
+
+	priv=self->priv;
+
+	_cookie_permission_manager_policy_list_label_index_invalidate(priv);
+	g_hash_table_remove_all(priv->domains);
+
+	/* Remove visible rows from end so views do not need to move remaining rows */
+	while(priv->rows->len>0)
+	{
+		g_ptr_array_set_size(priv->rows, priv->rows->len-1);
+		if(priv->freezeCount==0) _cookie_permission_manager_policy_list_row_deleted(self, priv->rows->len);
+	}
+
+	for(i=0; i<priv->entries->len; i++) g_free(g_ptr_array_index(priv->entries, i));
+	g_ptr_array_set_size(priv->entries, 0);
+}
+
+/* Show only domains and domain patterns having a label starting with text,
+ * e.g. "exa" or "example.co" matches "www.example.com". Setting NULL or an
+ * empty text shows all rows again.
+ */
+void cookie_permission_manager_policy_list_set_filter(CookiePermissionManagerPolicyList *self, const gchar *inFilter)
+{
+	CookiePermissionManagerPolicyListPrivate	*priv;
+	CookiePermissionManagerPolicyListEntry		*entry;
+	gchar										*filter=NULL;
+	guint										i, deleted;
+	gboolean									isNarrowed, inserted;
+
+	g_return_if_fail(IS_COOKIE_PERMISSION_MANAGER_POLICY_LIST(self));
+
+	priv=self->priv;
+
+	/* Normalize filter text */
+	if(inFilter)
+	{
+		filter=g_strstrip(g_ascii_strdown(inFilter, -1));
+		if(!*filter)
+		{
+			g_free(filter);
+			filter=NULL;
+		}
+	}
+
+	if(g_strcmp0(filter, priv->filter)==0)
+	{
+		g_free(filter);
+		return;
+	}
+
+	/* Set new filter and mark all entries matching it. If filter text was only
+	 * extended, as it is when typing, just rows shown already can match so these
+	 * are checked instead of looking up the index. Rows are up to date unless
+	 * list or filter changed while frozen.
+	 */
+	isNarrowed=(priv->filter &&
+				filter &&
+				g_str_has_prefix(filter, priv->filter) &&
+				!priv->frozenChanges &&
+				!priv->frozenFilterChanges);
+
+	g_free(priv->filter);
+	priv->filter=filter;
+	priv->filterStamp++;
+
+	if(isNarrowed)
+	{
+		for(i=0; i<priv->rows->len; i++)
+		{
+			entry=ENTRY(priv->rows, i);
+			if(_cookie_permission_manager_policy_list_entry_matches(priv, entry)) entry->filterStamp=priv->filterStamp;
+		}
+	}
+		else _cookie_permission_manager_policy_list_label_index_mark(priv);
+
+	/* While frozen visible rows are set up when thawed */
+	if(priv->freezeCount>0)
+	{
+		priv->frozenFilterChanges=TRUE;
+		return;
+	}
+
+	/* Remove rows not matching anymore. Each removal moves following rows up. */
+	for(i=0, deleted=0; i<priv->rows->len; i++)
+	{
+		entry=ENTRY(priv->rows, i);
+		if(!_cookie_permission_manager_policy_list_is_visible(priv, entry))
+		{
+			entry->row=G_MAXUINT;
+			_cookie_permission_manager_policy_list_row_deleted(self, i-deleted);
+			deleted++;
+		}
+	}
+
+	/* Set up rows and add rows matching now in ascending order */
+	g_ptr_array_set_size(priv->rows, 0);
+	for(i=0; i<priv->entries->len; i++)
+	{
+		entry=ENTRY(priv->entries, i);
+		if(!_cookie_permission_manager_policy_list_is_visible(priv, entry)) continue;
+
+		inserted=(entry->row==G_MAXUINT);
+		entry->row=priv->rows->len;
+		g_ptr_array_add(priv->rows, entry);
+
+		if(inserted) _cookie_permission_manager_policy_list_row_inserted(self, entry);
+	}
+}
+
+/* Freeze list to apply many changes at once. Changes made while list is frozen
+ * are not signalled but applied and sorted in one pass when list is thawed, so
+ * list must not be attached to any view while frozen.
+ */
+void cookie_permission_manager_policy_list_freeze(CookiePermissionManagerPolicyList *self)
+{
+	g_return_if_fail(IS_COOKIE_PERMISSION_MANAGER_POLICY_LIST(self));
+
+	self->priv->freezeCount++;
+}
+
+void cookie_permission_manager_policy_list_thaw(CookiePermissionManagerPolicyList *self)
+{
+	CookiePermissionManagerPolicyListPrivate	*priv;
+	CookiePermissionManagerPolicyListEntry		*entry;
+	guint										i, kept;
+
+	g_return_if_fail(IS_COOKIE_PERMISSION_MANAGER_POLICY_LIST(self));
+	g_return_if_fail(self->priv->freezeCount>0);
+
+	priv=self->priv;
+
+	priv->freezeCount--;
+	if(priv->freezeCount>0) return;
+
+	if(priv->frozenChanges)
+	{
+		/* Label index misses new entries only as removed ones were taken out already */
+		_cookie_permission_manager_policy_list_label_index_add_pending(priv);
+
+		/* Drop removed entries */
+		for(i=0, kept=0; i<priv->entries->len; i++)
+		{
+			entry=ENTRY(priv->entries, i);
+			if(entry->policy==COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED) g_free(entry);
+				else priv->entries->pdata[kept++]=entry;
+		}
+		g_ptr_array_set_size(priv->entries, kept);
+
+		/* Restore order */
+		if(_cookie_permission_manager_policy_list_is_sorted(priv))
+		{
+			g_ptr_array_sort_with_data(priv->entries, _cookie_permission_manager_policy_list_sort_callback, priv);
+		}
+		_cookie_permission_manager_policy_list_update_indices(priv, 0);
+	}
+
+	if(priv->frozenChanges || priv->frozenFilterChanges) _cookie_permission_manager_policy_list_rebuild_rows(priv);
+
+	priv->frozenChanges=FALSE;
+	priv->frozenFilterChanges=FALSE;
+}
+
+/* Get name of policy to show in list */
+const gchar* cookie_permission_manager_policy_list_get_policy_name(gint inPolicy)
+{
+	switch(inPolicy)
+	{
+		case COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT:
+			return(_("Accept"));
+
+		case COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION:
+			return(_("Accept for session"));
+
+		case COOKIE_PERMISSION_MANAGER_POLICY_BLOCK:
+			return(_("Block"));
+
+		default:
+			break;
+	}
+
+	return(NULL);
+}
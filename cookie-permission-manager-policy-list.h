@@ -0,0 +1,85 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+#ifndef __COOKIE_PERMISSION_MANAGER_POLICY_LIST__
+#define __COOKIE_PERMISSION_MANAGER_POLICY_LIST__
+
+#include "config.h"
+#include <midori/midori.h>
+
+G_BEGIN_DECLS
+
+/* Tree model listing policies of domains and domain patterns. Rows are kept in
+ * a compact array sorted by current sort column and are found by domain in a
+ * hash-table so a policy can be added, changed or removed without scanning
+ * the list. Policy is stored as integer and has to be rendered by a cell data
+ * function. Rows can be narrowed to domains having a label starting with a
+ * filter text which is looked up in a sorted index of all labels.
+ */
+enum
+{
+	COOKIE_PERMISSION_MANAGER_POLICY_LIST_COLUMN_DOMAIN,
+	COOKIE_PERMISSION_MANAGER_POLICY_LIST_COLUMN_POLICY,
+	COOKIE_PERMISSION_MANAGER_POLICY_LIST_COLUMN_IS_PATTERN,
+
+	COOKIE_PERMISSION_MANAGER_POLICY_LIST_N_COLUMNS
+};
+
+#define TYPE_COOKIE_PERMISSION_MANAGER_POLICY_LIST				(cookie_permission_manager_policy_list_get_type())
+#define COOKIE_PERMISSION_MANAGER_POLICY_LIST(obj)				(G_TYPE_CHECK_INSTANCE_CAST((obj), TYPE_COOKIE_PERMISSION_MANAGER_POLICY_LIST, CookiePermissionManagerPolicyList))
+#define IS_COOKIE_PERMISSION_MANAGER_POLICY_LIST(obj)			(G_TYPE_CHECK_INSTANCE_TYPE((obj), TYPE_COOKIE_PERMISSION_MANAGER_POLICY_LIST))
+#define COOKIE_PERMISSION_MANAGER_POLICY_LIST_CLASS(klass)		(G_TYPE_CHECK_CLASS_CAST((klass), TYPE_COOKIE_PERMISSION_MANAGER_POLICY_LIST, CookiePermissionManagerPolicyListClass))
+#define IS_COOKIE_PERMISSION_MANAGER_POLICY_LIST_CLASS(klass)	(G_TYPE_CHECK_CLASS_TYPE((klass), TYPE_COOKIE_PERMISSION_MANAGER_POLICY_LIST))
+#define COOKIE_PERMISSION_MANAGER_POLICY_LIST_GET_CLASS(obj)	(G_TYPE_INSTANCE_GET_CLASS((obj), TYPE_COOKIE_PERMISSION_MANAGER_POLICY_LIST, CookiePermissionManagerPolicyListClass))
+
+typedef struct _CookiePermissionManagerPolicyList				CookiePermissionManagerPolicyList;
+typedef struct _CookiePermissionManagerPolicyListClass			CookiePermissionManagerPolicyListClass;
+typedef struct _CookiePermissionManagerPolicyListPrivate		CookiePermissionManagerPolicyListPrivate;
+
+struct _CookiePermissionManagerPolicyList
+{
+	/* Parent instance */
+	GObject										parent_instance;
+
+	/* Private structure */
+	CookiePermissionManagerPolicyListPrivate	*priv;
+};
+
+struct _CookiePermissionManagerPolicyListClass
+{
+	/* Parent class */
+	GObjectClass								parent_class;
+};
+
+/* Public API */
+GType cookie_permission_manager_policy_list_get_type(void);
+
+CookiePermissionManagerPolicyList* cookie_permission_manager_policy_list_new(void);
+
+guint cookie_permission_manager_policy_list_get_size(CookiePermissionManagerPolicyList *self);
+
+void cookie_permission_manager_policy_list_set_policy(CookiePermissionManagerPolicyList *self, const gchar *inDomain, gint inPolicy);
+void cookie_permission_manager_policy_list_add_policies(CookiePermissionManagerPolicyList *self,
+															const gchar **inDomains,
+															const gint *inPolicies,
+															guint inCount);
+void cookie_permission_manager_policy_list_remove_all(CookiePermissionManagerPolicyList *self);
+
+void cookie_permission_manager_policy_list_set_filter(CookiePermissionManagerPolicyList *self, const gchar *inFilter);
+
+void cookie_permission_manager_policy_list_freeze(CookiePermissionManagerPolicyList *self);
+void cookie_permission_manager_policy_list_thaw(CookiePermissionManagerPolicyList *self);
+
+const gchar* cookie_permission_manager_policy_list_get_policy_name(gint inPolicy);
+
+G_END_DECLS
+
+#endif /* __COOKIE_PERMISSION_MANAGER_POLICY_LIST__ */
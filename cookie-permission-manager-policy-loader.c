@@ -0,0 +1,312 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+#include "cookie-permission-manager-policy-loader.h"
+#include "cookie-permission-manager-database.h"
+#include "cookie-permission-manager.h"
+
+/* Number of rows handed over to main loop at once */
+#define POLICY_LOADER_CHUNK_SIZE		512
+
+/* Interval in milliseconds to check for loaded chunks in main loop */
+#define POLICY_LOADER_INTERVAL			20
+
+/* Time in milliseconds main loop may spend on processing loaded chunks per interval */
+#define POLICY_LOADER_TIME_SLICE		10
+
+/* Number of times to step again if database stays locked longer than busy timeout */
+#define POLICY_LOADER_BUSY_RETRIES		3
+
+typedef struct _CookiePermissionManagerPolicyLoaderChunk		CookiePermissionManagerPolicyLoaderChunk;
+
+struct _CookiePermissionManagerPolicyLoaderChunk
+{
+	guint			count;
+	gchar			*domains[POLICY_LOADER_CHUNK_SIZE+1];
+	gint			policies[POLICY_LOADER_CHUNK_SIZE];
+};
+
+struct _CookiePermissionManagerPolicyLoader
+{
+	gchar											*databaseFilename;
+	CookiePermissionManagerPolicyLoaderChunkFunc	chunkCallback;
+	CookiePermissionManagerPolicyLoaderProgressFunc	progressCallback;
+	gpointer										userData;
+
+	GThread											*thread;
+	GAsyncQueue										*chunks;
+	guint											sourceID;
+	guint											loaded;
+
+	volatile gint									total;			/* Increased by thread and by rows pushed */
+	volatile gint									finished;		/* Set by thread when all chunks are queued */
+	volatile gint									cancelled;		/* Set by main loop to stop thread */
+	gchar											*error;			/* Set by thread before it finishes */
+};
+
+/* IMPLEMENTATION: Private variables and methods */
+
+/* Release a chunk of rows */
+static void _cookie_permission_manager_policy_loader_chunk_free(CookiePermissionManagerPolicyLoaderChunk *inChunk)
+{
+	guint		i;
+
+	for(i=0; i<inChunk->count; i++) g_free(inChunk->domains[i]);
+	g_free(inChunk);
+}
+
+/* Remember first error of thread and report it */
+static void _cookie_permission_manager_policy_loader_set_error(CookiePermissionManagerPolicyLoader *self, sqlite3 *inDatabase)
+{
+	g_warning(_("SQL fails: %s"), sqlite3_errmsg(inDatabase));
+
+	if(!self->error) self->error=g_strdup(sqlite3_errmsg(inDatabase));
+}
+
+/* Read all rows of statement and queue them in chunks. Returns FALSE if not
+ * all rows could be read, e.g. database is corrupt or stayed locked.
+ */
+static gboolean _cookie_permission_manager_policy_loader_read(CookiePermissionManagerPolicyLoader *self,
+																sqlite3_stmt *inStatement,
+																CookiePermissionManagerPolicyLoaderChunk **ioChunk)
+{
+	gint		success=SQLITE_DONE;
+	guint		retries=0;
+
+	while(!g_atomic_int_get(&self->cancelled))
+	{
+		success=sqlite3_step(inStatement);
+
+		/* Busy timeout is over but writer may be done soon so try again */
+		if(success==SQLITE_BUSY && retries<POLICY_LOADER_BUSY_RETRIES)
+		{
+			retries++;
+			continue;
+		}
+
+		if(success!=SQLITE_ROW) break;
+
+		retries=0;
+		if(!*ioChunk) *ioChunk=g_new0(CookiePermissionManagerPolicyLoaderChunk, 1);
+
+		(*ioChunk)->domains[(*ioChunk)->count]=g_strdup((const gchar*)sqlite3_column_text(inStatement, 0));
+		(*ioChunk)->policies[(*ioChunk)->count]=sqlite3_column_int(inStatement, 1);
+		(*ioChunk)->count++;
+
+		if((*ioChunk)->count==POLICY_LOADER_CHUNK_SIZE)
+		{
+			g_async_queue_push(self->chunks, *ioChunk);
+			*ioChunk=NULL;
+		}
+	}
+
+	sqlite3_reset(inStatement);
+
+	return(g_atomic_int_get(&self->cancelled) || success==SQLITE_DONE);
+}
+
+/* Thread reading policies from database */
+static gpointer _cookie_permission_manager_policy_loader_thread(gpointer inUserData)
+{
+	CookiePermissionManagerPolicyLoader			*self=(CookiePermissionManagerPolicyLoader*)inUserData;
+	sqlite3										*database=NULL;
+	CookiePermissionManagerStatementRegistry	*statements;
+	sqlite3_stmt								*statement;
+	CookiePermissionManagerPolicyLoaderChunk	*chunk=NULL;
+
+	if(sqlite3_open_v2(self->databaseFilename, &database, SQLITE_OPEN_READONLY, NULL)!=SQLITE_OK)
+	{
+		g_warning(_("Could not open database of extenstion: %s"), sqlite3_errmsg(database));
+		self->error=g_strdup(sqlite3_errmsg(database));
+
+		if(database) sqlite3_close(database);
+		g_atomic_int_set(&self->finished, TRUE);
+		return(NULL);
+	}
+
+	sqlite3_busy_timeout(database, COOKIE_PERMISSION_DATABASE_BUSY_TIMEOUT);
+	statements=cookie_permission_manager_statement_registry_new(database);
+
+	/* Read count and rows in one transaction so they match */
+	if(cookie_permission_manager_database_begin(statements)!=SQLITE_OK) _cookie_permission_manager_policy_loader_set_error(self, database);
+
+	statement=cookie_permission_manager_statement_registry_get(statements, COOKIE_PERMISSION_MANAGER_STATEMENT_COUNT_ALL);
+	if(statement)
+	{
+		if(sqlite3_step(statement)==SQLITE_ROW) g_atomic_int_add(&self->total, sqlite3_column_int(statement, 0));
+		sqlite3_reset(statement);
+	}
+
+	/* Stop at first error so list is not mistaken as complete */
+	statement=cookie_permission_manager_statement_registry_get(statements, COOKIE_PERMISSION_MANAGER_STATEMENT_SELECT_ALL);
+	if(!statement || !_cookie_permission_manager_policy_loader_read(self, statement, &chunk))
+	{
+		_cookie_permission_manager_policy_loader_set_error(self, database);
+	}
+
+	if(!self->error)
+	{
+		statement=cookie_permission_manager_statement_registry_get(statements, COOKIE_PERMISSION_MANAGER_STATEMENT_SELECT_ALL_PATTERNS);
+		if(!statement || !_cookie_permission_manager_policy_loader_read(self, statement, &chunk))
+		{
+			_cookie_permission_manager_policy_loader_set_error(self, database);
+		}
+	}
+
+	if(chunk) g_async_queue_push(self->chunks, chunk);
+
+	cookie_permission_manager_database_commit(statements);
+
+	/* Release allocated resources */
+	cookie_permission_manager_statement_registry_free(statements);
+	sqlite3_close(database);
+
+	g_atomic_int_set(&self->finished, TRUE);
+
+	return(NULL);
+}
+
+/* Hand over loaded chunks to callback until time slice is used up */
+static gboolean _cookie_permission_manager_policy_loader_on_interval(gpointer inUserData)
+{
+	CookiePermissionManagerPolicyLoader			*self=(CookiePermissionManagerPolicyLoader*)inUserData;
+	CookiePermissionManagerPolicyLoaderChunk	*chunk;
+	gint64										deadline;
+	gboolean									finished;
+	guint										loaded, total;
+	CookiePermissionManagerPolicyLoaderProgressFunc	progressCallback;
+	gpointer									userData;
+
+	/* Check if thread has queued all chunks before taking any so none is missed */
+	finished=g_atomic_int_get(&self->finished);
+
+	deadline=g_get_monotonic_time()+POLICY_LOADER_TIME_SLICE*G_TIME_SPAN_MILLISECOND;
+	while(g_get_monotonic_time()<deadline &&
+			(chunk=(CookiePermissionManagerPolicyLoaderChunk*)g_async_queue_try_pop(self->chunks)))
+	{
+		self->chunkCallback((const gchar**)chunk->domains, chunk->policies, chunk->count, self->userData);
+		self->loaded+=chunk->count;
+
+		_cookie_permission_manager_policy_loader_chunk_free(chunk);
+	}
+
+	finished=(finished && g_async_queue_length(self->chunks)==0);
+	if(finished) self->sourceID=0;
+
+	/* Callback may free loader so do not access it afterwards */
+	loaded=self->loaded;
+	total=MAX((guint)g_atomic_int_get(&self->total), loaded);
+	progressCallback=self->progressCallback;
+	userData=self->userData;
+
+	if(progressCallback) progressCallback(loaded, total, finished, userData);
+
+	return(!finished);
+}
+
+/* IMPLEMENTATION: Public API */
+
+/* Create new loader and start loading policies from database file. The chunk
+ * callback is called in main loop for each chunk of rows and must not free the
+ * loader. The progress callback is called after each time slice and may free it.
+ */
+CookiePermissionManagerPolicyLoader* cookie_permission_manager_policy_loader_new(const gchar *inDatabaseFilename,
+																					CookiePermissionManagerPolicyLoaderChunkFunc inChunkCallback,
+																					CookiePermissionManagerPolicyLoaderProgressFunc inProgressCallback,
+																					gpointer inUserData)
+{
+	CookiePermissionManagerPolicyLoader		*self;
+
+	g_return_val_if_fail(inDatabaseFilename, NULL);
+	g_return_val_if_fail(inChunkCallback, NULL);
+
+	self=g_new0(CookiePermissionManagerPolicyLoader, 1);
+	self->databaseFilename=g_strdup(inDatabaseFilename);
+	self->chunkCallback=inChunkCallback;
+	self->progressCallback=inProgressCallback;
+	self->userData=inUserData;
+	self->chunks=g_async_queue_new_full((GDestroyNotify)_cookie_permission_manager_policy_loader_chunk_free);
+	self->loaded=0;
+	self->total=0;
+	self->finished=FALSE;
+	self->cancelled=FALSE;
+	self->error=NULL;
+
+	self->thread=g_thread_new("cookie-permission-loader", _cookie_permission_manager_policy_loader_thread, self);
+	self->sourceID=g_timeout_add(POLICY_LOADER_INTERVAL, _cookie_permission_manager_policy_loader_on_interval, self);
+
+	return(self);
+}
+
+/* Hand over rows not stored in database together with loaded ones. Rows are
+ * copied and must be pushed before control returns to main loop.
+ */
+void cookie_permission_manager_policy_loader_push(CookiePermissionManagerPolicyLoader *self,
+													const gchar **inDomains,
+													const gint *inPolicies,
+													guint inCount)
+{
+	CookiePermissionManagerPolicyLoaderChunk	*chunk=NULL;
+	guint										i;
+
+	g_return_if_fail(self);
+	g_return_if_fail(inDomains || inCount==0);
+	g_return_if_fail(inPolicies || inCount==0);
+
+	for(i=0; i<inCount; i++)
+	{
+		if(!chunk) chunk=g_new0(CookiePermissionManagerPolicyLoaderChunk, 1);
+
+		chunk->domains[chunk->count]=g_strdup(inDomains[i]);
+		chunk->policies[chunk->count]=inPolicies[i];
+		chunk->count++;
+
+		if(chunk->count==POLICY_LOADER_CHUNK_SIZE)
+		{
+			g_async_queue_push(self->chunks, chunk);
+			chunk=NULL;
+		}
+	}
+
+	if(chunk) g_async_queue_push(self->chunks, chunk);
+
+	g_atomic_int_add(&self->total, inCount);
+}
+
+/* Cancel loading if not finished yet and release loader */
+void cookie_permission_manager_policy_loader_free(CookiePermissionManagerPolicyLoader *self)
+{
+	g_return_if_fail(self);
+
+	/* Stop handing over chunks and tell thread to stop reading */
+	if(self->sourceID) g_source_remove(self->sourceID);
+	self->sourceID=0;
+
+	g_atomic_int_set(&self->cancelled, TRUE);
+	g_thread_join(self->thread);
+
+	/* Release allocated resources including chunks not handed over yet */
+	g_async_queue_unref(self->chunks);
+	g_free(self->databaseFilename);
+	g_free(self->error);
+	g_free(self);
+}
+
+/* Get reason why not all policies could be loaded or NULL if loading has
+ * not finished yet or all policies were loaded
+ */
+const gchar* cookie_permission_manager_policy_loader_get_error(CookiePermissionManagerPolicyLoader *self)
+{
+	g_return_val_if_fail(self, NULL);
+
+	if(!g_atomic_int_get(&self->finished)) return(NULL);
+	return(self->error);
+}
@@ -0,0 +1,51 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+#ifndef __COOKIE_PERMISSION_MANAGER_POLICY_LOADER__
+#define __COOKIE_PERMISSION_MANAGER_POLICY_LOADER__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Loads all stored policies of domains and domain patterns in a background
+ * thread using its own read-only database connection. Rows are handed over to
+ * the main loop in chunks which are processed in short time slices so the user
+ * interface keeps responding while a large database is loaded. Freeing the
+ * loader cancels loading.
+ */
+typedef struct _CookiePermissionManagerPolicyLoader		CookiePermissionManagerPolicyLoader;
+
+typedef void (*CookiePermissionManagerPolicyLoaderChunkFunc)(const gchar **inDomains,
+																const gint *inPolicies,
+																guint inCount,
+																gpointer inUserData);
+typedef void (*CookiePermissionManagerPolicyLoaderProgressFunc)(guint inLoaded,
+																guint inTotal,
+																gboolean inFinished,
+																gpointer inUserData);
+
+CookiePermissionManagerPolicyLoader* cookie_permission_manager_policy_loader_new(const gchar *inDatabaseFilename,
+																					CookiePermissionManagerPolicyLoaderChunkFunc inChunkCallback,
+																					CookiePermissionManagerPolicyLoaderProgressFunc inProgressCallback,
+																					gpointer inUserData);
+void cookie_permission_manager_policy_loader_free(CookiePermissionManagerPolicyLoader *self);
+
+void cookie_permission_manager_policy_loader_push(CookiePermissionManagerPolicyLoader *self,
+													const gchar **inDomains,
+													const gint *inPolicies,
+													guint inCount);
+
+const gchar* cookie_permission_manager_policy_loader_get_error(CookiePermissionManagerPolicyLoader *self);
+
+G_END_DECLS
+
+#endif /* __COOKIE_PERMISSION_MANAGER_POLICY_LOADER__ */
@@ -0,0 +1,502 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+#include "cookie-permission-manager-policy-snapshot.h"
+
+#include <string.h>
+
+/* Minimum number of changed domains recorded in overlay before they are folded
+ * into a new trie. The overlay may grow with the number of domains in trie so
+ * the cost of copying the trie is shared by many changes.
+ */
+#define SNAPSHOT_MIN_OVERLAY_SIZE		1024
+#define SNAPSHOT_OVERLAY_RATIO			64
+
+typedef struct _CookiePermissionManagerPolicySnapshotBase	CookiePermissionManagerPolicySnapshotBase;
+
+/* Trie shared by snapshots copied from each other. Reference count is
+ * only changed by writer.
+ */
+struct _CookiePermissionManagerPolicySnapshotBase
+{
+	gint									refCount;
+	CookiePermissionManagerDomainTrie		*trie;
+};
+
+typedef struct _CookiePermissionManagerPolicySnapshotPatterns	CookiePermissionManagerPolicySnapshotPatterns;
+
+/* Pattern matcher shared by snapshots copied from each other. It is never changed
+ * but replaced as a whole. Reference count is only changed by writer.
+ */
+struct _CookiePermissionManagerPolicySnapshotPatterns
+{
+	gint									refCount;
+	CookiePermissionManagerPatternMatcher	*matcher;
+};
+
+struct _CookiePermissionManagerPolicySnapshot
+{
+	CookiePermissionManagerPolicySnapshotBase	*base;			/* NULL if policies are not held in memory */
+	GHashTable								*overlay;		/* Domain -> policy changed since trie was built */
+	GHashTable								*sessionDomains;	/* Shared set of domains allowed for session only */
+	CookiePermissionManagerPolicySnapshotPatterns	*patterns;		/* NULL if there are no patterns */
+	CookiePermissionManagerPolicySnapshotPatterns	*sessionPatterns;	/* Patterns allowed for session only or NULL */
+};
+
+struct _CookiePermissionManagerPolicySnapshotSlot
+{
+	CookiePermissionManagerPolicySnapshot	*current;
+	GMutex									writerLock;
+
+	volatile gint							phase;
+	volatile gint							readers[2];
+};
+
+/* IMPLEMENTATION: Private variables and methods */
+
+/* Create and release base trie */
+static CookiePermissionManagerPolicySnapshotBase* _cookie_permission_manager_policy_snapshot_base_new(CookiePermissionManagerDomainTrie *inTrie)
+{
+	CookiePermissionManagerPolicySnapshotBase	*base;
+
+	base=g_new0(CookiePermissionManagerPolicySnapshotBase, 1);
+	base->refCount=1;
+	base->trie=inTrie;
+
+	return(base);
+}
+
+static void _cookie_permission_manager_policy_snapshot_base_unref(CookiePermissionManagerPolicySnapshotBase *inBase)
+{
+	if(--inBase->refCount>0) return;
+
+	cookie_permission_manager_domain_trie_free(inBase->trie);
+	g_free(inBase);
+}
+
+/* Create and release shared pattern matcher. Returns NULL for NULL matcher. */
+static CookiePermissionManagerPolicySnapshotPatterns* _cookie_permission_manager_policy_snapshot_patterns_new(CookiePermissionManagerPatternMatcher *inMatcher)
+{
+	CookiePermissionManagerPolicySnapshotPatterns	*patterns;
+
+	if(!inMatcher) return(NULL);
+
+	patterns=g_new0(CookiePermissionManagerPolicySnapshotPatterns, 1);
+	patterns->refCount=1;
+	patterns->matcher=inMatcher;
+
+	return(patterns);
+}
+
+static void _cookie_permission_manager_policy_snapshot_patterns_unref(CookiePermissionManagerPolicySnapshotPatterns *inPatterns)
+{
+	if(!inPatterns || --inPatterns->refCount>0) return;
+
+	cookie_permission_manager_pattern_matcher_free(inPatterns->matcher);
+	g_free(inPatterns);
+}
+
+/* Get key of domain in overlay and session domains, i.e. the lower-cased
+ * domain without leading dot. Returned string must be freed with g_free().
+ */
+static gchar* _cookie_permission_manager_policy_snapshot_get_key(const gchar *inDomain)
+{
+	if(*inDomain=='.') inDomain++;
+
+	return(g_ascii_strdown(inDomain, -1));
+}
+
+/* Apply all changes in overlay to a copy of trie and use it as new base */
+static void _cookie_permission_manager_policy_snapshot_fold(CookiePermissionManagerPolicySnapshot *self)
+{
+	CookiePermissionManagerDomainTrie		*trie;
+	GHashTableIter							iter;
+	gpointer								domain, policy;
+
+	trie=cookie_permission_manager_domain_trie_copy(self->base->trie);
+
+	g_hash_table_iter_init(&iter, self->overlay);
+	while(g_hash_table_iter_next(&iter, &domain, &policy))
+	{
+		if(GPOINTER_TO_INT(policy)==0) cookie_permission_manager_domain_trie_remove(trie, (const gchar*)domain);
+			else cookie_permission_manager_domain_trie_insert(trie, (const gchar*)domain, GPOINTER_TO_INT(policy));
+	}
+
+	_cookie_permission_manager_policy_snapshot_base_unref(self->base);
+	self->base=_cookie_permission_manager_policy_snapshot_base_new(trie);
+
+	g_hash_table_remove_all(self->overlay);
+}
+
+/* IMPLEMENTATION: Public API */
+
+/* Create new snapshot taking ownership of trie and pattern matcher. Trie may be
+ * NULL if policies of domains are not held in memory and pattern matcher may be
+ * NULL if there are no patterns.
+ */
+CookiePermissionManagerPolicySnapshot* cookie_permission_manager_policy_snapshot_new(CookiePermissionManagerDomainTrie *inPolicies,
+																						CookiePermissionManagerPatternMatcher *inPatterns)
+{
+	CookiePermissionManagerPolicySnapshot	*self;
+
+	self=g_new0(CookiePermissionManagerPolicySnapshot, 1);
+	self->base=(inPolicies ? _cookie_permission_manager_policy_snapshot_base_new(inPolicies) : NULL);
+	self->overlay=g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	self->sessionDomains=NULL;
+	self->patterns=_cookie_permission_manager_policy_snapshot_patterns_new(inPatterns);
+	self->sessionPatterns=NULL;
+
+	return(self);
+}
+
+/* Create a copy of snapshot which can be changed and published afterwards */
+CookiePermissionManagerPolicySnapshot* cookie_permission_manager_policy_snapshot_copy(CookiePermissionManagerPolicySnapshot *self)
+{
+	CookiePermissionManagerPolicySnapshot	*copy;
+	GHashTableIter							iter;
+	gpointer								domain, policy;
+
+	g_return_val_if_fail(self, NULL);
+
+	copy=g_new0(CookiePermissionManagerPolicySnapshot, 1);
+	copy->base=self->base;
+	if(copy->base) copy->base->refCount++;
+	copy->overlay=g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	copy->sessionDomains=(self->sessionDomains ? g_hash_table_ref(self->sessionDomains) : NULL);
+	copy->patterns=self->patterns;
+	if(copy->patterns) copy->patterns->refCount++;
+	copy->sessionPatterns=self->sessionPatterns;
+	if(copy->sessionPatterns) copy->sessionPatterns->refCount++;
+
+	g_hash_table_iter_init(&iter, self->overlay);
+	while(g_hash_table_iter_next(&iter, &domain, &policy))
+	{
+		g_hash_table_insert(copy->overlay, g_strdup((const gchar*)domain), policy);
+	}
+
+	return(copy);
+}
+
+/* Release snapshot. It must not be published anymore. */
+void cookie_permission_manager_policy_snapshot_free(CookiePermissionManagerPolicySnapshot *self)
+{
+	g_return_if_fail(self);
+
+	if(self->base) _cookie_permission_manager_policy_snapshot_base_unref(self->base);
+	if(self->sessionDomains) g_hash_table_unref(self->sessionDomains);
+	_cookie_permission_manager_policy_snapshot_patterns_unref(self->patterns);
+	_cookie_permission_manager_policy_snapshot_patterns_unref(self->sessionPatterns);
+	g_hash_table_destroy(self->overlay);
+	g_free(self);
+}
+
+/* Replace trie of domains and pattern matcher of a snapshot not published yet
+ * taking ownership of both. Domains and patterns allowed for session only are kept.
+ */
+void cookie_permission_manager_policy_snapshot_replace(CookiePermissionManagerPolicySnapshot *self,
+														CookiePermissionManagerDomainTrie *inPolicies,
+														CookiePermissionManagerPatternMatcher *inPatterns)
+{
+	g_return_if_fail(self);
+
+	if(self->base) _cookie_permission_manager_policy_snapshot_base_unref(self->base);
+	self->base=(inPolicies ? _cookie_permission_manager_policy_snapshot_base_new(inPolicies) : NULL);
+	g_hash_table_remove_all(self->overlay);
+
+	cookie_permission_manager_policy_snapshot_set_patterns(self, inPatterns);
+}
+
+/* Check if policies of domains are held in snapshot */
+gboolean cookie_permission_manager_policy_snapshot_has_policies(CookiePermissionManagerPolicySnapshot *self)
+{
+	g_return_val_if_fail(self, FALSE);
+
+	return(self->base!=NULL);
+}
+
+/* Get pattern matcher valid as long as snapshot is held. It must not be changed
+ * but a changed copy can be set at a snapshot not published yet.
+ */
+CookiePermissionManagerPatternMatcher* cookie_permission_manager_policy_snapshot_get_patterns(CookiePermissionManagerPolicySnapshot *self)
+{
+	g_return_val_if_fail(self, NULL);
+
+	return(self->patterns ? self->patterns->matcher : NULL);
+}
+
+CookiePermissionManagerPatternMatcher* cookie_permission_manager_policy_snapshot_get_session_patterns(CookiePermissionManagerPolicySnapshot *self)
+{
+	g_return_val_if_fail(self, NULL);
+
+	return(self->sessionPatterns ? self->sessionPatterns->matcher : NULL);
+}
+
+/* Set compiled pattern matcher of a snapshot not published yet taking ownership
+ * of it. Matcher may be NULL if there are no patterns. The one replaced is released
+ * together with the last snapshot using it.
+ */
+void cookie_permission_manager_policy_snapshot_set_patterns(CookiePermissionManagerPolicySnapshot *self, CookiePermissionManagerPatternMatcher *inPatterns)
+{
+	g_return_if_fail(self);
+
+	_cookie_permission_manager_policy_snapshot_patterns_unref(self->patterns);
+	self->patterns=_cookie_permission_manager_policy_snapshot_patterns_new(inPatterns);
+}
+
+void cookie_permission_manager_policy_snapshot_set_session_patterns(CookiePermissionManagerPolicySnapshot *self, CookiePermissionManagerPatternMatcher *inPatterns)
+{
+	g_return_if_fail(self);
+
+	_cookie_permission_manager_policy_snapshot_patterns_unref(self->sessionPatterns);
+	self->sessionPatterns=_cookie_permission_manager_policy_snapshot_patterns_new(inPatterns);
+}
+
+/* Set policy for domain in a snapshot not published yet. Setting policy to
+ * 0 (undetermined) removes the policy of domain.
+ */
+void cookie_permission_manager_policy_snapshot_set_policy(CookiePermissionManagerPolicySnapshot *self, const gchar *inDomain, gint inPolicy)
+{
+	guint									maxSize;
+
+	g_return_if_fail(self);
+	g_return_if_fail(inDomain);
+
+	if(!self->base) return;
+
+	g_hash_table_insert(self->overlay,
+						_cookie_permission_manager_policy_snapshot_get_key(inDomain),
+						GINT_TO_POINTER(inPolicy));
+
+	maxSize=MAX(SNAPSHOT_MIN_OVERLAY_SIZE, cookie_permission_manager_domain_trie_get_size(self->base->trie)/SNAPSHOT_OVERLAY_RATIO);
+	if(g_hash_table_size(self->overlay)>maxSize) _cookie_permission_manager_policy_snapshot_fold(self);
+}
+
+/* Set domains allowed for session only in a snapshot not published yet.
+ * Domains are keys of hash table passed in and are copied.
+ */
+void cookie_permission_manager_policy_snapshot_set_session_domains(CookiePermissionManagerPolicySnapshot *self, GHashTable *inDomains)
+{
+	GHashTableIter							iter;
+	gpointer								domain;
+
+	g_return_if_fail(self);
+
+	if(self->sessionDomains) g_hash_table_unref(self->sessionDomains);
+	self->sessionDomains=NULL;
+
+	if(!inDomains || g_hash_table_size(inDomains)==0) return;
+
+	self->sessionDomains=g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+	g_hash_table_iter_init(&iter, inDomains);
+	while(g_hash_table_iter_next(&iter, &domain, NULL))
+	{
+		g_hash_table_add(self->sessionDomains, g_strdup((const gchar*)domain));
+	}
+}
+
+/* Lookup most specific policy for domain, i.e. the policy stored for the domain
+ * itself or - if none is stored - for its nearest parent domain. Returns TRUE
+ * if a policy was found.
+ */
+gboolean cookie_permission_manager_policy_snapshot_lookup(CookiePermissionManagerPolicySnapshot *self, const gchar *inDomain, gint *outPolicy)
+{
+	gchar									*key, *parent;
+	gpointer								policy;
+	gint									storedPolicy=0;
+	gboolean								found=FALSE;
+
+	g_return_val_if_fail(self, FALSE);
+	g_return_val_if_fail(inDomain, FALSE);
+
+	if(!self->base) return(FALSE);
+
+	/* Without changes since trie was built look up trie only */
+	if(g_hash_table_size(self->overlay)==0) return(cookie_permission_manager_domain_trie_lookup(self->base->trie, inDomain, outPolicy));
+
+	/* Otherwise check overlay before trie at each level from domain up to
+	 * top-level domain. A domain removed in overlay hides its policy in trie.
+	 */
+	key=_cookie_permission_manager_policy_snapshot_get_key(inDomain);
+	for(parent=key; parent && !found; parent=strchr(parent, '.'))
+	{
+		if(*parent=='.') parent++;
+		if(!*parent) continue;
+
+		if(g_hash_table_lookup_extended(self->overlay, parent, NULL, &policy))
+		{
+			storedPolicy=GPOINTER_TO_INT(policy);
+			found=(storedPolicy!=0);
+		}
+			else found=cookie_permission_manager_domain_trie_get(self->base->trie, parent, &storedPolicy);
+	}
+	g_free(key);
+
+	if(found && outPolicy) *outPolicy=storedPolicy;
+	return(found);
+}
+
+/* Get policy stored for domain itself (not resolved by any parent domain).
+ * Returns TRUE if a policy is stored for domain. Returns FALSE as well if
+ * policies are not held in memory.
+ */
+gboolean cookie_permission_manager_policy_snapshot_get(CookiePermissionManagerPolicySnapshot *self, const gchar *inDomain, gint *outPolicy)
+{
+	gchar									*key;
+	gpointer								policy;
+	gint									storedPolicy=0;
+	gboolean								found;
+
+	g_return_val_if_fail(self, FALSE);
+	g_return_val_if_fail(inDomain, FALSE);
+
+	if(!self->base) return(FALSE);
+
+	/* A domain changed in overlay hides its policy in trie */
+	key=_cookie_permission_manager_policy_snapshot_get_key(inDomain);
+	if(g_hash_table_lookup_extended(self->overlay, key, NULL, &policy))
+	{
+		storedPolicy=GPOINTER_TO_INT(policy);
+		found=(storedPolicy!=0);
+	}
+		else found=cookie_permission_manager_domain_trie_get(self->base->trie, key, &storedPolicy);
+	g_free(key);
+
+	if(found && outPolicy) *outPolicy=storedPolicy;
+	return(found);
+}
+
+/* Check if cookies of domain are allowed for session only because of the
+ * domain itself or one of its parent domains
+ */
+gboolean cookie_permission_manager_policy_snapshot_is_session_domain(CookiePermissionManagerPolicySnapshot *self, const gchar *inDomain)
+{
+	gchar									*key, *parent;
+	gboolean								found=FALSE;
+
+	g_return_val_if_fail(self, FALSE);
+	g_return_val_if_fail(inDomain, FALSE);
+
+	if(!self->sessionDomains) return(FALSE);
+
+	key=_cookie_permission_manager_policy_snapshot_get_key(inDomain);
+	for(parent=key; parent && !found; parent=strchr(parent, '.'))
+	{
+		if(*parent=='.') parent++;
+		found=g_hash_table_contains(self->sessionDomains, parent);
+	}
+	g_free(key);
+
+	return(found);
+}
+
+/* Check if any domain or domain pattern is allowed for session only */
+gboolean cookie_permission_manager_policy_snapshot_has_session_domains(CookiePermissionManagerPolicySnapshot *self)
+{
+	g_return_val_if_fail(self, FALSE);
+
+	return(self->sessionDomains!=NULL);
+}
+
+/* Create new slot taking ownership of snapshot */
+CookiePermissionManagerPolicySnapshotSlot* cookie_permission_manager_policy_snapshot_slot_new(CookiePermissionManagerPolicySnapshot *inSnapshot)
+{
+	CookiePermissionManagerPolicySnapshotSlot	*self;
+
+	g_return_val_if_fail(inSnapshot, NULL);
+
+	self=g_new0(CookiePermissionManagerPolicySnapshotSlot, 1);
+	self->current=inSnapshot;
+	self->phase=0;
+	self->readers[0]=0;
+	self->readers[1]=0;
+	g_mutex_init(&self->writerLock);
+
+	return(self);
+}
+
+/* Release slot and current snapshot when readers still holding it are done.
+ * No reader may lock slot anymore.
+ */
+void cookie_permission_manager_policy_snapshot_slot_free(CookiePermissionManagerPolicySnapshotSlot *self)
+{
+	g_return_if_fail(self);
+
+	while(g_atomic_int_get(&self->readers[0])>0 || g_atomic_int_get(&self->readers[1])>0) g_thread_yield();
+
+	cookie_permission_manager_policy_snapshot_free(self->current);
+	g_mutex_clear(&self->writerLock);
+	g_free(self);
+}
+
+/* Get current snapshot at writer. It is valid until writer publishes another one. */
+CookiePermissionManagerPolicySnapshot* cookie_permission_manager_policy_snapshot_slot_get(CookiePermissionManagerPolicySnapshotSlot *self)
+{
+	g_return_val_if_fail(self, NULL);
+
+	return((CookiePermissionManagerPolicySnapshot*)g_atomic_pointer_get(&self->current));
+}
+
+/* Replace current snapshot and release old one when no reader holds it anymore.
+ * Counters are switched twice so also readers which picked up the phase just
+ * before the first switch but were counted after it are waited for.
+ */
+void cookie_permission_manager_policy_snapshot_slot_publish(CookiePermissionManagerPolicySnapshotSlot *self, CookiePermissionManagerPolicySnapshot *inSnapshot)
+{
+	CookiePermissionManagerPolicySnapshot	*oldSnapshot;
+	gint									phase;
+	gint									i;
+
+	g_return_if_fail(self);
+	g_return_if_fail(inSnapshot);
+
+	g_mutex_lock(&self->writerLock);
+
+	oldSnapshot=(CookiePermissionManagerPolicySnapshot*)g_atomic_pointer_get(&self->current);
+	g_atomic_pointer_set(&self->current, inSnapshot);
+
+	for(i=0; i<2; i++)
+	{
+		phase=g_atomic_int_get(&self->phase);
+		g_atomic_int_set(&self->phase, phase+1);
+
+		while(g_atomic_int_get(&self->readers[phase & 1])>0) g_thread_yield();
+	}
+
+	g_mutex_unlock(&self->writerLock);
+
+	if(oldSnapshot!=inSnapshot) cookie_permission_manager_policy_snapshot_free(oldSnapshot);
+}
+
+/* Get current snapshot at reader. It must be passed back by calling
+ * cookie_permission_manager_policy_snapshot_slot_read_unlock() with the
+ * phase returned as soon as possible. Never blocks.
+ */
+CookiePermissionManagerPolicySnapshot* cookie_permission_manager_policy_snapshot_slot_read_lock(CookiePermissionManagerPolicySnapshotSlot *self, gint *outPhase)
+{
+	gint									phase;
+
+	g_return_val_if_fail(self, NULL);
+	g_return_val_if_fail(outPhase, NULL);
+
+	phase=g_atomic_int_get(&self->phase) & 1;
+	g_atomic_int_inc(&self->readers[phase]);
+
+	*outPhase=phase;
+	return((CookiePermissionManagerPolicySnapshot*)g_atomic_pointer_get(&self->current));
+}
+
+void cookie_permission_manager_policy_snapshot_slot_read_unlock(CookiePermissionManagerPolicySnapshotSlot *self, gint inPhase)
+{
+	g_return_if_fail(self);
+
+	g_atomic_int_dec_and_test(&self->readers[inPhase & 1]);
+}
@@ -0,0 +1,76 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+#ifndef __COOKIE_PERMISSION_MANAGER_POLICY_SNAPSHOT__
+#define __COOKIE_PERMISSION_MANAGER_POLICY_SNAPSHOT__
+
+#include "cookie-permission-manager-domain-trie.h"
+#include "cookie-permission-manager-pattern-matcher.h"
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Immutable view of policies held in memory. A snapshot is never changed once
+ * it was published so it can be read from any thread without locking. Changes
+ * are made to a copy which is published as a whole afterwards. A copy shares
+ * the trie of domains with the snapshot it was copied from and only records
+ * changed domains in a small overlay which is folded into a new trie when it
+ * grows too large. Pattern matchers of patterns and of patterns allowed for
+ * session only are shared by copies and replaced as a whole when changed.
+ */
+typedef struct _CookiePermissionManagerPolicySnapshot		CookiePermissionManagerPolicySnapshot;
+
+CookiePermissionManagerPolicySnapshot* cookie_permission_manager_policy_snapshot_new(CookiePermissionManagerDomainTrie *inPolicies,
+																						CookiePermissionManagerPatternMatcher *inPatterns);
+CookiePermissionManagerPolicySnapshot* cookie_permission_manager_policy_snapshot_copy(CookiePermissionManagerPolicySnapshot *self);
+void cookie_permission_manager_policy_snapshot_free(CookiePermissionManagerPolicySnapshot *self);
+
+void cookie_permission_manager_policy_snapshot_replace(CookiePermissionManagerPolicySnapshot *self,
+														CookiePermissionManagerDomainTrie *inPolicies,
+														CookiePermissionManagerPatternMatcher *inPatterns);
+
+gboolean cookie_permission_manager_policy_snapshot_has_policies(CookiePermissionManagerPolicySnapshot *self);
+
+CookiePermissionManagerPatternMatcher* cookie_permission_manager_policy_snapshot_get_patterns(CookiePermissionManagerPolicySnapshot *self);
+void cookie_permission_manager_policy_snapshot_set_patterns(CookiePermissionManagerPolicySnapshot *self, CookiePermissionManagerPatternMatcher *inPatterns);
+
+CookiePermissionManagerPatternMatcher* cookie_permission_manager_policy_snapshot_get_session_patterns(CookiePermissionManagerPolicySnapshot *self);
+void cookie_permission_manager_policy_snapshot_set_session_patterns(CookiePermissionManagerPolicySnapshot *self, CookiePermissionManagerPatternMatcher *inPatterns);
+
+void cookie_permission_manager_policy_snapshot_set_policy(CookiePermissionManagerPolicySnapshot *self, const gchar *inDomain, gint inPolicy);
+void cookie_permission_manager_policy_snapshot_set_session_domains(CookiePermissionManagerPolicySnapshot *self, GHashTable *inDomains);
+
+gboolean cookie_permission_manager_policy_snapshot_get(CookiePermissionManagerPolicySnapshot *self, const gchar *inDomain, gint *outPolicy);
+gboolean cookie_permission_manager_policy_snapshot_lookup(CookiePermissionManagerPolicySnapshot *self, const gchar *inDomain, gint *outPolicy);
+gboolean cookie_permission_manager_policy_snapshot_is_session_domain(CookiePermissionManagerPolicySnapshot *self, const gchar *inDomain);
+gboolean cookie_permission_manager_policy_snapshot_has_session_domains(CookiePermissionManagerPolicySnapshot *self);
+
+/* Slot holding the current snapshot. Readers only increase and decrease a counter
+ * to announce they are reading the current snapshot. A writer publishing a new
+ * snapshot swaps it in atomically and waits for readers still holding the old
+ * snapshot before releasing it. Readers arriving meanwhile already count on the
+ * other counter and get the new snapshot so they never delay the writer further.
+ */
+typedef struct _CookiePermissionManagerPolicySnapshotSlot	CookiePermissionManagerPolicySnapshotSlot;
+
+CookiePermissionManagerPolicySnapshotSlot* cookie_permission_manager_policy_snapshot_slot_new(CookiePermissionManagerPolicySnapshot *inSnapshot);
+void cookie_permission_manager_policy_snapshot_slot_free(CookiePermissionManagerPolicySnapshotSlot *self);
+
+CookiePermissionManagerPolicySnapshot* cookie_permission_manager_policy_snapshot_slot_get(CookiePermissionManagerPolicySnapshotSlot *self);
+void cookie_permission_manager_policy_snapshot_slot_publish(CookiePermissionManagerPolicySnapshotSlot *self, CookiePermissionManagerPolicySnapshot *inSnapshot);
+
+CookiePermissionManagerPolicySnapshot* cookie_permission_manager_policy_snapshot_slot_read_lock(CookiePermissionManagerPolicySnapshotSlot *self, gint *outPhase);
+void cookie_permission_manager_policy_snapshot_slot_read_unlock(CookiePermissionManagerPolicySnapshotSlot *self, gint inPhase);
+
+G_END_DECLS
+
+#endif /* __COOKIE_PERMISSION_MANAGER_POLICY_SNAPSHOT__ */
@@ -10,12 +10,17 @@
 */
 
 #include "cookie-permission-manager-preferences-window.h"
+#include "cookie-permission-manager-pattern-matcher.h"
+#include "cookie-permission-manager-policy-list.h"
 
 /* Define this class in GObject system */
 G_DEFINE_TYPE(CookiePermissionManagerPreferencesWindow,
 				cookie_permission_manager_preferences_window,
 				GTK_TYPE_DIALOG)
 
+/* Interval in seconds to refresh statistics while they are shown */
+#define STATISTICS_REFRESH_INTERVAL		1
+
 /* Properties */
 enum
 {
@@ -36,33 +41,38 @@ struct _CookiePermissionManagerPreferencesWindowPrivate
 {
 	/* Extension related */
 	CookiePermissionManager	*manager;
-	sqlite3					*database;
 
 	/* Dialog related */
 	GtkWidget				*contentArea;
-	GtkListStore			*listStore;
+	CookiePermissionManagerPolicyList	*policyList;
+	CookiePermissionManagerPolicyLoader	*policyLoader;
+	GHashTable				*changedWhileLoading;
+	GtkWidget				*loadProgress;
+	GtkWidget				*filterEntry;
 	GtkWidget				*list;
 	GtkTreeSelection		*listSelection;
 	GtkWidget				*deleteButton;
 	GtkWidget				*deleteAllButton;
+	GtkWidget				*changePolicyCombo;
+	GtkWidget				*changePolicyButton;
 	GtkWidget				*askForUnknownPolicyCheckbox;
+	GtkWidget				*groupByRegistrableDomainCheckbox;
 	GtkWidget				*addDomainEntry;
 	GtkWidget				*addDomainPolicyCombo;
+	GtkWidget				*addDomainIsPatternCheckbox;
 	GtkWidget				*addDomainButton;
+	GtkWidget				*statisticsExpander;
+	GtkWidget				*statisticsLabel;
+	guint					statisticsRefreshID;
 
 	gint					signalManagerChangedDatabaseID;
+	gint					signalManagerPolicyChangedID;
 	gint					signalManagerAskForUnknownPolicyID;
 	gint					signalAskForUnknownPolicyID;
+	gint					signalManagerGroupByRegistrableDomainID;
+	gint					signalGroupByRegistrableDomainID;
 };
 
-enum
-{
-	DOMAIN_COLUMN,
-	POLICY_COLUMN,
-	N_COLUMN
-};
-
-
 /* IMPLEMENTATION: Private variables and methods */
 
 /* "Add domain"-button was pressed */
@@ -74,11 +84,14 @@ static void _cookie_permission_manager_preferences_on_add_domain_clicked(CookieP
 	const gchar										*domainStart, *domainEnd;
 	gchar											*realDomain;
 	GtkTreeIter										policyIter;
+	gboolean										isPattern;
 
-	g_return_if_fail(priv->database);
+	g_return_if_fail(priv->manager);
 
-	/* Get domain name entered */
-	domain=g_hostname_to_ascii(gtk_entry_get_text(GTK_ENTRY(priv->addDomainEntry)));
+	/* Get domain name or domain pattern entered */
+	isPattern=gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(priv->addDomainIsPatternCheckbox));
+	if(isPattern) domain=g_ascii_strdown(gtk_entry_get_text(GTK_ENTRY(priv->addDomainEntry)), -1);
+		else domain=g_hostname_to_ascii(gtk_entry_get_text(GTK_ENTRY(priv->addDomainEntry)));
 
 	/* Trim whitespaces from start and end of entered domain name */
 	domainStart=domain;
@@ -95,47 +108,57 @@ static void _cookie_permission_manager_preferences_on_add_domain_clicked(CookieP
 	/* Get policy from combo box */
 	if(gtk_combo_box_get_active_iter(GTK_COMBO_BOX(priv->addDomainPolicyCombo), &policyIter))
 	{
-		gchar	*sql;
-		gchar	*error=NULL;
-		gint	success;
 		gint	policy;
-		gchar	*policyName;
 
 		/* Get policy value to set for domain */
 		gtk_tree_model_get(gtk_combo_box_get_model(GTK_COMBO_BOX(priv->addDomainPolicyCombo)),
 													&policyIter,
 													0, &policy,
-													1, &policyName,
 													-1);
 
-		/* Add domain name and the selected policy to database */
-		sql=sqlite3_mprintf("INSERT OR REPLACE INTO policies (domain, value) VALUES ('%q', %d);",
-								realDomain,
-								policy);
-		success=sqlite3_exec(priv->database, sql, NULL, NULL, &error);
+		/* Set policy of domain name or pattern. The list is updated
+		 * when manager tells about the changed policy.
+		 */
+		cookie_permission_manager_set_policy(priv->manager, realDomain, policy);
+	}
 
-		/* Show error message if any */
-		if(success==SQLITE_OK)
-		{
-			gtk_list_store_append(priv->listStore, &policyIter);
-			gtk_list_store_set(priv->listStore,
-								&policyIter,
-								DOMAIN_COLUMN, realDomain,
-								POLICY_COLUMN, policyName,
-								-1);
-		}
-			else g_warning(_("SQL fails: %s"), error);
+	/* Free allocated resources */
+	g_free(realDomain);
+	g_free(domain);
+}
 
+/* Check if domain pattern entered is valid. A domain pattern may contain
+ * wildcards ('*' and '?') besides the characters valid in domain names
+ * and must contain at least one wildcard.
+ */
+static gboolean _cookie_permission_manager_preferences_is_valid_pattern(const gchar *inPattern)
+{
+	const gchar										*patternStart, *patternEnd;
+	const gchar										*checkPattern;
+	gboolean										hasWildcard=FALSE;
 
-		if(error) sqlite3_free(error);
+	/* Trim whitespaces from start and end of entered pattern */
+	patternStart=inPattern;
+	while(*patternStart && g_ascii_isspace(*patternStart)) patternStart++;
 
-		/* Free allocated resources */
-		sqlite3_free(sql);
+	patternEnd=inPattern+strlen(inPattern);
+	while(patternEnd>patternStart && g_ascii_isspace(*(patternEnd-1))) patternEnd--;
+	if(patternEnd==patternStart) return(FALSE);
+
+	/* Check for valid characters in domain pattern */
+	for(checkPattern=patternStart; checkPattern<patternEnd; checkPattern++)
+	{
+		if(*checkPattern=='*' || *checkPattern=='?') hasWildcard=TRUE;
+			else if(!g_ascii_isalpha(*checkPattern) &&
+					!g_ascii_isdigit(*checkPattern) &&
+					*checkPattern!='-' &&
+					*checkPattern!='.')
+			{
+				return(FALSE);
+			}
 	}
 
-	/* Free allocated resources */
-	g_free(realDomain);
-	g_free(domain);
+	return(hasWildcard);
 }
 
 /* Entry containing domain name which may be added to list has changed */
@@ -148,6 +171,14 @@ static void _cookie_permission_manager_preferences_on_add_domain_entry_changed(C
 	gint											dots;
 	gboolean										isValid=FALSE;
 
+	/* Check domain patterns on their own */
+	if(gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(priv->addDomainIsPatternCheckbox)))
+	{
+		isValid=_cookie_permission_manager_preferences_is_valid_pattern(gtk_entry_get_text(GTK_ENTRY(priv->addDomainEntry)));
+		gtk_widget_set_sensitive(priv->addDomainButton, isValid);
+		return;
+	}
+
 	/* Get ASCII representation of domain name entered */
 	asciiDomain=g_hostname_to_ascii(gtk_entry_get_text(GTK_ENTRY(priv->addDomainEntry)));
 
@@ -208,110 +239,154 @@ static void _cookie_permission_manager_preferences_on_add_domain_entry_changed(C
 	g_free(asciiDomain);
 }
 
-/* Fill domain list with stored policies */
-static void _cookie_permission_manager_preferences_window_fill(CookiePermissionManagerPreferencesWindow *self)
+/* A chunk of stored policies was loaded */
+static void _cookie_permission_manager_preferences_window_on_policies_loaded(const gchar **inDomains,
+																				const gint *inPolicies,
+																				guint inCount,
+																				gpointer inUserData)
 {
-	CookiePermissionManagerPreferencesWindowPrivate	*priv=self->priv;
-	gint											success;
-	sqlite3_stmt									*statement=NULL;
-
-	/* Clear tree/list view */
-	gtk_list_store_clear(priv->listStore);
-
-	/* If no database is present return here */
-	if(!priv->database) return;
-
-	/* Fill list store with policies from database */
-	success=sqlite3_prepare_v2(priv->database,
-								"SELECT domain, value FROM policies;",
-								-1,
-								&statement,
-								NULL);
-	if(statement && success==SQLITE_OK)
+	CookiePermissionManagerPreferencesWindowPrivate	*priv=COOKIE_PERMISSION_MANAGER_PREFERENCES_WINDOW(inUserData)->priv;
+	const gchar										**domains;
+	gint											*policies;
+	guint											i, count;
+	gchar											*key;
+
+	/* Policies changed while loading are already up to date in list
+	 * and must not be overwritten by older ones loaded
+	 */
+	if(g_hash_table_size(priv->changedWhileLoading)==0)
 	{
-		gchar		*domain;
-		gint		policy;
-		gchar		*policyName;
-		GtkTreeIter	iter;
+		cookie_permission_manager_policy_list_add_policies(priv->policyList, inDomains, inPolicies, inCount);
+		return;
+	}
 
-		while(sqlite3_step(statement)==SQLITE_ROW)
+	domains=g_new(const gchar*, inCount);
+	policies=g_new(gint, inCount);
+	for(i=0, count=0; i<inCount; i++)
+	{
+		key=g_ascii_strdown(inDomains[i], -1);
+		if(!g_hash_table_contains(priv->changedWhileLoading, key))
 		{
-			/* Get values */
-			domain=(gchar*)sqlite3_column_text(statement, 0);
-			policy=sqlite3_column_int(statement, 1);
-
-			switch(policy)
-			{
-				case COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT:
-					policyName=_("Accept");
-					break;
+			domains[count]=inDomains[i];
+			policies[count]=inPolicies[i];
+			count++;
+		}
+		g_free(key);
+	}
 
-				case COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION:
-					policyName=_("Accept for session");
-					break;
+	cookie_permission_manager_policy_list_add_policies(priv->policyList, domains, policies, count);
 
-				case COOKIE_PERMISSION_MANAGER_POLICY_BLOCK:
-					policyName=_("Block");
-					break;
+	g_free(domains);
+	g_free(policies);
+}
 
-				default:
-					policyName=NULL;
-					break;
-			}
+/* Show progress of loading stored policies */
+static void _cookie_permission_manager_preferences_window_on_policies_load_progress(guint inLoaded,
+																					guint inTotal,
+																					gboolean inFinished,
+																					gpointer inUserData)
+{
+	CookiePermissionManagerPreferencesWindowPrivate	*priv=COOKIE_PERMISSION_MANAGER_PREFERENCES_WINDOW(inUserData)->priv;
+	gchar											*text;
 
-			if(policyName)
-			{
-				gtk_list_store_append(priv->listStore, &iter);
-				gtk_list_store_set(priv->listStore,
-									&iter,
-									DOMAIN_COLUMN, domain,
-									POLICY_COLUMN, policyName,
-									-1);
-			}
+	if(inFinished)
+	{
+		/* Keep telling user that list is incomplete if not all policies could be loaded */
+		if(cookie_permission_manager_policy_loader_get_error(priv->policyLoader))
+		{
+			text=g_strdup_printf(_("Not all policies could be loaded: %s"),
+									cookie_permission_manager_policy_loader_get_error(priv->policyLoader));
+			gtk_progress_bar_set_text(GTK_PROGRESS_BAR(priv->loadProgress), text);
+			g_free(text);
 		}
+			else gtk_widget_hide(priv->loadProgress);
+
+		cookie_permission_manager_policy_loader_free(priv->policyLoader);
+		priv->policyLoader=NULL;
+
+		g_hash_table_remove_all(priv->changedWhileLoading);
+
+		gtk_widget_set_sensitive(priv->deleteAllButton, TRUE);
+		return;
 	}
-		else g_warning(_("SQL fails: %s"), sqlite3_errmsg(priv->database));
 
-	sqlite3_finalize(statement);
+	text=g_strdup_printf(_("Loading policies (%u of %u)"), inLoaded, inTotal);
+	gtk_progress_bar_set_text(GTK_PROGRESS_BAR(priv->loadProgress), text);
+	gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(priv->loadProgress), (inTotal>0 ? (gdouble)inLoaded/inTotal : 0.0));
+	g_free(text);
 }
 
-/* Database instance in manager changed */
-static void _cookie_permission_manager_preferences_window_manager_database_changed(CookiePermissionManagerPreferencesWindow *self,
-																					GParamSpec *inSpec,
-																					gpointer inUserData)
+/* Fill domain list with stored policies */
+static void _cookie_permission_manager_preferences_window_fill(CookiePermissionManagerPreferencesWindow *self)
 {
 	CookiePermissionManagerPreferencesWindowPrivate	*priv=self->priv;
-	CookiePermissionManager							*manager=COOKIE_PERMISSION_MANAGER(inUserData);
-	const gchar										*databaseFilename;
 
-	/* Close connection to any open database */
-	if(priv->database) sqlite3_close(priv->database);
-	priv->database=NULL;
+	/* Stop loading policies of previous database */
+	if(priv->policyLoader) cookie_permission_manager_policy_loader_free(priv->policyLoader);
+	priv->policyLoader=NULL;
 
-	/* Get pointer to new database and open database */
-	g_object_get(manager, "database-filename", &databaseFilename, NULL);
-	if(databaseFilename)
-	{
-		gint										success;
+	g_hash_table_remove_all(priv->changedWhileLoading);
 
-		success=sqlite3_open(databaseFilename, &priv->database);
-		if(success!=SQLITE_OK)
-		{
-			g_warning(_("Could not open database of extenstion: %s"), sqlite3_errmsg(priv->database));
+	/* Clear list while detached from view so view is not updated for each row */
+	gtk_tree_view_set_model(GTK_TREE_VIEW(priv->list), NULL);
+	cookie_permission_manager_policy_list_freeze(priv->policyList);
+	cookie_permission_manager_policy_list_remove_all(priv->policyList);
+	cookie_permission_manager_policy_list_thaw(priv->policyList);
+	gtk_tree_view_set_model(GTK_TREE_VIEW(priv->list), GTK_TREE_MODEL(priv->policyList));
 
-			if(priv->database) sqlite3_close(priv->database);
-			priv->database=NULL;
-		}
+	/* Load policies of domains and domain patterns in background and
+	 * add them to list in chunks so dialog can be used meanwhile
+	 */
+	if(priv->manager)
+	{
+		priv->policyLoader=cookie_permission_manager_load_policies(priv->manager,
+																	_cookie_permission_manager_preferences_window_on_policies_loaded,
+																	_cookie_permission_manager_preferences_window_on_policies_load_progress,
+																	self);
+	}
+
+	if(priv->policyLoader)
+	{
+		gtk_progress_bar_set_text(GTK_PROGRESS_BAR(priv->loadProgress), _("Loading policies"));
+		gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(priv->loadProgress), 0.0);
+		gtk_widget_show(priv->loadProgress);
 	}
+		else gtk_widget_hide(priv->loadProgress);
+}
 
-	/* Fill list with new database */
+/* Policy of a domain was changed in manager */
+static void _cookie_permission_manager_preferences_window_manager_policy_changed(CookiePermissionManagerPreferencesWindow *self,
+																					const gchar *inDomain,
+																					gint inOldPolicy,
+																					gint inNewPolicy,
+																					gpointer inUserData)
+{
+	CookiePermissionManagerPreferencesWindowPrivate	*priv=self->priv;
+
+	/* Remember domain while policies are loaded so its newer policy is kept */
+	if(priv->policyLoader) g_hash_table_add(priv->changedWhileLoading, g_ascii_strdown(inDomain, -1));
+
+	cookie_permission_manager_policy_list_set_policy(priv->policyList, inDomain, inNewPolicy);
+}
+
+/* Database instance in manager changed */
+static void _cookie_permission_manager_preferences_window_manager_database_changed(CookiePermissionManagerPreferencesWindow *self,
+																					GParamSpec *inSpec,
+																					gpointer inUserData)
+{
+	CookiePermissionManagerPreferencesWindowPrivate	*priv=self->priv;
+	CookiePermissionManager							*manager=COOKIE_PERMISSION_MANAGER(inUserData);
+	gpointer										database;
+
+	/* Fill list with policies of new database */
 	_cookie_permission_manager_preferences_window_fill(self);
 
 	/* Set up availability of management buttons */
-	gtk_widget_set_sensitive(priv->deleteAllButton, priv->database!=NULL);
-	gtk_widget_set_sensitive(priv->list, priv->database!=NULL);
+	g_object_get(manager, "database", &database, NULL);
 
-	return;
+	gtk_widget_set_sensitive(priv->deleteAllButton, database!=NULL && !priv->policyLoader);
+	gtk_widget_set_sensitive(priv->list, database!=NULL);
+	gtk_widget_set_sensitive(priv->addDomainEntry, database!=NULL);
 }
 
 /* Ask-for-unknown-policy in manager changed or check-box changed */
@@ -345,6 +420,118 @@ static void _cookie_permission_manager_preferences_window_ask_for_unknown_policy
 	g_signal_handler_unblock(priv->manager, priv->signalManagerAskForUnknownPolicyID);
 }
 
+/* Group-by-registrable-domain in manager changed or check-box changed */
+static void _cookie_permission_manager_preferences_window_manager_group_by_registrable_domain_changed(CookiePermissionManagerPreferencesWindow *self,
+																										GParamSpec *inSpec,
+																										gpointer inUserData)
+{
+	CookiePermissionManagerPreferencesWindowPrivate	*priv=self->priv;
+	CookiePermissionManager							*manager=COOKIE_PERMISSION_MANAGER(inUserData);
+	gboolean										doGroup;
+
+	/* Get new group-by-registrable-domain value */
+	g_object_get(manager, "group-by-registrable-domain", &doGroup, NULL);
+
+	/* Set toogle in widget (but block signal for toggle) */
+	g_signal_handler_block(priv->groupByRegistrableDomainCheckbox, priv->signalGroupByRegistrableDomainID);
+	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(priv->groupByRegistrableDomainCheckbox), doGroup);
+	g_signal_handler_unblock(priv->groupByRegistrableDomainCheckbox, priv->signalGroupByRegistrableDomainID);
+}
+
+static void _cookie_permission_manager_preferences_window_group_by_registrable_domain_changed(CookiePermissionManagerPreferencesWindow *self,
+																								gpointer *inUserData)
+{
+	CookiePermissionManagerPreferencesWindowPrivate	*priv=self->priv;
+	gboolean										doGroup;
+
+	/* Get toogle state of widget (but block signal for manager) and set in manager */
+	g_signal_handler_block(priv->manager, priv->signalManagerGroupByRegistrableDomainID);
+	doGroup=gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(priv->groupByRegistrableDomainCheckbox));
+	g_object_set(priv->manager, "group-by-registrable-domain", doGroup, NULL);
+	g_signal_handler_unblock(priv->manager, priv->signalManagerGroupByRegistrableDomainID);
+}
+
+/* Set policy of rows in list in one transaction and update list in one batch.
+ * Setting policy to COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED deletes the rows.
+ * Rows are given as list of iterators and are updated when manager tells about
+ * each changed policy.
+ */
+static void _cookie_permission_manager_preferences_window_set_policy_of_rows(CookiePermissionManagerPreferencesWindow *self,
+																				GList *inRows,
+																				gint inPolicy)
+{
+	CookiePermissionManagerPreferencesWindowPrivate	*priv=self->priv;
+	GtkTreeModel									*model=GTK_TREE_MODEL(priv->policyList);
+	GList											*row;
+	gchar											**domains, **domain;
+
+	g_return_if_fail(priv->manager);
+
+	/* Get domains of rows */
+	domains=g_new0(gchar*, g_list_length(inRows)+1);
+	for(row=inRows, domain=domains; row; row=row->next, domain++)
+	{
+		gtk_tree_model_get(model, (GtkTreeIter*)row->data, COOKIE_PERMISSION_MANAGER_POLICY_LIST_COLUMN_DOMAIN, domain, -1);
+	}
+
+	/* Detach list from view while modifying it so view is not updated for each row
+	 * and list is sorted only once
+	 */
+	gtk_tree_view_set_model(GTK_TREE_VIEW(priv->list), NULL);
+	cookie_permission_manager_policy_list_freeze(priv->policyList);
+
+	cookie_permission_manager_set_policies(priv->manager, (const gchar**)domains, inPolicy);
+
+	cookie_permission_manager_policy_list_thaw(priv->policyList);
+	gtk_tree_view_set_model(GTK_TREE_VIEW(priv->list), model);
+
+	/* Free allocated resources */
+	g_strfreev(domains);
+}
+
+/* Text in filter entry changed */
+static void _cookie_permission_manager_preferences_window_on_filter_changed(CookiePermissionManagerPreferencesWindow *self,
+																			GtkEditable *inEditable)
+{
+	CookiePermissionManagerPreferencesWindowPrivate	*priv=self->priv;
+	GtkTreeModel									*model=GTK_TREE_MODEL(priv->policyList);
+
+	/* Detach list from view while filtering so view is not updated for each
+	 * row shown or hidden
+	 */
+	gtk_tree_view_set_model(GTK_TREE_VIEW(priv->list), NULL);
+	cookie_permission_manager_policy_list_freeze(priv->policyList);
+
+	cookie_permission_manager_policy_list_set_filter(priv->policyList, gtk_entry_get_text(GTK_ENTRY(inEditable)));
+
+	cookie_permission_manager_policy_list_thaw(priv->policyList);
+	gtk_tree_view_set_model(GTK_TREE_VIEW(priv->list), model);
+}
+
+/* Get iterators of selected rows in list. Returned list must be freed with
+ * g_list_free_full(list, g_free).
+ */
+static GList* _cookie_permission_manager_preferences_window_get_selected_rows(CookiePermissionManagerPreferencesWindow *self)
+{
+	CookiePermissionManagerPreferencesWindowPrivate	*priv=self->priv;
+	GtkTreeModel									*model=GTK_TREE_MODEL(priv->policyList);
+	GList											*paths, *path, *iters=NULL;
+	GtkTreeIter										iter;
+
+	paths=gtk_tree_selection_get_selected_rows(priv->listSelection, &model);
+	for(path=paths; path; path=path->next)
+	{
+		if(gtk_tree_model_get_iter(model, &iter, (GtkTreePath*)path->data))
+		{
+			iters=g_list_prepend(iters, g_memdup(&iter, sizeof(GtkTreeIter)));
+		}
+	}
+	g_list_foreach(paths,(GFunc)gtk_tree_path_free, NULL);
+	g_list_free(paths);
+
+	return(iters);
+}
+
 /* Selection in list changed */
 void _cookie_permission_manager_preferences_changed_selection(CookiePermissionManagerPreferencesWindow *self,
 																GtkTreeSelection *inSelection)
@@ -352,66 +539,41 @@ void _cookie_permission_manager_preferences_changed_selection(CookiePermissionMa
 	gboolean									selected=(gtk_tree_selection_count_selected_rows(inSelection)>0 ? TRUE: FALSE);
 
 	gtk_widget_set_sensitive(self->priv->deleteButton, selected);
+	gtk_widget_set_sensitive(self->priv->changePolicyButton, selected);
 }
 
 /* Delete button was clicked on selection */
 void _cookie_permission_manager_preferences_on_delete_selection(CookiePermissionManagerPreferencesWindow *self,
 																	GtkButton *inButton)
+{
+	GList											*rows;
+
+	rows=_cookie_permission_manager_preferences_window_get_selected_rows(self);
+	_cookie_permission_manager_preferences_window_set_policy_of_rows(self, rows, COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED);
+	g_list_free_full(rows, g_free);
+}
+
+/* Change-policy button was clicked on selection */
+void _cookie_permission_manager_preferences_on_change_policy_of_selection(CookiePermissionManagerPreferencesWindow *self,
+																			GtkButton *inButton)
 {
 	CookiePermissionManagerPreferencesWindowPrivate	*priv=self->priv;
-	GList											*rows, *row, *refs=NULL;
-	GtkTreeRowReference								*ref;
-	GtkTreeModel									*model=GTK_TREE_MODEL(priv->listStore);
-	GtkTreeIter										iter;
-	GtkTreePath										*path;
-	gchar											*domain;
-	gchar											*sql;
-	gint											success;
-	gchar											*error;
+	GList											*rows;
+	GtkTreeIter										policyIter;
+	gint											policy;
 
-	/* Get selected rows in list and create a row reference because
-	 * we will modify the model while iterating through selected rows
-	 */
-	rows=gtk_tree_selection_get_selected_rows(priv->listSelection, &model);
-	for(row=rows; row; row=row->next)
-	{
-		ref=gtk_tree_row_reference_new(model, (GtkTreePath*)row->data);
-		refs=g_list_prepend(refs, ref);
-	}
-	g_list_foreach(rows,(GFunc)gtk_tree_path_free, NULL);
-	g_list_free(rows);
+	/* Get policy to set from combo box */
+	if(!gtk_combo_box_get_active_iter(GTK_COMBO_BOX(priv->changePolicyCombo), &policyIter)) return;
 
-	/* Delete each selected row by its reference */
-	for(row=refs; row; row=row->next)
-	{
-		/* Get domain from selected row */
-		path=gtk_tree_row_reference_get_path((GtkTreeRowReference*)row->data);
-		gtk_tree_model_get_iter(model, &iter, path);
-		gtk_tree_model_get(model, &iter, DOMAIN_COLUMN, &domain, -1);
-
-		/* Delete domain from database */
-		sql=sqlite3_mprintf("DELETE FROM policies WHERE domain='%q';", domain);
-		success=sqlite3_exec(priv->database,
-								sql,
-								NULL,
-								NULL,
-								&error);
-		if(success!=SQLITE_OK || error)
-		{
-			if(error)
-			{
-				g_critical(_("Failed to execute database statement: %s"), error);
-				sqlite3_free(error);
-			}
-				else g_critical(_("Failed to execute database statement: %s"), sqlite3_errmsg(priv->database));
-		}
-		sqlite3_free(sql);
+	gtk_tree_model_get(gtk_combo_box_get_model(GTK_COMBO_BOX(priv->changePolicyCombo)),
+												&policyIter,
+												0, &policy,
+												-1);
 
-		/* Delete row from model */
-		gtk_list_store_remove(priv->listStore, &iter);
-	}
-	g_list_foreach(refs,(GFunc)gtk_tree_row_reference_free, NULL);
-	g_list_free(refs);
+	/* Set policy of all selected rows */
+	rows=_cookie_permission_manager_preferences_window_get_selected_rows(self);
+	_cookie_permission_manager_preferences_window_set_policy_of_rows(self, rows, policy);
+	g_list_free_full(rows, g_free);
 }
 
 /* Delete all button was clicked */
@@ -419,69 +581,125 @@ void _cookie_permission_manager_preferences_on_delete_all(CookiePermissionManage
 																	GtkButton *inButton)
 {
 	CookiePermissionManagerPreferencesWindowPrivate	*priv=self->priv;
-	gint											success;
-	gchar											*error=NULL;
+	GtkTreeModel									*model=GTK_TREE_MODEL(priv->policyList);
 	GtkWidget										*dialog;
 	gint											dialogResponse;
+	GList											*rows=NULL;
+	GtkTreeIter										iter;
+	gboolean										isFiltered;
+
+	/* Ask user if he really wants to delete all permissions. If list is
+	 * filtered only the permissions shown are deleted.
+	 */
+	isFiltered=(*gtk_entry_get_text(GTK_ENTRY(priv->filterEntry))!=0);
 
-	/* Ask user if he really wants to delete all permissions */
 	dialog=gtk_message_dialog_new(GTK_WINDOW(self),
 									GTK_DIALOG_MODAL,
 									GTK_MESSAGE_QUESTION,
 									GTK_BUTTONS_YES_NO,
-									_("Do you really want to delete all cookie permissions?"));
+									isFiltered ? _("Do you really want to delete all cookie permissions shown?") : _("Do you really want to delete all cookie permissions?"));
 
 	gtk_window_set_title(GTK_WINDOW(dialog), _("Delete all cookie permissions?"));
 	gtk_window_set_icon_name(GTK_WINDOW(dialog), GTK_STOCK_PROPERTIES);
 
-	gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog),
-												_("This action will delete all cookie permissions. "
-												  "You will be asked for permissions again for each web site visited."));
+	if(isFiltered)
+	{
+		gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog),
+													_("This action will delete the cookie permissions of all domains matching the filter. "
+													  "You will be asked for permissions again for each of these web sites visited."));
+	}
+		else
+		{
+			gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog),
+														_("This action will delete all cookie permissions. "
+														  "You will be asked for permissions again for each web site visited."));
+		}
 
 	dialogResponse=gtk_dialog_run(GTK_DIALOG(dialog));
 	gtk_widget_destroy(dialog);
 
 	if(dialogResponse==GTK_RESPONSE_NO) return;
 
-	/* Delete all permission */
-	success=sqlite3_exec(priv->database,
-							"DELETE FROM policies;",
-							NULL,
-							NULL,
-							&error);
-
-	if(success!=SQLITE_OK || error)
+	/* Delete all permissions shown the same way as selected ones */
+	if(gtk_tree_model_get_iter_first(model, &iter))
 	{
-		if(error)
+		do
 		{
-			g_critical(_("Failed to execute database statement: %s"), error);
-			sqlite3_free(error);
+			rows=g_list_prepend(rows, g_memdup(&iter, sizeof(GtkTreeIter)));
 		}
+		while(gtk_tree_model_iter_next(model, &iter));
 	}
 
-	/* Re-setup list */
-	_cookie_permission_manager_preferences_window_fill(self);
+	_cookie_permission_manager_preferences_window_set_policy_of_rows(self, rows, COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED);
+	g_list_free_full(rows, g_free);
 }
 
-/* Sorting callbacks */
-static gint _cookie_permission_manager_preferences_sort_string_callback(GtkTreeModel *inModel,
-																		GtkTreeIter *inLeft,
-																		GtkTreeIter *inRight,
+/* Render name of policy in list */
+static void _cookie_permission_manager_preferences_window_render_policy(GtkTreeViewColumn *inColumn,
+																		GtkCellRenderer *inRenderer,
+																		GtkTreeModel *inModel,
+																		GtkTreeIter *inIter,
 																		gpointer inUserData)
 {
-	gchar		*left, *right;
-	gint		column=GPOINTER_TO_INT(inUserData);
-	gint		result;
+	gint		policy;
+
+	gtk_tree_model_get(inModel, inIter, COOKIE_PERMISSION_MANAGER_POLICY_LIST_COLUMN_POLICY, &policy, -1);
+	g_object_set(inRenderer, "text", cookie_permission_manager_policy_list_get_policy_name(policy), NULL);
+}
+
+/* Show current statistics of manager */
+static gboolean _cookie_permission_manager_preferences_window_refresh_statistics(gpointer inUserData)
+{
+	CookiePermissionManagerPreferencesWindow			*self=COOKIE_PERMISSION_MANAGER_PREFERENCES_WINDOW(inUserData);
+	CookiePermissionManagerPreferencesWindowPrivate		*priv=self->priv;
+	gchar												*text;
 
-	gtk_tree_model_get(inModel, inLeft, column, &left, -1);
-	gtk_tree_model_get(inModel, inRight, column, &right, -1);
+	if(!priv->manager) return(TRUE);
 
-	result=g_strcmp0(left, right);
+	text=cookie_permission_manager_statistics_to_string(cookie_permission_manager_get_statistics(priv->manager));
+	gtk_label_set_text(GTK_LABEL(priv->statisticsLabel), text);
+	g_free(text);
 
-	g_free(left);
-	g_free(right);
+	return(TRUE);
+}
 
-	return(result);
+/* Stop refreshing statistics */
+static void _cookie_permission_manager_preferences_window_stop_statistics(CookiePermissionManagerPreferencesWindow *self)
+{
+	CookiePermissionManagerPreferencesWindowPrivate		*priv=self->priv;
+
+	if(priv->statisticsRefreshID) g_source_remove(priv->statisticsRefreshID);
+	priv->statisticsRefreshID=0;
+}
+
+/* Statistics section was expanded or collapsed so refresh statistics
+ * periodically only while they are shown
+ */
+static void _cookie_permission_manager_preferences_window_on_statistics_expanded(CookiePermissionManagerPreferencesWindow *self,
+																					GParamSpec *inSpec,
+																					gpointer inUserData)
+{
+	CookiePermissionManagerPreferencesWindowPrivate		*priv=self->priv;
+
+	_cookie_permission_manager_preferences_window_stop_statistics(self);
+
+	if(gtk_expander_get_expanded(GTK_EXPANDER(priv->statisticsExpander)))
+	{
+		_cookie_permission_manager_preferences_window_refresh_statistics(self);
+		priv->statisticsRefreshID=g_timeout_add_seconds(STATISTICS_REFRESH_INTERVAL, _cookie_permission_manager_preferences_window_refresh_statistics, self);
+	}
+}
+
+/* "Reset statistics"-button was pressed */
+static void _cookie_permission_manager_preferences_window_on_reset_statistics(CookiePermissionManagerPreferencesWindow *self,
+																				gpointer *inUserData)
+{
+	CookiePermissionManagerPreferencesWindowPrivate		*priv=self->priv;
+
+	if(!priv->manager) return;
+
+	cookie_permission_manager_reset_statistics(priv->manager);
+	_cookie_permission_manager_preferences_window_refresh_statistics(self);
 }
 
 /* IMPLEMENTATION: GObject */
@@ -492,21 +710,36 @@ static void cookie_permission_manager_preferences_window_finalize(GObject *inObj
 	CookiePermissionManagerPreferencesWindowPrivate	*priv=COOKIE_PERMISSION_MANAGER_PREFERENCES_WINDOW(inObject)->priv;
 
 	/* Dispose allocated resources */
-	if(priv->database) sqlite3_close(priv->database);
-	priv->database=NULL;
+	if(priv->statisticsRefreshID) g_source_remove(priv->statisticsRefreshID);
+	priv->statisticsRefreshID=0;
 
 	if(priv->manager)
 	{
 		if(priv->signalManagerChangedDatabaseID) g_signal_handler_disconnect(priv->manager, priv->signalManagerChangedDatabaseID);
 		priv->signalManagerChangedDatabaseID=0;
 
+		if(priv->signalManagerPolicyChangedID) g_signal_handler_disconnect(priv->manager, priv->signalManagerPolicyChangedID);
+		priv->signalManagerPolicyChangedID=0;
+
 		if(priv->signalManagerAskForUnknownPolicyID) g_signal_handler_disconnect(priv->manager, priv->signalManagerAskForUnknownPolicyID);
 		priv->signalManagerAskForUnknownPolicyID=0;
 
+		if(priv->signalManagerGroupByRegistrableDomainID) g_signal_handler_disconnect(priv->manager, priv->signalManagerGroupByRegistrableDomainID);
+		priv->signalManagerGroupByRegistrableDomainID=0;
+
 		g_object_unref(priv->manager);
 		priv->manager=NULL;
 	}
 
+	if(priv->policyLoader) cookie_permission_manager_policy_loader_free(priv->policyLoader);
+	priv->policyLoader=NULL;
+
+	if(priv->changedWhileLoading) g_hash_table_destroy(priv->changedWhileLoading);
+	priv->changedWhileLoading=NULL;
+
+	if(priv->policyList) g_object_unref(priv->policyList);
+	priv->policyList=NULL;
+
 	/* Call parent's class finalize method */
 	G_OBJECT_CLASS(cookie_permission_manager_preferences_window_parent_class)->finalize(inObject);
 }
@@ -531,9 +764,15 @@ static void cookie_permission_manager_preferences_window_set_property(GObject *i
 				if(priv->signalManagerChangedDatabaseID) g_signal_handler_disconnect(priv->manager, priv->signalManagerChangedDatabaseID);
 				priv->signalManagerChangedDatabaseID=0;
 
+				if(priv->signalManagerPolicyChangedID) g_signal_handler_disconnect(priv->manager, priv->signalManagerPolicyChangedID);
+				priv->signalManagerPolicyChangedID=0;
+
 				if(priv->signalManagerAskForUnknownPolicyID) g_signal_handler_disconnect(priv->manager, priv->signalManagerAskForUnknownPolicyID);
 				priv->signalManagerAskForUnknownPolicyID=0;
 
+				if(priv->signalManagerGroupByRegistrableDomainID) g_signal_handler_disconnect(priv->manager, priv->signalManagerGroupByRegistrableDomainID);
+				priv->signalManagerGroupByRegistrableDomainID=0;
+
 				g_object_unref(priv->manager);
 				priv->manager=NULL;
 			}
@@ -553,12 +792,25 @@ static void cookie_permission_manager_preferences_window_set_property(GObject *i
 												self);
 				_cookie_permission_manager_preferences_window_manager_database_changed(self, NULL, priv->manager);
 
+				priv->signalManagerPolicyChangedID=
+					g_signal_connect_swapped(priv->manager,
+												"policy-changed",
+												G_CALLBACK(_cookie_permission_manager_preferences_window_manager_policy_changed),
+												self);
+
 				priv->signalManagerAskForUnknownPolicyID=
 					g_signal_connect_swapped(priv->manager,
 												"notify::ask-for-unknown-policy",
 												G_CALLBACK(_cookie_permission_manager_preferences_window_manager_ask_for_unknown_policy_changed),
 												self);
 				_cookie_permission_manager_preferences_window_manager_ask_for_unknown_policy_changed(self, NULL, priv->manager);
+
+				priv->signalManagerGroupByRegistrableDomainID=
+					g_signal_connect_swapped(priv->manager,
+												"notify::group-by-registrable-domain",
+												G_CALLBACK(_cookie_permission_manager_preferences_window_manager_group_by_registrable_domain_changed),
+												self);
+				_cookie_permission_manager_preferences_window_manager_group_by_registrable_domain_changed(self, NULL, priv->manager);
 			}
 			break;
 
@@ -619,7 +871,6 @@ static void cookie_permission_manager_preferences_window_class_init(CookiePermis
 static void cookie_permission_manager_preferences_window_init(CookiePermissionManagerPreferencesWindow *self)
 {
 	CookiePermissionManagerPreferencesWindowPrivate		*priv;
-	GtkTreeSortable										*sortableList;
 	GtkCellRenderer										*renderer;
 	GtkTreeViewColumn									*column;
 	GtkWidget											*widget;
@@ -636,6 +887,9 @@ static void cookie_permission_manager_preferences_window_init(CookiePermissionMa
 
 	/* Set up default values */
 	priv->manager=NULL;
+	priv->policyLoader=NULL;
+	priv->changedWhileLoading=g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	priv->statisticsRefreshID=0;
 
 	/* Get content area to add gui controls to */
 	priv->contentArea=gtk_dialog_get_content_area(GTK_DIALOG(self));
@@ -663,31 +917,23 @@ static void cookie_permission_manager_preferences_window_init(CookiePermissionMa
 	/* Set up description */
 	widget=gtk_label_new(NULL);
 	text=g_strdup_printf(_("Below is a list of all web sites and the policy set for them. "
-							"You can delete policies by marking the entries and clicking on <i>Delete</i>."
+							"You can delete policies by marking the entries and clicking on <i>Delete</i> "
+							"or change their policy by choosing another one and clicking on <i>Change policy</i>. "
 							"You can also add a policy for a domain manually by entering the domain below, "
-							"choosing the policy and clicking on <i>Add</i>."));
+							"choosing the policy and clicking on <i>Add</i>. "
+							"Check <i>Pattern</i> to add a policy for all domains matching a pattern "
+							"like <i>*.doubleclick.*</i> where '*' matches any text and '?' matches "
+							"exactly one character. Policies of domains take precedence over patterns."));
 	gtk_label_set_markup(GTK_LABEL(widget), text);
 	g_free(text);
 	gtk_label_set_line_wrap(GTK_LABEL(widget), TRUE);
 	gtk_box_pack_start(GTK_BOX(vbox), widget, FALSE, FALSE, 4);
 
 	/* Set up model for cookie domain list */
-	priv->listStore=gtk_list_store_new(N_COLUMN,
-										G_TYPE_STRING,	/* DOMAIN_COLUMN */
-										G_TYPE_STRING	/* POLICY_COLUMN */);
-
-	sortableList=GTK_TREE_SORTABLE(priv->listStore);
-	gtk_tree_sortable_set_sort_func(sortableList,
-										DOMAIN_COLUMN,
-										(GtkTreeIterCompareFunc)_cookie_permission_manager_preferences_sort_string_callback,
-										GINT_TO_POINTER(DOMAIN_COLUMN),
-										NULL);
-	gtk_tree_sortable_set_sort_func(sortableList,
-										POLICY_COLUMN,
-										(GtkTreeIterCompareFunc)_cookie_permission_manager_preferences_sort_string_callback,
-										GINT_TO_POINTER(POLICY_COLUMN),
-										NULL);
-	gtk_tree_sortable_set_sort_column_id(sortableList, DOMAIN_COLUMN, GTK_SORT_ASCENDING);
+	priv->policyList=cookie_permission_manager_policy_list_new();
+	gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(priv->policyList),
+											COOKIE_PERMISSION_MANAGER_POLICY_LIST_COLUMN_DOMAIN,
+											GTK_SORT_ASCENDING);
 
 	/* Set up domain addition widgets */
 #ifdef GTK__3_0_VERSION
@@ -718,6 +964,10 @@ static void cookie_permission_manager_preferences_window_init(CookiePermissionMa
 	gtk_cell_layout_pack_start(GTK_CELL_LAYOUT(priv->addDomainPolicyCombo), renderer, TRUE);
 	gtk_cell_layout_add_attribute(GTK_CELL_LAYOUT(priv->addDomainPolicyCombo), renderer, "text", 1);
 
+	priv->addDomainIsPatternCheckbox=gtk_check_button_new_with_mnemonic(_("_Pattern"));
+	gtk_container_add(GTK_CONTAINER(hbox), priv->addDomainIsPatternCheckbox);
+	g_signal_connect_swapped(priv->addDomainIsPatternCheckbox, "toggled", G_CALLBACK(_cookie_permission_manager_preferences_on_add_domain_entry_changed), self);
+
 	priv->addDomainButton=gtk_button_new_from_stock(GTK_STOCK_ADD);
 	gtk_widget_set_sensitive(priv->addDomainButton, FALSE);
 	gtk_container_add(GTK_CONTAINER(hbox), priv->addDomainButton);
@@ -725,8 +975,30 @@ static void cookie_permission_manager_preferences_window_init(CookiePermissionMa
 
 	gtk_box_pack_start(GTK_BOX(vbox), hbox, TRUE, TRUE, 5);
 
+	/* Set up filter of cookie domain list */
+#ifdef GTK__3_0_VERSION
+	hbox=gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
+	gtk_box_set_homogeneous(GTK_BOX(hbox), FALSE);
+#else
+	hbox=gtk_hbox_new(FALSE, 0);
+#endif
+
+	widget=gtk_label_new_with_mnemonic(_("_Filter:"));
+	gtk_box_pack_start(GTK_BOX(hbox), widget, FALSE, FALSE, 4);
+
+	priv->filterEntry=gtk_entry_new();
+#ifdef GTK__3_0_VERSION
+	gtk_entry_set_placeholder_text(GTK_ENTRY(priv->filterEntry), _("Search domains"));
+#endif
+	gtk_label_set_mnemonic_widget(GTK_LABEL(widget), priv->filterEntry);
+	gtk_box_pack_start(GTK_BOX(hbox), priv->filterEntry, TRUE, TRUE, 0);
+	g_signal_connect_swapped(priv->filterEntry, "changed", G_CALLBACK(_cookie_permission_manager_preferences_window_on_filter_changed), self);
+
+	gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, FALSE, 5);
+
 	/* Set up cookie domain list */
-	priv->list=gtk_tree_view_new_with_model(GTK_TREE_MODEL(priv->listStore));
+	priv->list=gtk_tree_view_new_with_model(GTK_TREE_MODEL(priv->policyList));
+	gtk_tree_view_set_fixed_height_mode(GTK_TREE_VIEW(priv->list), TRUE);
 
 #ifndef GTK__3_0_VERSION
 	gtk_widget_set_size_request(priv->list, -1, 300);
@@ -739,17 +1011,37 @@ static void cookie_permission_manager_preferences_window_init(CookiePermissionMa
 	renderer=gtk_cell_renderer_text_new();
 	column=gtk_tree_view_column_new_with_attributes(_("Domain"),
 													renderer,
-													"text", DOMAIN_COLUMN,
+													"text", COOKIE_PERMISSION_MANAGER_POLICY_LIST_COLUMN_DOMAIN,
 													NULL);
-	gtk_tree_view_column_set_sort_column_id(column, DOMAIN_COLUMN);
+	gtk_tree_view_column_set_sizing(column, GTK_TREE_VIEW_COLUMN_FIXED);
+	gtk_tree_view_column_set_fixed_width(column, width*24);
+	gtk_tree_view_column_set_expand(column, TRUE);
+	gtk_tree_view_column_set_sort_column_id(column, COOKIE_PERMISSION_MANAGER_POLICY_LIST_COLUMN_DOMAIN);
 	gtk_tree_view_append_column(GTK_TREE_VIEW(priv->list), column);
 
 	renderer=gtk_cell_renderer_text_new();
 	column=gtk_tree_view_column_new_with_attributes(_("Policy"),
 													renderer,
-													"text", POLICY_COLUMN,
 													NULL);
-	gtk_tree_view_column_set_sort_column_id(column, POLICY_COLUMN);
+	gtk_tree_view_column_set_cell_data_func(column,
+												renderer,
+												_cookie_permission_manager_preferences_window_render_policy,
+												NULL,
+												NULL);
+	gtk_tree_view_column_set_sizing(column, GTK_TREE_VIEW_COLUMN_FIXED);
+	gtk_tree_view_column_set_fixed_width(column, width*16);
+	gtk_tree_view_column_set_sort_column_id(column, COOKIE_PERMISSION_MANAGER_POLICY_LIST_COLUMN_POLICY);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(priv->list), column);
+
+	renderer=gtk_cell_renderer_toggle_new();
+	gtk_cell_renderer_toggle_set_activatable(GTK_CELL_RENDERER_TOGGLE(renderer), FALSE);
+	column=gtk_tree_view_column_new_with_attributes(_("Pattern"),
+													renderer,
+													"active", COOKIE_PERMISSION_MANAGER_POLICY_LIST_COLUMN_IS_PATTERN,
+													NULL);
+	gtk_tree_view_column_set_sizing(column, GTK_TREE_VIEW_COLUMN_FIXED);
+	gtk_tree_view_column_set_fixed_width(column, width*8);
+	gtk_tree_view_column_set_sort_column_id(column, COOKIE_PERMISSION_MANAGER_POLICY_LIST_COLUMN_IS_PATTERN);
 	gtk_tree_view_append_column(GTK_TREE_VIEW(priv->list), column);
 
 	scrolled=gtk_scrolled_window_new(NULL, NULL);
@@ -761,6 +1053,14 @@ static void cookie_permission_manager_preferences_window_init(CookiePermissionMa
 	gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(scrolled), GTK_SHADOW_IN);
 	gtk_box_pack_start(GTK_BOX(vbox), scrolled, TRUE, TRUE, 5);
 
+	/* Set up progress of loading policies shown only while loading */
+	priv->loadProgress=gtk_progress_bar_new();
+#ifdef GTK__3_0_VERSION
+	gtk_progress_bar_set_show_text(GTK_PROGRESS_BAR(priv->loadProgress), TRUE);
+#endif
+	gtk_widget_set_no_show_all(priv->loadProgress, TRUE);
+	gtk_box_pack_start(GTK_BOX(vbox), priv->loadProgress, FALSE, FALSE, 0);
+
 	/* Set up cookie domain list management buttons */
 #ifdef GTK__3_0_VERSION
 	hbox=gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
@@ -780,6 +1080,19 @@ static void cookie_permission_manager_preferences_window_init(CookiePermissionMa
 	gtk_container_add(GTK_CONTAINER(hbox), priv->deleteAllButton);
 	g_signal_connect_swapped(priv->deleteAllButton, "clicked", G_CALLBACK(_cookie_permission_manager_preferences_on_delete_all), self);
 
+	priv->changePolicyCombo=gtk_combo_box_new_with_model(GTK_TREE_MODEL(list));
+	gtk_combo_box_set_active(GTK_COMBO_BOX(priv->changePolicyCombo), 0);
+	gtk_container_add(GTK_CONTAINER(hbox), priv->changePolicyCombo);
+
+	renderer=gtk_cell_renderer_text_new();
+	gtk_cell_layout_pack_start(GTK_CELL_LAYOUT(priv->changePolicyCombo), renderer, TRUE);
+	gtk_cell_layout_add_attribute(GTK_CELL_LAYOUT(priv->changePolicyCombo), renderer, "text", 1);
+
+	priv->changePolicyButton=gtk_button_new_with_mnemonic(_("_Change policy"));
+	gtk_widget_set_sensitive(priv->changePolicyButton, FALSE);
+	gtk_container_add(GTK_CONTAINER(hbox), priv->changePolicyButton);
+	g_signal_connect_swapped(priv->changePolicyButton, "clicked", G_CALLBACK(_cookie_permission_manager_preferences_on_change_policy_of_selection), self);
+
 	gtk_box_pack_start(GTK_BOX(vbox), hbox, TRUE, TRUE, 5);
 
 	/* Add "ask-for-unknown-policy" checkbox */
@@ -790,6 +1103,41 @@ static void cookie_permission_manager_preferences_window_init(CookiePermissionMa
 																self);
 	gtk_box_pack_start(GTK_BOX(vbox), priv->askForUnknownPolicyCheckbox, TRUE, TRUE, 5);
 
+	/* Add "group-by-registrable-domain" checkbox */
+	priv->groupByRegistrableDomainCheckbox=gtk_check_button_new_with_mnemonic(_("_Group policies by registrable domain (e.g. example.co.uk)"));
+	priv->signalGroupByRegistrableDomainID=g_signal_connect_swapped(priv->groupByRegistrableDomainCheckbox,
+																	"toggled",
+																	G_CALLBACK(_cookie_permission_manager_preferences_window_group_by_registrable_domain_changed),
+																	self);
+	gtk_box_pack_start(GTK_BOX(vbox), priv->groupByRegistrableDomainCheckbox, TRUE, TRUE, 5);
+
+	/* Set up statistics section */
+	priv->statisticsExpander=gtk_expander_new_with_mnemonic(_("S_tatistics"));
+	g_signal_connect_swapped(priv->statisticsExpander, "notify::expanded", G_CALLBACK(_cookie_permission_manager_preferences_window_on_statistics_expanded), self);
+
+#ifdef GTK__3_0_VERSION
+	hbox=gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
+	gtk_box_set_homogeneous(GTK_BOX(hbox), FALSE);
+#else
+	hbox=gtk_hbox_new(FALSE, 0);
+#endif
+
+	priv->statisticsLabel=gtk_label_new(NULL);
+	gtk_label_set_selectable(GTK_LABEL(priv->statisticsLabel), TRUE);
+	gtk_misc_set_alignment(GTK_MISC(priv->statisticsLabel), 0.0f, 0.0f);
+	gtk_box_pack_start(GTK_BOX(hbox), priv->statisticsLabel, TRUE, TRUE, 4);
+
+	widget=gtk_button_new_with_mnemonic(_("_Reset"));
+	gtk_button_set_image(GTK_BUTTON(widget), gtk_image_new_from_stock(GTK_STOCK_CLEAR, GTK_ICON_SIZE_BUTTON));
+	g_signal_connect_swapped(widget, "clicked", G_CALLBACK(_cookie_permission_manager_preferences_window_on_reset_statistics), self);
+	gtk_box_pack_start(GTK_BOX(hbox), widget, FALSE, FALSE, 4);
+
+	gtk_container_add(GTK_CONTAINER(priv->statisticsExpander), hbox);
+	gtk_box_pack_start(GTK_BOX(vbox), priv->statisticsExpander, FALSE, FALSE, 5);
+
+	/* Widgets are gone when dialog is destroyed so stop refreshing them */
+	g_signal_connect(self, "destroy", G_CALLBACK(_cookie_permission_manager_preferences_window_stop_statistics), NULL);
+
 	/* Finalize setup of content area */
 	gtk_container_add(GTK_CONTAINER(priv->contentArea), vbox);
 }
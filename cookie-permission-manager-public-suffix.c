@@ -0,0 +1,121 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+#include "cookie-permission-manager-public-suffix.h"
+
+#include <string.h>
+
+/* Rule types - must match the definitions in tools/make-public-suffix-dafsa.py */
+#define RULE_NORMAL			1
+#define RULE_WILDCARD		2
+#define RULE_EXCEPTION		4
+
+#define NO_NODE				G_MAXUINT
+
+/* The Public Suffix List compiled into a DAFSA of reversed rules.
+ * Regenerate it by calling:
+ *   tools/make-public-suffix-dafsa.py public_suffix_list.dat > cookie-permission-manager-public-suffix.inc
+ */
+#include "cookie-permission-manager-public-suffix.inc"
+
+/* IMPLEMENTATION: Private variables and methods */
+
+/* Follow edge of node labeled with character */
+static guint _cookie_permission_manager_public_suffix_next_node(guint inNode, guchar inCharacter)
+{
+	guint		edge, lastEdge;
+
+	edge=_cookie_permission_manager_public_suffix_first_edges[inNode];
+	lastEdge=edge+_cookie_permission_manager_public_suffix_edge_counts[inNode];
+
+	/* Edges are sorted by character */
+	for(; edge<lastEdge; edge++)
+	{
+		guchar	character=_cookie_permission_manager_public_suffix_edge_characters[edge];
+
+		if(character==inCharacter) return(_cookie_permission_manager_public_suffix_edge_targets[edge]);
+		if(character>inCharacter) break;
+	}
+
+	return(NO_NODE);
+}
+
+/* IMPLEMENTATION: Public API */
+
+/* Get registrable domain (public suffix plus one label, also called eTLD+1) of domain.
+ * The returned pointer points into domain passed in so no memory is allocated.
+ * Returns NULL if domain is a public suffix itself.
+ */
+const gchar* cookie_permission_manager_public_suffix_get_registrable_domain(const gchar *inDomain)
+{
+	const gchar		*start, *end, *iter;
+	guint			node;
+	guint8			value;
+	gint			labels, suffixLabels, dots;
+
+	g_return_val_if_fail(inDomain, NULL);
+
+	/* Strip leading dot of cookie domains and trailing dot of fully qualified names */
+	start=inDomain;
+	if(*start=='.') start++;
+
+	end=start+strlen(start);
+	if(end>start && *(end-1)=='.') end--;
+	if(end==start) return(NULL);
+
+	/* Walk domain backwards through automaton and check rules at each label boundary.
+	 * The longest matching rule wins and an exception rule overrides any other rule.
+	 * If no rule matches the top-level domain is the public suffix.
+	 */
+	node=0;
+	labels=0;
+	suffixLabels=1;
+
+	iter=end;
+	while(iter>start)
+	{
+		iter--;
+
+		node=_cookie_permission_manager_public_suffix_next_node(node, g_ascii_tolower(*iter));
+		if(node==NO_NODE) break;
+
+		if(iter==start || *(iter-1)=='.')
+		{
+			labels++;
+			value=_cookie_permission_manager_public_suffix_values[node];
+
+			if(value & RULE_EXCEPTION)
+			{
+				suffixLabels=labels-1;
+				break;
+			}
+
+			if(value & RULE_NORMAL) suffixLabels=MAX(suffixLabels, labels);
+			if(value & RULE_WILDCARD) suffixLabels=MAX(suffixLabels, labels+1);
+		}
+	}
+
+	/* Find start of label in front of public suffix */
+	dots=0;
+	iter=end;
+	while(iter>start)
+	{
+		iter--;
+
+		if(*iter=='.')
+		{
+			dots++;
+			if(dots==suffixLabels+1) return(iter+1);
+		}
+	}
+
+	return(dots>=suffixLabels ? start : NULL);
+}
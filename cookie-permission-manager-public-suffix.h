@@ -0,0 +1,24 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+#ifndef __COOKIE_PERMISSION_MANAGER_PUBLIC_SUFFIX__
+#define __COOKIE_PERMISSION_MANAGER_PUBLIC_SUFFIX__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Public API */
+const gchar* cookie_permission_manager_public_suffix_get_registrable_domain(const gchar *inDomain);
+
+G_END_DECLS
+
+#endif /* __COOKIE_PERMISSION_MANAGER_PUBLIC_SUFFIX__ */
@@ -0,0 +1,243 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+#include "cookie-permission-manager-statistics.h"
+#include "cookie-permission-manager.h"
+
+#include <string.h>
+
+typedef struct _CookiePermissionManagerStatisticsTimerData		CookiePermissionManagerStatisticsTimerData;
+
+struct _CookiePermissionManagerStatisticsTimerData
+{
+	guint64			calls;
+	guint64			totalTime;		/* in microseconds */
+	guint64			maxTime;		/* in microseconds */
+	guint64			histogram[COOKIE_PERMISSION_MANAGER_STATISTICS_BUCKETS];
+};
+
+struct _CookiePermissionManagerStatistics
+{
+	CookiePermissionManagerStatisticsTimerData	timers[COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_LAST];
+	guint64										outcomes[COOKIE_PERMISSION_MANAGER_STATISTICS_OUTCOME_LAST];
+};
+
+/* IMPLEMENTATION: Private variables and methods */
+
+/* Get bucket of latency histogram for a time in microseconds */
+static guint _cookie_permission_manager_statistics_get_bucket(guint64 inTime)
+{
+	if(inTime==0) return(0);
+
+	return(MIN(g_bit_storage(inTime), COOKIE_PERMISSION_MANAGER_STATISTICS_BUCKETS-1));
+}
+
+/* IMPLEMENTATION: Public API */
+
+/* Create new and empty statistics */
+CookiePermissionManagerStatistics* cookie_permission_manager_statistics_new(void)
+{
+	return(g_new0(CookiePermissionManagerStatistics, 1));
+}
+
+/* Release statistics */
+void cookie_permission_manager_statistics_free(CookiePermissionManagerStatistics *self)
+{
+	g_return_if_fail(self);
+
+	g_free(self);
+}
+
+/* Clear all counters and histograms */
+void cookie_permission_manager_statistics_reset(CookiePermissionManagerStatistics *self)
+{
+	g_return_if_fail(self);
+
+	memset(self, 0, sizeof(CookiePermissionManagerStatistics));
+}
+
+/* Record a call of a timed part which started at given monotonic time */
+void cookie_permission_manager_statistics_record(CookiePermissionManagerStatistics *self,
+													CookiePermissionManagerStatisticsTimer inTimer,
+													gint64 inStartTime)
+{
+	CookiePermissionManagerStatisticsTimerData	*timer;
+	guint64										elapsed;
+
+	g_return_if_fail(self);
+	g_return_if_fail(inTimer<COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_LAST);
+
+	elapsed=(guint64)MAX(g_get_monotonic_time()-inStartTime, 0);
+
+	timer=&self->timers[inTimer];
+	timer->calls++;
+	timer->totalTime+=elapsed;
+	if(elapsed>timer->maxTime) timer->maxTime=elapsed;
+	timer->histogram[_cookie_permission_manager_statistics_get_bucket(elapsed)]++;
+}
+
+/* Count outcome of a policy lookup */
+void cookie_permission_manager_statistics_count_outcome(CookiePermissionManagerStatistics *self,
+															CookiePermissionManagerStatisticsOutcome inOutcome)
+{
+	g_return_if_fail(self);
+	g_return_if_fail(inOutcome<COOKIE_PERMISSION_MANAGER_STATISTICS_OUTCOME_LAST);
+
+	self->outcomes[inOutcome]++;
+}
+
+/* Get number of calls, total and maximum time in microseconds of a timed part */
+guint64 cookie_permission_manager_statistics_get_calls(CookiePermissionManagerStatistics *self,
+														CookiePermissionManagerStatisticsTimer inTimer)
+{
+	g_return_val_if_fail(self, 0);
+	g_return_val_if_fail(inTimer<COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_LAST, 0);
+
+	return(self->timers[inTimer].calls);
+}
+
+guint64 cookie_permission_manager_statistics_get_total_time(CookiePermissionManagerStatistics *self,
+															CookiePermissionManagerStatisticsTimer inTimer)
+{
+	g_return_val_if_fail(self, 0);
+	g_return_val_if_fail(inTimer<COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_LAST, 0);
+
+	return(self->timers[inTimer].totalTime);
+}
+
+guint64 cookie_permission_manager_statistics_get_max_time(CookiePermissionManagerStatistics *self,
+															CookiePermissionManagerStatisticsTimer inTimer)
+{
+	g_return_val_if_fail(self, 0);
+	g_return_val_if_fail(inTimer<COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_LAST, 0);
+
+	return(self->timers[inTimer].maxTime);
+}
+
+/* Get latency histogram of a timed part. It has COOKIE_PERMISSION_MANAGER_STATISTICS_BUCKETS
+ * entries and is owned by statistics.
+ */
+const guint64* cookie_permission_manager_statistics_get_histogram(CookiePermissionManagerStatistics *self,
+																	CookiePermissionManagerStatisticsTimer inTimer)
+{
+	g_return_val_if_fail(self, NULL);
+	g_return_val_if_fail(inTimer<COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_LAST, NULL);
+
+	return(self->timers[inTimer].histogram);
+}
+
+/* Get upper limit in microseconds of latency the given percentage of calls of a
+ * timed part stayed below. It is only as exact as the buckets of histogram are.
+ */
+guint64 cookie_permission_manager_statistics_get_percentile(CookiePermissionManagerStatistics *self,
+															CookiePermissionManagerStatisticsTimer inTimer,
+															guint inPercentile)
+{
+	CookiePermissionManagerStatisticsTimerData	*timer;
+	guint64										wanted, counted=0;
+	guint										i;
+
+	g_return_val_if_fail(self, 0);
+	g_return_val_if_fail(inTimer<COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_LAST, 0);
+	g_return_val_if_fail(inPercentile<=100, 0);
+
+	timer=&self->timers[inTimer];
+	if(timer->calls==0) return(0);
+
+	wanted=(timer->calls*inPercentile+99)/100;
+	for(i=0; i<COOKIE_PERMISSION_MANAGER_STATISTICS_BUCKETS-1; i++)
+	{
+		counted+=timer->histogram[i];
+		if(counted>=wanted) return(G_GUINT64_CONSTANT(1)<<i);
+	}
+
+	return(timer->maxTime+1);
+}
+
+/* Get number of policy lookups with an outcome */
+guint64 cookie_permission_manager_statistics_get_outcomes(CookiePermissionManagerStatistics *self,
+															CookiePermissionManagerStatisticsOutcome inOutcome)
+{
+	g_return_val_if_fail(self, 0);
+	g_return_val_if_fail(inOutcome<COOKIE_PERMISSION_MANAGER_STATISTICS_OUTCOME_LAST, 0);
+
+	return(self->outcomes[inOutcome]);
+}
+
+/* Get translated name of a timed part */
+const gchar* cookie_permission_manager_statistics_get_timer_name(CookiePermissionManagerStatisticsTimer inTimer)
+{
+	switch(inTimer)
+	{
+		case COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_GET_POLICY:
+			return(_("Policy lookups"));
+
+		case COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_RESPONSE:
+			return(_("Responses"));
+
+		case COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_COOKIE_CHANGED:
+			return(_("Cookie jar changes"));
+
+		case COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_PROMPT_WAIT:
+			return(_("Waiting for user"));
+
+		case COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_SQL:
+			return(_("Database queries"));
+
+		default:
+			break;
+	}
+
+	return(NULL);
+}
+
+/* Get human-readable summary of statistics which must be freed by caller */
+gchar* cookie_permission_manager_statistics_to_string(CookiePermissionManagerStatistics *self)
+{
+	GString		*text;
+	guint		i;
+
+	g_return_val_if_fail(self, NULL);
+
+	text=g_string_new(NULL);
+
+	g_string_append_printf(text,
+							_("Accepted: %" G_GUINT64_FORMAT ", blocked: %" G_GUINT64_FORMAT ", asked: %" G_GUINT64_FORMAT "\n"),
+							self->outcomes[COOKIE_PERMISSION_MANAGER_STATISTICS_OUTCOME_ACCEPT],
+							self->outcomes[COOKIE_PERMISSION_MANAGER_STATISTICS_OUTCOME_BLOCK],
+							self->outcomes[COOKIE_PERMISSION_MANAGER_STATISTICS_OUTCOME_ASK]);
+
+	for(i=0; i<COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_LAST; i++)
+	{
+		CookiePermissionManagerStatisticsTimerData	*timer=&self->timers[i];
+
+		if(timer->calls==0)
+		{
+			g_string_append_printf(text, _("%s: no calls\n"), cookie_permission_manager_statistics_get_timer_name(i));
+			continue;
+		}
+
+		g_string_append_printf(text,
+								_("%s: %" G_GUINT64_FORMAT " calls, %.3f ms total, "
+								  "median <%" G_GUINT64_FORMAT " µs, 99%% <%" G_GUINT64_FORMAT " µs, max %" G_GUINT64_FORMAT " µs\n"),
+								cookie_permission_manager_statistics_get_timer_name(i),
+								timer->calls,
+								(gdouble)timer->totalTime/1000.0,
+								cookie_permission_manager_statistics_get_percentile(self, i, 50),
+								cookie_permission_manager_statistics_get_percentile(self, i, 99),
+								timer->maxTime);
+	}
+
+	/* Remove trailing new-line */
+	if(text->len>0) g_string_truncate(text, text->len-1);
+
+	return(g_string_free(text, FALSE));
+}
@@ -0,0 +1,83 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+#ifndef __COOKIE_PERMISSION_MANAGER_STATISTICS__
+#define __COOKIE_PERMISSION_MANAGER_STATISTICS__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Number of buckets of latency histograms. Bucket 0 counts calls taking less than
+ * one microsecond, bucket n counts calls taking 2^(n-1) up to 2^n-1 microseconds
+ * and the last bucket counts all slower calls.
+ */
+#define COOKIE_PERMISSION_MANAGER_STATISTICS_BUCKETS		24
+
+/* Timed parts of cookie decision path */
+typedef enum
+{
+	COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_GET_POLICY,
+	COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_RESPONSE,
+	COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_COOKIE_CHANGED,
+	COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_PROMPT_WAIT,
+	COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_SQL,
+
+	COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_LAST
+} CookiePermissionManagerStatisticsTimer;
+
+/* Outcomes of policy lookups */
+typedef enum
+{
+	COOKIE_PERMISSION_MANAGER_STATISTICS_OUTCOME_ACCEPT,
+	COOKIE_PERMISSION_MANAGER_STATISTICS_OUTCOME_BLOCK,
+	COOKIE_PERMISSION_MANAGER_STATISTICS_OUTCOME_ASK,
+
+	COOKIE_PERMISSION_MANAGER_STATISTICS_OUTCOME_LAST
+} CookiePermissionManagerStatisticsOutcome;
+
+/* Call counts, outcomes and latency histograms of cookie decision path. Recording
+ * only increases a few counters so it is cheap enough to be always enabled. It is
+ * not thread-safe and must only be used in main loop.
+ */
+typedef struct _CookiePermissionManagerStatistics		CookiePermissionManagerStatistics;
+
+CookiePermissionManagerStatistics* cookie_permission_manager_statistics_new(void);
+void cookie_permission_manager_statistics_free(CookiePermissionManagerStatistics *self);
+
+void cookie_permission_manager_statistics_reset(CookiePermissionManagerStatistics *self);
+
+void cookie_permission_manager_statistics_record(CookiePermissionManagerStatistics *self,
+													CookiePermissionManagerStatisticsTimer inTimer,
+													gint64 inStartTime);
+void cookie_permission_manager_statistics_count_outcome(CookiePermissionManagerStatistics *self,
+															CookiePermissionManagerStatisticsOutcome inOutcome);
+
+guint64 cookie_permission_manager_statistics_get_calls(CookiePermissionManagerStatistics *self,
+														CookiePermissionManagerStatisticsTimer inTimer);
+guint64 cookie_permission_manager_statistics_get_total_time(CookiePermissionManagerStatistics *self,
+															CookiePermissionManagerStatisticsTimer inTimer);
+guint64 cookie_permission_manager_statistics_get_max_time(CookiePermissionManagerStatistics *self,
+															CookiePermissionManagerStatisticsTimer inTimer);
+const guint64* cookie_permission_manager_statistics_get_histogram(CookiePermissionManagerStatistics *self,
+																	CookiePermissionManagerStatisticsTimer inTimer);
+guint64 cookie_permission_manager_statistics_get_percentile(CookiePermissionManagerStatistics *self,
+															CookiePermissionManagerStatisticsTimer inTimer,
+															guint inPercentile);
+guint64 cookie_permission_manager_statistics_get_outcomes(CookiePermissionManagerStatistics *self,
+															CookiePermissionManagerStatisticsOutcome inOutcome);
+
+const gchar* cookie_permission_manager_statistics_get_timer_name(CookiePermissionManagerStatisticsTimer inTimer);
+gchar* cookie_permission_manager_statistics_to_string(CookiePermissionManagerStatistics *self);
+
+G_END_DECLS
+
+#endif /* __COOKIE_PERMISSION_MANAGER_STATISTICS__ */
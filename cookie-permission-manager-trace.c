@@ -0,0 +1,518 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+/* Trace file format: magic bytes and version followed by records. Each record
+ * starts with its type. A segment record holds the magic bytes again and real time
+ * in microseconds when recording started and resets timestamp and string table.
+ * So reading can continue at next segment record after a corrupt one. An event record holds
+ * time since previous event, first-party host, cookie's domain, name and path and
+ * cookie's expiry. Numbers are stored as variable-length integers with seven bits
+ * per byte. A string is stored in full with its length the first time it is seen
+ * in a segment and by its index in string table afterwards.
+ */
+
+#include "cookie-permission-manager-trace.h"
+#include "cookie-permission-manager.h"
+
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Magic bytes at start of trace file */
+#define TRACE_MAGIC					"CPMT"
+#define TRACE_MAGIC_LENGTH			4
+
+/* Maximum number of strings in string table of a segment. Further strings are
+ * always stored in full.
+ */
+#define TRACE_MAX_STRINGS			65536
+
+/* Interval in microseconds to write buffered events to disk */
+#define TRACE_FLUSH_INTERVAL		G_USEC_PER_SEC
+
+/* Maximum size in bytes of trace file. If it is reached trace file is renamed
+ * by appending suffix, replacing the one renamed before, and recording goes on
+ * in a new trace file. So trace files never take more than twice this size.
+ */
+#define TRACE_MAX_SIZE				(64*1024*1024)
+#define TRACE_ROTATED_SUFFIX		".1"
+
+/* Type of segment record. Events use their source as record type. */
+#define TRACE_RECORD_SEGMENT		0
+
+struct _CookiePermissionManagerTraceWriter
+{
+	FILE			*file;
+	gchar			*filename;
+	gsize			size;
+	GHashTable		*strings;		/* String -> index in string table plus one */
+	gint64			lastTimestamp;
+	gint64			lastFlushTime;
+	gboolean		hasFailed;
+};
+
+struct _CookiePermissionManagerTraceReader
+{
+	GMappedFile		*file;
+	const guchar	*data;
+	gsize			length;
+	gsize			position;
+	GStringChunk	*strings;
+	GPtrArray		*table;			/* String table of current segment */
+	gint64			lastTimestamp;
+	gboolean		inSegment;
+	GArray			*skipped;		/* Ranges of corrupt or truncated records */
+};
+
+/* IMPLEMENTATION: Private variables and methods */
+
+/* Write bytes to trace file. Writing stops at first error. */
+static void _cookie_permission_manager_trace_writer_put(CookiePermissionManagerTraceWriter *self,
+														gconstpointer inData,
+														gsize inLength)
+{
+	if(self->hasFailed) return;
+
+	if(fwrite(inData, 1, inLength, self->file)!=inLength)
+	{
+		g_warning(_("Could not write trace file %s: %s"), self->filename, g_strerror(errno));
+		self->hasFailed=TRUE;
+		return;
+	}
+
+	self->size+=inLength;
+}
+
+/* Write number as variable-length integer */
+static void _cookie_permission_manager_trace_writer_put_number(CookiePermissionManagerTraceWriter *self, guint64 inValue)
+{
+	guchar		buffer[10];
+	gsize		length=0;
+
+	do
+	{
+		buffer[length]=inValue & 0x7f;
+		inValue>>=7;
+		if(inValue) buffer[length]|=0x80;
+		length++;
+	}
+	while(inValue);
+
+	_cookie_permission_manager_trace_writer_put(self, buffer, length);
+}
+
+/* Write string in full or as reference to string table if written before */
+static void _cookie_permission_manager_trace_writer_put_string(CookiePermissionManagerTraceWriter *self, const gchar *inString)
+{
+	gpointer	index;
+	gsize		length;
+
+	if(!inString) inString="";
+
+	index=g_hash_table_lookup(self->strings, inString);
+	if(index)
+	{
+		_cookie_permission_manager_trace_writer_put_number(self, (((guint64)(GPOINTER_TO_UINT(index)-1))<<1) | 1);
+		return;
+	}
+
+	length=strlen(inString);
+	_cookie_permission_manager_trace_writer_put_number(self, ((guint64)length)<<1);
+	_cookie_permission_manager_trace_writer_put(self, inString, length);
+
+	if(g_hash_table_size(self->strings)<TRACE_MAX_STRINGS)
+	{
+		g_hash_table_insert(self->strings,
+							g_strdup(inString),
+							GUINT_TO_POINTER(g_hash_table_size(self->strings)+1));
+	}
+}
+
+/* Write buffered events to disk */
+static void _cookie_permission_manager_trace_writer_flush(CookiePermissionManagerTraceWriter *self)
+{
+	self->lastFlushTime=g_get_monotonic_time();
+
+	if(!self->hasFailed && fflush(self->file)!=0)
+	{
+		g_warning(_("Could not write trace file %s: %s"), self->filename, g_strerror(errno));
+		self->hasFailed=TRUE;
+	}
+}
+
+/* Open trace file for appending and start a new segment with empty string table.
+ * Returns FALSE if file could not be opened.
+ */
+static gboolean _cookie_permission_manager_trace_writer_open(CookiePermissionManagerTraceWriter *self)
+{
+	guchar		byte;
+	glong		size;
+
+	self->file=g_fopen(self->filename, "ab");
+	if(!self->file)
+	{
+		g_warning(_("Could not open trace file %s: %s"), self->filename, g_strerror(errno));
+		return(FALSE);
+	}
+
+	size=(fseek(self->file, 0, SEEK_END)==0 ? ftell(self->file) : -1);
+	self->size=(gsize)MAX(size, 0);
+
+	/* Write header if file is new */
+	if(size==0)
+	{
+		byte=COOKIE_PERMISSION_TRACE_VERSION;
+		_cookie_permission_manager_trace_writer_put(self, TRACE_MAGIC, TRACE_MAGIC_LENGTH);
+		_cookie_permission_manager_trace_writer_put(self, &byte, 1);
+	}
+
+	/* Start segment */
+	g_hash_table_remove_all(self->strings);
+
+	byte=TRACE_RECORD_SEGMENT;
+	_cookie_permission_manager_trace_writer_put(self, &byte, 1);
+	_cookie_permission_manager_trace_writer_put(self, TRACE_MAGIC, TRACE_MAGIC_LENGTH);
+	_cookie_permission_manager_trace_writer_put_number(self, (guint64)MAX(self->lastTimestamp, 0));
+
+	return(TRUE);
+}
+
+/* Rename trace file which reached its maximum size and continue in a new one */
+static void _cookie_permission_manager_trace_writer_rotate(CookiePermissionManagerTraceWriter *self)
+{
+	gchar		*rotatedFilename;
+
+	_cookie_permission_manager_trace_writer_flush(self);
+	fclose(self->file);
+	self->file=NULL;
+
+	rotatedFilename=g_strconcat(self->filename, TRACE_ROTATED_SUFFIX, NULL);
+	g_remove(rotatedFilename);
+	if(g_rename(self->filename, rotatedFilename)!=0)
+	{
+		g_warning(_("Could not rename trace file %s: %s"), self->filename, g_strerror(errno));
+		self->hasFailed=TRUE;
+	}
+	g_free(rotatedFilename);
+
+	if(!self->hasFailed && !_cookie_permission_manager_trace_writer_open(self)) self->hasFailed=TRUE;
+}
+
+/* Read variable-length integer. Returns FALSE if trace file ends before. */
+static gboolean _cookie_permission_manager_trace_reader_get_number(CookiePermissionManagerTraceReader *self, guint64 *outValue)
+{
+	guint64		value=0;
+	guint		shift=0;
+	guchar		byte;
+
+	do
+	{
+		if(self->position>=self->length || shift>=64) return(FALSE);
+
+		byte=self->data[self->position++];
+		value|=((guint64)(byte & 0x7f))<<shift;
+		shift+=7;
+	}
+	while(byte & 0x80);
+
+	*outValue=value;
+	return(TRUE);
+}
+
+/* Read string stored in full or as reference to string table */
+static gboolean _cookie_permission_manager_trace_reader_get_string(CookiePermissionManagerTraceReader *self, const gchar **outString)
+{
+	guint64		value;
+	gchar		*string;
+
+	if(!_cookie_permission_manager_trace_reader_get_number(self, &value)) return(FALSE);
+
+	/* Reference to string seen before */
+	if(value & 1)
+	{
+		value>>=1;
+		if(value>=self->table->len) return(FALSE);
+
+		*outString=(const gchar*)g_ptr_array_index(self->table, value);
+		return(TRUE);
+	}
+
+	/* String in full */
+	value>>=1;
+	if(value>self->length-self->position) return(FALSE);
+
+	string=g_string_chunk_insert_len(self->strings, (const gchar*)(self->data+self->position), value);
+	self->position+=value;
+
+	if(self->table->len<TRACE_MAX_STRINGS) g_ptr_array_add(self->table, string);
+
+	*outString=string;
+	return(TRUE);
+}
+
+/* Read remaining part of a segment record */
+static gboolean _cookie_permission_manager_trace_reader_get_segment(CookiePermissionManagerTraceReader *self, guint64 *outTimestamp)
+{
+	if(self->length-self->position<TRACE_MAGIC_LENGTH ||
+		memcmp(self->data+self->position, TRACE_MAGIC, TRACE_MAGIC_LENGTH)!=0)
+	{
+		return(FALSE);
+	}
+
+	self->position+=TRACE_MAGIC_LENGTH;
+	return(_cookie_permission_manager_trace_reader_get_number(self, outTimestamp));
+}
+
+/* Skip corrupt or truncated record and everything after up to next segment record
+ * as string table is not known before. Adjacent skipped ranges are merged.
+ */
+static void _cookie_permission_manager_trace_reader_skip(CookiePermissionManagerTraceReader *self, gsize inRecordStart)
+{
+	CookiePermissionManagerTraceRange	range;
+	CookiePermissionManagerTraceRange	*lastRange;
+	gsize								position;
+
+	for(position=inRecordStart+1; position+TRACE_MAGIC_LENGTH<self->length; position++)
+	{
+		if(self->data[position]==TRACE_RECORD_SEGMENT &&
+			memcmp(self->data+position+1, TRACE_MAGIC, TRACE_MAGIC_LENGTH)==0)
+		{
+			break;
+		}
+	}
+	if(position+TRACE_MAGIC_LENGTH>=self->length) position=self->length;
+
+	lastRange=(self->skipped->len>0 ? &g_array_index(self->skipped, CookiePermissionManagerTraceRange, self->skipped->len-1) : NULL);
+	if(lastRange && lastRange->start+lastRange->length==inRecordStart) lastRange->length=position-lastRange->start;
+		else
+		{
+			range.start=inRecordStart;
+			range.length=position-inRecordStart;
+			g_array_append_val(self->skipped, range);
+		}
+
+	self->position=position;
+	self->inSegment=FALSE;
+}
+
+/* Read remaining part of an event record */
+static gboolean _cookie_permission_manager_trace_reader_get_event(CookiePermissionManagerTraceReader *self,
+																	CookiePermissionManagerTraceEvent *outEvent)
+{
+	guint64		delta, expires;
+
+	if(!_cookie_permission_manager_trace_reader_get_number(self, &delta) ||
+		!_cookie_permission_manager_trace_reader_get_string(self, &outEvent->firstParty) ||
+		!_cookie_permission_manager_trace_reader_get_string(self, &outEvent->domain) ||
+		!_cookie_permission_manager_trace_reader_get_string(self, &outEvent->name) ||
+		!_cookie_permission_manager_trace_reader_get_string(self, &outEvent->path) ||
+		!_cookie_permission_manager_trace_reader_get_number(self, &expires))
+	{
+		return(FALSE);
+	}
+
+	self->lastTimestamp+=(gint64)delta;
+	outEvent->timestamp=self->lastTimestamp;
+	outEvent->expires=(gint64)expires;
+
+	return(TRUE);
+}
+
+/* IMPLEMENTATION: Public API */
+
+/* Open trace file for appending events and start a new segment. Returns NULL
+ * if file could not be opened.
+ */
+CookiePermissionManagerTraceWriter* cookie_permission_manager_trace_writer_new(const gchar *inFilename)
+{
+	CookiePermissionManagerTraceWriter	*self;
+
+	g_return_val_if_fail(inFilename, NULL);
+
+	self=g_new0(CookiePermissionManagerTraceWriter, 1);
+	self->filename=g_strdup(inFilename);
+	self->strings=g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	self->lastTimestamp=g_get_real_time();
+	self->lastFlushTime=g_get_monotonic_time();
+	self->hasFailed=FALSE;
+
+	if(!_cookie_permission_manager_trace_writer_open(self))
+	{
+		g_hash_table_destroy(self->strings);
+		g_free(self->filename);
+		g_free(self);
+		return(NULL);
+	}
+
+	return(self);
+}
+
+/* Write all buffered events and close trace file */
+void cookie_permission_manager_trace_writer_free(CookiePermissionManagerTraceWriter *self)
+{
+	g_return_if_fail(self);
+
+	if(self->file)
+	{
+		_cookie_permission_manager_trace_writer_flush(self);
+		fclose(self->file);
+	}
+
+	g_hash_table_destroy(self->strings);
+	g_free(self->filename);
+	g_free(self);
+}
+
+/* Append event to trace file */
+void cookie_permission_manager_trace_writer_append(CookiePermissionManagerTraceWriter *self,
+													const CookiePermissionManagerTraceEvent *inEvent)
+{
+	guchar		byte;
+
+	g_return_if_fail(self);
+	g_return_if_fail(inEvent);
+	g_return_if_fail(inEvent->source==COOKIE_PERMISSION_MANAGER_TRACE_SOURCE_RESPONSE ||
+						inEvent->source==COOKIE_PERMISSION_MANAGER_TRACE_SOURCE_SCRIPT);
+
+	if(!self->hasFailed && self->size>=TRACE_MAX_SIZE) _cookie_permission_manager_trace_writer_rotate(self);
+	if(self->hasFailed) return;
+
+	/* Time does not go backwards in trace even if system clock does */
+	byte=inEvent->source;
+	_cookie_permission_manager_trace_writer_put(self, &byte, 1);
+	_cookie_permission_manager_trace_writer_put_number(self, (guint64)MAX(inEvent->timestamp-self->lastTimestamp, 0));
+	self->lastTimestamp=MAX(self->lastTimestamp, inEvent->timestamp);
+
+	_cookie_permission_manager_trace_writer_put_string(self, inEvent->firstParty);
+	_cookie_permission_manager_trace_writer_put_string(self, inEvent->domain);
+	_cookie_permission_manager_trace_writer_put_string(self, inEvent->name);
+	_cookie_permission_manager_trace_writer_put_string(self, inEvent->path);
+	_cookie_permission_manager_trace_writer_put_number(self, (guint64)MAX(inEvent->expires, 0));
+
+	if(g_get_monotonic_time()-self->lastFlushTime>=TRACE_FLUSH_INTERVAL)
+	{
+		_cookie_permission_manager_trace_writer_flush(self);
+	}
+}
+
+/* Open trace file for reading. Returns NULL if it could not be opened or is
+ * not a trace file.
+ */
+CookiePermissionManagerTraceReader* cookie_permission_manager_trace_reader_new(const gchar *inFilename)
+{
+	CookiePermissionManagerTraceReader	*self;
+	GMappedFile							*file;
+	GError								*error=NULL;
+	const guchar						*data;
+	gsize								length;
+
+	g_return_val_if_fail(inFilename, NULL);
+
+	file=g_mapped_file_new(inFilename, FALSE, &error);
+	if(!file)
+	{
+		g_warning(_("Could not open trace file %s: %s"), inFilename, error->message);
+		g_error_free(error);
+		return(NULL);
+	}
+
+	data=(const guchar*)g_mapped_file_get_contents(file);
+	length=g_mapped_file_get_length(file);
+	if(length<TRACE_MAGIC_LENGTH+1 ||
+		memcmp(data, TRACE_MAGIC, TRACE_MAGIC_LENGTH)!=0 ||
+		data[TRACE_MAGIC_LENGTH]!=COOKIE_PERMISSION_TRACE_VERSION)
+	{
+		g_warning(_("Not a trace file of a supported version: %s"), inFilename);
+		g_mapped_file_unref(file);
+		return(NULL);
+	}
+
+	self=g_new0(CookiePermissionManagerTraceReader, 1);
+	self->file=file;
+	self->data=data;
+	self->length=length;
+	self->position=TRACE_MAGIC_LENGTH+1;
+	self->strings=g_string_chunk_new(4096);
+	self->table=g_ptr_array_new();
+	self->lastTimestamp=0;
+	self->inSegment=FALSE;
+	self->skipped=g_array_new(FALSE, FALSE, sizeof(CookiePermissionManagerTraceRange));
+
+	return(self);
+}
+
+/* Close trace file and release strings of all events read */
+void cookie_permission_manager_trace_reader_free(CookiePermissionManagerTraceReader *self)
+{
+	g_return_if_fail(self);
+
+	g_mapped_file_unref(self->file);
+	g_string_chunk_free(self->strings);
+	g_ptr_array_free(self->table, TRUE);
+	g_array_free(self->skipped, TRUE);
+	g_free(self);
+}
+
+/* Read next event. Corrupt or truncated records are skipped up to next segment.
+ * Returns FALSE at end of trace file.
+ */
+gboolean cookie_permission_manager_trace_reader_next(CookiePermissionManagerTraceReader *self,
+														CookiePermissionManagerTraceEvent *outEvent)
+{
+	gsize		recordStart;
+	guchar		type;
+	guint64		timestamp;
+
+	g_return_val_if_fail(self, FALSE);
+	g_return_val_if_fail(outEvent, FALSE);
+
+	while(self->position<self->length)
+	{
+		recordStart=self->position;
+		type=self->data[self->position++];
+
+		/* New segment starts with empty string table */
+		if(type==TRACE_RECORD_SEGMENT &&
+			_cookie_permission_manager_trace_reader_get_segment(self, &timestamp))
+		{
+			self->lastTimestamp=(gint64)timestamp;
+			g_ptr_array_set_size(self->table, 0);
+			self->inSegment=TRUE;
+			continue;
+		}
+
+		if(self->inSegment &&
+			(type==COOKIE_PERMISSION_MANAGER_TRACE_SOURCE_RESPONSE || type==COOKIE_PERMISSION_MANAGER_TRACE_SOURCE_SCRIPT) &&
+			_cookie_permission_manager_trace_reader_get_event(self, outEvent))
+		{
+			outEvent->source=type;
+			return(TRUE);
+		}
+
+		/* Events written before a crash may be truncated and recording went on
+		 * in a new segment afterwards so keep all events before and after
+		 */
+		_cookie_permission_manager_trace_reader_skip(self, recordStart);
+	}
+
+	return(FALSE);
+}
+
+/* Get byte ranges of trace file skipped as corrupt or truncated so far */
+const CookiePermissionManagerTraceRange* cookie_permission_manager_trace_reader_get_skipped(CookiePermissionManagerTraceReader *self, guint *outCount)
+{
+	g_return_val_if_fail(self, NULL);
+	g_return_val_if_fail(outCount, NULL);
+
+	*outCount=self->skipped->len;
+	return((const CookiePermissionManagerTraceRange*)self->skipped->data);
+}
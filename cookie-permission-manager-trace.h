@@ -0,0 +1,82 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+#ifndef __COOKIE_PERMISSION_MANAGER_TRACE__
+#define __COOKIE_PERMISSION_MANAGER_TRACE__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Version of trace file format written after its magic bytes */
+#define COOKIE_PERMISSION_TRACE_VERSION		2
+
+/* Sources of recorded cookies */
+typedef enum
+{
+	COOKIE_PERMISSION_MANAGER_TRACE_SOURCE_RESPONSE=1,
+	COOKIE_PERMISSION_MANAGER_TRACE_SOURCE_SCRIPT
+} CookiePermissionManagerTraceSource;
+
+/* A cookie which was about to be stored. Strings are never NULL. Cookies of
+ * same response share their timestamp.
+ */
+typedef struct _CookiePermissionManagerTraceEvent		CookiePermissionManagerTraceEvent;
+
+struct _CookiePermissionManagerTraceEvent
+{
+	gint64								timestamp;		/* Real time in microseconds */
+	CookiePermissionManagerTraceSource	source;
+	const gchar							*firstParty;	/* Empty if unknown */
+	const gchar							*domain;
+	const gchar							*name;
+	const gchar							*path;
+	gint64								expires;		/* Seconds since epoch or zero for session cookies */
+};
+
+/* Appends events to a trace file. Each writer starts a new segment in file so
+ * traces of several sessions can be recorded into same file. Events are buffered
+ * and written to disk at most once per second and when writer is freed. If trace
+ * file grows too large it is renamed by appending ".1" and a new one is started.
+ */
+typedef struct _CookiePermissionManagerTraceWriter		CookiePermissionManagerTraceWriter;
+
+CookiePermissionManagerTraceWriter* cookie_permission_manager_trace_writer_new(const gchar *inFilename);
+void cookie_permission_manager_trace_writer_free(CookiePermissionManagerTraceWriter *self);
+
+void cookie_permission_manager_trace_writer_append(CookiePermissionManagerTraceWriter *self,
+													const CookiePermissionManagerTraceEvent *inEvent);
+
+/* Reads events of a trace file in order they were recorded. Strings of an
+ * event are owned by reader and valid until reader is freed. Corrupt or truncated
+ * records, e.g. written before a crash, are skipped up to the next segment and
+ * the byte ranges skipped are reported.
+ */
+typedef struct _CookiePermissionManagerTraceReader		CookiePermissionManagerTraceReader;
+
+typedef struct _CookiePermissionManagerTraceRange		CookiePermissionManagerTraceRange;
+
+struct _CookiePermissionManagerTraceRange
+{
+	gsize								start;			/* Offset in trace file */
+	gsize								length;
+};
+
+CookiePermissionManagerTraceReader* cookie_permission_manager_trace_reader_new(const gchar *inFilename);
+void cookie_permission_manager_trace_reader_free(CookiePermissionManagerTraceReader *self);
+
+gboolean cookie_permission_manager_trace_reader_next(CookiePermissionManagerTraceReader *self,
+														CookiePermissionManagerTraceEvent *outEvent);
+const CookiePermissionManagerTraceRange* cookie_permission_manager_trace_reader_get_skipped(CookiePermissionManagerTraceReader *self, guint *outCount);
+
+G_END_DECLS
+
+#endif /* __COOKIE_PERMISSION_MANAGER_TRACE__ */
@@ -0,0 +1,262 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+#include "cookie-permission-manager-write-queue.h"
+#include "cookie-permission-manager-database.h"
+#include "cookie-permission-manager.h"
+
+/* Time in milliseconds to wait for further decisions before writing queued ones */
+#define WRITE_QUEUE_DELAY			250
+
+typedef struct _CookiePermissionManagerWriteQueueEntry		CookiePermissionManagerWriteQueueEntry;
+
+struct _CookiePermissionManagerWriteQueueEntry
+{
+	gchar			*domain;
+	gint			policy;
+};
+
+struct _CookiePermissionManagerWriteQueue
+{
+	sqlite3										*database;
+	CookiePermissionManagerStatementRegistry	*statements;
+	GThread										*thread;
+
+	GMutex			lock;			/* Protects all fields below */
+	GCond			changed;		/* Signalled when entries were queued or written */
+	GHashTable		*pending;		/* Domain key -> entry not written yet */
+	GHashTable		*writing;		/* Domain key -> entry currently written by thread */
+	gint			flushRequests;
+	gboolean		quit;
+};
+
+/* IMPLEMENTATION: Private variables and methods */
+
+/* Release an entry of queue */
+static void _cookie_permission_manager_write_queue_entry_free(CookiePermissionManagerWriteQueueEntry *inEntry)
+{
+	g_free(inEntry->domain);
+	g_slice_free(CookiePermissionManagerWriteQueueEntry, inEntry);
+}
+
+/* Create hash-table for queued entries */
+static GHashTable* _cookie_permission_manager_write_queue_new_entries(void)
+{
+	return(g_hash_table_new_full(g_str_hash,
+									g_str_equal,
+									g_free,
+									(GDestroyNotify)_cookie_permission_manager_write_queue_entry_free));
+}
+
+/* Write all entries in one transaction */
+static void _cookie_permission_manager_write_queue_write(CookiePermissionManagerWriteQueue *self, GHashTable *inEntries)
+{
+	GHashTableIter								iter;
+	CookiePermissionManagerWriteQueueEntry		*entry;
+	gint										success;
+
+	success=cookie_permission_manager_database_begin(self->statements);
+
+	g_hash_table_iter_init(&iter, inEntries);
+	while(success==SQLITE_OK && g_hash_table_iter_next(&iter, NULL, (gpointer*)&entry))
+	{
+		if(entry->policy==COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED)
+		{
+			success=cookie_permission_manager_database_remove_policy(self->statements, entry->domain);
+		}
+			else success=cookie_permission_manager_database_set_policy(self->statements, entry->domain, entry->policy);
+	}
+
+	if(success==SQLITE_OK) success=cookie_permission_manager_database_commit(self->statements);
+
+	if(success!=SQLITE_OK)
+	{
+		g_warning(_("SQL fails: %s"), sqlite3_errmsg(self->database));
+		cookie_permission_manager_database_rollback(self->statements);
+	}
+}
+
+/* Thread writing queued entries to database */
+static gpointer _cookie_permission_manager_write_queue_thread(gpointer inUserData)
+{
+	CookiePermissionManagerWriteQueue		*self=(CookiePermissionManagerWriteQueue*)inUserData;
+	gint64									deadline;
+
+	g_mutex_lock(&self->lock);
+	for(;;)
+	{
+		/* Wait for entries to write */
+		while(!self->quit && g_hash_table_size(self->pending)==0) g_cond_wait(&self->changed, &self->lock);
+		if(g_hash_table_size(self->pending)==0) break;
+
+		/* Give further decisions a chance to be written in same transaction
+		 * unless someone waits for queue to be written
+		 */
+		deadline=g_get_monotonic_time()+WRITE_QUEUE_DELAY*G_TIME_SPAN_MILLISECOND;
+		while(!self->quit && self->flushRequests==0)
+		{
+			if(!g_cond_wait_until(&self->changed, &self->lock, deadline)) break;
+		}
+
+		/* Take over pending entries and write them without holding lock
+		 * so decisions can still be queued and looked up meanwhile
+		 */
+		self->writing=self->pending;
+		self->pending=_cookie_permission_manager_write_queue_new_entries();
+		g_mutex_unlock(&self->lock);
+
+		_cookie_permission_manager_write_queue_write(self, self->writing);
+
+		g_mutex_lock(&self->lock);
+		g_hash_table_destroy(self->writing);
+		self->writing=NULL;
+		g_cond_broadcast(&self->changed);
+	}
+	g_mutex_unlock(&self->lock);
+
+	return(NULL);
+}
+
+/* IMPLEMENTATION: Public API */
+
+/* Create new queue writing to database file using durability profile.
+ * Returns NULL if database could not be opened.
+ */
+CookiePermissionManagerWriteQueue* cookie_permission_manager_write_queue_new(const gchar *inDatabaseFilename, gint inDurability)
+{
+	CookiePermissionManagerWriteQueue		*self;
+	sqlite3									*database=NULL;
+	gchar									*error=NULL;
+
+	g_return_val_if_fail(inDatabaseFilename, NULL);
+
+	/* Open own connection to database as connections must not be used by
+	 * more than one thread at the same time
+	 */
+	if(sqlite3_open(inDatabaseFilename, &database)!=SQLITE_OK)
+	{
+		g_warning(_("Could not open database of extenstion: %s"), sqlite3_errmsg(database));
+
+		if(database) sqlite3_close(database);
+		return(NULL);
+	}
+
+	if(cookie_permission_manager_database_set_durability(database, inDurability, &error)!=SQLITE_OK)
+	{
+		g_warning(_("Failed to execute database statement: %s"), error);
+		sqlite3_free(error);
+	}
+
+	/* Set up queue and start thread */
+	self=g_new0(CookiePermissionManagerWriteQueue, 1);
+	self->database=database;
+	self->statements=cookie_permission_manager_statement_registry_new(database);
+	self->pending=_cookie_permission_manager_write_queue_new_entries();
+	self->writing=NULL;
+	self->flushRequests=0;
+	self->quit=FALSE;
+	g_mutex_init(&self->lock);
+	g_cond_init(&self->changed);
+
+	self->thread=g_thread_new("cookie-permission-writer", _cookie_permission_manager_write_queue_thread, self);
+
+	return(self);
+}
+
+/* Write all queued entries, stop thread and release queue */
+void cookie_permission_manager_write_queue_free(CookiePermissionManagerWriteQueue *self)
+{
+	g_return_if_fail(self);
+
+	/* Tell thread to write all pending entries and to quit then */
+	g_mutex_lock(&self->lock);
+	self->quit=TRUE;
+	g_cond_broadcast(&self->changed);
+	g_mutex_unlock(&self->lock);
+
+	g_thread_join(self->thread);
+
+	/* Release allocated resources */
+	g_hash_table_destroy(self->pending);
+	g_cond_clear(&self->changed);
+	g_mutex_clear(&self->lock);
+
+	cookie_permission_manager_statement_registry_free(self->statements);
+	sqlite3_close(self->database);
+
+	g_free(self);
+}
+
+/* Queue policy of domain to write */
+void cookie_permission_manager_write_queue_push(CookiePermissionManagerWriteQueue *self, const gchar *inDomain, gint inPolicy)
+{
+	CookiePermissionManagerWriteQueueEntry		*entry;
+
+	g_return_if_fail(self);
+	g_return_if_fail(inDomain);
+
+	entry=g_slice_new(CookiePermissionManagerWriteQueueEntry);
+	entry->domain=g_strdup(inDomain);
+	entry->policy=inPolicy;
+
+	g_mutex_lock(&self->lock);
+	g_hash_table_replace(self->pending, cookie_permission_manager_database_get_domain_key(inDomain, NULL), entry);
+	g_cond_broadcast(&self->changed);
+	g_mutex_unlock(&self->lock);
+}
+
+/* Check if policy of domain key (or its prefix of given length) is queued but
+ * not written yet. Policy returned may be COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED
+ * if policy of domain is going to be removed.
+ */
+gboolean cookie_permission_manager_write_queue_lookup(CookiePermissionManagerWriteQueue *self,
+														const gchar *inKey,
+														gssize inLength,
+														gint *outPolicy)
+{
+	CookiePermissionManagerWriteQueueEntry		*entry=NULL;
+	gchar										*key;
+
+	g_return_val_if_fail(self, FALSE);
+	g_return_val_if_fail(inKey, FALSE);
+
+	key=(inLength<0 ? g_strdup(inKey) : g_strndup(inKey, inLength));
+
+	g_mutex_lock(&self->lock);
+
+	/* Newer decisions not taken over by thread yet take precedence */
+	entry=g_hash_table_lookup(self->pending, key);
+	if(!entry && self->writing) entry=g_hash_table_lookup(self->writing, key);
+	if(entry && outPolicy) *outPolicy=entry->policy;
+
+	g_mutex_unlock(&self->lock);
+
+	g_free(key);
+
+	return(entry!=NULL);
+}
+
+/* Block until all queued entries are written to database */
+void cookie_permission_manager_write_queue_flush(CookiePermissionManagerWriteQueue *self)
+{
+	g_return_if_fail(self);
+
+	g_mutex_lock(&self->lock);
+
+	self->flushRequests++;
+	g_cond_broadcast(&self->changed);
+
+	while(g_hash_table_size(self->pending)>0 || self->writing) g_cond_wait(&self->changed, &self->lock);
+
+	self->flushRequests--;
+
+	g_mutex_unlock(&self->lock);
+}
@@ -0,0 +1,41 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+#ifndef __COOKIE_PERMISSION_MANAGER_WRITE_QUEUE__
+#define __COOKIE_PERMISSION_MANAGER_WRITE_QUEUE__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Write-behind queue of policy decisions. Decisions pushed to queue are written
+ * to database by a background thread using its own database connection. All
+ * decisions queued within a short time are written in one transaction. A later
+ * decision for the same domain replaces an earlier one not written yet.
+ * Setting policy to COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED removes the
+ * policy of domain from database.
+ */
+typedef struct _CookiePermissionManagerWriteQueue		CookiePermissionManagerWriteQueue;
+
+CookiePermissionManagerWriteQueue* cookie_permission_manager_write_queue_new(const gchar *inDatabaseFilename, gint inDurability);
+void cookie_permission_manager_write_queue_free(CookiePermissionManagerWriteQueue *self);
+
+void cookie_permission_manager_write_queue_push(CookiePermissionManagerWriteQueue *self, const gchar *inDomain, gint inPolicy);
+gboolean cookie_permission_manager_write_queue_lookup(CookiePermissionManagerWriteQueue *self,
+														const gchar *inKey,
+														gssize inLength,
+														gint *outPolicy);
+
+void cookie_permission_manager_write_queue_flush(CookiePermissionManagerWriteQueue *self);
+
+G_END_DECLS
+
+#endif /* __COOKIE_PERMISSION_MANAGER_WRITE_QUEUE__ */
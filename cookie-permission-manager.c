@@ -10,12 +10,30 @@
 */
 
 #include "cookie-permission-manager.h"
+#include "cookie-permission-manager-domain-trie.h"
+#include "cookie-permission-manager-database.h"
+#include "cookie-permission-manager-pattern-matcher.h"
+#include "cookie-permission-manager-policy-cache.h"
+#include "cookie-permission-manager-policy-engine.h"
+#include "cookie-permission-manager-policy-snapshot.h"
+#include "cookie-permission-manager-public-suffix.h"
+#include "cookie-permission-manager-trace.h"
+#include "cookie-permission-manager-write-queue.h"
 
 #include <errno.h>
 
 /* Remove next line if we found a way to show details in infobar */
 #define NO_INFOBAR_DETAILS
 
+/* Interval in seconds to checkpoint write-ahead log in memory-first durability mode */
+#define CHECKPOINT_INTERVAL			30
+
+/* Maximum number of undetermined cookies queued per prompt while waiting for
+ * user's decision. Further cookies are denied this time like cookies of a prompt
+ * the user did not answer in time.
+ */
+#define PENDING_PROMPT_MAX_COOKIES	128
+
 /* Define this class in GObject system */
 G_DEFINE_TYPE(CookiePermissionManager,
 				cookie_permission_manager,
@@ -32,12 +50,34 @@ enum
 	PROP_DATABASE,
 	PROP_DATABASE_FILENAME,
 	PROP_ASK_FOR_UNKNOWN_POLICY,
+	PROP_MEMORY_BUDGET,
+	PROP_SAVED_LOOKUPS,
+	PROP_SKIPPED_EVALUATIONS,
+	PROP_STATISTICS,
+	PROP_GROUP_BY_REGISTRABLE_DOMAIN,
+	PROP_DURABILITY,
+	PROP_ASK_ASYNCHRONOUSLY,
+	PROP_PROMPT_TIMEOUT,
+	PROP_RECORD_TRACE,
 
 	PROP_LAST
 };
 
 static GParamSpec* CookiePermissionManagerProperties[PROP_LAST]={ 0, };
 
+/* Class handler of cookie jar's "changed" signal replaced while manager is active */
+static void (*CookiePermissionManagerCookieJarChanged)(SoupCookieJar*, SoupCookie*, SoupCookie*)=NULL;
+
+/* Signals */
+enum
+{
+	SIGNAL_POLICY_CHANGED,
+
+	SIGNAL_LAST
+};
+
+static guint CookiePermissionManagerSignals[SIGNAL_LAST]={ 0, };
+
 /* Private structure - access only by public API if needed */
 #define COOKIE_PERMISSION_MANAGER_GET_PRIVATE(obj) \
 	(G_TYPE_INSTANCE_GET_PRIVATE((obj), TYPE_COOKIE_PERMISSION_MANAGER, CookiePermissionManagerPrivate))
@@ -48,14 +88,38 @@ struct _CookiePermissionManagerPrivate
 	MidoriExtension					*extension;
 	MidoriApp						*application;
 	sqlite3							*database;
+	CookiePermissionManagerStatementRegistry	*statements;
+	CookiePermissionManagerWriteQueue	*writeQueue;
 	gchar							*databaseFilename;
 	gboolean						askForUnknownPolicy;
+	guint							memoryBudget;
+	guint64							savedLookups;
+	guint64							skippedEvaluations;
+	CookiePermissionManagerStatistics	*statistics;
+	gboolean						groupByRegistrableDomain;
+	CookiePermissionManagerDurability	durability;
+	guint							checkpointID;
+	gboolean						askAsynchronously;
+	guint							promptTimeout;
+	GSList							*pendingPrompts;
+	GHashTable						*inFlightDecisions;
+	GHashTable						*filteredMessages;
+	CookiePermissionManagerTraceWriter	*traceWriter;
+
+	/* Policy related */
+	CookiePermissionManagerPolicySnapshotSlot	*snapshots;
+	CookiePermissionManagerPolicySnapshot	*policyDraft;
+	CookiePermissionManagerPolicyCache	*policyCache;
+	CookiePermissionManagerBloomFilter	*policyFilter;
+	GHashTable						*sessionPolicies;
+	gboolean						sessionPoliciesChanged;
 
 	/* Cookie jar related */
 	SoupSession						*session;
 	SoupCookieJar					*cookieJar;
 	SoupSessionFeatureInterface		*featureIface;
-	gint							cookieJarChangedID;
+	gboolean						isRejectingCookie;
+	guint							ownChangesDepth;
 };
 
 enum
@@ -76,6 +140,35 @@ struct _CookiePermissionManagerModalInfobar
 
 typedef struct _CookiePermissionManagerModalInfobar		CookiePermissionManagerModalInfobar;
 
+struct _CookiePermissionManagerPendingPrompt
+{
+	CookiePermissionManager			*manager;
+	WebKitWebView					*webkitView;
+	GtkWidget						*infobar;
+	GSList							*cookies;		/* Queued cookies in reverse order */
+	guint							numberCookies;
+	guint							timeoutID;
+	gint64							shownTime;
+	GSList							*attachments;	/* Cookies queued here by other views */
+};
+
+typedef struct _CookiePermissionManagerPendingPrompt	CookiePermissionManagerPendingPrompt;
+
+struct _CookiePermissionManagerPendingAttachment
+{
+	MidoriView						*view;			/* Weak pointer to view cookies were received at */
+	GSList							*cookies;		/* Cookies also queued at prompt in reverse order */
+};
+
+typedef struct _CookiePermissionManagerPendingAttachment	CookiePermissionManagerPendingAttachment;
+
+/* Cookies attached to a prompt which is closed without decision are queued
+ * again at the view they were received at
+ */
+static void _cookie_permission_manager_queue_for_policy(CookiePermissionManager *self,
+														MidoriView *inView,
+														GSList *inUnknownCookies);
+
 /* IMPLEMENTATION: Private variables and methods */
 
 /* Show common error dialog */
@@ -106,345 +199,1101 @@ static void _cookie_permission_manager_error(CookiePermissionManager *self, cons
 	gtk_widget_destroy(dialog);
 }
 
-/* Open database containing policies for cookie domains.
- * Create database and setup table structure if it does not exist yet.
+/* Get snapshot of policies to change. Changes are seen by other threads
+ * not before snapshot is published.
  */
-static void _cookie_permission_manager_open_database(CookiePermissionManager *self)
+static CookiePermissionManagerPolicySnapshot* _cookie_permission_manager_edit_policies(CookiePermissionManager *self)
 {
 	CookiePermissionManagerPrivate	*priv=self->priv;
-	const gchar						*configDir;
-	gchar							*error=NULL;
-	gint							success;
-	sqlite3_stmt					*statement=NULL;
 
-	/* Close any open database */
-	if(priv->database)
+	if(!priv->policyDraft)
 	{
-		g_free(priv->databaseFilename);
-		priv->databaseFilename=NULL;
+		priv->policyDraft=cookie_permission_manager_policy_snapshot_copy(cookie_permission_manager_policy_snapshot_slot_get(priv->snapshots));
+	}
 
-		sqlite3_close(priv->database);
-		priv->database=NULL;
+	return(priv->policyDraft);
+}
 
-		g_object_notify_by_pspec(G_OBJECT(self), CookiePermissionManagerProperties[PROP_DATABASE]);
-		g_object_notify_by_pspec(G_OBJECT(self), CookiePermissionManagerProperties[PROP_DATABASE_FILENAME]);
-	}
+/* Get snapshot of policies held in memory at main thread including changes
+ * not published yet. Changes of session tier are collected and copied into
+ * snapshot not before it is needed.
+ */
+static CookiePermissionManagerPolicySnapshot* _cookie_permission_manager_get_policy_snapshot(CookiePermissionManager *self)
+{
+	CookiePermissionManagerPrivate	*priv=self->priv;
 
-	/* Build path to database file */
-	configDir=midori_extension_get_config_dir(priv->extension);
-	if(!configDir)
+	if(priv->sessionPoliciesChanged)
 	{
-		g_warning(_("Could not get path to configuration of extension: path is NULL"));
-
-		_cookie_permission_manager_error(self, _("Could not get path to configuration of extension."));
-		return;
+		cookie_permission_manager_policy_snapshot_set_session_domains(_cookie_permission_manager_edit_policies(self), priv->sessionPolicies);
+		priv->sessionPoliciesChanged=FALSE;
 	}
-	
-	if(katze_mkdir_with_parents(configDir, 0700))
-	{
-		g_warning(_("Could not create configuration folder for extension: %s"), g_strerror(errno));
 
-		_cookie_permission_manager_error(self, _("Could not create configuration folder for extension."));
-		return;
-	}
+	if(priv->policyDraft) return(priv->policyDraft);
+	return(cookie_permission_manager_policy_snapshot_slot_get(priv->snapshots));
+}
 
-	/* Open database */
-	priv->databaseFilename=g_build_filename(configDir, COOKIE_PERMISSION_DATABASE, NULL);
-	success=sqlite3_open(priv->databaseFilename, &priv->database);
-	if(success!=SQLITE_OK)
-	{
-		g_warning(_("Could not open database of extenstion: %s"), sqlite3_errmsg(priv->database));
+/* Publish changed policies to all threads */
+static void _cookie_permission_manager_publish_policies(CookiePermissionManager *self)
+{
+	CookiePermissionManagerPrivate	*priv=self->priv;
 
-		g_free(priv->databaseFilename);
-		priv->databaseFilename=NULL;
+	/* Changes of session tier are copied into draft before */
+	_cookie_permission_manager_get_policy_snapshot(self);
+	if(!priv->policyDraft) return;
 
-		if(priv->database) sqlite3_close(priv->database);
-		priv->database=NULL;
+	cookie_permission_manager_policy_snapshot_slot_publish(priv->snapshots, priv->policyDraft);
+	priv->policyDraft=NULL;
+}
 
-		_cookie_permission_manager_error(self, _("Could not open database of extension."));
-		return;
-	}
+/* Replace all policies held in memory and publish them at once. The trie of
+ * domains and the pattern matcher may be NULL and are owned by snapshot afterwards.
+ * The ones replaced are released when no other thread can use them anymore.
+ * Policies of session tier are kept.
+ */
+static void _cookie_permission_manager_replace_policies(CookiePermissionManager *self,
+														CookiePermissionManagerDomainTrie *inPolicies,
+														CookiePermissionManagerPatternMatcher *inPatterns)
+{
+	cookie_permission_manager_policy_snapshot_replace(_cookie_permission_manager_edit_policies(self), inPolicies, inPatterns);
+	_cookie_permission_manager_publish_policies(self);
+}
 
-	/* Create table structure if it does not exist */
-	success=sqlite3_exec(priv->database,
-							"CREATE TABLE IF NOT EXISTS "
-							"policies(domain text, value integer);",
-							NULL,
-							NULL,
-							&error);
+/* Release all policies held in memory */
+static void _cookie_permission_manager_release_policies(CookiePermissionManager *self)
+{
+	CookiePermissionManagerPrivate	*priv=self->priv;
 
-	if(success==SQLITE_OK)
-	{
-		success=sqlite3_exec(priv->database,
-								"CREATE UNIQUE INDEX IF NOT EXISTS "
-								"domain ON policies (domain);",
-								NULL,
-								NULL,
-								&error);
-	}
+	if(priv->policyCache) cookie_permission_manager_policy_cache_free(priv->policyCache);
+	priv->policyCache=NULL;
 
-	if(success==SQLITE_OK)
-	{
-		success=sqlite3_exec(priv->database,
-								"PRAGMA journal_mode=TRUNCATE;",
-								NULL,
-								NULL,
-								&error);
-	}
+	if(priv->policyFilter) cookie_permission_manager_bloom_filter_free(priv->policyFilter);
+	priv->policyFilter=NULL;
 
-	if(success!=SQLITE_OK || error)
-	{
-		_cookie_permission_manager_error(self, _("Could not set up database structure of extension."));
+	_cookie_permission_manager_replace_policies(self, NULL, NULL);
+}
 
-		if(error)
-		{
-			g_critical(_("Failed to execute database statement: %s"), error);
-			sqlite3_free(error);
-		}
+/* Load all policies of domain patterns from database and compile them into
+ * pattern matcher. Patterns are always held in memory regardless of memory budget
+ * as they cannot be looked up in database by domain key.
+ */
+static CookiePermissionManagerPatternMatcher* _cookie_permission_manager_load_patterns(CookiePermissionManager *self)
+{
+	CookiePermissionManagerPrivate	*priv=self->priv;
+	CookiePermissionManagerPatternMatcher	*patterns;
+	gint							success;
+	sqlite3_stmt					*statement=NULL;
+	gint64							startTime;
 
-		g_free(priv->databaseFilename);
-		priv->databaseFilename=NULL;
+	startTime=g_get_monotonic_time();
 
-		sqlite3_close(priv->database);
-		priv->database=NULL;
-		return;
+	statement=cookie_permission_manager_statement_registry_get(priv->statements, COOKIE_PERMISSION_MANAGER_STATEMENT_SELECT_ALL_PATTERNS);
+	if(!statement)
+	{
+		g_warning(_("SQL fails: %s"), sqlite3_errmsg(priv->database));
+		return(NULL);
 	}
 
-	// Delete all cookies allowed only in one session
-	success=sqlite3_prepare_v2(priv->database,
-								"SELECT domain FROM policies WHERE value=? ORDER BY domain DESC;",
-								-1,
-								&statement,
-								NULL);
-	if(statement && success==SQLITE_OK) success=sqlite3_bind_int(statement, 1, COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION);
-	if(statement && success==SQLITE_OK)
+	patterns=cookie_permission_manager_pattern_matcher_new();
+
+	while((success=sqlite3_step(statement))==SQLITE_ROW)
 	{
-		while(sqlite3_step(statement)==SQLITE_ROW)
-		{
-			gchar		*domain=(gchar*)sqlite3_column_text(statement, 0);
-			GSList		*cookies, *cookie;
+		cookie_permission_manager_pattern_matcher_insert(patterns,
+															(gchar*)sqlite3_column_text(statement, 0),
+															sqlite3_column_int(statement, 1));
+	}
 
-#ifdef HAVE_LIBSOUP_2_40_0
-			SoupURI		*uri;
+	if(success!=SQLITE_DONE) g_warning(_("SQL fails: %s"), sqlite3_errmsg(priv->database));
 
-			uri=soup_uri_new(NULL);
-			soup_uri_set_host(uri, domain);
-			cookies=soup_cookie_jar_get_cookie_list(priv->cookieJar, uri, TRUE);
-			for(cookie=cookies; cookie; cookie->next)
-			{
-				soup_cookie_jar_delete_cookie(priv->cookieJar, (SoupCookie*)cookie->data);
-			}
-			soup_cookies_free(cookies);
-			soup_uri_free(uri);
-#else
-			cookies=soup_cookie_jar_all_cookies(priv->cookieJar);
-			for(cookie=cookies; cookie; cookie=cookie->next)
-			{
-				if(soup_cookie_domain_matches((SoupCookie*)cookie->data, domain))
-				{
-					soup_cookie_jar_delete_cookie(priv->cookieJar, (SoupCookie*)cookie->data);
-				}
-			}
-			soup_cookies_free(cookies);
-#endif
-		}
-	}
-		else g_warning(_("SQL fails: %s"), sqlite3_errmsg(priv->database));
+	cookie_permission_manager_pattern_matcher_compile(patterns);
 
-	sqlite3_finalize(statement);
+	sqlite3_reset(statement);
 
-	g_object_notify_by_pspec(G_OBJECT(self), CookiePermissionManagerProperties[PROP_DATABASE]);
-	g_object_notify_by_pspec(G_OBJECT(self), CookiePermissionManagerProperties[PROP_DATABASE_FILENAME]);
+	cookie_permission_manager_statistics_record(priv->statistics, COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_SQL, startTime);
+
+	return(patterns);
 }
 
-/* Get policy for cookies from domain */
-static gint _cookie_permission_manager_get_policy(CookiePermissionManager *self, SoupCookie *inCookie)
+/* Load all policies from database into in-memory trie. If a memory budget is set
+ * only a bloom filter over all domain keys is built and resolved policies are kept
+ * in a least-recently-used cache of limited size. If loading fails policies are
+ * looked up in database directly.
+ */
+static void _cookie_permission_manager_load_policies(CookiePermissionManager *self)
 {
 	CookiePermissionManagerPrivate	*priv=self->priv;
+	CookiePermissionManagerDomainTrie	*policies=NULL;
+	gint							success;
 	sqlite3_stmt					*statement=NULL;
-	gchar							*domain;
-	gint							error;
-	gint							policy=COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED;
-	gboolean						foundPolicy=FALSE;
+	gint64							startTime;
 
-	/* Check for open database */
-	g_return_val_if_fail(priv->database, COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED);
+	/* Release any loaded policy */
+	_cookie_permission_manager_release_policies(self);
+
+	/* If no database is present return here */
+	if(!priv->database) return;
+
+	/* Write all queued decisions to database before reading it */
+	if(priv->writeQueue) cookie_permission_manager_write_queue_flush(priv->writeQueue);
 
-	/* Lookup policy for cookie domain in database */
-	domain=g_strdup(soup_cookie_get_domain(inCookie));
-	if(*domain=='.') *domain='%';
+	startTime=g_get_monotonic_time();
 
-	error=sqlite3_prepare_v2(priv->database,
-								"SELECT domain, value FROM policies WHERE domain LIKE ? ORDER BY domain DESC;",
-								-1,
-								&statement,
-								NULL);
-	if(statement && error==SQLITE_OK) error=sqlite3_bind_text(statement, 1, domain, -1, NULL);
-	if(statement && error==SQLITE_OK)
+	/* Fill trie with policies from database if memory is not limited */
+	if(priv->memoryBudget==0)
 	{
-		while(policy==COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED &&
-				sqlite3_step(statement)==SQLITE_ROW)
+		statement=cookie_permission_manager_statement_registry_get(priv->statements, COOKIE_PERMISSION_MANAGER_STATEMENT_SELECT_ALL);
+		if(statement)
 		{
-			gchar		*policyDomain=(gchar*)sqlite3_column_text(statement, 0);
+			policies=cookie_permission_manager_domain_trie_new();
 
-			if(soup_cookie_domain_matches(inCookie, policyDomain))
+			while((success=sqlite3_step(statement))==SQLITE_ROW)
 			{
-				policy=sqlite3_column_int(statement, 1);
-				foundPolicy=TRUE;
+				cookie_permission_manager_domain_trie_insert(policies,
+																(gchar*)sqlite3_column_text(statement, 0),
+																sqlite3_column_int(statement, 1));
 			}
-		}
-	}
-		else g_warning(_("SQL fails: %s"), sqlite3_errmsg(priv->database));
 
-	sqlite3_finalize(statement);
+			/* If not all policies could be read use database for lookups */
+			if(success!=SQLITE_DONE)
+			{
+				g_warning(_("SQL fails: %s"), sqlite3_errmsg(priv->database));
 
-	/* Check if policy is undetermined. If it is then check if this policy was set by user.
-	 * If it was not set by user check if we should ask user for his decision
-	 */
-	if(!priv->askForUnknownPolicy && !foundPolicy)
-	{
-		switch(soup_cookie_jar_get_accept_policy(priv->cookieJar))
+				cookie_permission_manager_domain_trie_free(policies);
+				policies=NULL;
+			}
+		}
+			else g_warning(_("SQL fails: %s"), sqlite3_errmsg(priv->database));
+	}
+		/* Otherwise spend a quarter of budget on bloom filter and the rest on cache */
+		else
 		{
-			case SOUP_COOKIE_JAR_ACCEPT_ALWAYS:
-			case SOUP_COOKIE_JAR_ACCEPT_NO_THIRD_PARTY:
-				policy=COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT;
-				break;
+			gsize					budget=((gsize)priv->memoryBudget)*1024;
 
-			case SOUP_COOKIE_JAR_ACCEPT_NEVER:
-				policy=COOKIE_PERMISSION_MANAGER_POLICY_BLOCK;
-				break;
+			statement=cookie_permission_manager_statement_registry_get(priv->statements, COOKIE_PERMISSION_MANAGER_STATEMENT_SELECT_ALL_KEYS);
+			if(statement)
+			{
+				priv->policyFilter=cookie_permission_manager_bloom_filter_new(cookie_permission_manager_policy_engine_get_filter_size(budget));
 
-			default:
-				g_critical(_("Could not determine global cookie policy to set for domain: %s"), domain);
-				break;
-		}
-	}
+				while((success=sqlite3_step(statement))==SQLITE_ROW)
+				{
+					cookie_permission_manager_bloom_filter_add(priv->policyFilter,
+																(gchar*)sqlite3_column_text(statement, 0),
+																-1);
+				}
 
-	/* Release allocated resources */
-	g_free(domain);
+				/* If not all keys could be read bloom filter would reject stored domains */
+				if(success!=SQLITE_DONE)
+				{
+					g_warning(_("SQL fails: %s"), sqlite3_errmsg(priv->database));
 
-	return(policy);
-}
+					cookie_permission_manager_bloom_filter_free(priv->policyFilter);
+					priv->policyFilter=NULL;
+				}
+			}
+				else g_warning(_("SQL fails: %s"), sqlite3_errmsg(priv->database));
 
-/* Ask user what to do with cookies from domain(s) which were neither marked accepted nor blocked */
-static gint _cookie_permission_manager_sort_cookies_by_domain(SoupCookie *inLeft, SoupCookie *inRight)
-{
-	const gchar		*domainLeft=soup_cookie_get_domain(inLeft);
-	const gchar		*domainRight=soup_cookie_get_domain(inRight);
+			priv->policyCache=cookie_permission_manager_policy_cache_new(cookie_permission_manager_policy_engine_get_cache_size(budget));
+		}
 
-	if(*domainLeft=='.') domainLeft++;
-	if(*domainRight=='.') domainRight++;
+	if(statement) sqlite3_reset(statement);
 
-	return(g_ascii_strcasecmp(domainLeft, domainRight));
+	cookie_permission_manager_statistics_record(priv->statistics, COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_SQL, startTime);
+
+	/* Load policies of domain patterns and publish them together with policies of domains */
+	_cookie_permission_manager_replace_policies(self, policies, _cookie_permission_manager_load_patterns(self));
 }
 
-static GSList* _cookie_permission_manager_get_number_domains_and_cookies(CookiePermissionManager *self,
-																			GSList *inCookies,
-																			gint *ioNumberDomains,
-																			gint *ioNumberCookies)
+/* Update policy of domain held in memory. Setting policy to
+ * COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED removes the policy of domain.
+ */
+static void _cookie_permission_manager_update_policy_in_memory(CookiePermissionManager *self,
+																const gchar *inDomain,
+																gint inPolicy)
 {
-	GSList			*sortedList, *iter;
-	gint			domains, cookies;
-	const gchar		*lastDomain=NULL;
-	const gchar		*cookieDomain;
+	CookiePermissionManagerPrivate	*priv=self->priv;
 
-	/* Make copy and sort cookies in new list */
-	sortedList=g_slist_copy(inCookies);
+	/* Change is published together with other changes of same batch */
+	if(cookie_permission_manager_policy_snapshot_has_policies(_cookie_permission_manager_get_policy_snapshot(self)))
+	{
+		cookie_permission_manager_policy_snapshot_set_policy(_cookie_permission_manager_edit_policies(self), inDomain, inPolicy);
+	}
 
-	/* Sort cookies by domain to prevent a doman counted multiple times */
-	sortedList=g_slist_sort(sortedList, (GCompareFunc)_cookie_permission_manager_sort_cookies_by_domain);
+	/* Resolved policies of sub-domains may be affected so clear whole cache.
+	 * Keys cannot be removed from bloom filter but a false positive only
+	 * costs a database lookup.
+	 */
+	if(priv->policyCache) cookie_permission_manager_policy_cache_remove_all(priv->policyCache);
 
-	/* Iterate through list and count domains and cookies */
-	domains=cookies=0;
-	for(iter=sortedList; iter; iter=iter->next)
+	if(priv->policyFilter && inPolicy!=COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED)
 	{
-		cookieDomain=soup_cookie_get_domain((SoupCookie*)iter->data);
-
-		if(!lastDomain || g_ascii_strcasecmp(lastDomain, cookieDomain)!=0)
-		{
-			domains++;
-			lastDomain=cookieDomain;
-		}
+		gchar						*key;
 
-		cookies++;
+		key=cookie_permission_manager_database_get_domain_key(inDomain, NULL);
+		cookie_permission_manager_bloom_filter_add(priv->policyFilter, key, -1);
+		g_free(key);
 	}
-
-	/* Store counted numbers to final variables */
-	if(ioNumberDomains) *ioNumberDomains=domains;
-	if(ioNumberCookies) *ioNumberCookies=cookies;
-
-	/* Return the copied but sorted cookie list. Caller is responsible to free
-	 * this list with g_slist_free
-	 */
-	return(sortedList);
 }
 
-/* FIXME: Find a way to add "details" widget */
-#ifndef NO_INFOBAR_DETAILS
-static void _cookie_permission_manager_when_ask_expander_changed(CookiePermissionManager *self,
-																	GParamSpec *inSpec,
-																	gpointer inUserData)
+/* Update policy of domain pattern held in memory. Setting policy to
+ * COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED removes the pattern. Other
+ * threads may still match against published patterns so a changed copy is
+ * compiled and replaces them.
+ */
+static void _cookie_permission_manager_update_pattern_in_memory(CookiePermissionManager *self,
+																const gchar *inPattern,
+																gint inPolicy)
 {
-	GtkExpander			*expander=GTK_EXPANDER(inUserData);
+	CookiePermissionManagerPatternMatcher	*patterns;
 
-	midori_extension_set_boolean(self->priv->extension, "show-details-when-ask", gtk_expander_get_expanded(expander));
-}
-#endif
+	patterns=cookie_permission_manager_policy_snapshot_get_patterns(_cookie_permission_manager_get_policy_snapshot(self));
+	if(!patterns) return;
 
-static gboolean _cookie_permission_manager_on_infobar_webview_navigate(WebKitWebView *inView,
-																		WebKitWebFrame *inFrame,
-																		WebKitNetworkRequest *inRequest,
-																		WebKitWebNavigationAction *inAction,
-																		WebKitWebPolicyDecision *inDecision,
-																		gpointer inUserData)
-{
-	/* Destroy info bar - that calls another callback which quits main loop */
-	GtkWidget		*infobar=GTK_WIDGET(inUserData);
+	patterns=cookie_permission_manager_pattern_matcher_copy(patterns);
 
-	gtk_widget_destroy(infobar);
+	if(inPolicy==COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED) cookie_permission_manager_pattern_matcher_remove(patterns, inPattern);
+		else cookie_permission_manager_pattern_matcher_insert(patterns, inPattern, inPolicy);
 
-	/* Let the default handler decide */
-	return(FALSE);
+	cookie_permission_manager_pattern_matcher_compile(patterns);
+	cookie_permission_manager_policy_snapshot_set_patterns(_cookie_permission_manager_edit_policies(self), patterns);
 }
 
-static void _cookie_permission_manager_on_infobar_destroy(GtkWidget* inInfobar,
-															gpointer inUserData)
+/* Get key of domain or domain pattern in session tier, i.e. the lower-cased
+ * domain without leading dot. Returned string must be freed with g_free().
+ */
+static gchar* _cookie_permission_manager_get_session_key(const gchar *inDomain)
 {
-	CookiePermissionManagerModalInfobar		*modalInfo=(CookiePermissionManagerModalInfobar*)inUserData;
+	if(*inDomain=='.') inDomain++;
 
-	/* Quit main loop */
-	if(g_main_loop_is_running(modalInfo->mainLoop)) g_main_loop_quit(modalInfo->mainLoop);
+	return(g_ascii_strdown(inDomain, -1));
 }
 
-static void _cookie_permission_manager_on_infobar_policy_decision(GtkWidget* inInfobar,
-																	gint inResponse,
-																	gpointer inUserData)
+/* Check if domain or one of its parent domains is a key in session tier */
+static gboolean _cookie_permission_manager_has_session_key(GHashTable *inKeys, const gchar *inDomain)
 {
-	CookiePermissionManagerModalInfobar		*modalInfo;
+	gchar							*key, *parent;
+	gboolean						found=FALSE;
 
-	/* Get modal info struct */
-	modalInfo=(CookiePermissionManagerModalInfobar*)g_object_get_data(G_OBJECT(inInfobar), "cookie-permission-manager-infobar-data");
+	if(g_hash_table_size(inKeys)==0) return(FALSE);
 
-	/* Store response */
-	modalInfo->response=inResponse;
+	key=_cookie_permission_manager_get_session_key(inDomain);
+	for(parent=key; parent && !found; parent=strchr(parent, '.'))
+	{
+		if(*parent=='.') parent++;
+		found=g_hash_table_contains(inKeys, parent);
+	}
+	g_free(key);
 
-	/* Quit main loop */
-	if(g_main_loop_is_running(modalInfo->mainLoop)) g_main_loop_quit(modalInfo->mainLoop);
+	return(found);
 }
 
-static gint _cookie_permission_manager_ask_for_policy(CookiePermissionManager *self,
-														MidoriView *inView,
-														SoupMessage *inMessage,
-														GSList *inUnknownCookies)
+/* Add domain or domain pattern to or remove it from session tier. Decisions
+ * for one session only are held in memory and never written to database.
+ */
+static void _cookie_permission_manager_update_session_policy(CookiePermissionManager *self,
+																const gchar *inDomain,
+																gboolean inIsSessionOnly)
 {
-	/* Ask user for policy of unkndown domains in an undistracting way.
-	 * The idea is to put the message not in a modal window but into midori's info bar.
-	 * Then we'll set up our own GMainLoop to simulate a modal info bar. We need to
-	 * connect to all possible signals of info bar, web view and so on to handle user's
-	 * decision and to get out of our own GMainLoop. After that webkit resumes processing
-	 * data.
-	 */
-	CookiePermissionManagerPrivate			*priv=self->priv;
+	CookiePermissionManagerPrivate	*priv=self->priv;
+	gchar							*key;
+	gboolean						changed;
+
+	key=_cookie_permission_manager_get_session_key(inDomain);
+
+	if(inIsSessionOnly) changed=g_hash_table_add(priv->sessionPolicies, g_strdup(key));
+		else changed=g_hash_table_remove(priv->sessionPolicies, key);
+
+	if(changed) priv->sessionPoliciesChanged=TRUE;
+
+	/* Patterns of session tier are replaced by a changed copy like other patterns */
+	if(changed && cookie_permission_manager_pattern_matcher_is_pattern(key))
+	{
+		CookiePermissionManagerPatternMatcher	*patterns;
+
+		patterns=cookie_permission_manager_policy_snapshot_get_session_patterns(_cookie_permission_manager_get_policy_snapshot(self));
+		if(patterns) patterns=cookie_permission_manager_pattern_matcher_copy(patterns);
+			else patterns=cookie_permission_manager_pattern_matcher_new();
+
+		if(inIsSessionOnly) cookie_permission_manager_pattern_matcher_insert(patterns, key, COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION);
+			else cookie_permission_manager_pattern_matcher_remove(patterns, key);
+
+		if(cookie_permission_manager_pattern_matcher_get_size(patterns)>0) cookie_permission_manager_pattern_matcher_compile(patterns);
+			else
+			{
+				cookie_permission_manager_pattern_matcher_free(patterns);
+				patterns=NULL;
+			}
+
+		cookie_permission_manager_policy_snapshot_set_session_patterns(_cookie_permission_manager_edit_policies(self), patterns);
+	}
+
+	g_free(key);
+}
+
+/* Get policy stored for domain or domain pattern itself (not resolved by any
+ * parent domain or matching pattern). It is read from policies held in memory
+ * which include decisions not written to database yet. Only if a memory budget
+ * is set or policies could not be loaded it is looked up in database.
+ */
+static gint _cookie_permission_manager_get_stored_policy(CookiePermissionManager *self, const gchar *inDomain)
+{
+	CookiePermissionManagerPrivate	*priv=self->priv;
+	CookiePermissionManagerPolicySnapshot	*snapshot;
+	gint							policy=COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED;
+	gint							success;
+	gchar							*key;
+
+	/* Decisions for this session only are not stored in database */
+	key=_cookie_permission_manager_get_session_key(inDomain);
+	success=g_hash_table_contains(priv->sessionPolicies, key);
+	g_free(key);
+
+	if(success) return(COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION);
+
+	/* Patterns are always held in memory */
+	if(cookie_permission_manager_pattern_matcher_is_pattern(inDomain))
+	{
+		CookiePermissionManagerPatternMatcher	*patterns;
+
+		patterns=cookie_permission_manager_policy_snapshot_get_patterns(_cookie_permission_manager_get_policy_snapshot(self));
+		if(patterns) cookie_permission_manager_pattern_matcher_get(patterns, inDomain, &policy);
+		return(policy);
+	}
+
+	/* All policies of domains are held in snapshot if memory is not limited */
+	snapshot=_cookie_permission_manager_get_policy_snapshot(self);
+	if(cookie_permission_manager_policy_snapshot_has_policies(snapshot))
+	{
+		cookie_permission_manager_policy_snapshot_get(snapshot, inDomain, &policy);
+		return(policy);
+	}
+
+	/* Decisions not written to database yet take precedence */
+	if(priv->writeQueue)
+	{
+		key=cookie_permission_manager_database_get_domain_key(inDomain, NULL);
+		success=cookie_permission_manager_write_queue_lookup(priv->writeQueue, key, -1, &policy);
+		g_free(key);
+
+		if(success) return(policy);
+	}
+
+	success=cookie_permission_manager_database_get_policy(priv->statements, inDomain, &policy);
+	if(success!=SQLITE_ROW && success!=SQLITE_DONE) g_warning(_("SQL fails: %s"), sqlite3_errmsg(priv->database));
+
+	return(policy);
+}
+
+/* Apply changed policy of domain or domain pattern in memory and tell everyone about it */
+static void _cookie_permission_manager_apply_policy(CookiePermissionManager *self,
+													const gchar *inDomain,
+													gint inOldPolicy,
+													gint inNewPolicy)
+{
+	gint							storedPolicy;
+
+	/* Decisions for this session only replace any stored policy */
+	_cookie_permission_manager_update_session_policy(self, inDomain, inNewPolicy==COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION);
+
+	storedPolicy=(inNewPolicy==COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION ? COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED : inNewPolicy);
+
+	if(cookie_permission_manager_pattern_matcher_is_pattern(inDomain)) _cookie_permission_manager_update_pattern_in_memory(self, inDomain, storedPolicy);
+		else _cookie_permission_manager_update_policy_in_memory(self, inDomain, storedPolicy);
+
+	if(inOldPolicy!=inNewPolicy)
+	{
+		g_signal_emit(self, CookiePermissionManagerSignals[SIGNAL_POLICY_CHANGED], 0, inDomain, inOldPolicy, inNewPolicy);
+	}
+}
+
+/* Store policy for all domains or domain patterns in one transaction. Setting policy
+ * to COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED removes the policies. Policies
+ * for one session only are not written to database but replace stored ones.
+ */
+static gboolean _cookie_permission_manager_store_policies(CookiePermissionManager *self,
+															const gchar **inDomains,
+															gint inPolicy)
+{
+	CookiePermissionManagerPrivate	*priv=self->priv;
+	const gchar						**domain;
+	gint							*oldPolicies, *oldPolicy;
+	gint							storedPolicy;
+	gint							success;
+
+	g_return_val_if_fail(priv->database, FALSE);
+
+	storedPolicy=(inPolicy==COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION ? COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED : inPolicy);
+
+	/* Write all queued decisions before so they cannot overwrite these policies later */
+	if(priv->writeQueue) cookie_permission_manager_write_queue_flush(priv->writeQueue);
+
+	/* Store policies in database and remember old ones */
+	oldPolicies=g_new(gint, g_strv_length((gchar**)inDomains)+1);
+	oldPolicy=oldPolicies;
+
+	success=cookie_permission_manager_database_begin(priv->statements);
+	for(domain=inDomains; *domain && success==SQLITE_OK; domain++, oldPolicy++)
+	{
+		*oldPolicy=_cookie_permission_manager_get_stored_policy(self, *domain);
+
+		/* Nothing to write if neither old nor new policy is stored in database */
+		if(storedPolicy==COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED &&
+			(*oldPolicy==COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED || *oldPolicy==COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION))
+		{
+			continue;
+		}
+
+		if(cookie_permission_manager_pattern_matcher_is_pattern(*domain))
+		{
+			if(storedPolicy==COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED) success=cookie_permission_manager_database_remove_pattern_policy(priv->statements, *domain);
+				else success=cookie_permission_manager_database_set_pattern_policy(priv->statements, *domain, storedPolicy);
+		}
+			else
+			{
+				if(storedPolicy==COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED) success=cookie_permission_manager_database_remove_policy(priv->statements, *domain);
+					else success=cookie_permission_manager_database_set_policy(priv->statements, *domain, storedPolicy);
+			}
+	}
+	if(success==SQLITE_OK) success=cookie_permission_manager_database_commit(priv->statements);
+
+	if(success!=SQLITE_OK)
+	{
+		g_warning(_("SQL fails: %s"), sqlite3_errmsg(priv->database));
+		cookie_permission_manager_database_rollback(priv->statements);
+
+		g_free(oldPolicies);
+		return(FALSE);
+	}
+
+	/* Apply policies after they were stored successfully */
+	for(domain=inDomains, oldPolicy=oldPolicies; *domain; domain++, oldPolicy++)
+	{
+		_cookie_permission_manager_apply_policy(self, *domain, *oldPolicy, inPolicy);
+	}
+	_cookie_permission_manager_publish_policies(self);
+
+	g_free(oldPolicies);
+	return(TRUE);
+}
+
+/* Copy changes in write-ahead log into database periodically */
+static gboolean _cookie_permission_manager_on_checkpoint(CookiePermissionManager *self)
+{
+	CookiePermissionManagerPrivate	*priv=self->priv;
+	gint							success;
+
+	if(!priv->database) return(FALSE);
+
+	/* Do not wait for connections busy writing but try again next time */
+	success=sqlite3_wal_checkpoint_v2(priv->database, NULL, SQLITE_CHECKPOINT_PASSIVE, NULL, NULL);
+	if(success!=SQLITE_OK && success!=SQLITE_BUSY) g_warning(_("SQL fails: %s"), sqlite3_errmsg(priv->database));
+
+	return(TRUE);
+}
+
+/* Begin and end a batch of changes to cookie jar made by manager itself. Cookies
+ * changed in a batch were already checked or decided by user so they are not
+ * checked again when cookie jar notifies about them. Batches may be nested.
+ */
+static void _cookie_permission_manager_begin_own_changes(CookiePermissionManager *self)
+{
+	self->priv->ownChangesDepth++;
+}
+
+static void _cookie_permission_manager_end_own_changes(CookiePermissionManager *self)
+{
+	g_return_if_fail(self->priv->ownChangesDepth>0);
+
+	self->priv->ownChangesDepth--;
+}
+
+/* Delete all cookies of domains and domain patterns allowed only for a session.
+ * The cookie jar is walked only once and each cookie's domain and its parent
+ * domains are looked up in keys of session tier.
+ */
+static void _cookie_permission_manager_evict_session_cookies(CookiePermissionManager *self,
+																GHashTable *inKeys,
+																CookiePermissionManagerPatternMatcher *inPatterns)
+{
+	CookiePermissionManagerPrivate	*priv=self->priv;
+	GSList							*cookies, *cookie, *evict=NULL;
+	const gchar						*cookieDomain;
+	gboolean						hasPatterns;
+	gboolean						isSessionOnly;
+	gint							policy;
+
+	if(g_hash_table_size(inKeys)==0) return;
+
+	hasPatterns=(inPatterns && cookie_permission_manager_pattern_matcher_get_size(inPatterns)>0);
+
+	/* Walk cookie jar once and collect cookies to delete */
+	cookies=soup_cookie_jar_all_cookies(priv->cookieJar);
+	for(cookie=cookies; cookie; cookie=cookie->next)
+	{
+		cookieDomain=soup_cookie_get_domain((SoupCookie*)cookie->data);
+		if(!cookieDomain) continue;
+
+		isSessionOnly=_cookie_permission_manager_has_session_key(inKeys, cookieDomain);
+
+		if(!isSessionOnly &&
+			hasPatterns &&
+			cookie_permission_manager_pattern_matcher_lookup(inPatterns, cookieDomain, &policy))
+		{
+			isSessionOnly=TRUE;
+		}
+
+		if(isSessionOnly) evict=g_slist_prepend(evict, cookie->data);
+	}
+
+	/* Delete collected cookies in one batch */
+	_cookie_permission_manager_begin_own_changes(self);
+	for(cookie=evict; cookie; cookie=cookie->next)
+	{
+		soup_cookie_jar_delete_cookie(priv->cookieJar, (SoupCookie*)cookie->data);
+	}
+	_cookie_permission_manager_end_own_changes(self);
+
+	g_slist_free(evict);
+	soup_cookies_free(cookies);
+}
+
+/* Purge cookies of domains and domain patterns allowed for one session only
+ * which were stored as policies by versions before database schema version 3.
+ * Migration moved them to a table of legacy session domains which is cleared
+ * afterwards, so this is done only once after database was migrated.
+ */
+static void _cookie_permission_manager_purge_legacy_session_policies(CookiePermissionManager *self)
+{
+	CookiePermissionManagerPrivate	*priv=self->priv;
+	CookiePermissionManagerPatternMatcher	*legacyPatterns;
+	GHashTable						*legacyKeys;
+	sqlite3_stmt					*statement;
+	const gchar						*key;
+	gint							success;
+
+	statement=cookie_permission_manager_statement_registry_get(priv->statements, COOKIE_PERMISSION_MANAGER_STATEMENT_SELECT_ALL_SESSION);
+	if(!statement)
+	{
+		g_warning(_("SQL fails: %s"), sqlite3_errmsg(priv->database));
+		return;
+	}
+
+	legacyKeys=g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	legacyPatterns=cookie_permission_manager_pattern_matcher_new();
+
+	while((success=sqlite3_step(statement))==SQLITE_ROW)
+	{
+		key=(const gchar*)sqlite3_column_text(statement, 0);
+		if(!key) continue;
+
+		g_hash_table_add(legacyKeys, g_strdup(key));
+		if(cookie_permission_manager_pattern_matcher_is_pattern(key))
+		{
+			cookie_permission_manager_pattern_matcher_insert(legacyPatterns, key, COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION);
+		}
+	}
+	sqlite3_reset(statement);
+
+	if(success!=SQLITE_DONE) g_warning(_("SQL fails: %s"), sqlite3_errmsg(priv->database));
+
+	/* Purge their cookies and forget them */
+	if(success==SQLITE_DONE && g_hash_table_size(legacyKeys)>0)
+	{
+		cookie_permission_manager_pattern_matcher_compile(legacyPatterns);
+		_cookie_permission_manager_evict_session_cookies(self, legacyKeys, legacyPatterns);
+
+		if(cookie_permission_manager_database_remove_all_session_policies(priv->statements)!=SQLITE_OK)
+		{
+			g_warning(_("SQL fails: %s"), sqlite3_errmsg(priv->database));
+		}
+	}
+
+	cookie_permission_manager_pattern_matcher_free(legacyPatterns);
+	g_hash_table_destroy(legacyKeys);
+}
+
+/* Open database containing policies for cookie domains.
+ * Create database and setup table structure if it does not exist yet.
+ */
+static void _cookie_permission_manager_open_database(CookiePermissionManager *self)
+{
+	CookiePermissionManagerPrivate	*priv=self->priv;
+	const gchar						*configDir;
+	gchar							*error=NULL;
+	gint							version=0;
+	gint							success;
+
+	/* Close any open database but write all queued decisions before */
+	if(priv->database)
+	{
+		if(priv->checkpointID) g_source_remove(priv->checkpointID);
+		priv->checkpointID=0;
+
+		if(priv->writeQueue) cookie_permission_manager_write_queue_free(priv->writeQueue);
+		priv->writeQueue=NULL;
+
+		g_free(priv->databaseFilename);
+		priv->databaseFilename=NULL;
+
+		cookie_permission_manager_statement_registry_free(priv->statements);
+		priv->statements=NULL;
+
+		sqlite3_close(priv->database);
+		priv->database=NULL;
+
+		_cookie_permission_manager_release_policies(self);
+
+		g_object_notify_by_pspec(G_OBJECT(self), CookiePermissionManagerProperties[PROP_DATABASE]);
+		g_object_notify_by_pspec(G_OBJECT(self), CookiePermissionManagerProperties[PROP_DATABASE_FILENAME]);
+	}
+
+	/* Build path to database file */
+	configDir=midori_extension_get_config_dir(priv->extension);
+	if(!configDir)
+	{
+		g_warning(_("Could not get path to configuration of extension: path is NULL"));
+
+		_cookie_permission_manager_error(self, _("Could not get path to configuration of extension."));
+		return;
+	}
+	
+	if(katze_mkdir_with_parents(configDir, 0700))
+	{
+		g_warning(_("Could not create configuration folder for extension: %s"), g_strerror(errno));
+
+		_cookie_permission_manager_error(self, _("Could not create configuration folder for extension."));
+		return;
+	}
+
+	/* Open database */
+	priv->databaseFilename=g_build_filename(configDir, COOKIE_PERMISSION_DATABASE, NULL);
+	success=sqlite3_open(priv->databaseFilename, &priv->database);
+	if(success!=SQLITE_OK)
+	{
+		g_warning(_("Could not open database of extenstion: %s"), sqlite3_errmsg(priv->database));
+
+		g_free(priv->databaseFilename);
+		priv->databaseFilename=NULL;
+
+		if(priv->database) sqlite3_close(priv->database);
+		priv->database=NULL;
+
+		_cookie_permission_manager_error(self, _("Could not open database of extension."));
+		return;
+	}
+
+	/* Create table structure of first version if it does not exist. It is
+	 * migrated to current version including its indices below.
+	 */
+	success=sqlite3_exec(priv->database,
+							"CREATE TABLE IF NOT EXISTS "
+							"policies(domain text, value integer);",
+							NULL,
+							NULL,
+							&error);
+
+	if(success==SQLITE_OK)
+	{
+		success=cookie_permission_manager_database_get_version(priv->database, &version, &error);
+	}
+
+	if(success==SQLITE_OK)
+	{
+		success=cookie_permission_manager_database_migrate(priv->database, &error);
+	}
+
+	if(success==SQLITE_OK)
+	{
+		success=cookie_permission_manager_database_set_durability(priv->database, priv->durability, &error);
+	}
+
+	if(success!=SQLITE_OK || error)
+	{
+		_cookie_permission_manager_error(self, _("Could not set up database structure of extension."));
+
+		if(error)
+		{
+			g_critical(_("Failed to execute database statement: %s"), error);
+			sqlite3_free(error);
+		}
+
+		g_free(priv->databaseFilename);
+		priv->databaseFilename=NULL;
+
+		sqlite3_close(priv->database);
+		priv->database=NULL;
+		return;
+	}
+
+	/* Set up registry of prepared statements for this database connection */
+	priv->statements=cookie_permission_manager_statement_registry_new(priv->database);
+
+	/* Cookies allowed for one session only by earlier versions must not outlive it */
+	if(version<COOKIE_PERMISSION_DATABASE_VERSION) _cookie_permission_manager_purge_legacy_session_policies(self);
+
+	/* Set up queue writing user's decisions to database in background */
+	priv->writeQueue=cookie_permission_manager_write_queue_new(priv->databaseFilename, priv->durability);
+
+	/* Write-ahead log is not checkpointed automatically if memory comes first */
+	if(priv->durability==COOKIE_PERMISSION_MANAGER_DURABILITY_MEMORY_FIRST)
+	{
+		priv->checkpointID=g_timeout_add_seconds(CHECKPOINT_INTERVAL,
+													(GSourceFunc)_cookie_permission_manager_on_checkpoint,
+													self);
+	}
+
+	/* Load policies into memory to avoid database lookups for each cookie */
+	_cookie_permission_manager_load_policies(self);
+
+	g_object_notify_by_pspec(G_OBJECT(self), CookiePermissionManagerProperties[PROP_DATABASE]);
+	g_object_notify_by_pspec(G_OBJECT(self), CookiePermissionManagerProperties[PROP_DATABASE_FILENAME]);
+}
+
+/* Get policy for cookies from domain no policy was set for by user. It follows
+ * global cookie policy of cookie jar.
+ */
+static gint _cookie_permission_manager_get_unknown_policy(CookiePermissionManager *self, const gchar *inDomain)
+{
+	switch(soup_cookie_jar_get_accept_policy(self->priv->cookieJar))
+	{
+		case SOUP_COOKIE_JAR_ACCEPT_ALWAYS:
+		case SOUP_COOKIE_JAR_ACCEPT_NO_THIRD_PARTY:
+			return(COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT);
+
+		case SOUP_COOKIE_JAR_ACCEPT_NEVER:
+			return(COOKIE_PERMISSION_MANAGER_POLICY_BLOCK);
+
+		default:
+			g_critical(_("Could not determine global cookie policy to set for domain: %s"), inDomain);
+			break;
+	}
+
+	return(COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED);
+}
+
+/* Get policy for cookies from domain */
+static gint _cookie_permission_manager_get_policy_for_domain(CookiePermissionManager *self, const gchar *inDomain)
+{
+	CookiePermissionManagerPrivate	*priv=self->priv;
+	CookiePermissionManagerPolicySources	sources;
+
+	/* Check for open database */
+	g_return_val_if_fail(priv->database, COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED);
+
+	sources.snapshot=_cookie_permission_manager_get_policy_snapshot(self);
+	sources.statements=priv->statements;
+	sources.writeQueue=priv->writeQueue;
+	sources.policyCache=priv->policyCache;
+	sources.policyFilter=priv->policyFilter;
+	sources.statistics=priv->statistics;
+
+	/* If user should not be asked global cookie policy applies to unknown domains */
+	if(priv->askForUnknownPolicy) sources.unknownPolicy=COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED;
+		else sources.unknownPolicy=_cookie_permission_manager_get_unknown_policy(self, inDomain);
+
+	return(cookie_permission_manager_policy_engine_get_policy(&sources, inDomain));
+}
+
+static gint _cookie_permission_manager_get_policy(CookiePermissionManager *self, SoupCookie *inCookie)
+{
+	return(_cookie_permission_manager_get_policy_for_domain(self, soup_cookie_get_domain(inCookie)));
+}
+
+/* Resolve policies for all cookies of a response at once. Each distinct cookie domain
+ * is looked up only once. Returns a hash table mapping cookie domains to policies which
+ * must be destroyed by caller.
+ */
+static GHashTable* _cookie_permission_manager_get_policies(CookiePermissionManager *self, GSList *inCookies)
+{
+	CookiePermissionManagerPrivate	*priv=self->priv;
+	GHashTable						*policies;
+	GSList							*iter;
+	const gchar						*domain;
+	guint							numberCookies=0;
+
+	policies=g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+	for(iter=inCookies; iter; iter=iter->next)
+	{
+		domain=soup_cookie_get_domain((SoupCookie*)iter->data);
+		numberCookies++;
+
+		if(!g_hash_table_contains(policies, domain))
+		{
+			g_hash_table_insert(policies,
+								g_strdup(domain),
+								GINT_TO_POINTER(_cookie_permission_manager_get_policy_for_domain(self, domain)));
+		}
+	}
+
+	/* Count lookups saved by resolving each domain only once */
+	priv->savedLookups+=numberCookies-g_hash_table_size(policies);
+
+	return(policies);
+}
+
+/* Get domain a policy decision for a cookie domain is made for. If policies are grouped
+ * by registrable domain it is the registrable domain (eTLD+1) of cookie domain otherwise
+ * it is the cookie domain itself. Cookie domains which are a public suffix have no
+ * registrable domain, e.g. host-only cookies of github.io or blogspot.com, so the
+ * decision falls back to the cookie domain itself like without grouping.
+ */
+static const gchar* _cookie_permission_manager_get_decision_domain(CookiePermissionManager *self, const gchar *inDomain)
+{
+	const gchar		*domain=inDomain;
+	const gchar		*registrableDomain;
+
+	if(*domain=='.') domain++;
+
+	if(self->priv->groupByRegistrableDomain)
+	{
+		registrableDomain=cookie_permission_manager_public_suffix_get_registrable_domain(domain);
+		if(registrableDomain) domain=registrableDomain;
+	}
+
+	return(domain);
+}
+
+/* Ask user what to do with cookies from domain(s) which were neither marked accepted nor blocked */
+static gint _cookie_permission_manager_sort_cookies_by_domain(SoupCookie *inLeft,
+																SoupCookie *inRight,
+																gpointer inUserData)
+{
+	CookiePermissionManager		*self=COOKIE_PERMISSION_MANAGER(inUserData);
+	const gchar					*domainLeft=_cookie_permission_manager_get_decision_domain(self, soup_cookie_get_domain(inLeft));
+	const gchar					*domainRight=_cookie_permission_manager_get_decision_domain(self, soup_cookie_get_domain(inRight));
+
+	return(g_ascii_strcasecmp(domainLeft, domainRight));
+}
+
+static GSList* _cookie_permission_manager_get_number_domains_and_cookies(CookiePermissionManager *self,
+																			GSList *inCookies,
+																			gint *ioNumberDomains,
+																			gint *ioNumberCookies)
+{
+	GSList			*sortedList, *iter;
+	gint			domains, cookies;
+	const gchar		*lastDomain=NULL;
+	const gchar		*cookieDomain;
+
+	/* Make copy and sort cookies in new list */
+	sortedList=g_slist_copy(inCookies);
+
+	/* Sort cookies by domain to prevent a doman counted multiple times */
+	sortedList=g_slist_sort_with_data(sortedList, (GCompareDataFunc)_cookie_permission_manager_sort_cookies_by_domain, self);
+
+	/* Iterate through list and count domains and cookies */
+	domains=cookies=0;
+	for(iter=sortedList; iter; iter=iter->next)
+	{
+		cookieDomain=_cookie_permission_manager_get_decision_domain(self, soup_cookie_get_domain((SoupCookie*)iter->data));
+
+		if(!lastDomain || g_ascii_strcasecmp(lastDomain, cookieDomain)!=0)
+		{
+			domains++;
+			lastDomain=cookieDomain;
+		}
+
+		cookies++;
+	}
+
+	/* Store counted numbers to final variables */
+	if(ioNumberDomains) *ioNumberDomains=domains;
+	if(ioNumberCookies) *ioNumberCookies=cookies;
+
+	/* Return the copied but sorted cookie list. Caller is responsible to free
+	 * this list with g_slist_free
+	 */
+	return(sortedList);
+}
+
+/* Get text of prompt asking for policy of sorted cookies */
+static gchar* _cookie_permission_manager_get_prompt_text(CookiePermissionManager *self,
+															GSList *inSortedCookies,
+															gint inNumberDomains,
+															gint inNumberCookies)
+{
+	gchar							*text;
+
+	if(inNumberDomains==1)
+	{
+		const gchar					*cookieDomain;
+
+		cookieDomain=_cookie_permission_manager_get_decision_domain(self, soup_cookie_get_domain((SoupCookie*)inSortedCookies->data));
+
+		if(inNumberCookies>1)
+			text=g_strdup_printf(_("The website %s wants to store %d cookies."), cookieDomain, inNumberCookies);
+		else
+			text=g_strdup_printf(_("The website %s wants to store a cookie."), cookieDomain);
+	}
+		else
+		{
+			text=g_strdup_printf(_("Multiple websites want to store %d cookies in total."), inNumberCookies);
+		}
+
+	return(text);
+}
+
+/* Append a cookie about to be stored to trace file if recording trace */
+static void _cookie_permission_manager_record_cookie(CookiePermissionManager *self,
+														CookiePermissionManagerTraceSource inSource,
+														const gchar *inFirstParty,
+														SoupCookie *inCookie,
+														gint64 inTimestamp)
+{
+	CookiePermissionManagerTraceEvent	event;
+
+	event.timestamp=inTimestamp;
+	event.source=inSource;
+	event.firstParty=inFirstParty ? inFirstParty : "";
+	event.domain=soup_cookie_get_domain(inCookie);
+	event.name=soup_cookie_get_name(inCookie);
+	event.path=soup_cookie_get_path(inCookie);
+	event.expires=inCookie->expires ? soup_date_to_time_t(inCookie->expires) : 0;
+
+	cookie_permission_manager_trace_writer_append(self->priv->traceWriter, &event);
+}
+
+/* Add a cookie which was checked already or decided by user to cookie jar.
+ * Cookie jar takes ownership of cookie.
+ */
+static void _cookie_permission_manager_commit_cookie(CookiePermissionManager *self, SoupCookie *inCookie)
+{
+	_cookie_permission_manager_begin_own_changes(self);
+	soup_cookie_jar_add_cookie(self->priv->cookieJar, inCookie);
+	_cookie_permission_manager_end_own_changes(self);
+}
+
+/* Store user's decision in database if it is not a temporary block.
+ * Decisions are applied in memory at once and written to database
+ * in background to keep web view responsive.
+ * We use the already sorted list of cookies to prevent multiple
+ * updates of database for the same domain. This sorted list is a copy
+ * to avoid a reorder of cookies. If policies are grouped by registrable
+ * domain the decision is stored once for the registrable domain and
+ * applies to all its sub-domains. Decisions for a cookie domain being a
+ * public suffix are stored for that domain as without grouping so the
+ * user is not asked again each time.
+ */
+static void _cookie_permission_manager_store_decision(CookiePermissionManager *self,
+														GSList *inSortedCookies,
+														gint inResponse)
+{
+	CookiePermissionManagerPrivate	*priv=self->priv;
+	GSList							*cookies;
+
+	if(inResponse!=COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED)
+	{
+		const gchar					*lastDomain=NULL;
+
+		/* Iterate through cookies and store decision for each domain once */
+		for(cookies=inSortedCookies; cookies; cookies=cookies->next)
+		{
+			SoupCookie				*cookie=(SoupCookie*)cookies->data;
+			const gchar				*cookieDomain=_cookie_permission_manager_get_decision_domain(self, soup_cookie_get_domain(cookie));
+
+			/* Store decision if new domain found while iterating through cookies */
+			if(!lastDomain || g_ascii_strcasecmp(lastDomain, cookieDomain)!=0)
+			{
+				const gchar		*domains[2]={ cookieDomain, NULL };
+
+				lastDomain=cookieDomain;
+
+				if(priv->writeQueue)
+				{
+					gint			oldPolicy;
+
+					/* Decisions for this session only are kept in memory but
+					 * replace any policy stored for domain
+					 */
+					oldPolicy=_cookie_permission_manager_get_stored_policy(self, cookieDomain);
+					if(inResponse!=COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION)
+					{
+						cookie_permission_manager_write_queue_push(priv->writeQueue, cookieDomain, inResponse);
+					}
+						else if(oldPolicy!=COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED &&
+								oldPolicy!=COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION)
+						{
+							cookie_permission_manager_write_queue_push(priv->writeQueue, cookieDomain, COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED);
+						}
+					_cookie_permission_manager_apply_policy(self, cookieDomain, oldPolicy, inResponse);
+					_cookie_permission_manager_publish_policies(self);
+				}
+					else _cookie_permission_manager_store_policies(self, domains, inResponse);
+			}
+		}
+	}
+}
+
+/* FIXME: Find a way to add "details" widget */
+#ifndef NO_INFOBAR_DETAILS
+static void _cookie_permission_manager_when_ask_expander_changed(CookiePermissionManager *self,
+																	GParamSpec *inSpec,
+																	gpointer inUserData)
+{
+	GtkExpander			*expander=GTK_EXPANDER(inUserData);
+
+	midori_extension_set_boolean(self->priv->extension, "show-details-when-ask", gtk_expander_get_expanded(expander));
+}
+#endif
+
+static gboolean _cookie_permission_manager_on_infobar_webview_navigate(WebKitWebView *inView,
+																		WebKitWebFrame *inFrame,
+																		WebKitNetworkRequest *inRequest,
+																		WebKitWebNavigationAction *inAction,
+																		WebKitWebPolicyDecision *inDecision,
+																		gpointer inUserData)
+{
+	GtkWidget		*infobar=GTK_WIDGET(inUserData);
+
+	/* Navigations of sub-frames like iframes do not leave the page
+	 * the user is asked for so keep info bar
+	 */
+	if(inFrame!=webkit_web_view_get_main_frame(inView)) return(FALSE);
+
+	/* Destroy info bar - that calls another callback which quits main loop */
+	gtk_widget_destroy(infobar);
+
+	/* Let the default handler decide */
+	return(FALSE);
+}
+
+static void _cookie_permission_manager_on_infobar_destroy(GtkWidget* inInfobar,
+															gpointer inUserData)
+{
+	CookiePermissionManagerModalInfobar		*modalInfo=(CookiePermissionManagerModalInfobar*)inUserData;
+
+	/* Quit main loop */
+	if(g_main_loop_is_running(modalInfo->mainLoop)) g_main_loop_quit(modalInfo->mainLoop);
+}
+
+static void _cookie_permission_manager_on_infobar_policy_decision(GtkWidget* inInfobar,
+																	gint inResponse,
+																	gpointer inUserData)
+{
+	CookiePermissionManagerModalInfobar		*modalInfo;
+
+	/* Get modal info struct */
+	modalInfo=(CookiePermissionManagerModalInfobar*)g_object_get_data(G_OBJECT(inInfobar), "cookie-permission-manager-infobar-data");
+
+	/* Store response */
+	modalInfo->response=inResponse;
+
+	/* Quit main loop */
+	if(g_main_loop_is_running(modalInfo->mainLoop)) g_main_loop_quit(modalInfo->mainLoop);
+}
+
+static gint _cookie_permission_manager_ask_for_policy(CookiePermissionManager *self,
+														MidoriView *inView,
+														SoupMessage *inMessage,
+														GSList *inUnknownCookies)
+{
+	/* Ask user for policy of unkndown domains in an undistracting way.
+	 * The idea is to put the message not in a modal window but into midori's info bar.
+	 * Then we'll set up our own GMainLoop to simulate a modal info bar. We need to
+	 * connect to all possible signals of info bar, web view and so on to handle user's
+	 * decision and to get out of our own GMainLoop. After that webkit resumes processing
+	 * data.
+	 */
+	CookiePermissionManagerPrivate			*priv=self->priv;
 	GtkWidget								*infobar;
 /* FIXME: Find a way to add "details" widget */
 #ifndef NO_INFOBAR_DETAILS
@@ -458,12 +1307,14 @@ static gint _cookie_permission_manager_ask_for_policy(CookiePermissionManager *s
 	GtkWidget								*list;
 	GtkCellRenderer							*renderer;
 	GtkTreeViewColumn						*column;
+	GSList									*cookies;
 #endif
 	gchar									*text;
 	gint									numberDomains, numberCookies;
-	GSList									*sortedCookies, *cookies;
+	GSList									*sortedCookies;
 	WebKitWebView							*webkitView;
 	CookiePermissionManagerModalInfobar		modalInfo;
+	gint64									startTime;
 
 	/* Get webkit view of midori view */
 	webkitView=WEBKIT_WEB_VIEW(midori_view_get_web_view(inView));
@@ -507,21 +1358,7 @@ static gint _cookie_permission_manager_ask_for_policy(CookiePermissionManager *s
 #endif
 
 	/* Create description text */
-	if(numberDomains==1)
-	{
-		const gchar					*cookieDomain=soup_cookie_get_domain((SoupCookie*)sortedCookies->data);
-
-		if(*cookieDomain=='.') cookieDomain++;
-		
-		if(numberCookies>1)
-			text=g_strdup_printf(_("The website %s wants to store %d cookies."), cookieDomain, numberCookies);
-		else
-			text=g_strdup_printf(_("The website %s wants to store a cookie."), cookieDomain);
-	}
-		else
-		{
-			text=g_strdup_printf(_("Multiple websites want to store %d cookies in total."), numberCookies);
-		}
+	text=_cookie_permission_manager_get_prompt_text(self, sortedCookies, numberDomains, numberCookies);
 
 	/* Create info bar message and buttons */
 	infobar=midori_view_add_info_bar(inView,
@@ -571,184 +1408,557 @@ static gint _cookie_permission_manager_ask_for_policy(CookiePermissionManager *s
 													NULL);
 	gtk_tree_view_append_column(GTK_TREE_VIEW(list), column);
 
-	renderer=gtk_cell_renderer_text_new();
-	column=gtk_tree_view_column_new_with_attributes(_("Name"),
-													renderer,
-													"text", NAME_COLUMN,
-													NULL);
-	gtk_tree_view_append_column(GTK_TREE_VIEW(list), column);
+	renderer=gtk_cell_renderer_text_new();
+	column=gtk_tree_view_column_new_with_attributes(_("Name"),
+													renderer,
+													"text", NAME_COLUMN,
+													NULL);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(list), column);
+
+	renderer=gtk_cell_renderer_text_new();
+	column=gtk_tree_view_column_new_with_attributes(_("Value"),
+													renderer,
+													"text", VALUE_COLUMN,
+													NULL);
+	g_object_set(G_OBJECT(renderer),
+					"ellipsize", PANGO_ELLIPSIZE_END,
+					"width-chars", 30,
+					NULL);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(list), column);
+
+	renderer=gtk_cell_renderer_text_new();
+	column=gtk_tree_view_column_new_with_attributes(_("Expire date"),
+													renderer,
+													"text", EXPIRE_DATE_COLUMN,
+													NULL);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(list), column);
+
+	scrolled=gtk_scrolled_window_new(NULL, NULL);
+#ifdef GTK__3_0_VERSION
+	gtk_scrolled_window_set_min_content_height(GTK_SCROLLED_WINDOW(scrolled), 100);
+#endif
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+	gtk_container_add(GTK_CONTAINER(scrolled), list);
+	gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(scrolled), GTK_SHADOW_IN);
+	gtk_container_add(GTK_CONTAINER(expander), scrolled);
+
+	gtk_widget_show_all(vbox);
+	gtk_container_add(GTK_CONTAINER(contentArea), vbox);
+
+	/* Set state of expander based on config 'show-details-when-ask' */
+	gtk_expander_set_expanded(GTK_EXPANDER(expander),
+								midori_extension_get_boolean(priv->extension, "show-details-when-ask"));
+	g_signal_connect_swapped(expander, "notify::expanded", G_CALLBACK(_cookie_permission_manager_when_ask_expander_changed), self);
+#endif
+
+	/* Show all widgets of info bar */
+	gtk_widget_show_all(infobar);
+
+	/* Connect signals to quit main loop */
+	g_signal_connect(webkitView, "navigation-policy-decision-requested", G_CALLBACK(_cookie_permission_manager_on_infobar_webview_navigate), infobar);
+	g_signal_connect(infobar, "destroy", G_CALLBACK(_cookie_permission_manager_on_infobar_destroy), &modalInfo);
+
+	/* Let info bar be modal and set response to default */
+	modalInfo.response=COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED;
+	modalInfo.mainLoop=g_main_loop_new(NULL, FALSE);
+
+	startTime=g_get_monotonic_time();
+
+	GDK_THREADS_LEAVE();
+	g_main_loop_run(modalInfo.mainLoop);
+	GDK_THREADS_ENTER();
+
+	cookie_permission_manager_statistics_record(priv->statistics, COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_PROMPT_WAIT, startTime);
+
+	g_main_loop_unref(modalInfo.mainLoop);
+
+	modalInfo.mainLoop=NULL;
+
+	/* Disconnect signal handler to webkit's web view  */
+	g_signal_handlers_disconnect_by_func(webkitView, G_CALLBACK(_cookie_permission_manager_on_infobar_webview_navigate), infobar);
+
+	/* Store user's decision */
+	_cookie_permission_manager_store_decision(self, sortedCookies, modalInfo.response);
+
+	/* Free up allocated resources */
+	g_slist_free(sortedCookies);
+
+	/* Return response */
+	return(modalInfo.response==COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED ?
+			COOKIE_PERMISSION_MANAGER_POLICY_BLOCK : modalInfo.response);
+}
+
+/* Set message text of an info bar */
+static void _cookie_permission_manager_set_infobar_text(GtkWidget *inInfobar, const gchar *inText)
+{
+	GtkWidget						*contentArea;
+	GList							*children, *iter;
+
+#if HAVE_GTK_INFO_BAR
+	contentArea=gtk_info_bar_get_content_area(GTK_INFO_BAR(inInfobar));
+#else
+	contentArea=inInfobar;
+#endif
+
+	children=gtk_container_get_children(GTK_CONTAINER(contentArea));
+	for(iter=children; iter; iter=g_list_next(iter))
+	{
+		if(GTK_IS_LABEL(iter->data))
+		{
+			gtk_label_set_text(GTK_LABEL(iter->data), inText);
+			break;
+		}
+	}
+	g_list_free(children);
+}
+
+/* Remember that a cookie received at a view was attached to prompt of another view */
+static void _cookie_permission_manager_pending_prompt_attach(CookiePermissionManagerPendingPrompt *inPending,
+																MidoriView *inView,
+																SoupCookie *inCookie)
+{
+	CookiePermissionManagerPendingAttachment	*attachment=NULL;
+	GSList										*iter;
+
+	for(iter=inPending->attachments; iter && !attachment; iter=iter->next)
+	{
+		if(((CookiePermissionManagerPendingAttachment*)iter->data)->view==inView) attachment=iter->data;
+	}
+
+	if(!attachment)
+	{
+		attachment=g_new0(CookiePermissionManagerPendingAttachment, 1);
+		attachment->view=inView;
+		attachment->cookies=NULL;
+		g_object_add_weak_pointer(G_OBJECT(inView), (gpointer*)&attachment->view);
+
+		inPending->attachments=g_slist_prepend(inPending->attachments, attachment);
+	}
+
+	attachment->cookies=g_slist_prepend(attachment->cookies, inCookie);
+}
+
+/* Forget which views cookies queued at prompt were received at */
+static void _cookie_permission_manager_pending_prompt_free_attachments(CookiePermissionManagerPendingPrompt *inPending)
+{
+	CookiePermissionManagerPendingAttachment	*attachment;
+	GSList										*iter;
+
+	for(iter=inPending->attachments; iter; iter=iter->next)
+	{
+		attachment=(CookiePermissionManagerPendingAttachment*)iter->data;
+
+		if(attachment->view) g_object_remove_weak_pointer(G_OBJECT(attachment->view), (gpointer*)&attachment->view);
+		g_slist_free(attachment->cookies);
+		g_free(attachment);
+	}
+
+	g_slist_free(inPending->attachments);
+	inPending->attachments=NULL;
+}
+
+/* User decided about cookies queued at a view. Store decision and add cookies
+ * to cookie jar or drop them. Info bar is destroyed afterwards by midori.
+ */
+static void _cookie_permission_manager_on_pending_prompt_decision(GtkWidget* inInfobar,
+																	gint inResponse,
+																	gpointer inUserData)
+{
+	CookiePermissionManagerPendingPrompt	*pending;
+	CookiePermissionManager					*self;
+	GSList									*cookies, *sortedCookies, *cookie;
+
+	pending=(CookiePermissionManagerPendingPrompt*)g_object_get_data(G_OBJECT(inInfobar), "cookie-permission-manager-pending-prompt");
+	if(!pending) return;
+
+	self=pending->manager;
+
+	/* Take queued cookies in order they were received. Decision applies to
+	 * cookies attached by other views as well.
+	 */
+	cookies=g_slist_reverse(pending->cookies);
+	pending->cookies=NULL;
+	pending->numberCookies=0;
+	_cookie_permission_manager_pending_prompt_free_attachments(pending);
+
+	/* Store decision for each domain once */
+	sortedCookies=_cookie_permission_manager_get_number_domains_and_cookies(self, cookies, NULL, NULL);
+	_cookie_permission_manager_store_decision(self, sortedCookies, inResponse);
+	g_slist_free(sortedCookies);
+
+	/* Commit cookies to cookie jar if accepted or drop them */
+	for(cookie=cookies; cookie; cookie=cookie->next)
+	{
+		if(inResponse==COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT ||
+			inResponse==COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION)
+		{
+			_cookie_permission_manager_commit_cookie(self, (SoupCookie*)cookie->data);
+		}
+			else soup_cookie_free((SoupCookie*)cookie->data);
+	}
+
+	g_slist_free(cookies);
+}
+
+/* Check if decision about a domain in registry of in-flight decisions is
+ * made by a prompt
+ */
+static gboolean _cookie_permission_manager_is_in_flight_at_prompt(gpointer inKey,
+																	gpointer inValue,
+																	gpointer inUserData)
+{
+	return(inValue==inUserData);
+}
+
+/* Info bar of a view was destroyed. Cookies of this view without decision are
+ * dropped as if user denied them this time. Cookies attached by other views were
+ * never asked about at their views so they are queued there again.
+ */
+static void _cookie_permission_manager_on_pending_prompt_destroy(GtkWidget* inInfobar,
+																	gpointer inUserData)
+{
+	CookiePermissionManagerPendingPrompt		*pending=(CookiePermissionManagerPendingPrompt*)inUserData;
+	CookiePermissionManager						*self=pending->manager;
+	CookiePermissionManagerPrivate				*priv=self->priv;
+	CookiePermissionManagerPendingAttachment	*attachment;
+	GSList										*attachments, *iter, *cookie;
+
+	if(pending->timeoutID) g_source_remove(pending->timeoutID);
+	pending->timeoutID=0;
+
+	/* Prompt is gone whether user decided or not */
+	cookie_permission_manager_statistics_record(priv->statistics, COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_PROMPT_WAIT, pending->shownTime);
+
+	g_signal_handlers_disconnect_by_func(pending->webkitView, G_CALLBACK(_cookie_permission_manager_on_infobar_webview_navigate), inInfobar);
+	g_object_set_data(G_OBJECT(pending->webkitView), "cookie-permission-manager-pending-prompt", NULL);
+	g_object_set_data(G_OBJECT(inInfobar), "cookie-permission-manager-pending-prompt", NULL);
+
+	priv->pendingPrompts=g_slist_remove(priv->pendingPrompts, pending);
+	g_hash_table_foreach_remove(priv->inFlightDecisions, _cookie_permission_manager_is_in_flight_at_prompt, pending);
+
+	/* Take out cookies attached by views still existing */
+	attachments=pending->attachments;
+	pending->attachments=NULL;
+
+	for(iter=attachments; iter; iter=iter->next)
+	{
+		attachment=(CookiePermissionManagerPendingAttachment*)iter->data;
+		if(!attachment->view) continue;
+
+		for(cookie=attachment->cookies; cookie; cookie=cookie->next)
+		{
+			pending->cookies=g_slist_remove(pending->cookies, cookie->data);
+		}
+	}
+
+	/* Free up allocated resources */
+	g_slist_free_full(pending->cookies, (GDestroyNotify)soup_cookie_free);
+	g_free(pending);
+
+	/* Queue attached cookies again at their views in order they were received */
+	for(iter=attachments; iter; iter=iter->next)
+	{
+		attachment=(CookiePermissionManagerPendingAttachment*)iter->data;
+
+		if(attachment->view)
+		{
+			g_object_remove_weak_pointer(G_OBJECT(attachment->view), (gpointer*)&attachment->view);
+
+			attachment->cookies=g_slist_reverse(attachment->cookies);
+			_cookie_permission_manager_queue_for_policy(self, attachment->view, attachment->cookies);
+		}
+
+		g_slist_free(attachment->cookies);
+		g_free(attachment);
+	}
+	g_slist_free(attachments);
+}
+
+/* User did not answer prompt in time so deny cookies queued this time */
+static gboolean _cookie_permission_manager_on_pending_prompt_timeout(gpointer inUserData)
+{
+	CookiePermissionManagerPendingPrompt	*pending=(CookiePermissionManagerPendingPrompt*)inUserData;
+
+	pending->timeoutID=0;
+	gtk_widget_destroy(pending->infobar);
 
-	renderer=gtk_cell_renderer_text_new();
-	column=gtk_tree_view_column_new_with_attributes(_("Value"),
-													renderer,
-													"text", VALUE_COLUMN,
-													NULL);
-	g_object_set(G_OBJECT(renderer),
-					"ellipsize", PANGO_ELLIPSIZE_END,
-					"width-chars", 30,
-					NULL);
-	gtk_tree_view_append_column(GTK_TREE_VIEW(list), column);
+	return(FALSE);
+}
 
-	renderer=gtk_cell_renderer_text_new();
-	column=gtk_tree_view_column_new_with_attributes(_("Expire date"),
-													renderer,
-													"text", EXPIRE_DATE_COLUMN,
-													NULL);
-	gtk_tree_view_append_column(GTK_TREE_VIEW(list), column);
+/* Show prompt asking for policy of all cookies queued at it or update its text
+ * if it is already shown
+ */
+static void _cookie_permission_manager_show_pending_prompt(CookiePermissionManager *self,
+															CookiePermissionManagerPendingPrompt *inPending,
+															MidoriView *inView)
+{
+	CookiePermissionManagerPrivate			*priv=self->priv;
+	GSList									*cookies, *sortedCookies;
+	gint									numberDomains, numberCookies;
+	gchar									*text;
 
-	scrolled=gtk_scrolled_window_new(NULL, NULL);
-#ifdef GTK__3_0_VERSION
-	gtk_scrolled_window_set_min_content_height(GTK_SCROLLED_WINDOW(scrolled), 100);
-#endif
-	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
-	gtk_container_add(GTK_CONTAINER(scrolled), list);
-	gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(scrolled), GTK_SHADOW_IN);
-	gtk_container_add(GTK_CONTAINER(expander), scrolled);
+	/* Describe all queued cookies */
+	cookies=g_slist_reverse(g_slist_copy(inPending->cookies));
+	sortedCookies=_cookie_permission_manager_get_number_domains_and_cookies(self, cookies, &numberDomains, &numberCookies);
+	text=_cookie_permission_manager_get_prompt_text(self, sortedCookies, numberDomains, numberCookies);
+	g_slist_free(sortedCookies);
+	g_slist_free(cookies);
 
-	gtk_widget_show_all(vbox);
-	gtk_container_add(GTK_CONTAINER(contentArea), vbox);
+	/* Update text of prompt already shown */
+	if(inPending->infobar)
+	{
+		_cookie_permission_manager_set_infobar_text(inPending->infobar, text);
+		g_free(text);
+		return;
+	}
 
-	/* Set state of expander based on config 'show-details-when-ask' */
-	gtk_expander_set_expanded(GTK_EXPANDER(expander),
-								midori_extension_get_boolean(priv->extension, "show-details-when-ask"));
-	g_signal_connect_swapped(expander, "notify::expanded", G_CALLBACK(_cookie_permission_manager_when_ask_expander_changed), self);
-#endif
+	/* Create info bar message and buttons */
+	inPending->infobar=midori_view_add_info_bar(inView,
+												GTK_MESSAGE_QUESTION,
+												text,
+												G_CALLBACK(_cookie_permission_manager_on_pending_prompt_decision),
+												NULL,
+												_("_Accept"), COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT,
+												_("Accept for this _session"), COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION,
+												_("De_ny"), COOKIE_PERMISSION_MANAGER_POLICY_BLOCK,
+												_("Deny _this time"), COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED,
+												NULL);
+	g_free(text);
 
-	/* Show all widgets of info bar */
-	gtk_widget_show_all(infobar);
+	g_object_set_data(G_OBJECT(inPending->infobar), "cookie-permission-manager-pending-prompt", inPending);
+	g_object_set_data(G_OBJECT(inPending->webkitView), "cookie-permission-manager-pending-prompt", inPending);
+	priv->pendingPrompts=g_slist_prepend(priv->pendingPrompts, inPending);
 
-	/* Connect signals to quit main loop */
-	g_signal_connect(webkitView, "navigation-policy-decision-requested", G_CALLBACK(_cookie_permission_manager_on_infobar_webview_navigate), infobar);
-	g_signal_connect(infobar, "destroy", G_CALLBACK(_cookie_permission_manager_on_infobar_destroy), &modalInfo);
+	gtk_widget_show_all(inPending->infobar);
+	inPending->shownTime=g_get_monotonic_time();
 
-	/* Let info bar be modal and set response to default */
-	modalInfo.response=COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED;
-	modalInfo.mainLoop=g_main_loop_new(NULL, FALSE);
+	/* Drop queued cookies if user navigates away, closes info bar or does not answer in time */
+	g_signal_connect(inPending->webkitView, "navigation-policy-decision-requested", G_CALLBACK(_cookie_permission_manager_on_infobar_webview_navigate), inPending->infobar);
+	g_signal_connect(inPending->infobar, "destroy", G_CALLBACK(_cookie_permission_manager_on_pending_prompt_destroy), inPending);
 
-	GDK_THREADS_LEAVE();
-	g_main_loop_run(modalInfo.mainLoop);
-	GDK_THREADS_ENTER();
+	if(priv->promptTimeout>0)
+	{
+		inPending->timeoutID=g_timeout_add_seconds(priv->promptTimeout, _cookie_permission_manager_on_pending_prompt_timeout, inPending);
+	}
+}
 
-	g_main_loop_unref(modalInfo.mainLoop);
+/* Queue undetermined cookies of a view and ask user for policy without waiting
+ * for the decision. Cookies received while info bar is shown are added to the
+ * same prompt. If user is already asked about a cookie's domain in any view the
+ * cookie is attached to that in-flight decision instead so user is asked only
+ * once per domain and the decision is stored once. Takes ownership of cookies.
+ */
+static void _cookie_permission_manager_queue_for_policy(CookiePermissionManager *self,
+														MidoriView *inView,
+														GSList *inUnknownCookies)
+{
+	CookiePermissionManagerPrivate			*priv=self->priv;
+	CookiePermissionManagerPendingPrompt	*pending, *target;
+	WebKitWebView							*webkitView;
+	GSList									*changedPrompts=NULL;
+	GSList									*cookie, *iter;
+	gchar									*key;
 
-	modalInfo.mainLoop=NULL;
+	/* Get webkit view of midori view and its pending prompt if any */
+	webkitView=WEBKIT_WEB_VIEW(midori_view_get_web_view(inView));
 
-	/* Disconnect signal handler to webkit's web view  */
-	g_signal_handlers_disconnect_by_func(webkitView, G_CALLBACK(_cookie_permission_manager_on_infobar_webview_navigate), infobar);
+	pending=(CookiePermissionManagerPendingPrompt*)g_object_get_data(G_OBJECT(webkitView), "cookie-permission-manager-pending-prompt");
+	if(!pending)
+	{
+		pending=g_new0(CookiePermissionManagerPendingPrompt, 1);
+		pending->manager=self;
+		pending->webkitView=webkitView;
+		pending->infobar=NULL;
+		pending->cookies=NULL;
+		pending->numberCookies=0;
+		pending->timeoutID=0;
+		pending->shownTime=0;
+		pending->attachments=NULL;
+	}
 
-	/* Store user's decision in database if it is not a temporary block.
-	 * We use the already sorted list of cookies to prevent multiple
-	 * updates of database for the same domain. This sorted list is a copy
-	 * to avoid a reorder of cookies
+	/* Queue each cookie at the prompt asking about its domain. Register domains
+	 * not asked about yet at prompt of this view. Cookies exceeding limit of queue
+	 * are denied this time and their domains are neither registered nor listed
+	 * at prompt unless other cookies of them are queued.
 	 */
-	if(modalInfo.response!=COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED)
+	for(cookie=inUnknownCookies; cookie; cookie=cookie->next)
 	{
-		const gchar					*lastDomain=NULL;
+		key=g_ascii_strdown(_cookie_permission_manager_get_decision_domain(self, soup_cookie_get_domain((SoupCookie*)cookie->data)), -1);
 
-		/* Iterate through cookies and store decision for each domain once */
-		for(cookies=sortedCookies; cookies; cookies=cookies->next)
+		target=(CookiePermissionManagerPendingPrompt*)g_hash_table_lookup(priv->inFlightDecisions, key);
+		if(!target) target=pending;
+
+		if(target->numberCookies>=PENDING_PROMPT_MAX_COOKIES)
 		{
-			SoupCookie				*cookie=(SoupCookie*)cookies->data;
-			const gchar				*cookieDomain=soup_cookie_get_domain(cookie);
+			soup_cookie_free((SoupCookie*)cookie->data);
+			g_free(key);
+			continue;
+		}
 
-			if(*cookieDomain=='.') cookieDomain++;
+		if(!g_hash_table_contains(priv->inFlightDecisions, key)) g_hash_table_insert(priv->inFlightDecisions, key, target);
+			else g_free(key);
 
-			/* Store decision if new domain found while iterating through cookies */
-			if(!lastDomain || g_ascii_strcasecmp(lastDomain, cookieDomain)!=0)
-			{
-				gchar	*sql;
-				gchar	*error=NULL;
-				gint	success;
-
-				sql=sqlite3_mprintf("INSERT OR REPLACE INTO policies (domain, value) VALUES ('%q', %d);",
-										cookieDomain,
-										modalInfo.response);
-				success=sqlite3_exec(priv->database, sql, NULL, NULL, &error);
-				if(success!=SQLITE_OK) g_warning(_("SQL fails: %s"), error);
-				if(error) sqlite3_free(error);
-				sqlite3_free(sql);
+		target->cookies=g_slist_prepend(target->cookies, cookie->data);
+		target->numberCookies++;
 
-				lastDomain=cookieDomain;
-			}
-		}
+		if(target!=pending) _cookie_permission_manager_pending_prompt_attach(target, inView, (SoupCookie*)cookie->data);
+
+		if(!g_slist_find(changedPrompts, target)) changedPrompts=g_slist_prepend(changedPrompts, target);
 	}
 
-	/* Free up allocated resources */
-	g_slist_free(sortedCookies);
+	/* Show or update all prompts which got new cookies */
+	for(iter=changedPrompts; iter; iter=iter->next)
+	{
+		_cookie_permission_manager_show_pending_prompt(self, (CookiePermissionManagerPendingPrompt*)iter->data, inView);
+	}
 
-	/* Return response */
-	return(modalInfo.response==COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED ?
-			COOKIE_PERMISSION_MANAGER_POLICY_BLOCK : modalInfo.response);
+	/* Release prompt of this view if all cookies were attached to other prompts */
+	if(!pending->infobar)
+	{
+		g_hash_table_foreach_remove(priv->inFlightDecisions, _cookie_permission_manager_is_in_flight_at_prompt, pending);
+		g_free(pending);
+	}
+
+	g_slist_free(changedPrompts);
 }
 
-/* A cookie was changed outside a request (e.g. Javascript) */
-static void _cookie_permission_manager_on_cookie_changed(CookiePermissionManager *self,
-															SoupCookie *inOldCookie,
-															SoupCookie *inNewCookie,
-															SoupCookieJar *inCookieJar)
+/* Class handler of cookie jar's "changed" signal replacing the one of cookie
+ * jar's class while manager is active. A cookie set outside a request (e.g. by
+ * Javascript) whose domain is not allowed to store cookies is taken out again
+ * before it is stored persistently and before any handler is notified about it.
+ */
+static void _cookie_permission_manager_on_cookie_jar_changed(SoupCookieJar *inCookieJar,
+																SoupCookie *inOldCookie,
+																SoupCookie *inNewCookie)
 {
+	CookiePermissionManager			*self;
+	CookiePermissionManagerPrivate	*priv;
+	gint64							startTime;
+
+	/* Cookie jars of same class not managed by us are handled as usual */
+	self=(CookiePermissionManager*)g_object_get_data(G_OBJECT(inCookieJar), "cookie-permission-manager");
+	if(!self)
+	{
+		if(CookiePermissionManagerCookieJarChanged) (CookiePermissionManagerCookieJarChanged)(inCookieJar, inOldCookie, inNewCookie);
+		return;
+	}
+
+	priv=self->priv;
+
+	/* Changes made by us were already checked or decided by user */
+	if(priv->ownChangesDepth>0)
+	{
+		if(inNewCookie && !inOldCookie) priv->skippedEvaluations++;
+
+		if(CookiePermissionManagerCookieJarChanged) (CookiePermissionManagerCookieJarChanged)(inCookieJar, inOldCookie, inNewCookie);
+		return;
+	}
+
+	/* Rejected cookie is removed from jar again so it never existed for anybody */
+	if(priv->isRejectingCookie)
+	{
+		g_signal_stop_emission_by_name(inCookieJar, "changed");
+		return;
+	}
+
 	/* Do not check changed cookies because they must have been allowed before.
 	 * Also do not check removed cookies because they are removed ;)
 	 */
-	if(inNewCookie==NULL || inOldCookie) return;
-
-	/* New cookie is a new cookie so check */
-	switch(_cookie_permission_manager_get_policy(self, inNewCookie))
+	if(inNewCookie && !inOldCookie)
 	{
-		case COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT:
-		case COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION:
-			break;
+		startTime=g_get_monotonic_time();
+
+		if(priv->traceWriter)
+		{
+			_cookie_permission_manager_record_cookie(self,
+														COOKIE_PERMISSION_MANAGER_TRACE_SOURCE_SCRIPT,
+														NULL,
+														inNewCookie,
+														g_get_real_time());
+		}
 
-		case COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED:
-			/* Fallthrough!
-			 * The problem here is that we don't know the view to ask user
-			 * for policy to follow for this cookie domain. Therefore we
-			 * delete the cookie from jar and assume that we will be asked
-			 * again in _cookie_permission_manager_on_response_received().
-			 */
+		switch(_cookie_permission_manager_get_policy(self, inNewCookie))
+		{
+			case COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT:
+			case COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION:
+				break;
 
-		default:
-			soup_cookie_jar_delete_cookie(inCookieJar, inNewCookie);
-			break;
+			case COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED:
+				/* Fallthrough!
+				 * The problem here is that we don't know the view to ask user
+				 * for policy to follow for this cookie domain. Therefore we
+				 * reject the cookie and assume that we will be asked again in
+				 * _cookie_permission_manager_on_response_received().
+				 */
+
+			default:
+				/* Do not chain up so cookie is not stored persistently and stop
+				 * emission so no handler gets notified. Cookie jar frees cookie
+				 * when removing it so it must not be accessed afterwards.
+				 */
+				g_signal_stop_emission_by_name(inCookieJar, "changed");
+
+				priv->isRejectingCookie=TRUE;
+				soup_cookie_jar_delete_cookie(inCookieJar, inNewCookie);
+				priv->isRejectingCookie=FALSE;
+
+				cookie_permission_manager_statistics_record(priv->statistics, COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_COOKIE_CHANGED, startTime);
+				return;
+		}
+
+		cookie_permission_manager_statistics_record(priv->statistics, COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_COOKIE_CHANGED, startTime);
 	}
+
+	/* Let cookie jar's class handle change, e.g. store it persistently */
+	if(CookiePermissionManagerCookieJarChanged) (CookiePermissionManagerCookieJarChanged)(inCookieJar, inOldCookie, inNewCookie);
 }
 
-/* We received the HTTP headers of the request and it contains cookie-managing headers */
-static void _cookie_permission_manager_on_response_received(WebKitWebView *inView,
-															WebKitWebFrame *inFrame,
-															WebKitWebResource *inResource,
-															WebKitNetworkResponse *inResponse,
-															gpointer inUserData)
+/* Sort cookies of a response by their policies into accepted and undetermined
+ * ones. Blocked cookies and cookies not allowed by cookie jar's accept policy
+ * are freed. Returned lists keep order of cookies and must be freed by caller.
+ */
+static void _cookie_permission_manager_classify_cookies(CookiePermissionManager *self,
+														SoupMessage *inMessage,
+														GSList *inCookies,
+														GSList **outAcceptedCookies,
+														GSList **outUnknownCookies)
 {
-	g_return_if_fail(IS_COOKIE_PERMISSION_MANAGER(inUserData));
-
-	CookiePermissionManager			*self=COOKIE_PERMISSION_MANAGER(inUserData);
 	CookiePermissionManagerPrivate	*priv=self->priv;
-	GSList							*newCookies, *cookie;
+	GSList							*cookie;
 	GSList							*unknownCookies=NULL, *acceptedCookies=NULL;
+	GHashTable						*policies;
 	SoupURI							*firstParty;
 	SoupCookieJarAcceptPolicy		cookiePolicy;
-	gint							unknownCookiesPolicy;
-	SoupMessage						*message;
-
-	/* If policy is to deny all cookies return immediately */
-	cookiePolicy=soup_cookie_jar_get_accept_policy(priv->cookieJar);
-	if(cookiePolicy==SOUP_COOKIE_JAR_ACCEPT_NEVER) return;
-
-	/* Get SoupMessage */
-	message=webkit_network_response_get_message(inResponse);
-	if(!message || !SOUP_IS_MESSAGE(message)) return;
 
 	/* Iterate through cookies in response and check if they should be
 	 * blocked (remove from cookies list) or accepted (added to cookie jar).
 	 * If we could not determine what to do collect these cookies and
 	 * ask user
 	 */
-	newCookies=soup_cookies_from_response(message);
-	firstParty=soup_message_get_first_party(message);
-	for(cookie=newCookies; cookie; cookie=cookie->next)
+	cookiePolicy=soup_cookie_jar_get_accept_policy(priv->cookieJar);
+	firstParty=soup_message_get_first_party(inMessage);
+
+	/* Record all cookies of response with same timestamp so they can be
+	 * replayed as one response
+	 */
+	if(priv->traceWriter)
+	{
+		gint64						timestamp=g_get_real_time();
+
+		for(cookie=inCookies; cookie; cookie=cookie->next)
+		{
+			_cookie_permission_manager_record_cookie(self,
+														COOKIE_PERMISSION_MANAGER_TRACE_SOURCE_RESPONSE,
+														firstParty ? firstParty->host : NULL,
+														(SoupCookie*)cookie->data,
+														timestamp);
+		}
+	}
+
+	policies=_cookie_permission_manager_get_policies(self, inCookies);
+	for(cookie=inCookies; cookie; cookie=cookie->next)
 	{
-		switch(_cookie_permission_manager_get_policy(self, cookie->data))
+		switch(GPOINTER_TO_INT(g_hash_table_lookup(policies, soup_cookie_get_domain((SoupCookie*)cookie->data))))
 		{
 			case COOKIE_PERMISSION_MANAGER_POLICY_BLOCK:
 				soup_cookie_free(cookie->data);
@@ -782,12 +1992,182 @@ static void _cookie_permission_manager_on_response_received(WebKitWebView *inVie
 		}
 	}
 
-	/* Prepending an item to list is the fastest method but the order of cookies
-	 * is reversed now and may be added to cookie jar in the wrong order. So we
-	 * need to reverse list now of both - undetermined and accepted cookies
-	 */
-	unknownCookies=g_slist_reverse(unknownCookies);
-	acceptedCookies=g_slist_reverse(acceptedCookies);
+	/* Resolved policies are not needed anymore */
+	g_hash_table_destroy(policies);
+
+	/* Prepending an item to list is the fastest method but the order of cookies
+	 * is reversed now and may be added to cookie jar in the wrong order. So we
+	 * need to reverse list now of both - undetermined and accepted cookies
+	 */
+	*outUnknownCookies=g_slist_reverse(unknownCookies);
+	*outAcceptedCookies=g_slist_reverse(acceptedCookies);
+}
+
+/* Free a list of cookies and the cookies in it */
+static void _cookie_permission_manager_free_cookies(gpointer inCookies)
+{
+	g_slist_free_full((GSList*)inCookies, (GDestroyNotify)soup_cookie_free);
+}
+
+/* Headers of a response were received at session level and contain cookies.
+ * This handler runs instead of the one of cookie jar for all views. Set-Cookie
+ * headers of cookies not allowed are stripped and allowed cookies are stored
+ * in cookie jar so blocked cookies never reach it. Undetermined cookies are
+ * attached to message to ask user when the view receives the response.
+ */
+static void _cookie_permission_manager_on_message_got_headers(SoupMessage *inMessage, gpointer inUserData)
+{
+	CookiePermissionManager			*self=COOKIE_PERMISSION_MANAGER(inUserData);
+	CookiePermissionManagerPrivate	*priv=self->priv;
+	GSList							*newCookies, *cookie;
+	GSList							*unknownCookies=NULL, *acceptedCookies=NULL;
+	gchar							*header;
+
+	/* Mark message as filtered so view does not process its headers again */
+	g_object_set_data(G_OBJECT(inMessage), "cookie-permission-manager-filtered", GINT_TO_POINTER(TRUE));
+
+	/* If policy is to deny all cookies strip all of them */
+	newCookies=NULL;
+	if(soup_cookie_jar_get_accept_policy(priv->cookieJar)!=SOUP_COOKIE_JAR_ACCEPT_NEVER)
+	{
+		newCookies=soup_cookies_from_response(inMessage);
+		_cookie_permission_manager_classify_cookies(self, inMessage, newCookies, &acceptedCookies, &unknownCookies);
+	}
+
+	/* Keep only headers of accepted cookies and store these cookies in cookie jar */
+	soup_message_headers_remove(inMessage->response_headers, "Set-Cookie");
+
+	for(cookie=acceptedCookies; cookie; cookie=cookie->next)
+	{
+		header=soup_cookie_to_set_cookie_header((SoupCookie*)cookie->data);
+		soup_message_headers_append(inMessage->response_headers, "Set-Cookie", header);
+		g_free(header);
+
+		_cookie_permission_manager_commit_cookie(self, (SoupCookie*)cookie->data);
+	}
+
+	/* Remember undetermined cookies until view asks user. If no view does they
+	 * follow policy for unknown cookie domains when message is unqueued.
+	 */
+	if(unknownCookies)
+	{
+		g_object_set_data_full(G_OBJECT(inMessage),
+								"cookie-permission-manager-unknown-cookies",
+								unknownCookies,
+								_cookie_permission_manager_free_cookies);
+	}
+
+	/* Free list of cookies */
+	g_slist_free(acceptedCookies);
+	g_slist_free(newCookies);
+}
+
+/* A message was queued in session. Block handler of cookie jar processing
+ * Set-Cookie headers of response and filter them in our handler instead.
+ */
+static void _cookie_permission_manager_on_request_queued(CookiePermissionManager *self,
+															SoupMessage *inMessage,
+															SoupSession *inSession)
+{
+	CookiePermissionManagerPrivate	*priv=self->priv;
+
+	if(g_hash_table_contains(priv->filteredMessages, inMessage)) return;
+
+	g_signal_handlers_block_matched(inMessage, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, priv->cookieJar);
+	soup_message_add_header_handler(inMessage,
+									"got-headers",
+									"Set-Cookie",
+									G_CALLBACK(_cookie_permission_manager_on_message_got_headers),
+									self);
+
+	g_hash_table_add(priv->filteredMessages, g_object_ref(inMessage));
+}
+
+/* A message was removed from session. Undetermined cookies of a message not
+ * loaded by any view (e.g. downloads, favicons or prefetched resources) are left
+ * because no view took them to ask user. As nobody can be asked they follow the
+ * policy for unknown cookie domains, i.e. the global cookie policy of cookie jar.
+ */
+static void _cookie_permission_manager_on_request_unqueued(CookiePermissionManager *self,
+															SoupMessage *inMessage,
+															SoupSession *inSession)
+{
+	GSList							*unknownCookies, *cookie;
+	SoupCookie						*unknownCookie;
+
+	unknownCookies=(GSList*)g_object_steal_data(G_OBJECT(inMessage), "cookie-permission-manager-unknown-cookies");
+	for(cookie=unknownCookies; cookie; cookie=cookie->next)
+	{
+		unknownCookie=(SoupCookie*)cookie->data;
+
+		switch(_cookie_permission_manager_get_unknown_policy(self, soup_cookie_get_domain(unknownCookie)))
+		{
+			case COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT:
+				_cookie_permission_manager_commit_cookie(self, unknownCookie);
+				break;
+
+			default:
+				soup_cookie_free(unknownCookie);
+				break;
+		}
+	}
+	g_slist_free(unknownCookies);
+
+	g_hash_table_remove(self->priv->filteredMessages, inMessage);
+}
+
+/* Stop filtering a message and hand it back to cookie jar */
+static void _cookie_permission_manager_release_filtered_message(gpointer inMessage, gpointer inUnused, gpointer inUserData)
+{
+	CookiePermissionManager			*self=COOKIE_PERMISSION_MANAGER(inUserData);
+
+	g_signal_handlers_disconnect_by_func(inMessage, G_CALLBACK(_cookie_permission_manager_on_message_got_headers), self);
+	g_signal_handlers_unblock_matched(inMessage, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, self->priv->cookieJar);
+}
+
+/* We received the HTTP headers of the request and it contains cookie-managing headers */
+static void _cookie_permission_manager_on_response_received(WebKitWebView *inView,
+															WebKitWebFrame *inFrame,
+															WebKitWebResource *inResource,
+															WebKitNetworkResponse *inResponse,
+															gpointer inUserData)
+{
+	g_return_if_fail(IS_COOKIE_PERMISSION_MANAGER(inUserData));
+
+	CookiePermissionManager			*self=COOKIE_PERMISSION_MANAGER(inUserData);
+	CookiePermissionManagerPrivate	*priv=self->priv;
+	GSList							*newCookies=NULL, *cookie;
+	GSList							*unknownCookies=NULL, *acceptedCookies=NULL;
+	gint							unknownCookiesPolicy;
+	SoupMessage						*message;
+	gint64							startTime;
+
+	/* Get SoupMessage */
+	message=webkit_network_response_get_message(inResponse);
+	if(!message || !SOUP_IS_MESSAGE(message)) return;
+
+	startTime=g_get_monotonic_time();
+
+	/* Cookies of response were filtered at session level already so only
+	 * undetermined ones are left to ask user for. Otherwise (e.g. message
+	 * was queued before we got activated) filter cookies now.
+	 */
+	if(g_object_get_data(G_OBJECT(message), "cookie-permission-manager-filtered"))
+	{
+		unknownCookies=(GSList*)g_object_steal_data(G_OBJECT(message), "cookie-permission-manager-unknown-cookies");
+	}
+		else
+		{
+			/* If policy is to deny all cookies return immediately */
+			if(soup_cookie_jar_get_accept_policy(priv->cookieJar)==SOUP_COOKIE_JAR_ACCEPT_NEVER)
+			{
+				cookie_permission_manager_statistics_record(priv->statistics, COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_RESPONSE, startTime);
+				return;
+			}
+
+			newCookies=soup_cookies_from_response(message);
+			_cookie_permission_manager_classify_cookies(self, message, newCookies, &acceptedCookies, &unknownCookies);
+		}
 
 	/* Ask user for his decision what to do with cookies whose policy is undetermined
 	 * But only ask if there is any undetermined one
@@ -799,37 +2179,48 @@ static void _cookie_permission_manager_on_response_received(WebKitWebView *inVie
 
 		view=MIDORI_VIEW(g_object_get_data(G_OBJECT(inView), "midori-view"));
 
-		/* Ask for user's decision */
-		unknownCookiesPolicy=_cookie_permission_manager_ask_for_policy(self, view, message, unknownCookies);
-		if(unknownCookiesPolicy==COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT ||
-			unknownCookiesPolicy==COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION)
-		{
-			/* Add accepted undetermined cookies to cookie jar */
-			for(cookie=unknownCookies; cookie; cookie=cookie->next)
-			{
-				soup_cookie_jar_add_cookie(priv->cookieJar, (SoupCookie*)cookie->data);
-			}
-		}
+		/* Queue cookies and return at once if user should be asked asynchronously.
+		 * The queue takes ownership of cookies and adds them to cookie jar when
+		 * user decided.
+		 */
+		if(priv->askAsynchronously) _cookie_permission_manager_queue_for_policy(self, view, unknownCookies);
 			else
 			{
-				/* Free cookies because they should be blocked */
-				for(cookie=unknownCookies; cookie; cookie=cookie->next)
+				/* Ask for user's decision */
+				unknownCookiesPolicy=_cookie_permission_manager_ask_for_policy(self, view, message, unknownCookies);
+				if(unknownCookiesPolicy==COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT ||
+					unknownCookiesPolicy==COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION)
 				{
-					soup_cookie_free((SoupCookie*)cookie->data);
+					/* Add accepted undetermined cookies to cookie jar */
+					for(cookie=unknownCookies; cookie; cookie=cookie->next)
+					{
+						_cookie_permission_manager_commit_cookie(self, (SoupCookie*)cookie->data);
+					}
 				}
+					else
+					{
+						/* Free cookies because they should be blocked */
+						for(cookie=unknownCookies; cookie; cookie=cookie->next)
+						{
+							soup_cookie_free((SoupCookie*)cookie->data);
+						}
+					}
 			}
 	}
 
 	/* Add accepted cookies to cookie jar */
 	for(cookie=acceptedCookies; cookie; cookie=cookie->next)
 	{
-		soup_cookie_jar_add_cookie(priv->cookieJar, (SoupCookie*)cookie->data);
+		_cookie_permission_manager_commit_cookie(self, (SoupCookie*)cookie->data);
 	}
 
 	/* Free list of cookies */
 	g_slist_free(unknownCookies);
 	g_slist_free(acceptedCookies);
 	g_slist_free(newCookies);
+
+	/* Time includes waiting for user if asked synchronously */
+	cookie_permission_manager_statistics_record(priv->statistics, COOKIE_PERMISSION_MANAGER_STATISTICS_TIMER_RESPONSE, startTime);
 }
 
 /* A tab to a browser was added */
@@ -890,7 +2281,44 @@ static void cookie_permission_manager_finalize(GObject *inObject)
 	GList							*tabs, *tab;
 	WebKitWebView					*webkitView;
 
-	/* Dispose allocated resources */
+	/* Close prompts still waiting for user's decision and drop their cookies
+	 * including the ones attached by other views
+	 */
+	while(priv->pendingPrompts)
+	{
+		CookiePermissionManagerPendingPrompt	*pending=(CookiePermissionManagerPendingPrompt*)priv->pendingPrompts->data;
+
+		_cookie_permission_manager_pending_prompt_free_attachments(pending);
+		gtk_widget_destroy(pending->infobar);
+	}
+
+	g_hash_table_destroy(priv->inFlightDecisions);
+	priv->inFlightDecisions=NULL;
+
+	if(priv->traceWriter)
+	{
+		cookie_permission_manager_trace_writer_free(priv->traceWriter);
+		priv->traceWriter=NULL;
+	}
+
+	/* Cookies allowed for this session only must not outlive it */
+	_cookie_permission_manager_evict_session_cookies(self,
+														priv->sessionPolicies,
+														cookie_permission_manager_policy_snapshot_get_session_patterns(_cookie_permission_manager_get_policy_snapshot(self)));
+
+	/* Dispose allocated resources but write all queued decisions before */
+	if(priv->checkpointID)
+	{
+		g_source_remove(priv->checkpointID);
+		priv->checkpointID=0;
+	}
+
+	if(priv->writeQueue)
+	{
+		cookie_permission_manager_write_queue_free(priv->writeQueue);
+		priv->writeQueue=NULL;
+	}
+
 	if(priv->databaseFilename)
 	{
 		g_free(priv->databaseFilename);
@@ -898,6 +2326,12 @@ static void cookie_permission_manager_finalize(GObject *inObject)
 		g_object_notify_by_pspec(inObject, CookiePermissionManagerProperties[PROP_DATABASE_FILENAME]);
 	}
 
+	if(priv->statements)
+	{
+		cookie_permission_manager_statement_registry_free(priv->statements);
+		priv->statements=NULL;
+	}
+
 	if(priv->database)
 	{
 		sqlite3_close(priv->database);
@@ -905,7 +2339,26 @@ static void cookie_permission_manager_finalize(GObject *inObject)
 		g_object_notify_by_pspec(inObject, CookiePermissionManagerProperties[PROP_DATABASE]);
 	}
 
-	g_signal_handler_disconnect(priv->cookieJar, priv->cookieJarChangedID);
+	_cookie_permission_manager_release_policies(self);
+
+	g_hash_table_destroy(priv->sessionPolicies);
+	priv->sessionPolicies=NULL;
+
+	cookie_permission_manager_policy_snapshot_slot_free(priv->snapshots);
+	priv->snapshots=NULL;
+
+	cookie_permission_manager_statistics_free(priv->statistics);
+	priv->statistics=NULL;
+
+	/* Hand messages still in session back to cookie jar */
+	g_signal_handlers_disconnect_by_data(priv->session, self);
+	g_hash_table_foreach(priv->filteredMessages, _cookie_permission_manager_release_filtered_message, self);
+	g_hash_table_destroy(priv->filteredMessages);
+	priv->filteredMessages=NULL;
+
+	/* Restore class handler of cookie jar's "changed" signal */
+	SOUP_COOKIE_JAR_GET_CLASS(priv->cookieJar)->changed=CookiePermissionManagerCookieJarChanged;
+	CookiePermissionManagerCookieJarChanged=NULL;
 	g_object_steal_data(G_OBJECT(priv->cookieJar), "cookie-permission-manager");
 
 	g_signal_handlers_disconnect_by_data(priv->application, self);
@@ -942,6 +2395,8 @@ static void cookie_permission_manager_set_property(GObject *inObject,
 		/* Construct-only properties */
 		case PROP_EXTENSION:
 			self->priv->extension=g_value_get_object(inValue);
+			self->priv->memoryBudget=midori_extension_get_integer(self->priv->extension, "memory-budget");
+			self->priv->durability=midori_extension_get_integer(self->priv->extension, "durability");
 			_cookie_permission_manager_open_database(self);
 			break;
 
@@ -954,6 +2409,30 @@ static void cookie_permission_manager_set_property(GObject *inObject,
 			cookie_permission_manager_set_ask_for_unknown_policy(self, g_value_get_boolean(inValue));
 			break;
 
+		case PROP_MEMORY_BUDGET:
+			cookie_permission_manager_set_memory_budget(self, g_value_get_uint(inValue));
+			break;
+
+		case PROP_GROUP_BY_REGISTRABLE_DOMAIN:
+			cookie_permission_manager_set_group_by_registrable_domain(self, g_value_get_boolean(inValue));
+			break;
+
+		case PROP_DURABILITY:
+			cookie_permission_manager_set_durability(self, g_value_get_enum(inValue));
+			break;
+
+		case PROP_ASK_ASYNCHRONOUSLY:
+			cookie_permission_manager_set_ask_asynchronously(self, g_value_get_boolean(inValue));
+			break;
+
+		case PROP_PROMPT_TIMEOUT:
+			cookie_permission_manager_set_prompt_timeout(self, g_value_get_uint(inValue));
+			break;
+
+		case PROP_RECORD_TRACE:
+			cookie_permission_manager_set_record_trace(self, g_value_get_boolean(inValue));
+			break;
+
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(inObject, inPropID, inSpec);
 			break;
@@ -989,6 +2468,42 @@ static void cookie_permission_manager_get_property(GObject *inObject,
 			g_value_set_boolean(outValue, self->priv->askForUnknownPolicy);
 			break;
 
+		case PROP_MEMORY_BUDGET:
+			g_value_set_uint(outValue, self->priv->memoryBudget);
+			break;
+
+		case PROP_SAVED_LOOKUPS:
+			g_value_set_uint64(outValue, self->priv->savedLookups);
+			break;
+
+		case PROP_SKIPPED_EVALUATIONS:
+			g_value_set_uint64(outValue, self->priv->skippedEvaluations);
+			break;
+
+		case PROP_STATISTICS:
+			g_value_set_pointer(outValue, self->priv->statistics);
+			break;
+
+		case PROP_GROUP_BY_REGISTRABLE_DOMAIN:
+			g_value_set_boolean(outValue, self->priv->groupByRegistrableDomain);
+			break;
+
+		case PROP_DURABILITY:
+			g_value_set_enum(outValue, self->priv->durability);
+			break;
+
+		case PROP_ASK_ASYNCHRONOUSLY:
+			g_value_set_boolean(outValue, self->priv->askAsynchronously);
+			break;
+
+		case PROP_PROMPT_TIMEOUT:
+			g_value_set_uint(outValue, self->priv->promptTimeout);
+			break;
+
+		case PROP_RECORD_TRACE:
+			g_value_set_boolean(outValue, self->priv->traceWriter!=NULL);
+			break;
+
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(inObject, inPropID, inSpec);
 			break;
@@ -1042,11 +2557,100 @@ static void cookie_permission_manager_class_init(CookiePermissionManagerClass *k
 		g_param_spec_boolean("ask-for-unknown-policy",
 								_("Ask for unknown policy"),
 								_("If true this extension ask for policy for every unknown domain."
-								  "If false this extension uses the global cookie policy set in Midori settings."),
+								  "If false this extension uses the global cookie policy set in Midori settings. "
+								  "Cookies received outside any view, e.g. by downloads, always follow the global cookie policy."),
 								TRUE,
 								G_PARAM_READWRITE | G_PARAM_CONSTRUCT);
 
+	CookiePermissionManagerProperties[PROP_MEMORY_BUDGET]=
+		g_param_spec_uint("memory-budget",
+								_("Memory budget"),
+								_("Maximum memory in KiB to spend on policies held in memory. "
+								  "If zero all policies are held in memory."),
+								0, G_MAXUINT,
+								0,
+								G_PARAM_READWRITE);
+
+	CookiePermissionManagerProperties[PROP_SAVED_LOOKUPS]=
+		g_param_spec_uint64("saved-lookups",
+								_("Saved lookups"),
+								_("Number of policy lookups saved by resolving each cookie domain of a response only once"),
+								0, G_MAXUINT64,
+								0,
+								G_PARAM_READABLE);
+
+	CookiePermissionManagerProperties[PROP_SKIPPED_EVALUATIONS]=
+		g_param_spec_uint64("skipped-evaluations",
+								_("Skipped evaluations"),
+								_("Number of policy evaluations skipped for cookies added to cookie jar by manager itself"),
+								0, G_MAXUINT64,
+								0,
+								G_PARAM_READABLE);
+
+	CookiePermissionManagerProperties[PROP_STATISTICS]=
+		g_param_spec_pointer("statistics",
+								_("Statistics"),
+								_("Call counts, outcomes and latency histograms of cookie decision path"),
+								G_PARAM_READABLE);
+
+	CookiePermissionManagerProperties[PROP_GROUP_BY_REGISTRABLE_DOMAIN]=
+		g_param_spec_boolean("group-by-registrable-domain",
+								_("Group by registrable domain"),
+								_("If true policy decisions are made and stored for the registrable domain "
+								  "(public suffix plus one label) instead of each host."),
+								FALSE,
+								G_PARAM_READWRITE);
+
+	CookiePermissionManagerProperties[PROP_DURABILITY]=
+		g_param_spec_enum("durability",
+							_("Durability"),
+							_("How policies are written to database: strict (sync at each commit), "
+							  "write-ahead log (sync at checkpoints) or memory-first (checkpoint periodically)"),
+							COOKIE_PERMISSION_MANAGER_TYPE_DURABILITY,
+							COOKIE_PERMISSION_MANAGER_DURABILITY_WAL,
+							G_PARAM_READWRITE);
+
+	CookiePermissionManagerProperties[PROP_ASK_ASYNCHRONOUSLY]=
+		g_param_spec_boolean("ask-asynchronously",
+								_("Ask asynchronously"),
+								_("If true undetermined cookies are queued per view while asking user "
+								  "and loading continues instead of waiting for user's decision"),
+								TRUE,
+								G_PARAM_READWRITE);
+
+	CookiePermissionManagerProperties[PROP_PROMPT_TIMEOUT]=
+		g_param_spec_uint("prompt-timeout",
+								_("Prompt timeout"),
+								_("Seconds to wait for user's decision when asking asynchronously "
+								  "before queued cookies are denied this time. If zero wait forever."),
+								0, G_MAXUINT,
+								120,
+								G_PARAM_READWRITE);
+
+	CookiePermissionManagerProperties[PROP_RECORD_TRACE]=
+		g_param_spec_boolean("record-trace",
+								_("Record trace"),
+								_("If true all cookies about to be stored are appended to trace file "
+								  "in configuration folder of extension to replay them offline"),
+								FALSE,
+								G_PARAM_READWRITE);
+
 	g_object_class_install_properties(gobjectClass, PROP_LAST, CookiePermissionManagerProperties);
+
+	/* Define signals */
+	CookiePermissionManagerSignals[SIGNAL_POLICY_CHANGED]=
+		g_signal_new("policy-changed",
+						G_TYPE_FROM_CLASS(klass),
+						G_SIGNAL_RUN_LAST,
+						G_STRUCT_OFFSET(CookiePermissionManagerClass, policy_changed),
+						NULL,
+						NULL,
+						g_cclosure_marshal_generic,
+						G_TYPE_NONE,
+						3,
+						G_TYPE_STRING,
+						COOKIE_PERMISSION_MANAGER_TYPE_POLICY,
+						COOKIE_PERMISSION_MANAGER_TYPE_POLICY);
 }
 
 /* Object initialization
@@ -1060,8 +2664,29 @@ static void cookie_permission_manager_init(CookiePermissionManager *self)
 
 	/* Set up default values */
 	priv->database=NULL;
+	priv->statements=NULL;
+	priv->writeQueue=NULL;
 	priv->databaseFilename=NULL;
 	priv->askForUnknownPolicy=TRUE;
+	priv->memoryBudget=0;
+	priv->savedLookups=0;
+	priv->skippedEvaluations=0;
+	priv->statistics=cookie_permission_manager_statistics_new();
+	priv->groupByRegistrableDomain=FALSE;
+	priv->durability=COOKIE_PERMISSION_MANAGER_DURABILITY_WAL;
+	priv->checkpointID=0;
+	priv->askAsynchronously=TRUE;
+	priv->promptTimeout=120;
+	priv->pendingPrompts=NULL;
+	priv->inFlightDecisions=g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	priv->filteredMessages=g_hash_table_new_full(g_direct_hash, g_direct_equal, g_object_unref, NULL);
+	priv->traceWriter=NULL;
+	priv->snapshots=cookie_permission_manager_policy_snapshot_slot_new(cookie_permission_manager_policy_snapshot_new(NULL, NULL));
+	priv->policyDraft=NULL;
+	priv->policyCache=NULL;
+	priv->policyFilter=NULL;
+	priv->sessionPolicies=g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	priv->sessionPoliciesChanged=FALSE;
 
 	/* Hijack session's cookie jar to handle cookies requests on our own in HTTP streams
 	 * but remember old handlers to restore them on deactivation
@@ -1071,8 +2696,17 @@ static void cookie_permission_manager_init(CookiePermissionManager *self)
 	priv->featureIface=SOUP_SESSION_FEATURE_GET_CLASS(priv->cookieJar);
 	g_object_set_data(G_OBJECT(priv->cookieJar), "cookie-permission-manager", self);
 
-	/* Listen to changed cookies set or changed by other sources like javascript */
-	priv->cookieJarChangedID=g_signal_connect_swapped(priv->cookieJar, "changed", G_CALLBACK(_cookie_permission_manager_on_cookie_changed), self);
+	/* Filter cookies of all responses at session level before they reach cookie jar */
+	g_signal_connect_swapped(priv->session, "request-queued", G_CALLBACK(_cookie_permission_manager_on_request_queued), self);
+	g_signal_connect_swapped(priv->session, "request-unqueued", G_CALLBACK(_cookie_permission_manager_on_request_unqueued), self);
+
+	/* Check cookies set by other sources like javascript before cookie jar's class
+	 * handler stores them by replacing it with our own one for the time being
+	 */
+	priv->isRejectingCookie=FALSE;
+	priv->ownChangesDepth=0;
+	CookiePermissionManagerCookieJarChanged=SOUP_COOKIE_JAR_GET_CLASS(priv->cookieJar)->changed;
+	SOUP_COOKIE_JAR_GET_CLASS(priv->cookieJar)->changed=_cookie_permission_manager_on_cookie_jar_changed;
 }
 
 /* Implementation: Public API */
@@ -1106,6 +2740,346 @@ void cookie_permission_manager_set_ask_for_unknown_policy(CookiePermissionManage
 	}
 }
 
+/* Get/set maximum memory to spend on policies held in memory */
+guint cookie_permission_manager_get_memory_budget(CookiePermissionManager *self)
+{
+	g_return_val_if_fail(IS_COOKIE_PERMISSION_MANAGER(self), 0);
+
+	return(self->priv->memoryBudget);
+}
+
+void cookie_permission_manager_set_memory_budget(CookiePermissionManager *self, guint inBudget)
+{
+	g_return_if_fail(IS_COOKIE_PERMISSION_MANAGER(self));
+
+	if(inBudget!=self->priv->memoryBudget)
+	{
+		self->priv->memoryBudget=inBudget;
+		midori_extension_set_integer(self->priv->extension, "memory-budget", inBudget);
+
+		/* Reload policies to switch between unbounded and bounded-memory mode */
+		_cookie_permission_manager_load_policies(self);
+
+		g_object_notify_by_pspec(G_OBJECT(self), CookiePermissionManagerProperties[PROP_MEMORY_BUDGET]);
+	}
+}
+
+/* Get/set if policy decisions are grouped by registrable domain */
+gboolean cookie_permission_manager_get_group_by_registrable_domain(CookiePermissionManager *self)
+{
+	g_return_val_if_fail(IS_COOKIE_PERMISSION_MANAGER(self), FALSE);
+
+	return(self->priv->groupByRegistrableDomain);
+}
+
+void cookie_permission_manager_set_group_by_registrable_domain(CookiePermissionManager *self, gboolean inDoGroup)
+{
+	g_return_if_fail(IS_COOKIE_PERMISSION_MANAGER(self));
+
+	if(inDoGroup!=self->priv->groupByRegistrableDomain)
+	{
+		self->priv->groupByRegistrableDomain=inDoGroup;
+		midori_extension_set_boolean(self->priv->extension, "group-by-registrable-domain", inDoGroup);
+		g_object_notify_by_pspec(G_OBJECT(self), CookiePermissionManagerProperties[PROP_GROUP_BY_REGISTRABLE_DOMAIN]);
+	}
+}
+
+/* Get/set durability profile of database. Changing it reopens database. */
+CookiePermissionManagerDurability cookie_permission_manager_get_durability(CookiePermissionManager *self)
+{
+	g_return_val_if_fail(IS_COOKIE_PERMISSION_MANAGER(self), COOKIE_PERMISSION_MANAGER_DURABILITY_STRICT);
+
+	return(self->priv->durability);
+}
+
+void cookie_permission_manager_set_durability(CookiePermissionManager *self, CookiePermissionManagerDurability inDurability)
+{
+	g_return_if_fail(IS_COOKIE_PERMISSION_MANAGER(self));
+
+	if(inDurability!=self->priv->durability)
+	{
+		self->priv->durability=inDurability;
+		midori_extension_set_integer(self->priv->extension, "durability", inDurability);
+
+		/* Reopen database to apply durability to all connections */
+		_cookie_permission_manager_open_database(self);
+
+		g_object_notify_by_pspec(G_OBJECT(self), CookiePermissionManagerProperties[PROP_DURABILITY]);
+	}
+}
+
+/* Get/set if user is asked for policy without waiting for decision */
+gboolean cookie_permission_manager_get_ask_asynchronously(CookiePermissionManager *self)
+{
+	g_return_val_if_fail(IS_COOKIE_PERMISSION_MANAGER(self), FALSE);
+
+	return(self->priv->askAsynchronously);
+}
+
+void cookie_permission_manager_set_ask_asynchronously(CookiePermissionManager *self, gboolean inDoAsync)
+{
+	g_return_if_fail(IS_COOKIE_PERMISSION_MANAGER(self));
+
+	if(inDoAsync!=self->priv->askAsynchronously)
+	{
+		self->priv->askAsynchronously=inDoAsync;
+		midori_extension_set_boolean(self->priv->extension, "ask-asynchronously", inDoAsync);
+		g_object_notify_by_pspec(G_OBJECT(self), CookiePermissionManagerProperties[PROP_ASK_ASYNCHRONOUSLY]);
+	}
+}
+
+/* Get/set seconds to wait for user's decision when asking asynchronously.
+ * Prompts already shown keep their timeout.
+ */
+guint cookie_permission_manager_get_prompt_timeout(CookiePermissionManager *self)
+{
+	g_return_val_if_fail(IS_COOKIE_PERMISSION_MANAGER(self), 0);
+
+	return(self->priv->promptTimeout);
+}
+
+void cookie_permission_manager_set_prompt_timeout(CookiePermissionManager *self, guint inTimeout)
+{
+	g_return_if_fail(IS_COOKIE_PERMISSION_MANAGER(self));
+
+	if(inTimeout!=self->priv->promptTimeout)
+	{
+		self->priv->promptTimeout=inTimeout;
+		midori_extension_set_integer(self->priv->extension, "prompt-timeout", inTimeout);
+		g_object_notify_by_pspec(G_OBJECT(self), CookiePermissionManagerProperties[PROP_PROMPT_TIMEOUT]);
+	}
+}
+
+/* Get/set if cookies about to be stored are recorded to trace file */
+gboolean cookie_permission_manager_get_record_trace(CookiePermissionManager *self)
+{
+	g_return_val_if_fail(IS_COOKIE_PERMISSION_MANAGER(self), FALSE);
+
+	return(self->priv->traceWriter!=NULL);
+}
+
+void cookie_permission_manager_set_record_trace(CookiePermissionManager *self, gboolean inDoRecord)
+{
+	CookiePermissionManagerPrivate	*priv;
+	const gchar						*configDir;
+	gchar							*filename;
+
+	g_return_if_fail(IS_COOKIE_PERMISSION_MANAGER(self));
+
+	priv=self->priv;
+	if(inDoRecord==(priv->traceWriter!=NULL)) return;
+
+	/* Start a new segment in trace file or stop recording */
+	if(inDoRecord)
+	{
+		configDir=midori_extension_get_config_dir(priv->extension);
+		if(!configDir)
+		{
+			g_warning(_("Could not get path to configuration of extension: path is NULL"));
+			return;
+		}
+
+		filename=g_build_filename(configDir, COOKIE_PERMISSION_TRACE, NULL);
+		priv->traceWriter=cookie_permission_manager_trace_writer_new(filename);
+		g_free(filename);
+
+		if(!priv->traceWriter) return;
+	}
+		else
+		{
+			cookie_permission_manager_trace_writer_free(priv->traceWriter);
+			priv->traceWriter=NULL;
+		}
+
+	midori_extension_set_boolean(priv->extension, "record-trace", inDoRecord);
+	g_object_notify_by_pspec(G_OBJECT(self), CookiePermissionManagerProperties[PROP_RECORD_TRACE]);
+}
+
+/* Get statistics of cookie decision path owned by manager or clear them */
+CookiePermissionManagerStatistics* cookie_permission_manager_get_statistics(CookiePermissionManager *self)
+{
+	g_return_val_if_fail(IS_COOKIE_PERMISSION_MANAGER(self), NULL);
+
+	return(self->priv->statistics);
+}
+
+void cookie_permission_manager_reset_statistics(CookiePermissionManager *self)
+{
+	g_return_if_fail(IS_COOKIE_PERMISSION_MANAGER(self));
+
+	cookie_permission_manager_statistics_reset(self->priv->statistics);
+	g_object_notify_by_pspec(G_OBJECT(self), CookiePermissionManagerProperties[PROP_STATISTICS]);
+}
+
+/* Get policy stored for domain or domain pattern itself. Returns
+ * COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED if none is stored.
+ */
+gint cookie_permission_manager_get_policy(CookiePermissionManager *self, const gchar *inDomain)
+{
+	g_return_val_if_fail(IS_COOKIE_PERMISSION_MANAGER(self), COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED);
+	g_return_val_if_fail(inDomain, COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED);
+	g_return_val_if_fail(self->priv->database, COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED);
+
+	return(_cookie_permission_manager_get_stored_policy(self, inDomain));
+}
+
+/* Lookup policy for cookies from domain in policies held in memory without
+ * blocking. Can be called from any thread. Returns FALSE if no policy was found
+ * in memory, i.e. no policy is stored for domain or - if a memory budget is
+ * set - it has to be looked up in database at main thread.
+ * Nothing in this extension calls it yet: cookies are still decided at main
+ * thread where the cookie jar of WebKit's session emits its signals. It is meant
+ * for callers outside main thread, e.g. libsoup worker threads of a session
+ * running in its own thread.
+ */
+gboolean cookie_permission_manager_lookup_policy(CookiePermissionManager *self, const gchar *inDomain, gint *outPolicy)
+{
+	CookiePermissionManagerPrivate	*priv;
+	CookiePermissionManagerPolicySources	sources={ NULL, };
+	gint							phase;
+	gint							policy=COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED;
+	gboolean						foundPolicy;
+
+	g_return_val_if_fail(IS_COOKIE_PERMISSION_MANAGER(self), FALSE);
+	g_return_val_if_fail(inDomain, FALSE);
+
+	priv=self->priv;
+
+	/* Same order as at main thread but only policies held in memory are used
+	 * as cache and database must not be used by other threads
+	 */
+	sources.snapshot=cookie_permission_manager_policy_snapshot_slot_read_lock(priv->snapshots, &phase);
+	foundPolicy=cookie_permission_manager_policy_engine_lookup(&sources, inDomain, &policy);
+	cookie_permission_manager_policy_snapshot_slot_read_unlock(priv->snapshots, phase);
+
+	if(foundPolicy && outPolicy) *outPolicy=policy;
+	return(foundPolicy);
+}
+
+/* Set policy of domain or domain pattern (if it contains wildcards) and emit
+ * "policy-changed" signal if it changed. Setting policy to
+ * COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED removes the policy.
+ */
+gboolean cookie_permission_manager_set_policy(CookiePermissionManager *self, const gchar *inDomain, gint inPolicy)
+{
+	const gchar		*domains[2]={ inDomain, NULL };
+
+	g_return_val_if_fail(IS_COOKIE_PERMISSION_MANAGER(self), FALSE);
+	g_return_val_if_fail(inDomain, FALSE);
+
+	return(_cookie_permission_manager_store_policies(self, domains, inPolicy));
+}
+
+/* Same as cookie_permission_manager_set_policy() for a NULL-terminated list of
+ * domains but all policies are stored in one transaction
+ */
+gboolean cookie_permission_manager_set_policies(CookiePermissionManager *self, const gchar **inDomains, gint inPolicy)
+{
+	g_return_val_if_fail(IS_COOKIE_PERMISSION_MANAGER(self), FALSE);
+	g_return_val_if_fail(inDomains, FALSE);
+
+	return(_cookie_permission_manager_store_policies(self, inDomains, inPolicy));
+}
+
+/* Call function for each domain and domain pattern a policy is stored for */
+void cookie_permission_manager_foreach_policy(CookiePermissionManager *self,
+												CookiePermissionManagerForeachPolicyFunc inCallback,
+												gpointer inUserData)
+{
+	CookiePermissionManagerPrivate	*priv;
+	const CookiePermissionManagerStatement	statements[]={ COOKIE_PERMISSION_MANAGER_STATEMENT_SELECT_ALL,
+															COOKIE_PERMISSION_MANAGER_STATEMENT_SELECT_ALL_PATTERNS };
+	sqlite3_stmt					*statement;
+	GHashTableIter					iter;
+	const gchar						*domain;
+	guint							i;
+
+	g_return_if_fail(IS_COOKIE_PERMISSION_MANAGER(self));
+	g_return_if_fail(inCallback);
+
+	priv=self->priv;
+	if(!priv->database) return;
+
+	/* Write all queued decisions before so database is complete */
+	if(priv->writeQueue) cookie_permission_manager_write_queue_flush(priv->writeQueue);
+
+	for(i=0; i<G_N_ELEMENTS(statements); i++)
+	{
+		statement=cookie_permission_manager_statement_registry_get(priv->statements, statements[i]);
+		if(!statement)
+		{
+			g_warning(_("SQL fails: %s"), sqlite3_errmsg(priv->database));
+			continue;
+		}
+
+		while(sqlite3_step(statement)==SQLITE_ROW)
+		{
+			inCallback((const gchar*)sqlite3_column_text(statement, 0), sqlite3_column_int(statement, 1), inUserData);
+		}
+
+		sqlite3_reset(statement);
+	}
+
+	/* Decisions for this session only are not stored in database */
+	g_hash_table_iter_init(&iter, priv->sessionPolicies);
+	while(g_hash_table_iter_next(&iter, (gpointer*)&domain, NULL))
+	{
+		inCallback(domain, COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION, inUserData);
+	}
+}
+
+/* Same as cookie_permission_manager_foreach_policy() but policies are loaded in
+ * background and handed over in chunks from main loop. Free returned loader with
+ * cookie_permission_manager_policy_loader_free() when finished or to cancel loading.
+ * Returns NULL if no database is opened.
+ */
+CookiePermissionManagerPolicyLoader* cookie_permission_manager_load_policies(CookiePermissionManager *self,
+																				CookiePermissionManagerPolicyLoaderChunkFunc inChunkCallback,
+																				CookiePermissionManagerPolicyLoaderProgressFunc inProgressCallback,
+																				gpointer inUserData)
+{
+	CookiePermissionManagerPrivate	*priv;
+	CookiePermissionManagerPolicyLoader	*loader;
+	GHashTableIter					iter;
+	const gchar						**domains;
+	gint							*policies;
+	guint							count;
+
+	g_return_val_if_fail(IS_COOKIE_PERMISSION_MANAGER(self), NULL);
+	g_return_val_if_fail(inChunkCallback, NULL);
+
+	priv=self->priv;
+	if(!priv->database || !priv->databaseFilename) return(NULL);
+
+	/* Write all queued decisions before so database is complete */
+	if(priv->writeQueue) cookie_permission_manager_write_queue_flush(priv->writeQueue);
+
+	loader=cookie_permission_manager_policy_loader_new(priv->databaseFilename, inChunkCallback, inProgressCallback, inUserData);
+
+	/* Hand over decisions for this session only which are not stored in database */
+	count=g_hash_table_size(priv->sessionPolicies);
+	if(count>0)
+	{
+		domains=g_new(const gchar*, count);
+		policies=g_new(gint, count);
+
+		count=0;
+		g_hash_table_iter_init(&iter, priv->sessionPolicies);
+		while(g_hash_table_iter_next(&iter, (gpointer*)&domains[count], NULL))
+		{
+			policies[count]=COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION;
+			count++;
+		}
+
+		cookie_permission_manager_policy_loader_push(loader, domains, policies, count);
+
+		g_free(policies);
+		g_free(domains);
+	}
+
+	return(loader);
+}
+
 /************************************************************************************/
 
 /* Implementation: Enumeration */
@@ -1130,3 +3104,24 @@ GType cookie_permission_manager_policy_get_type(void)
 
 	return(g_define_type_id__volatile);
 }
+
+GType cookie_permission_manager_durability_get_type(void)
+{
+	static volatile gsize	g_define_type_id__volatile=0;
+
+	if(g_once_init_enter(&g_define_type_id__volatile))
+	{
+		static const GEnumValue values[]=
+		{
+			{ COOKIE_PERMISSION_MANAGER_DURABILITY_STRICT, "COOKIE_PERMISSION_MANAGER_DURABILITY_STRICT", N_("Strict") },
+			{ COOKIE_PERMISSION_MANAGER_DURABILITY_WAL, "COOKIE_PERMISSION_MANAGER_DURABILITY_WAL", N_("Write-ahead log") },
+			{ COOKIE_PERMISSION_MANAGER_DURABILITY_MEMORY_FIRST, "COOKIE_PERMISSION_MANAGER_DURABILITY_MEMORY_FIRST", N_("Memory first") },
+			{ 0, NULL, NULL }
+		};
+
+		GType	g_define_type_id=g_enum_register_static(g_intern_static_string("CookiePermissionManagerDurability"), values);
+		g_once_init_leave(&g_define_type_id__volatile, g_define_type_id);
+	}
+
+	return(g_define_type_id__volatile);
+}
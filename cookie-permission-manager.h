@@ -15,7 +15,11 @@
 #include "config.h"
 #include <midori/midori.h>
 
+#include "cookie-permission-manager-policy-loader.h"
+#include "cookie-permission-manager-statistics.h"
+
 #define COOKIE_PERMISSION_DATABASE	"domains.db"
+#define COOKIE_PERMISSION_TRACE		"cookies.trace"
 
 G_BEGIN_DECLS
 
@@ -28,6 +32,13 @@ typedef enum
 	COOKIE_PERMISSION_MANAGER_POLICY_BLOCK
 } CookiePermissionManagerPolicy;
 
+typedef enum
+{
+	COOKIE_PERMISSION_MANAGER_DURABILITY_STRICT,
+	COOKIE_PERMISSION_MANAGER_DURABILITY_WAL,
+	COOKIE_PERMISSION_MANAGER_DURABILITY_MEMORY_FIRST
+} CookiePermissionManagerDurability;
+
 /* Cookie permission manager object */
 #define TYPE_COOKIE_PERMISSION_MANAGER				(cookie_permission_manager_get_type())
 #define COOKIE_PERMISSION_MANAGER(obj)				(G_TYPE_CHECK_INSTANCE_CAST((obj), TYPE_COOKIE_PERMISSION_MANAGER, CookiePermissionManager))
@@ -53,8 +64,13 @@ struct _CookiePermissionManagerClass
 {
 	/* Parent class */
 	GObjectClass					parent_class;
+
+	/* Virtual functions */
+	void (*policy_changed)(CookiePermissionManager *self, const gchar *inDomain, gint inOldPolicy, gint inNewPolicy);
 };
 
+typedef void (*CookiePermissionManagerForeachPolicyFunc)(const gchar *inDomain, gint inPolicy, gpointer inUserData);
+
 /* Public API */
 GType cookie_permission_manager_get_type(void);
 
@@ -63,10 +79,46 @@ CookiePermissionManager* cookie_permission_manager_new(MidoriExtension *inExtens
 gboolean cookie_permission_manager_get_ask_for_unknown_policy(CookiePermissionManager *self);
 void cookie_permission_manager_set_ask_for_unknown_policy(CookiePermissionManager *self, gboolean inDoAsk);
 
+guint cookie_permission_manager_get_memory_budget(CookiePermissionManager *self);
+void cookie_permission_manager_set_memory_budget(CookiePermissionManager *self, guint inBudget);
+
+gboolean cookie_permission_manager_get_group_by_registrable_domain(CookiePermissionManager *self);
+void cookie_permission_manager_set_group_by_registrable_domain(CookiePermissionManager *self, gboolean inDoGroup);
+
+CookiePermissionManagerDurability cookie_permission_manager_get_durability(CookiePermissionManager *self);
+void cookie_permission_manager_set_durability(CookiePermissionManager *self, CookiePermissionManagerDurability inDurability);
+
+gboolean cookie_permission_manager_get_ask_asynchronously(CookiePermissionManager *self);
+void cookie_permission_manager_set_ask_asynchronously(CookiePermissionManager *self, gboolean inDoAsync);
+
+guint cookie_permission_manager_get_prompt_timeout(CookiePermissionManager *self);
+void cookie_permission_manager_set_prompt_timeout(CookiePermissionManager *self, guint inTimeout);
+
+gboolean cookie_permission_manager_get_record_trace(CookiePermissionManager *self);
+void cookie_permission_manager_set_record_trace(CookiePermissionManager *self, gboolean inDoRecord);
+
+CookiePermissionManagerStatistics* cookie_permission_manager_get_statistics(CookiePermissionManager *self);
+void cookie_permission_manager_reset_statistics(CookiePermissionManager *self);
+
+gint cookie_permission_manager_get_policy(CookiePermissionManager *self, const gchar *inDomain);
+gboolean cookie_permission_manager_lookup_policy(CookiePermissionManager *self, const gchar *inDomain, gint *outPolicy);
+gboolean cookie_permission_manager_set_policy(CookiePermissionManager *self, const gchar *inDomain, gint inPolicy);
+gboolean cookie_permission_manager_set_policies(CookiePermissionManager *self, const gchar **inDomains, gint inPolicy);
+void cookie_permission_manager_foreach_policy(CookiePermissionManager *self,
+												CookiePermissionManagerForeachPolicyFunc inCallback,
+												gpointer inUserData);
+CookiePermissionManagerPolicyLoader* cookie_permission_manager_load_policies(CookiePermissionManager *self,
+																				CookiePermissionManagerPolicyLoaderChunkFunc inChunkCallback,
+																				CookiePermissionManagerPolicyLoaderProgressFunc inProgressCallback,
+																				gpointer inUserData);
+
 /* Enumeration */
 GType cookie_permission_manager_policy_get_type(void) G_GNUC_CONST;
 #define COOKIE_PERMISSION_MANAGER_TYPE_POLICY	(cookie_permission_manager_policy_get_type())
 
+GType cookie_permission_manager_durability_get_type(void) G_GNUC_CONST;
+#define COOKIE_PERMISSION_MANAGER_TYPE_DURABILITY	(cookie_permission_manager_durability_get_type())
+
 G_END_DECLS
 
 #endif /* __COOKIE_PERMISSION_MANAGER__ */
@@ -21,7 +21,15 @@ static void _cpm_on_activate(MidoriExtension *inExtension, MidoriApp *inApp, gpo
 	g_return_if_fail(cpm==NULL);
 
 	cpm=cookie_permission_manager_new(inExtension, inApp);
-	g_object_set(cpm, "ask-for-unknown-policy", midori_extension_get_boolean(inExtension, "ask-for-unknown-policy"), NULL);
+	g_object_set(cpm,
+					"ask-for-unknown-policy", midori_extension_get_boolean(inExtension, "ask-for-unknown-policy"),
+					"memory-budget", midori_extension_get_integer(inExtension, "memory-budget"),
+					"group-by-registrable-domain", midori_extension_get_boolean(inExtension, "group-by-registrable-domain"),
+					"durability", midori_extension_get_integer(inExtension, "durability"),
+					"ask-asynchronously", midori_extension_get_boolean(inExtension, "ask-asynchronously"),
+					"prompt-timeout", midori_extension_get_integer(inExtension, "prompt-timeout"),
+					"record-trace", midori_extension_get_boolean(inExtension, "record-trace"),
+					NULL);
 }
 
 /* This extension was deactivated */
@@ -67,6 +75,12 @@ MidoriExtension *extension_init(void)
 
 	midori_extension_install_boolean(extension, "ask-for-unknown-policy", TRUE);
 	midori_extension_install_boolean(extension, "show-details-when-ask", FALSE);
+	midori_extension_install_integer(extension, "memory-budget", 0);
+	midori_extension_install_boolean(extension, "group-by-registrable-domain", FALSE);
+	midori_extension_install_integer(extension, "durability", COOKIE_PERMISSION_MANAGER_DURABILITY_WAL);
+	midori_extension_install_boolean(extension, "ask-asynchronously", TRUE);
+	midori_extension_install_integer(extension, "prompt-timeout", 120);
+	midori_extension_install_boolean(extension, "record-trace", FALSE);
 
 	g_signal_connect(extension, "activate", G_CALLBACK(_cpm_on_activate), NULL);
 	g_signal_connect(extension, "deactivate", G_CALLBACK(_cpm_on_deactivate), NULL);
@@ -0,0 +1,112 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+/* Stand-in for cookie-permission-manager.h when building policy engine without
+ * Midori, WebKit and libsoup. It is force-included before any source file and
+ * claims the include guard of the real header so that one is skipped.
+ */
+#ifndef __COOKIE_PERMISSION_MANAGER_BENCHMARK_STUBS__
+#define __COOKIE_PERMISSION_MANAGER_BENCHMARK_STUBS__
+
+#define __COOKIE_PERMISSION_MANAGER__
+
+#include <glib.h>
+
+#define _(x)		(x)
+
+G_BEGIN_DECLS
+
+/* Cookie permission manager enums as in cookie-permission-manager.h */
+typedef enum
+{
+	COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED,
+	COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT,
+	COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION,
+	COOKIE_PERMISSION_MANAGER_POLICY_BLOCK
+} CookiePermissionManagerPolicy;
+
+typedef enum
+{
+	COOKIE_PERMISSION_MANAGER_DURABILITY_STRICT,
+	COOKIE_PERMISSION_MANAGER_DURABILITY_WAL,
+	COOKIE_PERMISSION_MANAGER_DURABILITY_MEMORY_FIRST
+} CookiePermissionManagerDurability;
+
+/* Cookie of a response. Only the parts needed to resolve its policy. */
+typedef struct _SoupCookie		SoupCookie;
+
+struct _SoupCookie
+{
+	gchar			*name;
+	gchar			*domain;
+};
+
+static inline SoupCookie* soup_cookie_new(const gchar *inName, const gchar *inDomain)
+{
+	SoupCookie		*cookie;
+
+	cookie=g_new0(SoupCookie, 1);
+	cookie->name=g_strdup(inName);
+	cookie->domain=g_strdup(inDomain);
+
+	return(cookie);
+}
+
+static inline void soup_cookie_free(SoupCookie *inCookie)
+{
+	g_free(inCookie->name);
+	g_free(inCookie->domain);
+	g_free(inCookie);
+}
+
+static inline const gchar* soup_cookie_get_domain(SoupCookie *inCookie)
+{
+	return(inCookie->domain);
+}
+
+/* Settings of extension. Values are kept in a table filled from command-line
+ * instead of Midori's configuration file.
+ */
+typedef GHashTable		MidoriExtension;
+
+static inline MidoriExtension* midori_extension_new(void)
+{
+	return(g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL));
+}
+
+static inline void midori_extension_free(MidoriExtension *self)
+{
+	g_hash_table_destroy(self);
+}
+
+static inline void midori_extension_set_integer(MidoriExtension *self, const gchar *inName, gint inValue)
+{
+	g_hash_table_insert(self, g_strdup(inName), GINT_TO_POINTER(inValue));
+}
+
+static inline gint midori_extension_get_integer(MidoriExtension *self, const gchar *inName)
+{
+	return(GPOINTER_TO_INT(g_hash_table_lookup(self, inName)));
+}
+
+static inline void midori_extension_set_boolean(MidoriExtension *self, const gchar *inName, gboolean inValue)
+{
+	midori_extension_set_integer(self, inName, inValue ? TRUE : FALSE);
+}
+
+static inline gboolean midori_extension_get_boolean(MidoriExtension *self, const gchar *inName)
+{
+	return(midori_extension_get_integer(self, inName) ? TRUE : FALSE);
+}
+
+G_END_DECLS
+
+#endif /* __COOKIE_PERMISSION_MANAGER_BENCHMARK_STUBS__ */
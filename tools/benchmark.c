@@ -0,0 +1,602 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+/* Micro-benchmark of policy engine outside a running Midori. It builds a synthetic
+ * set of stored policies and responses with cookies and resolves the policies of
+ * all cookies with each storage and lookup strategy the manager uses. Lookups are
+ * done by the policy engine the manager uses.
+ */
+
+#include "benchmark-stubs.h"
+
+#include "../cookie-permission-manager-database.h"
+#include "../cookie-permission-manager-domain-trie.h"
+#include "../cookie-permission-manager-pattern-matcher.h"
+#include "../cookie-permission-manager-policy-cache.h"
+#include "../cookie-permission-manager-policy-engine.h"
+#include "../cookie-permission-manager-policy-snapshot.h"
+
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Count allocations by wrapping allocator of C library. GLib and SQLite both
+ * use it so all allocations of policy engine are counted.
+ */
+#ifdef __GLIBC__
+extern void* __libc_malloc(size_t inSize);
+extern void* __libc_calloc(size_t inNumber, size_t inSize);
+extern void* __libc_realloc(void *inPointer, size_t inSize);
+
+static guint64		BenchmarkAllocations=0;
+static gboolean		BenchmarkCountAllocations=FALSE;
+
+void* malloc(size_t inSize)
+{
+	if(BenchmarkCountAllocations) BenchmarkAllocations++;
+	return(__libc_malloc(inSize));
+}
+
+void* calloc(size_t inNumber, size_t inSize)
+{
+	if(BenchmarkCountAllocations) BenchmarkAllocations++;
+	return(__libc_calloc(inNumber, inSize));
+}
+
+void* realloc(void *inPointer, size_t inSize)
+{
+	if(BenchmarkCountAllocations) BenchmarkAllocations++;
+	return(__libc_realloc(inPointer, inSize));
+}
+
+#define BENCHMARK_HAVE_ALLOCATIONS	1
+#endif
+
+/* Workload and engine state */
+typedef struct _Benchmark			Benchmark;
+typedef struct _BenchmarkStrategy	BenchmarkStrategy;
+
+struct _Benchmark
+{
+	/* Settings */
+	MidoriExtension							*extension;
+	guint									numberDomains;
+	guint									numberCookies;
+	guint									numberResponses;
+	gdouble									hitRatio;
+	guint									depth;
+	guint									numberPatterns;
+	guint									seed;
+
+	/* Workload */
+	GRand									*random;
+	gchar									**domains;
+	gint									*policies;
+	GPtrArray								*responses;		/* Array of GPtrArray of SoupCookie */
+
+	/* Engines */
+	gchar									*databaseDirectory;
+	gchar									*databaseFilename;
+	sqlite3									*database;
+	CookiePermissionManagerStatementRegistry	*statements;
+	CookiePermissionManagerPatternMatcher	*patterns;
+	CookiePermissionManagerPolicySources	sources;		/* Set up by strategy */
+
+	/* Results of current run */
+	guint64									*latencies;
+	guint									numberLatencies;
+};
+
+struct _BenchmarkStrategy
+{
+	const gchar			*name;
+	void				(*setup)(Benchmark *self);
+};
+
+/* IMPLEMENTATION: Private variables and methods */
+
+/* Get current monotonic time in nanoseconds */
+static guint64 _benchmark_get_time(void)
+{
+	struct timespec		now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return(((guint64)now.tv_sec)*G_GUINT64_CONSTANT(1000000000)+(guint64)now.tv_nsec);
+}
+
+/* Prepend random labels to a domain up to configured depth of sub-domains */
+static gchar* _benchmark_get_sub_domain(Benchmark *self, const gchar *inDomain)
+{
+	GString		*domain;
+	guint		i;
+
+	domain=g_string_new(NULL);
+	for(i=0; i<self->depth; i++) g_string_append_printf(domain, "w%u.", g_rand_int_range(self->random, 0, 16));
+	g_string_append(domain, inDomain[0]=='.' ? inDomain+1 : inDomain);
+
+	return(g_string_free(domain, FALSE));
+}
+
+/* Create stored policies and responses */
+static void _benchmark_create_workload(Benchmark *self)
+{
+	static const gchar	*suffixes[]={ "com", "org", "net", "co.uk", "de" };
+	guint				i, j;
+
+	self->random=g_rand_new_with_seed(self->seed);
+
+	/* Stored policies. Every fourth one is stored for a domain cookie. */
+	self->domains=g_new0(gchar*, self->numberDomains+1);
+	self->policies=g_new0(gint, self->numberDomains);
+	for(i=0; i<self->numberDomains; i++)
+	{
+		self->domains[i]=g_strdup_printf("%ssite%u.%s",
+											(i%4)==0 ? "." : "",
+											i,
+											suffixes[i%G_N_ELEMENTS(suffixes)]);
+
+		switch(g_rand_int_range(self->random, 0, 3))
+		{
+			case 0:
+				self->policies[i]=COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT;
+				break;
+
+			case 1:
+				self->policies[i]=COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION;
+				break;
+
+			default:
+				self->policies[i]=COOKIE_PERMISSION_MANAGER_POLICY_BLOCK;
+				break;
+		}
+	}
+
+	/* Responses setting cookies for a host and its parent domain. A hit is a
+	 * sub-domain of a stored domain and a miss is a domain never stored.
+	 */
+	self->responses=g_ptr_array_new_with_free_func((GDestroyNotify)g_ptr_array_unref);
+	for(i=0; i<self->numberResponses; i++)
+	{
+		GPtrArray		*cookies;
+		gchar			*host;
+		gchar			*parent;
+
+		if(self->numberDomains>0 && g_rand_double(self->random)<self->hitRatio)
+		{
+			host=_benchmark_get_sub_domain(self, self->domains[g_rand_int_range(self->random, 0, self->numberDomains)]);
+		}
+			else
+			{
+				gchar		*missing;
+
+				missing=g_strdup_printf("missing%u.%s",
+											g_rand_int(self->random),
+											suffixes[g_rand_int_range(self->random, 0, G_N_ELEMENTS(suffixes))]);
+				host=_benchmark_get_sub_domain(self, missing);
+				g_free(missing);
+			}
+
+		parent=strchr(host, '.');
+
+		cookies=g_ptr_array_new_with_free_func((GDestroyNotify)soup_cookie_free);
+		for(j=0; j<self->numberCookies; j++)
+		{
+			g_ptr_array_add(cookies, soup_cookie_new("name", ((j%2)==1 && parent) ? parent : host));
+		}
+		g_ptr_array_add(self->responses, cookies);
+
+		g_free(host);
+	}
+}
+
+/* Create database file and fill it with stored policies */
+static void _benchmark_create_database(Benchmark *self)
+{
+	gchar		*error=NULL;
+	guint		i;
+
+	self->databaseDirectory=g_dir_make_tmp("cookie-permission-benchmark-XXXXXX", NULL);
+	if(!self->databaseDirectory)
+	{
+		g_printerr("Could not create temporary directory for database\n");
+		exit(1);
+	}
+	self->databaseFilename=g_build_filename(self->databaseDirectory, "domains.db", NULL);
+
+	/* Create table structure like manager does before migrating it */
+	if(sqlite3_open(self->databaseFilename, &self->database)!=SQLITE_OK ||
+		sqlite3_exec(self->database,
+						"CREATE TABLE IF NOT EXISTS policies(domain text, value integer);",
+						NULL,
+						NULL,
+						&error)!=SQLITE_OK ||
+		cookie_permission_manager_database_migrate(self->database, &error)!=SQLITE_OK)
+	{
+		g_printerr("Could not create database: %s\n", error ? error : sqlite3_errmsg(self->database));
+		exit(1);
+	}
+
+	cookie_permission_manager_database_set_durability(self->database, COOKIE_PERMISSION_MANAGER_DURABILITY_WAL, NULL);
+	self->statements=cookie_permission_manager_statement_registry_new(self->database);
+
+	cookie_permission_manager_database_begin(self->statements);
+	for(i=0; i<self->numberDomains; i++)
+	{
+		cookie_permission_manager_database_set_policy(self->statements, self->domains[i], self->policies[i]);
+	}
+	cookie_permission_manager_database_commit(self->statements);
+}
+
+/* Create pattern matcher like user-defined patterns for ad networks */
+static void _benchmark_create_patterns(Benchmark *self)
+{
+	guint		i;
+	gchar		*pattern;
+
+	self->patterns=cookie_permission_manager_pattern_matcher_new();
+	for(i=0; i<self->numberPatterns; i++)
+	{
+		if(i%2) pattern=g_strdup_printf("*.tracker%u.*", i);
+			else pattern=g_strdup_printf("ads%u?.*.com", i);
+
+		cookie_permission_manager_pattern_matcher_insert(self->patterns, pattern, COOKIE_PERMISSION_MANAGER_POLICY_BLOCK);
+		g_free(pattern);
+	}
+	cookie_permission_manager_pattern_matcher_compile(self->patterns);
+}
+
+/* Create snapshot with a copy of patterns as each strategy releases its snapshot */
+static CookiePermissionManagerPolicySnapshot* _benchmark_create_snapshot(Benchmark *self, CookiePermissionManagerDomainTrie *inPolicies)
+{
+	CookiePermissionManagerPatternMatcher	*patterns=NULL;
+
+	if(self->patterns)
+	{
+		patterns=cookie_permission_manager_pattern_matcher_copy(self->patterns);
+		cookie_permission_manager_pattern_matcher_compile(patterns);
+	}
+
+	return(cookie_permission_manager_policy_snapshot_new(inPolicies, patterns));
+}
+
+/* Strategy: all policies in a trie published as snapshot */
+static void _benchmark_trie_setup(Benchmark *self)
+{
+	CookiePermissionManagerDomainTrie	*trie;
+	guint								i;
+
+	trie=cookie_permission_manager_domain_trie_new();
+	for(i=0; i<self->numberDomains; i++)
+	{
+		cookie_permission_manager_domain_trie_insert(trie, self->domains[i], self->policies[i]);
+	}
+
+	self->sources.snapshot=_benchmark_create_snapshot(self, trie);
+}
+
+/* Strategy: snapshot with recent decisions not folded into its trie yet */
+static void _benchmark_overlay_setup(Benchmark *self)
+{
+	CookiePermissionManagerPolicySnapshot	*base;
+	guint									i, changes;
+
+	_benchmark_trie_setup(self);
+
+	/* Change as many policies as overlay holds before it is folded */
+	changes=MIN(self->numberDomains, MAX(1024, self->numberDomains/64)-1);
+
+	base=self->sources.snapshot;
+	self->sources.snapshot=cookie_permission_manager_policy_snapshot_copy(base);
+	for(i=0; i<changes; i++)
+	{
+		cookie_permission_manager_policy_snapshot_set_policy(self->sources.snapshot,
+																self->domains[i],
+																COOKIE_PERMISSION_MANAGER_POLICY_BLOCK);
+	}
+	cookie_permission_manager_policy_snapshot_free(base);
+}
+
+/* Strategy: memory budget with bloom filter and cache in front of database */
+static void _benchmark_budget_setup(Benchmark *self)
+{
+	gsize		budget;
+	guint		i;
+	gchar		*key;
+
+	budget=((gsize)midori_extension_get_integer(self->extension, "memory-budget"))*1024;
+
+	self->sources.policyFilter=cookie_permission_manager_bloom_filter_new(cookie_permission_manager_policy_engine_get_filter_size(budget));
+	for(i=0; i<self->numberDomains; i++)
+	{
+		key=cookie_permission_manager_database_get_domain_key(self->domains[i], NULL);
+		cookie_permission_manager_bloom_filter_add(self->sources.policyFilter, key, -1);
+		g_free(key);
+	}
+
+	self->sources.policyCache=cookie_permission_manager_policy_cache_new(cookie_permission_manager_policy_engine_get_cache_size(budget));
+	self->sources.statements=self->statements;
+	self->sources.snapshot=_benchmark_create_snapshot(self, NULL);
+}
+
+/* Strategy: every lookup goes to database as if loading policies failed */
+static void _benchmark_database_setup(Benchmark *self)
+{
+	self->sources.statements=self->statements;
+	self->sources.snapshot=_benchmark_create_snapshot(self, NULL);
+}
+
+/* Release everything set up by a strategy */
+static void _benchmark_teardown(Benchmark *self)
+{
+	if(self->sources.snapshot) cookie_permission_manager_policy_snapshot_free(self->sources.snapshot);
+	if(self->sources.policyCache) cookie_permission_manager_policy_cache_free(self->sources.policyCache);
+	if(self->sources.policyFilter) cookie_permission_manager_bloom_filter_free(self->sources.policyFilter);
+
+	memset(&self->sources, 0, sizeof(CookiePermissionManagerPolicySources));
+}
+
+static const BenchmarkStrategy		BenchmarkStrategies[]=
+{
+	/* All policies in trie of snapshot */
+	{ "trie", _benchmark_trie_setup },
+
+	/* Snapshot with full overlay of recent decisions */
+	{ "overlay", _benchmark_overlay_setup },
+
+	/* Bloom filter and cache in front of database */
+	{ "budget", _benchmark_budget_setup },
+
+	/* Database only */
+	{ "database", _benchmark_database_setup },
+	{ NULL, }
+};
+
+/* Compare latencies for sorting */
+static gint _benchmark_compare_latencies(gconstpointer inLeft, gconstpointer inRight)
+{
+	guint64		left=*((const guint64*)inLeft);
+	guint64		right=*((const guint64*)inRight);
+
+	return(left<right ? -1 : (left>right ? 1 : 0));
+}
+
+/* Get latency below which given percentage of lookups stayed */
+static guint64 _benchmark_get_percentile(Benchmark *self, guint inPercentile)
+{
+	guint		position;
+
+	if(self->numberLatencies==0) return(0);
+
+	position=(guint)(((guint64)self->numberLatencies*inPercentile+99)/100);
+	if(position>0) position--;
+
+	return(self->latencies[position]);
+}
+
+/* Run workload with a strategy and print results */
+static void _benchmark_run(Benchmark *self, const BenchmarkStrategy *inStrategy)
+{
+	GHashTable		*policies;
+	guint64			startTime, totalTime, lookupTime;
+	guint64			allocations=0;
+	guint64			numberCookies=0;
+	guint			outcomes[COOKIE_PERMISSION_MANAGER_POLICY_BLOCK+1]={ 0, };
+	guint			i, j;
+	GHashTableIter	iter;
+	gpointer		value;
+
+	inStrategy->setup(self);
+
+	self->numberLatencies=0;
+	policies=g_hash_table_new(g_str_hash, g_str_equal);
+
+#ifdef BENCHMARK_HAVE_ALLOCATIONS
+	BenchmarkAllocations=0;
+	BenchmarkCountAllocations=TRUE;
+#endif
+
+	/* Resolve each distinct cookie domain of a response once like manager does */
+	startTime=_benchmark_get_time();
+	for(i=0; i<self->responses->len; i++)
+	{
+		GPtrArray		*cookies=(GPtrArray*)g_ptr_array_index(self->responses, i);
+
+		for(j=0; j<cookies->len; j++)
+		{
+			const gchar	*domain=soup_cookie_get_domain((SoupCookie*)g_ptr_array_index(cookies, j));
+
+			numberCookies++;
+			if(g_hash_table_contains(policies, domain)) continue;
+
+			lookupTime=_benchmark_get_time();
+			g_hash_table_insert(policies,
+								(gpointer)domain,
+								GINT_TO_POINTER(cookie_permission_manager_policy_engine_get_policy(&self->sources, domain)));
+			self->latencies[self->numberLatencies++]=_benchmark_get_time()-lookupTime;
+		}
+
+		g_hash_table_iter_init(&iter, policies);
+		while(g_hash_table_iter_next(&iter, NULL, &value)) outcomes[GPOINTER_TO_INT(value)]++;
+		g_hash_table_remove_all(policies);
+	}
+	totalTime=_benchmark_get_time()-startTime;
+
+#ifdef BENCHMARK_HAVE_ALLOCATIONS
+	BenchmarkCountAllocations=FALSE;
+	allocations=BenchmarkAllocations;
+#endif
+
+	g_hash_table_destroy(policies);
+
+	_benchmark_teardown(self);
+
+	/* Print results */
+	qsort(self->latencies, self->numberLatencies, sizeof(guint64), (int (*)(const void*, const void*))_benchmark_compare_latencies);
+
+	g_print("%-10s %12.0f %12.0f %10" G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT " ",
+			inStrategy->name,
+			totalTime>0 ? (gdouble)self->numberLatencies*1e9/(gdouble)totalTime : 0.0,
+			totalTime>0 ? (gdouble)numberCookies*1e9/(gdouble)totalTime : 0.0,
+			_benchmark_get_percentile(self, 50),
+			_benchmark_get_percentile(self, 99),
+			self->numberLatencies>0 ? self->latencies[self->numberLatencies-1] : 0);
+
+#ifdef BENCHMARK_HAVE_ALLOCATIONS
+	g_print("%10.2f", self->numberLatencies>0 ? (gdouble)allocations/(gdouble)self->numberLatencies : 0.0);
+#else
+	g_print("%10s", "n/a");
+#endif
+
+	g_print("   %u/%u/%u/%u\n",
+			outcomes[COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT],
+			outcomes[COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION],
+			outcomes[COOKIE_PERMISSION_MANAGER_POLICY_BLOCK],
+			outcomes[COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED]);
+}
+
+/* Release workload and engines */
+static void _benchmark_free(Benchmark *self)
+{
+	if(self->patterns) cookie_permission_manager_pattern_matcher_free(self->patterns);
+	if(self->statements) cookie_permission_manager_statement_registry_free(self->statements);
+	if(self->database) sqlite3_close(self->database);
+
+	if(self->databaseFilename)
+	{
+		gchar		*filename;
+
+		g_unlink(self->databaseFilename);
+
+		filename=g_strconcat(self->databaseFilename, "-wal", NULL);
+		g_unlink(filename);
+		g_free(filename);
+
+		filename=g_strconcat(self->databaseFilename, "-shm", NULL);
+		g_unlink(filename);
+		g_free(filename);
+	}
+	if(self->databaseDirectory) g_rmdir(self->databaseDirectory);
+
+	g_free(self->databaseFilename);
+	g_free(self->databaseDirectory);
+	g_free(self->latencies);
+	if(self->responses) g_ptr_array_unref(self->responses);
+	g_strfreev(self->domains);
+	g_free(self->policies);
+	if(self->random) g_rand_free(self->random);
+	midori_extension_free(self->extension);
+}
+
+/* IMPLEMENTATION: Main */
+
+int main(int argc, char **argv)
+{
+	Benchmark					self;
+	const BenchmarkStrategy		*strategy;
+	gint						domains=100000;
+	gint						cookies=4;
+	gint						responses=100000;
+	gdouble						hitRatio=0.5;
+	gint						depth=1;
+	gint						patterns=100;
+	gint						memoryBudget=1024;
+	gint						seed=1;
+	gchar						*strategyName=NULL;
+	gboolean					found=FALSE;
+	GOptionContext				*context;
+	GError						*error=NULL;
+	GOptionEntry				entries[]=
+	{
+		{ "domains", 'n', 0, G_OPTION_ARG_INT, &domains, "Number of stored domains", "N" },
+		{ "cookies", 'm', 0, G_OPTION_ARG_INT, &cookies, "Number of cookies per response", "M" },
+		{ "responses", 'r', 0, G_OPTION_ARG_INT, &responses, "Number of responses", "R" },
+		{ "hit-ratio", 'h', 0, G_OPTION_ARG_DOUBLE, &hitRatio, "Ratio of responses from stored domains", "0..1" },
+		{ "depth", 'd', 0, G_OPTION_ARG_INT, &depth, "Number of sub-domain labels above stored domain", "D" },
+		{ "patterns", 'p', 0, G_OPTION_ARG_INT, &patterns, "Number of domain patterns", "P" },
+		{ "memory-budget", 'b', 0, G_OPTION_ARG_INT, &memoryBudget, "Memory budget in KiB of budget strategy", "KIB" },
+		{ "strategy", 's', 0, G_OPTION_ARG_STRING, &strategyName, "Run only this strategy (trie, overlay, budget, database)", "NAME" },
+		{ "seed", 0, 0, G_OPTION_ARG_INT, &seed, "Seed of random workload", "SEED" },
+		{ NULL }
+	};
+
+	/* Parse command-line */
+	context=g_option_context_new("- benchmark policy lookups of cookie permission manager");
+	g_option_context_add_main_entries(context, entries, NULL);
+	if(!g_option_context_parse(context, &argc, &argv, &error))
+	{
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		g_option_context_free(context);
+		return(1);
+	}
+	g_option_context_free(context);
+
+	if(domains<0 || cookies<1 || responses<1 || depth<0 || patterns<0 || memoryBudget<1 || hitRatio<0.0 || hitRatio>1.0)
+	{
+		g_printerr("Invalid workload\n");
+		return(1);
+	}
+
+	for(strategy=BenchmarkStrategies; strategy->name && !found; strategy++)
+	{
+		found=(!strategyName || g_strcmp0(strategyName, strategy->name)==0);
+	}
+
+	if(!found)
+	{
+		g_printerr("Unknown strategy: %s\n", strategyName);
+		g_free(strategyName);
+		return(1);
+	}
+
+	/* Set up workload and engines shared by all strategies */
+	memset(&self, 0, sizeof(Benchmark));
+	self.extension=midori_extension_new();
+	midori_extension_set_integer(self.extension, "memory-budget", memoryBudget);
+	self.numberDomains=domains;
+	self.numberCookies=cookies;
+	self.numberResponses=responses;
+	self.hitRatio=hitRatio;
+	self.depth=depth;
+	self.numberPatterns=patterns;
+	self.seed=seed;
+
+	_benchmark_create_workload(&self);
+	_benchmark_create_database(&self);
+	if(self.numberPatterns>0) _benchmark_create_patterns(&self);
+
+	self.latencies=g_new0(guint64, (gsize)self.numberResponses*self.numberCookies);
+
+	g_print("%u stored domains, %u responses with %u cookies, hit ratio %.2f, depth %u, %u patterns\n\n",
+			self.numberDomains,
+			self.numberResponses,
+			self.numberCookies,
+			self.hitRatio,
+			self.depth,
+			self.numberPatterns);
+
+	g_print("%-10s %12s %12s %10s %10s %10s %10s   %s\n",
+			"strategy", "lookups/s", "cookies/s", "p50 ns", "p99 ns", "max ns", "allocs", "accept/session/block/ask");
+
+	/* Run strategies */
+	for(strategy=BenchmarkStrategies; strategy->name; strategy++)
+	{
+		if(strategyName && g_strcmp0(strategyName, strategy->name)!=0) continue;
+
+		_benchmark_run(&self, strategy);
+	}
+
+	g_free(strategyName);
+	_benchmark_free(&self);
+
+	return(0);
+}
@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# See the file COPYING for the full license text.
+#
+# Compile the Public Suffix List (https://publicsuffix.org/list/) into a
+# deterministic acyclic finite state automaton (DAFSA) embedded as C arrays.
+#
+# Each rule is stored with its characters in reversed order so a host name
+# can be matched by walking it from its last character to its first one.
+# Equivalent sub-trees of the resulting trie are merged bottom-up which
+# shrinks the automaton to a fraction of the trie.
+#
+# Usage: make-public-suffix-dafsa.py public_suffix_list.dat > cookie-permission-manager-public-suffix.inc
+
+import sys
+
+# Rule types - must match the definitions in cookie-permission-manager-public-suffix.c
+RULE_NORMAL = 1
+RULE_WILDCARD = 2
+RULE_EXCEPTION = 4
+
+
+def to_ascii(rule):
+	"""Convert internationalized labels to punycode as host names are stored in ASCII"""
+	labels = []
+	for label in rule.split('.'):
+		label = label.lower()
+		try:
+			label.encode('ascii')
+		except UnicodeEncodeError:
+			label = 'xn--' + label.encode('punycode').decode('ascii')
+		labels.append(label)
+	return '.'.join(labels)
+
+
+def read_rules(filename):
+	"""Read rules from list and return dictionary of rule to its rule types"""
+	rules = {}
+	with open(filename, encoding='utf-8') as listFile:
+		for line in listFile:
+			line = line.split('//')[0].strip()
+			if not line:
+				continue
+
+			line = line.split()[0]
+			if line.startswith('!'):
+				ruleType = RULE_EXCEPTION
+				line = line[1:]
+			elif line.startswith('*.'):
+				ruleType = RULE_WILDCARD
+				line = line[2:]
+			else:
+				ruleType = RULE_NORMAL
+
+			rule = to_ascii(line)
+			rules[rule] = rules.get(rule, 0) | ruleType
+	return rules
+
+
+def build_dafsa(rules):
+	"""Build trie of reversed rules and merge equivalent nodes. Returns list of
+	nodes as (value, [(character, target node index), ...]) with root at index 0."""
+	trie = {'value': 0, 'edges': {}}
+	for rule, value in rules.items():
+		node = trie
+		for character in reversed(rule):
+			node = node['edges'].setdefault(character, {'value': 0, 'edges': {}})
+		node['value'] |= value
+
+	signatures = {}
+	nodes = [None]
+
+	def merge(node):
+		edges = tuple(sorted((ord(character), merge(child)) for character, child in node['edges'].items()))
+		signature = (node['value'], edges)
+		if signature not in signatures:
+			signatures[signature] = len(nodes)
+			nodes.append(signature)
+		return signatures[signature]
+
+	# Make root the first node
+	root = merge(trie)
+	nodes[0] = nodes[root]
+	nodes[root] = None
+	remap = lambda index: 0 if index == root else index
+
+	result = []
+	mapping = {}
+	for index, node in enumerate(nodes):
+		if node is None:
+			continue
+		mapping[index] = len(result)
+		result.append(node)
+
+	return [(value, [(character, mapping[remap(target)]) for character, target in edges]) for value, edges in result]
+
+
+def write_array(output, ctype, name, values, perLine=16):
+	output.write('static const %s %s[%d]=\n{\n' % (ctype, name, len(values)))
+	for start in range(0, len(values), perLine):
+		output.write('\t' + ', '.join(str(value) for value in values[start:start + perLine]) + ',\n')
+	output.write('};\n\n')
+
+
+def main():
+	if len(sys.argv) != 2:
+		sys.stderr.write('Usage: %s public_suffix_list.dat\n' % sys.argv[0])
+		return 1
+
+	nodes = build_dafsa(read_rules(sys.argv[1]))
+
+	values = []
+	firstEdges = []
+	edgeCounts = []
+	edgeCharacters = []
+	edgeTargets = []
+	for value, edges in nodes:
+		values.append(value)
+		firstEdges.append(len(edgeCharacters))
+		edgeCounts.append(len(edges))
+		for character, target in edges:
+			edgeCharacters.append(character)
+			edgeTargets.append(target)
+
+	if len(nodes) > 0xffff or len(edgeCharacters) > 0xffff or max(edgeCounts) > 0xff:
+		sys.stderr.write('Automaton too large for node encoding\n')
+		return 1
+
+	output = sys.stdout
+	output.write('/* Generated by tools/make-public-suffix-dafsa.py - do not edit.\n')
+	output.write(' * %d nodes, %d edges\n */\n\n' % (len(nodes), len(edgeCharacters)))
+	write_array(output, 'guint8', '_cookie_permission_manager_public_suffix_values', values)
+	write_array(output, 'guint16', '_cookie_permission_manager_public_suffix_first_edges', firstEdges, 8)
+	write_array(output, 'guint8', '_cookie_permission_manager_public_suffix_edge_counts', edgeCounts)
+	write_array(output, 'guint8', '_cookie_permission_manager_public_suffix_edge_characters', edgeCharacters)
+	write_array(output, 'guint16', '_cookie_permission_manager_public_suffix_edge_targets', edgeTargets, 8)
+	return 0
+
+
+if __name__ == '__main__':
+	sys.exit(main())
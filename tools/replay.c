@@ -0,0 +1,440 @@
+/*
+ Copyright (C) 2013 Stephan Haller <nomad@froevel.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ See the file COPYING for the full license text.
+*/
+
+/* Offline replay of cookie traces recorded by manager if setting "record-trace"
+ * is enabled. All recorded cookies are resolved at full speed by the policy engine
+ * of manager against a copy of a policy database with all policies held in memory.
+ * Cookies of a response are resolved once per distinct domain and cookies set by
+ * scripts one by one like manager does. Throughput and the distribution of
+ * decisions are reported.
+ */
+
+#include "benchmark-stubs.h"
+
+#include "../cookie-permission-manager-database.h"
+#include "../cookie-permission-manager-domain-trie.h"
+#include "../cookie-permission-manager-pattern-matcher.h"
+#include "../cookie-permission-manager-policy-engine.h"
+#include "../cookie-permission-manager-policy-snapshot.h"
+#include "../cookie-permission-manager-trace.h"
+
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Recorded events and engine state */
+typedef struct _Replay		Replay;
+
+struct _Replay
+{
+	/* Recorded events */
+	GPtrArray								*readers;
+	GArray									*events;
+
+	/* Engine */
+	gchar									*databaseDirectory;
+	gchar									*databaseFilename;
+	sqlite3									*database;
+	CookiePermissionManagerStatementRegistry	*statements;
+	CookiePermissionManagerPolicySources	sources;		/* Snapshot is owned */
+};
+
+/* IMPLEMENTATION: Private variables and methods */
+
+/* Get current monotonic time in nanoseconds */
+static guint64 _replay_get_time(void)
+{
+	struct timespec		now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return(((guint64)now.tv_sec)*G_GUINT64_CONSTANT(1000000000)+(guint64)now.tv_nsec);
+}
+
+/* Read all events of trace files into memory so reading is not measured.
+ * Corrupt or truncated records are skipped and reported.
+ */
+static gboolean _replay_load_traces(Replay *self, gchar **inFilenames)
+{
+	CookiePermissionManagerTraceReader	*reader;
+	CookiePermissionManagerTraceEvent	event;
+	const CookiePermissionManagerTraceRange	*skipped;
+	guint								numberSkipped, i;
+	gchar								**filename;
+
+	for(filename=inFilenames; *filename; filename++)
+	{
+		reader=cookie_permission_manager_trace_reader_new(*filename);
+		if(!reader) return(FALSE);
+
+		g_ptr_array_add(self->readers, reader);
+
+		while(cookie_permission_manager_trace_reader_next(reader, &event))
+		{
+			g_array_append_val(self->events, event);
+		}
+
+		skipped=cookie_permission_manager_trace_reader_get_skipped(reader, &numberSkipped);
+		for(i=0; i<numberSkipped; i++)
+		{
+			g_printerr("%s: skipped %" G_GSIZE_FORMAT " corrupt or truncated bytes at offset %" G_GSIZE_FORMAT "\n",
+						*filename,
+						skipped[i].length,
+						skipped[i].start);
+		}
+	}
+
+	return(TRUE);
+}
+
+/* Copy policy database into temporary directory so the one of a running
+ * browser is neither locked nor changed by migrating it
+ */
+static gboolean _replay_copy_database(Replay *self, const gchar *inFilename)
+{
+	sqlite3				*source=NULL;
+	sqlite3_backup		*backup;
+	gchar				*error=NULL;
+	gint				success;
+
+	if(sqlite3_open_v2(inFilename, &source, SQLITE_OPEN_READONLY, NULL)!=SQLITE_OK)
+	{
+		g_printerr("Could not open database %s: %s\n", inFilename, sqlite3_errmsg(source));
+		sqlite3_close(source);
+		return(FALSE);
+	}
+	sqlite3_busy_timeout(source, COOKIE_PERMISSION_DATABASE_BUSY_TIMEOUT);
+
+	self->databaseDirectory=g_dir_make_tmp("cookie-permission-replay-XXXXXX", NULL);
+	if(!self->databaseDirectory)
+	{
+		g_printerr("Could not create temporary directory for database\n");
+		sqlite3_close(source);
+		return(FALSE);
+	}
+	self->databaseFilename=g_build_filename(self->databaseDirectory, "domains.db", NULL);
+
+	if(sqlite3_open(self->databaseFilename, &self->database)!=SQLITE_OK)
+	{
+		g_printerr("Could not create copy of database: %s\n", sqlite3_errmsg(self->database));
+		sqlite3_close(source);
+		return(FALSE);
+	}
+
+	backup=sqlite3_backup_init(self->database, "main", source, "main");
+	if(backup)
+	{
+		sqlite3_backup_step(backup, -1);
+		sqlite3_backup_finish(backup);
+	}
+	sqlite3_close(source);
+
+	success=sqlite3_errcode(self->database);
+	if(success==SQLITE_OK) success=cookie_permission_manager_database_migrate(self->database, &error);
+	if(success!=SQLITE_OK)
+	{
+		g_printerr("Could not copy database %s: %s\n", inFilename, error ? error : sqlite3_errmsg(self->database));
+		if(error) sqlite3_free(error);
+		return(FALSE);
+	}
+
+	self->statements=cookie_permission_manager_statement_registry_new(self->database);
+
+	return(TRUE);
+}
+
+/* Load all policies of domains and patterns like manager does without memory budget */
+static gboolean _replay_load_policies(Replay *self)
+{
+	CookiePermissionManagerDomainTrie	*policies;
+	CookiePermissionManagerPatternMatcher	*patterns;
+	sqlite3_stmt						*statement;
+	gint								success;
+
+	statement=cookie_permission_manager_statement_registry_get(self->statements, COOKIE_PERMISSION_MANAGER_STATEMENT_SELECT_ALL);
+	if(!statement)
+	{
+		g_printerr("SQL fails: %s\n", sqlite3_errmsg(self->database));
+		return(FALSE);
+	}
+
+	policies=cookie_permission_manager_domain_trie_new();
+	while((success=sqlite3_step(statement))==SQLITE_ROW)
+	{
+		cookie_permission_manager_domain_trie_insert(policies,
+														(gchar*)sqlite3_column_text(statement, 0),
+														sqlite3_column_int(statement, 1));
+	}
+	sqlite3_reset(statement);
+
+	if(success!=SQLITE_DONE)
+	{
+		g_printerr("SQL fails: %s\n", sqlite3_errmsg(self->database));
+		cookie_permission_manager_domain_trie_free(policies);
+		return(FALSE);
+	}
+
+	statement=cookie_permission_manager_statement_registry_get(self->statements, COOKIE_PERMISSION_MANAGER_STATEMENT_SELECT_ALL_PATTERNS);
+	if(!statement)
+	{
+		g_printerr("SQL fails: %s\n", sqlite3_errmsg(self->database));
+		cookie_permission_manager_domain_trie_free(policies);
+		return(FALSE);
+	}
+
+	patterns=cookie_permission_manager_pattern_matcher_new();
+	while((success=sqlite3_step(statement))==SQLITE_ROW)
+	{
+		cookie_permission_manager_pattern_matcher_insert(patterns,
+															(gchar*)sqlite3_column_text(statement, 0),
+															sqlite3_column_int(statement, 1));
+	}
+	sqlite3_reset(statement);
+
+	if(success!=SQLITE_DONE) g_printerr("SQL fails: %s\n", sqlite3_errmsg(self->database));
+
+	cookie_permission_manager_pattern_matcher_compile(patterns);
+
+	g_print("%u stored domains, %u patterns\n",
+			cookie_permission_manager_domain_trie_get_size(policies),
+			cookie_permission_manager_pattern_matcher_get_size(patterns));
+
+	self->sources.snapshot=cookie_permission_manager_policy_snapshot_new(policies, patterns);
+	self->sources.statements=self->statements;
+
+	return(TRUE);
+}
+
+/* Check if two events are cookies of same response. Manager records all cookies
+ * of a response with same timestamp.
+ */
+static gboolean _replay_is_same_response(const CookiePermissionManagerTraceEvent *inLeft,
+											const CookiePermissionManagerTraceEvent *inRight)
+{
+	return(inLeft->source==COOKIE_PERMISSION_MANAGER_TRACE_SOURCE_RESPONSE &&
+			inRight->source==COOKIE_PERMISSION_MANAGER_TRACE_SOURCE_RESPONSE &&
+			inLeft->timestamp==inRight->timestamp &&
+			strcmp(inLeft->firstParty, inRight->firstParty)==0);
+}
+
+/* Print number of decisions and their share of all decisions */
+static void _replay_print_outcome(const gchar *inName, guint64 inCount, guint64 inTotal)
+{
+	g_print("  %-22s %12" G_GUINT64_FORMAT " %7.2f%%\n",
+			inName,
+			inCount,
+			inTotal>0 ? (gdouble)inCount*100.0/(gdouble)inTotal : 0.0);
+}
+
+/* Replay all events and print results */
+static void _replay_run(Replay *self, guint inRepeat)
+{
+	const CookiePermissionManagerTraceEvent	*event, *previousEvent;
+	GHashTable								*policies;
+	GHashTable								*domains;
+	guint64									outcomes[COOKIE_PERMISSION_MANAGER_TRACE_SOURCE_SCRIPT+1][COOKIE_PERMISSION_MANAGER_POLICY_BLOCK+1];
+	guint64									startTime, totalTime;
+	guint64									numberEvents=0, numberResponses=0, numberScriptCookies=0, numberLookups=0;
+	gint64									traceTime=0;
+	gpointer								value;
+	gint									policy;
+	guint									i, j;
+
+	memset(outcomes, 0, sizeof(outcomes));
+	policies=g_hash_table_new(g_str_hash, g_str_equal);
+
+	startTime=_replay_get_time();
+	for(j=0; j<inRepeat; j++)
+	{
+		previousEvent=NULL;
+		for(i=0; i<self->events->len; i++)
+		{
+			event=&g_array_index(self->events, CookiePermissionManagerTraceEvent, i);
+
+			/* Policies are resolved once per domain of a response only */
+			if(!previousEvent || !_replay_is_same_response(previousEvent, event))
+			{
+				if(g_hash_table_size(policies)>0) g_hash_table_remove_all(policies);
+				if(event->source==COOKIE_PERMISSION_MANAGER_TRACE_SOURCE_RESPONSE) numberResponses++;
+					else numberScriptCookies++;
+			}
+
+			if(g_hash_table_lookup_extended(policies, event->domain, NULL, &value)) policy=GPOINTER_TO_INT(value);
+				else
+				{
+					policy=cookie_permission_manager_policy_engine_get_policy(&self->sources, event->domain);
+					numberLookups++;
+
+					if(event->source==COOKIE_PERMISSION_MANAGER_TRACE_SOURCE_RESPONSE)
+					{
+						g_hash_table_insert(policies, (gpointer)event->domain, GINT_TO_POINTER(policy));
+					}
+				}
+
+			outcomes[event->source][policy]++;
+			numberEvents++;
+			previousEvent=event;
+		}
+	}
+	totalTime=_replay_get_time()-startTime;
+
+	g_hash_table_destroy(policies);
+
+	/* Count distinct cookie domains and time span covered by trace */
+	domains=g_hash_table_new(g_str_hash, g_str_equal);
+	for(i=0; i<self->events->len; i++)
+	{
+		g_hash_table_add(domains, (gpointer)g_array_index(self->events, CookiePermissionManagerTraceEvent, i).domain);
+	}
+
+	if(self->events->len>0)
+	{
+		traceTime=g_array_index(self->events, CookiePermissionManagerTraceEvent, self->events->len-1).timestamp-
+					g_array_index(self->events, CookiePermissionManagerTraceEvent, 0).timestamp;
+	}
+
+	/* Print results */
+	g_print("%u cookies (%u distinct domains) recorded over %.1f s, replayed %u times\n\n",
+			self->events->len,
+			g_hash_table_size(domains),
+			(gdouble)MAX(traceTime, 0)/(gdouble)G_USEC_PER_SEC,
+			inRepeat);
+
+	g_hash_table_destroy(domains);
+
+	g_print("%" G_GUINT64_FORMAT " cookies of %" G_GUINT64_FORMAT " responses and %" G_GUINT64_FORMAT " from scripts with %" G_GUINT64_FORMAT " lookups in %.3f ms\n",
+			numberEvents,
+			numberResponses,
+			numberScriptCookies,
+			numberLookups,
+			(gdouble)totalTime/1e6);
+
+	g_print("%.0f cookies/s, %.0f lookups/s, %.0f ns per lookup\n\n",
+			totalTime>0 ? (gdouble)numberEvents*1e9/(gdouble)totalTime : 0.0,
+			totalTime>0 ? (gdouble)numberLookups*1e9/(gdouble)totalTime : 0.0,
+			numberLookups>0 ? (gdouble)totalTime/(gdouble)numberLookups : 0.0);
+
+	for(i=COOKIE_PERMISSION_MANAGER_TRACE_SOURCE_RESPONSE; i<=COOKIE_PERMISSION_MANAGER_TRACE_SOURCE_SCRIPT; i++)
+	{
+		guint64		total=0;
+
+		for(j=0; j<=COOKIE_PERMISSION_MANAGER_POLICY_BLOCK; j++) total+=outcomes[i][j];
+
+		g_print("%s:\n", i==COOKIE_PERMISSION_MANAGER_TRACE_SOURCE_RESPONSE ? "Cookies of responses" : "Cookies set by scripts");
+		_replay_print_outcome("accept", outcomes[i][COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT], total);
+		_replay_print_outcome("accept for session", outcomes[i][COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT_FOR_SESSION], total);
+		_replay_print_outcome("block", outcomes[i][COOKIE_PERMISSION_MANAGER_POLICY_BLOCK], total);
+		_replay_print_outcome("undetermined (ask)", outcomes[i][COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED], total);
+	}
+}
+
+/* Release events and engine */
+static void _replay_free(Replay *self)
+{
+	if(self->sources.snapshot) cookie_permission_manager_policy_snapshot_free(self->sources.snapshot);
+	if(self->statements) cookie_permission_manager_statement_registry_free(self->statements);
+	if(self->database) sqlite3_close(self->database);
+
+	if(self->databaseFilename)
+	{
+		gchar		*filename;
+
+		g_unlink(self->databaseFilename);
+
+		filename=g_strconcat(self->databaseFilename, "-wal", NULL);
+		g_unlink(filename);
+		g_free(filename);
+
+		filename=g_strconcat(self->databaseFilename, "-shm", NULL);
+		g_unlink(filename);
+		g_free(filename);
+	}
+	if(self->databaseDirectory) g_rmdir(self->databaseDirectory);
+
+	g_free(self->databaseFilename);
+	g_free(self->databaseDirectory);
+	g_array_free(self->events, TRUE);
+	g_ptr_array_free(self->readers, TRUE);
+}
+
+/* IMPLEMENTATION: Main */
+
+int main(int argc, char **argv)
+{
+	Replay						self;
+	gchar						*databaseFilename=NULL;
+	gchar						**traceFilenames=NULL;
+	gint						repeat=1;
+	gchar						*unknownPolicy=NULL;
+	gboolean					success;
+	GOptionContext				*context;
+	GError						*error=NULL;
+	GOptionEntry				entries[]=
+	{
+		{ "database", 'd', 0, G_OPTION_ARG_FILENAME, &databaseFilename, "Policy database to copy, i.e. domains.db in configuration folder of extension", "FILE" },
+		{ "repeat", 'r', 0, G_OPTION_ARG_INT, &repeat, "Number of times to replay traces", "N" },
+		{ "unknown-policy", 'u', 0, G_OPTION_ARG_STRING, &unknownPolicy, "Policy for cookies from domains without any policy if user is not asked (accept, block)", "POLICY" },
+		{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &traceFilenames, NULL, "TRACE..." },
+		{ NULL }
+	};
+
+	/* Parse command-line */
+	context=g_option_context_new("- replay recorded cookies through policy engine of cookie permission manager");
+	g_option_context_add_main_entries(context, entries, NULL);
+	if(!g_option_context_parse(context, &argc, &argv, &error))
+	{
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		g_option_context_free(context);
+		return(1);
+	}
+	g_option_context_free(context);
+
+	if(!databaseFilename || !traceFilenames || repeat<1)
+	{
+		g_printerr("A database, at least one trace file and a positive number of repeats are needed\n");
+		g_free(databaseFilename);
+		g_strfreev(traceFilenames);
+		g_free(unknownPolicy);
+		return(1);
+	}
+
+	/* Set up events and engine */
+	memset(&self, 0, sizeof(Replay));
+
+	self.sources.unknownPolicy=COOKIE_PERMISSION_MANAGER_POLICY_UNDETERMINED;
+	if(g_strcmp0(unknownPolicy, "accept")==0) self.sources.unknownPolicy=COOKIE_PERMISSION_MANAGER_POLICY_ACCEPT;
+		else if(g_strcmp0(unknownPolicy, "block")==0) self.sources.unknownPolicy=COOKIE_PERMISSION_MANAGER_POLICY_BLOCK;
+		else if(unknownPolicy)
+		{
+			g_printerr("Unknown policy: %s\n", unknownPolicy);
+			g_free(databaseFilename);
+			g_strfreev(traceFilenames);
+			g_free(unknownPolicy);
+			return(1);
+		}
+	g_free(unknownPolicy);
+
+	self.readers=g_ptr_array_new_with_free_func((GDestroyNotify)cookie_permission_manager_trace_reader_free);
+	self.events=g_array_new(FALSE, FALSE, sizeof(CookiePermissionManagerTraceEvent));
+
+	success=_replay_load_traces(&self, traceFilenames) &&
+			_replay_copy_database(&self, databaseFilename) &&
+			_replay_load_policies(&self);
+
+	if(success) _replay_run(&self, repeat);
+
+	g_free(databaseFilename);
+	g_strfreev(traceFilenames);
+	_replay_free(&self);
+
+	return(success ? 0 : 1);
+}